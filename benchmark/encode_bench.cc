@@ -0,0 +1,121 @@
+//  Copyright (c) 2017-present The blackwidow Authors.  All rights reserved.
+//  This source code is licensed under the BSD-style license found in the
+//  LICENSE file in the root directory of this source tree. An additional grant
+//  of patent rights can be found in the PATENTS file in the same directory.
+
+#include <atomic>
+#include <new>
+#include <string>
+#include <vector>
+
+#include "benchmark/benchmark.h"
+
+#include "blackwidow/blackwidow.h"
+#include "src/encode_buffer.h"
+
+using namespace blackwidow;
+
+const size_t KEY_SPACE = 1000;
+
+// Every heap allocation of the process, to report the allocations of a
+// command with short keys and with keys longer than the inline space of
+// the encoders
+static std::atomic<uint64_t> allocations(0);
+
+void* operator new(size_t size) {
+  allocations.fetch_add(1, std::memory_order_relaxed);
+  void* ptr = malloc(size);
+  if (ptr == nullptr) {
+    throw std::bad_alloc();
+  }
+  return ptr;
+}
+
+void operator delete(void* ptr) noexcept {
+  free(ptr);
+}
+
+static BlackWidow* OpenDB() {
+  BlackwidowOptions bw_options;
+  bw_options.options.create_if_missing = true;
+  BlackWidow* db = new BlackWidow();
+  Status s = db->Open(bw_options, "./db/encode");
+  if (!s.ok()) {
+    fprintf(stderr, "Open db failed, error: %s\n", s.ToString().c_str());
+    exit(-1);
+  }
+  return db;
+}
+
+static BlackWidow* db = OpenDB();
+
+// Keys of state.range(0) bytes
+static std::vector<std::string> Keys(const benchmark::State& state) {
+  std::vector<std::string> keys;
+  for (size_t idx = 0; idx < KEY_SPACE; ++idx) {
+    std::string key = "KEY_" + std::to_string(idx) + "_";
+    key.resize(state.range(0), 'k');
+    keys.push_back(key);
+  }
+  return keys;
+}
+
+template <typename Command>
+static void RunCommands(benchmark::State& state, const Command& command) {
+  std::vector<std::string> keys = Keys(state);
+  size_t idx = 0;
+  uint64_t start_allocations = allocations.load();
+  uint64_t start_scratch_allocations = ScratchBuffers::Allocations();
+  for (auto _ : state) {
+    command(keys[idx++ % KEY_SPACE]);
+  }
+  state.counters["allocs_per_op"] =
+    static_cast<double>(allocations.load() - start_allocations)
+    / state.iterations();
+  state.counters["scratch_allocs_per_op"] =
+    static_cast<double>(ScratchBuffers::Allocations()
+                        - start_scratch_allocations) / state.iterations();
+}
+
+static void BenchHSet(benchmark::State& state) {
+  int32_t ret;
+  RunCommands(state, [&ret](const std::string& key) {
+    db->HSet(key, "FIELD", "VALUE", &ret);
+  });
+}
+
+static void BenchHGet(benchmark::State& state) {
+  std::string value;
+  RunCommands(state, [&value](const std::string& key) {
+    db->HGet(key, "FIELD", &value);
+  });
+}
+
+static void BenchSAdd(benchmark::State& state) {
+  int32_t ret;
+  RunCommands(state, [&ret](const std::string& key) {
+    db->SAdd(key, {"MEMBER"}, &ret);
+  });
+}
+
+static void BenchZAdd(benchmark::State& state) {
+  int32_t ret;
+  RunCommands(state, [&ret](const std::string& key) {
+    db->ZAdd(key, {{1, "MEMBER"}}, &ret);
+  });
+}
+
+static void BenchRPush(benchmark::State& state) {
+  uint64_t len;
+  RunCommands(state, [&len](const std::string& key) {
+    db->RPush(key, {"NODE"}, &len);
+  });
+}
+
+BENCHMARK(BenchHSet)->Arg(16)->Arg(256);
+BENCHMARK(BenchHGet)->Arg(16)->Arg(256);
+BENCHMARK(BenchSAdd)->Arg(16)->Arg(256);
+BENCHMARK(BenchZAdd)->Arg(16)->Arg(256);
+BENCHMARK(BenchRPush)->Arg(16)->Arg(256);
+
+BENCHMARK_MAIN();
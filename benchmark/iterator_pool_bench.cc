@@ -0,0 +1,96 @@
+//  Copyright (c) 2017-present The blackwidow Authors.  All rights reserved.
+//  This source code is licensed under the BSD-style license found in the
+//  LICENSE file in the root directory of this source tree. An additional grant
+//  of patent rights can be found in the PATENTS file in the same directory.
+
+#include <atomic>
+#include <string>
+#include <vector>
+
+#include "benchmark/benchmark.h"
+
+#include "blackwidow/blackwidow.h"
+
+using namespace blackwidow;
+
+const size_t KEY_SPACE = 10000;
+const size_t FIELD_NUM = 8;
+const size_t ITERATOR_POOL_SIZE = 64;
+
+// The same small collections in a db reading with new iterators and in
+// one reading with pooled iterators
+static BlackWidow* OpenDB(const std::string& path, size_t iterator_pool_size) {
+  BlackwidowOptions bw_options;
+  bw_options.options.create_if_missing = true;
+  bw_options.iterator_pool_size = iterator_pool_size;
+  BlackWidow* db = new BlackWidow();
+  Status s = db->Open(bw_options, path);
+  if (!s.ok()) {
+    fprintf(stderr, "Open db failed, error: %s\n", s.ToString().c_str());
+    exit(-1);
+  }
+
+  int32_t ret;
+  std::vector<FieldValue> fvs;
+  std::vector<std::string> members;
+  std::vector<ScoreMember> score_members;
+  for (size_t idx = 0; idx < FIELD_NUM; ++idx) {
+    std::string element = "element_" + std::to_string(idx);
+    fvs.push_back({element, "value_" + std::to_string(idx)});
+    members.push_back(element);
+    score_members.push_back({static_cast<double>(idx), element});
+  }
+  for (size_t idx = 0; idx < KEY_SPACE; ++idx) {
+    std::string key = "KEY_" + std::to_string(idx);
+    db->HMSet(key, fvs);
+    db->SAdd(key, members, &ret);
+    db->ZAdd(key, score_members, &ret);
+  }
+  return db;
+}
+
+static BlackWidow* dbs[2] = {
+  OpenDB("./db/no_pool", 0),
+  OpenDB("./db/pool", ITERATOR_POOL_SIZE)
+};
+static std::atomic<size_t> start_pos(0);
+
+// state.range(0) picks the db, 1 reads with pooled iterators
+template <typename Read>
+static void RunReads(benchmark::State& state, const Read& read) {
+  BlackWidow* db = dbs[state.range(0)];
+  size_t pos = start_pos.fetch_add(KEY_SPACE / 16);
+  for (auto _ : state) {
+    read(db, "KEY_" + std::to_string(pos++ % KEY_SPACE));
+  }
+  state.SetItemsProcessed(state.iterations());
+}
+
+static void BenchHGetall(benchmark::State& state) {
+  std::vector<FieldValue> fvs;
+  RunReads(state, [&fvs](BlackWidow* db, const std::string& key) {
+    fvs.clear();
+    db->HGetall(key, &fvs);
+  });
+}
+
+static void BenchSMembers(benchmark::State& state) {
+  std::vector<std::string> members;
+  RunReads(state, [&members](BlackWidow* db, const std::string& key) {
+    members.clear();
+    db->SMembers(key, &members);
+  });
+}
+
+static void BenchZRange(benchmark::State& state) {
+  std::vector<ScoreMember> score_members;
+  RunReads(state, [&score_members](BlackWidow* db, const std::string& key) {
+    db->ZRange(key, 0, -1, &score_members);
+  });
+}
+
+BENCHMARK(BenchHGetall)->Arg(0)->Arg(1)->ThreadRange(1, 16)->UseRealTime();
+BENCHMARK(BenchSMembers)->Arg(0)->Arg(1)->ThreadRange(1, 16)->UseRealTime();
+BENCHMARK(BenchZRange)->Arg(0)->Arg(1)->ThreadRange(1, 16)->UseRealTime();
+
+BENCHMARK_MAIN();
@@ -0,0 +1,79 @@
+//  Copyright (c) 2017-present The blackwidow Authors.  All rights reserved.
+//  This source code is licensed under the BSD-style license found in the
+//  LICENSE file in the root directory of this source tree. An additional grant
+//  of patent rights can be found in the PATENTS file in the same directory.
+
+#include <atomic>
+#include <string>
+#include <vector>
+
+#include "benchmark/benchmark.h"
+
+#include "blackwidow/blackwidow.h"
+#include "src/lru_cache.h"
+#include "src/sharded_lru_cache.h"
+
+using namespace blackwidow;
+
+const size_t CACHE_CAPACITY = 5000;
+const size_t KEY_SPACE = 20000;
+
+static std::vector<std::string> NewKeys() {
+  std::vector<std::string> keys;
+  for (size_t idx = 0; idx < KEY_SPACE; ++idx) {
+    keys.push_back("h_KEY_*_" + std::to_string(idx));
+  }
+  return keys;
+}
+
+template <typename Cache>
+static Cache* NewCache(Cache* cache) {
+  cache->SetCapacity(CACHE_CAPACITY);
+  return cache;
+}
+
+static const std::vector<std::string> keys = NewKeys();
+static std::atomic<size_t> start_pos(0);
+
+static LRUCache<std::string, std::string>* lru_cache =
+  NewCache(new LRUCache<std::string, std::string>());
+static ShardedLRUCache<std::string, std::string>* sharded_cache =
+  NewCache(new ShardedLRUCache<std::string, std::string>());
+static ShardedLRUCache<std::string, std::string>* clock_cache =
+  NewCache(new ShardedLRUCache<std::string, std::string>(
+      4, CacheEvictionPolicy::kClock));
+
+// Mix of cursor lookups and inserts as done by the scan commands,
+// 3 lookups for 1 insert, every thread starts at another key
+template <typename Cache>
+static void RunCacheOps(benchmark::State& state, Cache* cache) {
+  std::string value;
+  size_t pos = start_pos.fetch_add(KEY_SPACE / 16);
+  for (auto _ : state) {
+    const std::string& key = keys[pos++ % KEY_SPACE];
+    if (pos % 4 == 0) {
+      cache->Insert(key, key);
+    } else {
+      cache->Lookup(key, &value);
+    }
+  }
+  state.SetItemsProcessed(state.iterations());
+}
+
+static void BenchLRUCache(benchmark::State& state) {
+  RunCacheOps(state, lru_cache);
+}
+
+static void BenchShardedLRUCache(benchmark::State& state) {
+  RunCacheOps(state, sharded_cache);
+}
+
+static void BenchShardedClockCache(benchmark::State& state) {
+  RunCacheOps(state, clock_cache);
+}
+
+BENCHMARK(BenchLRUCache)->ThreadRange(1, 16)->UseRealTime();
+BENCHMARK(BenchShardedLRUCache)->ThreadRange(1, 16)->UseRealTime();
+BENCHMARK(BenchShardedClockCache)->ThreadRange(1, 16)->UseRealTime();
+
+BENCHMARK_MAIN();
@@ -0,0 +1,101 @@
+//  Copyright (c) 2017-present The blackwidow Authors.  All rights reserved.
+//  This source code is licensed under the BSD-style license found in the
+//  LICENSE file in the root directory of this source tree. An additional grant
+//  of patent rights can be found in the PATENTS file in the same directory.
+
+#include <string>
+#include <vector>
+
+#include "benchmark/benchmark.h"
+
+#include "blackwidow/blackwidow.h"
+
+using namespace blackwidow;
+
+const size_t KEY_SPACE = 256;
+const size_t BLOCK_CACHE_SIZE = 256 << 20;
+
+// Values of 1KB and 100KB, all of them in the block cache
+static BlackWidow* OpenDB() {
+  BlackwidowOptions bw_options;
+  bw_options.options.create_if_missing = true;
+  bw_options.block_cache_size = BLOCK_CACHE_SIZE;
+  BlackWidow* db = new BlackWidow();
+  Status s = db->Open(bw_options, "./db/pinnable_get");
+  if (!s.ok()) {
+    fprintf(stderr, "Open db failed, error: %s\n", s.ToString().c_str());
+    exit(-1);
+  }
+
+  int32_t ret;
+  for (size_t idx = 0; idx < KEY_SPACE; ++idx) {
+    db->Set("KEY_1K_" + std::to_string(idx), std::string(1024, 'a'));
+    db->Set("KEY_100K_" + std::to_string(idx), std::string(100 * 1024, 'a'));
+    db->HSet("HASH_KEY", "FIELD_100K_" + std::to_string(idx),
+             std::string(100 * 1024, 'a'), &ret);
+  }
+  return db;
+}
+
+static BlackWidow* db = OpenDB();
+
+static std::string Key(const benchmark::State& state, size_t idx) {
+  return (state.range(0) == 1024 ? "KEY_1K_" : "KEY_100K_")
+    + std::to_string(idx % KEY_SPACE);
+}
+
+// Every read ends in the reply buffer of the caller, like a GET reply
+static void BenchGet(benchmark::State& state) {
+  std::string value;
+  std::string reply;
+  size_t idx = 0;
+  for (auto _ : state) {
+    db->Get(Key(state, idx++), &value);
+    reply.assign(value);
+  }
+  state.SetBytesProcessed(state.iterations() * state.range(0));
+}
+
+static void BenchPinnableGet(benchmark::State& state) {
+  PinnableSlice value;
+  std::string reply;
+  size_t idx = 0;
+  for (auto _ : state) {
+    db->Get(Key(state, idx++), &value);
+    reply.assign(value.data(), value.size());
+    value.Reset();
+  }
+  state.SetBytesProcessed(state.iterations() * state.range(0));
+}
+
+static void BenchHGet(benchmark::State& state) {
+  std::string value;
+  std::string reply;
+  size_t idx = 0;
+  for (auto _ : state) {
+    db->HGet("HASH_KEY", "FIELD_100K_" + std::to_string(idx++ % KEY_SPACE),
+             &value);
+    reply.assign(value);
+  }
+  state.SetBytesProcessed(state.iterations() * 100 * 1024);
+}
+
+static void BenchPinnableHGet(benchmark::State& state) {
+  PinnableSlice value;
+  std::string reply;
+  size_t idx = 0;
+  for (auto _ : state) {
+    db->HGet("HASH_KEY", "FIELD_100K_" + std::to_string(idx++ % KEY_SPACE),
+             &value);
+    reply.assign(value.data(), value.size());
+    value.Reset();
+  }
+  state.SetBytesProcessed(state.iterations() * 100 * 1024);
+}
+
+BENCHMARK(BenchGet)->Arg(1024)->Arg(100 * 1024)->ThreadRange(1, 8);
+BENCHMARK(BenchPinnableGet)->Arg(1024)->Arg(100 * 1024)->ThreadRange(1, 8);
+BENCHMARK(BenchHGet)->ThreadRange(1, 8);
+BENCHMARK(BenchPinnableHGet)->ThreadRange(1, 8);
+
+BENCHMARK_MAIN();
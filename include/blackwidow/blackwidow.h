@@ -11,6 +11,7 @@
 #include <list>
 #include <queue>
 #include <vector>
+#include <functional>
 #include <unistd.h>
 
 #include "rocksdb/status.h"
@@ -30,6 +31,9 @@ const double ZSET_SCORE_MIN = std::numeric_limits<double>::lowest();
 const std::string PROPERTY_TYPE_ROCKSDB_MEMTABLE = "rocksdb.cur-size-all-mem-tables";
 const std::string PROPERTY_TYPE_ROCKSDB_TABLE_READER = "rocksdb.estimate-table-readers-mem";
 const std::string PROPERTY_TYPE_ROCKSDB_BACKGROUND_ERRORS  = "rocksdb.background-errors";
+const std::string PROPERTY_TYPE_BLACKWIDOW_EXPIRED_RECLAIMED = "blackwidow.expired-reclaimed-bytes";
+const std::string PROPERTY_TYPE_BLACKWIDOW_WRITE_BUFFER_USAGE = "blackwidow.write-buffer-usage";
+const std::string PROPERTY_TYPE_BLACKWIDOW_WRITE_BUFFER_LIMIT = "blackwidow.write-buffer-limit";
 
 const std::string ALL_DB = "all";
 const std::string STRINGS_DB = "strings";
@@ -40,25 +44,38 @@ const std::string SETS_DB = "sets";
 
 const size_t BATCH_DELETE_LIMIT = 100;
 const size_t COMPACT_THRESHOLD_COUNT = 2000;
+const size_t GARBAGE_COMPACTION_MAX_FILES = 8;
+const size_t LOCK_STATS_TOP_K = 10;
 
 using Options = rocksdb::Options;
 using BlockBasedTableOptions = rocksdb::BlockBasedTableOptions;
 using Status = rocksdb::Status;
 using Slice = rocksdb::Slice;
+using PinnableSlice = rocksdb::PinnableSlice;
 
 class Mutex;
+class Redis;
 class RedisStrings;
 class RedisHashes;
 class RedisSets;
 class RedisLists;
 class RedisZSets;
 class HyperLogLog;
+class HotKeys;
+class ReplySink;
+class BGTaskScheduler;
+class MemoryBudget;
+class KeyRangeWorkers;
 enum class OptionType;
+enum DataType : int;
 
 
 template <typename T1, typename T2>
 class LRUCache;
 
+template <typename T1, typename T2>
+class ShardedLRUCache;
+
 struct BlackwidowOptions {
   rocksdb::Options options;
   rocksdb::BlockBasedTableOptions table_options;
@@ -66,12 +83,70 @@ struct BlackwidowOptions {
   bool share_block_cache;
   size_t statistics_max_size;
   size_t small_compaction_threshold;
+  size_t max_bg_task_threads;
+  // SSTs whose deletions, stale versions and expired records exceed this
+  // ratio of their entries are compacted. Off (0) by default, set it to a
+  // ratio such as 0.5 to let rocksdb and CompactGarbage pick those SSTs
+  double garbage_compaction_ratio;
+  // Interval in seconds of the job compacting SSTs that are mostly
+  // expired. Off (0) by default, it also needs garbage_compaction_ratio
+  uint32_t expired_compaction_interval;
+  // Collect the per command latency reported by GetCommandStats
+  bool enable_command_stats;
+  // Track the key lock waits reported by GetLockStats
+  bool enable_lock_stats;
+  // Record lock slots of every type, rounded up to a power of two. Keys
+  // hashing to the same slot are locked together, so fewer slots make
+  // unrelated keys wait for each other more often
+  size_t lock_slots;
+  // Record 1 out of hot_keys_sample_rate key accesses for GetHotKeys,
+  // 0 disables it
+  uint32_t hot_keys_sample_rate;
+  // Threads scanning the key ranges of Keys, GetKeyNum and
+  // PKPatternMatchDel in parallel, 1 scans every database in one go
+  size_t keyspace_scan_threads;
+  // Concurrent HIncrby, SAdd and ZIncrby of the same key are applied
+  // together by the thread holding the key lock
+  bool combine_hot_key_writes;
+  // Idle iterators kept per data column family for HGetall, HScan and
+  // SMembers reading at most scan_large_read_threshold elements. These
+  // take no snapshot and the pooled iterators read the latest data after
+  // their meta, the reads at a snapshot never use them. 0 disables it
+  size_t iterator_pool_size;
+  // Collection reads of more elements than scan_large_read_threshold,
+  // and the keyspace scans, read ahead scan_readahead_size bytes and do
+  // not fill the block cache, the smaller reads fill it
+  uint64_t scan_large_read_threshold;
+  size_t scan_readahead_size;
+  // Bytes of the block cache shared by all the column families, to which
+  // the memtables are charged too, 0 disables it and keeps the caches
+  // and memtable limits of block_cache_size and options
+  size_t memory_budget;
+  // Part of memory_budget, in (0, 1], the memtables of all the types may
+  // fill before they are flushed, split across the types by
+  // memory_budget_weights, a missing type weighs 1
+  double memory_budget_write_buffer_ratio;
+  std::map<DataType, double> memory_budget_weights;
 
   explicit BlackwidowOptions()
       : block_cache_size(0),
         share_block_cache(false),
         statistics_max_size(0),
-        small_compaction_threshold(5000) {}
+        small_compaction_threshold(5000),
+        max_bg_task_threads(2),
+        garbage_compaction_ratio(0),
+        expired_compaction_interval(0),
+        enable_command_stats(false),
+        enable_lock_stats(false),
+        lock_slots(16384),
+        hot_keys_sample_rate(0),
+        keyspace_scan_threads(1),
+        combine_hot_key_writes(false),
+        iterator_pool_size(0),
+        scan_large_read_threshold(1024),
+        scan_readahead_size(2 * 1024 * 1024),
+        memory_budget(0),
+        memory_budget_write_buffer_ratio(0.25) {}
 
   Status ResetOptions(const OptionType& option_type,
                       const std::unordered_map<std::string, std::string>& options_map);
@@ -95,6 +170,57 @@ struct KeyInfo {
   uint64_t invaild_keys;
 };
 
+struct KeySize {
+  std::string key;
+  uint64_t size;
+};
+
+// Sizes of the keys of a data type, the value bytes for strings and the
+// number of elements for the other types
+struct KeySizeStats {
+  uint64_t keys;
+  uint64_t total_size;
+  // histogram[i] counts the keys whose size is in [2^(i-1), 2^i),
+  // histogram[0] the empty strings
+  std::vector<uint64_t> histogram;
+  // The largest keys, largest first
+  std::vector<KeySize> largest_keys;
+
+  KeySizeStats() : keys(0), total_size(0) {}
+};
+
+struct KeyspaceAnalysisOptions {
+  // Length of the largest keys list of every type
+  size_t top_n;
+  // Keys read per second, 0 for no limit
+  uint64_t max_keys_per_sec;
+  // The report is written to this file once the analysis is done,
+  // nothing is written if empty. The keys are double quoted with the
+  // quotes, backslashes and non printable bytes escaped as in C
+  // strings
+  std::string result_path;
+
+  KeyspaceAnalysisOptions()
+      : top_n(20),
+        max_keys_per_sec(100000) {}
+};
+
+struct KeyspaceAnalysis {
+  bool running;
+  // False if the analysis was stopped before the end
+  bool completed;
+  int64_t start_time;
+  int64_t end_time;
+  uint64_t scanned_keys;
+  // Same db order as GetKeyNum, string, hash, list, zset, set, the types
+  // not analyzed yet are empty
+  std::vector<KeySizeStats> type_stats;
+
+  KeyspaceAnalysis()
+      : running(false), completed(false),
+        start_time(0), end_time(0), scanned_keys(0) {}
+};
+
 struct ValueStatus {
   std::string value;
   Status status;
@@ -127,12 +253,21 @@ struct ScoreMember {
   }
 };
 
+// Called with the entries of a streamed read in the order of the reply,
+// the slices are only valid during the call. Returning false stops the
+// read, which still returns OK.
+typedef std::function<bool(const Slice& element)> ElementVisitor;
+typedef std::function<bool(const Slice& field,
+                           const Slice& value)> FieldValueVisitor;
+typedef std::function<bool(double score,
+                           const Slice& member)> ScoreMemberVisitor;
+
 enum BeforeOrAfter {
   Before,
   After
 };
 
-enum DataType {
+enum DataType : int {
   kAll,
   kStrings,
   kHashes,
@@ -178,7 +313,10 @@ enum Operation {
   kCleanZSets,
   kCleanSets,
   kCleanLists,
-  kCompactKey
+  kCompactKey,
+  kCompactGarbage,
+  kCompactExpired,
+  kAnalyzeKeyspace
 };
 
 struct BGTask {
@@ -191,6 +329,123 @@ struct BGTask {
          const std::string& _argv = "") : type(_type), operation(_opeation), argv(_argv) {}
 };
 
+// Background tasks are served from the lowest priority value first,
+// a compaction of a single key never waits behind a whole db compaction
+enum BGTaskPriority {
+  kKeyPriority = 0,
+  kTypePriority,
+  kFullPriority,
+  kPriorityNum
+};
+
+struct BGTaskTiming {
+  uint64_t count;
+  uint64_t total_micros;
+  uint64_t max_micros;
+  uint64_t last_micros;
+};
+
+struct BGTaskStats {
+  uint64_t pending;
+  uint64_t running;
+  uint64_t workers;
+  uint64_t scheduled;
+  uint64_t coalesced;
+  uint64_t cancelled;
+  uint64_t pending_by_priority[kPriorityNum];
+  BGTaskTiming timing_by_priority[kPriorityNum];
+};
+
+// Where the time of a command goes, kPhaseTotal is the whole command
+enum CommandPhase {
+  kPhaseTotal = 0,
+  kPhaseLockWait,
+  kPhaseMetaRead,
+  kPhaseDataIO,
+  kPhaseWrite,
+  kPhaseNum
+};
+
+// Percentiles are approximated by a log-linear histogram and are
+// precise to within 1/8 of the value
+struct LatencyStats {
+  uint64_t count;
+  uint64_t total_micros;
+  uint64_t max_micros;
+  uint64_t p50_micros;
+  uint64_t p99_micros;
+  uint64_t p999_micros;
+};
+
+struct CommandStats {
+  std::string command;
+  uint64_t calls;
+  // Calls per second since the stats were last reset
+  double qps;
+  LatencyStats latency[kPhaseNum];
+};
+
+struct LockStripeStats {
+  uint64_t stripe;
+  uint64_t waits;
+  uint64_t wait_micros;
+  uint64_t max_wait_micros;
+};
+
+// Estimated from the sampled waits
+struct LockKeyStats {
+  std::string key;
+  uint64_t waits;
+  uint64_t wait_micros;
+};
+
+// Waits for record locks held by another command, the hot stripes and
+// keys are the LOCK_STATS_TOP_K most waited for
+struct LockStats {
+  uint64_t acquisitions;
+  uint64_t waits;
+  uint64_t total_wait_micros;
+  uint64_t max_wait_micros;
+  std::vector<LockStripeStats> hot_stripes;
+  std::vector<LockKeyStats> hot_keys;
+};
+
+// Range reads by the read options the scan policy picked for them
+// since the last reset
+struct ScanPolicyStats {
+  uint64_t large_read_threshold;
+  uint64_t readahead_size;
+  uint64_t small_reads;
+  uint64_t large_reads;
+  uint64_t keyspace_scans;
+};
+
+// Estimated accesses of a key since the last reset
+struct HotKey {
+  std::string key;
+  uint64_t reads;
+  uint64_t writes;
+};
+
+// Bounds the waits for the record locks of the commands run by this
+// thread within the scope: a command returns Status::TimedOut instead
+// of waiting more than timeout_micros for a key held by another command,
+// or Status::Busy right away when timeout_micros is 0. The innermost
+// scope applies. A command failing so changed nothing, those changing
+// several types report the types they skipped in type_status.
+class LockDeadline {
+ public:
+  explicit LockDeadline(uint64_t timeout_micros);
+  ~LockDeadline();
+
+ private:
+  uint64_t prev_deadline_micros_;
+
+  // No copying allowed
+  LockDeadline(const LockDeadline&);
+  void operator=(const LockDeadline&);
+};
+
 class BlackWidow {
  public:
   BlackWidow();
@@ -214,6 +469,9 @@ class BlackWidow {
   // Get the value of key. If the key does not exist
   // the special value nil is returned
   Status Get(const Slice& key, std::string* value);
+  // Pins the value in the block cache or memtable instead of copying
+  // it, the value stays valid until it is reset or destroyed
+  Status Get(const Slice& key, PinnableSlice* value);
 
   // Atomically sets key to value and returns the old value stored at key
   // Returns an error when key exists but does not hold a string value.
@@ -234,6 +492,10 @@ class BlackWidow {
   // special value nil is returned
   Status MGet(const std::vector<std::string>& keys,
               std::vector<ValueStatus>* vss);
+  // Pins the values like Get, values and statuses are arrays of
+  // keys.size() elements as in rocksdb::DB::MultiGet
+  Status MGet(const std::vector<std::string>& keys,
+              PinnableSlice* values, Status* statuses);
 
   // Set key to hold string value if key does not exist
   // return 1 if the key was set
@@ -333,6 +595,7 @@ class BlackWidow {
   // the value associated with field, or nil when field is not present in the
   // hash or key does not exist.
   Status HGet(const Slice& key, const Slice& field, std::string* value);
+  Status HGet(const Slice& key, const Slice& field, PinnableSlice* value);
 
   // Sets the specified fields to their respective values in the hash stored at
   // key. This command overwrites any specified fields already existing in the
@@ -354,14 +617,27 @@ class BlackWidow {
   // reply is twice the size of the hash.
   Status HGetall(const Slice& key,
                  std::vector<FieldValue>* fvs);
+  // Streams the fields and values to visitor instead
+  Status HGetall(const Slice& key,
+                 const FieldValueVisitor& visitor);
+  // Writes the reply into sink, a map of the fields and values, empty
+  // for a missing key. On any other error the caller drops what was
+  // written. The other sink overloads write an array the same way.
+  Status HGetall(const Slice& key, ReplySink* sink);
 
   // Returns all field names in the hash stored at key.
   Status HKeys(const Slice& key,
                std::vector<std::string>* fields);
+  Status HKeys(const Slice& key,
+               const ElementVisitor& visitor);
+  Status HKeys(const Slice& key, ReplySink* sink);
 
   // Returns all values in the hash stored at key.
   Status HVals(const Slice& key,
                std::vector<std::string>* values);
+  Status HVals(const Slice& key,
+               const ElementVisitor& visitor);
+  Status HVals(const Slice& key, ReplySink* sink);
 
   // Sets field in the hash stored at key to value, only if field does not yet
   // exist. If key does not exist, a new key holding a hash is created. If field
@@ -413,6 +689,10 @@ class BlackWidow {
   Status HScan(const Slice& key, int64_t cursor, const std::string& pattern,
                int64_t count, std::vector<FieldValue>* field_values, int64_t* next_cursor);
 
+  // See the Scan with a string cursor for its documentation.
+  Status HScan(const Slice& key, const std::string& cursor, const std::string& pattern,
+               int64_t count, std::vector<FieldValue>* field_values, std::string* next_cursor);
+
   // Iterate over a Hash table of fields
   // return next_field that the user need to use as the start_field argument
   // in the next call
@@ -504,6 +784,8 @@ class BlackWidow {
   // Returns all the members of the set value stored at key.
   // This has the same effect as running SINTER with one argument key.
   Status SMembers(const Slice& key, std::vector<std::string>* members);
+  Status SMembers(const Slice& key, const ElementVisitor& visitor);
+  Status SMembers(const Slice& key, ReplySink* sink);
 
   // Remove the specified members from the set stored at key. Specified members
   // that are not a member of this set are ignored. If key does not exist, it is
@@ -546,6 +828,10 @@ class BlackWidow {
   //   SUNION key1 key2 key3 = {a, b, c, d, e}
   Status SUnion(const std::vector<std::string>& keys,
                 std::vector<std::string>* members);
+  // Streams the members without keeping the ones already visited, a
+  // member of a set is looked up in the sets before it instead
+  Status SUnion(const std::vector<std::string>& keys,
+                const ElementVisitor& visitor);
 
   // This command is equal to SUNION, but instead of returning the resulting
   // set, it is stored in destination.
@@ -565,6 +851,10 @@ class BlackWidow {
   Status SScan(const Slice& key, int64_t cursor, const std::string& pattern,
                int64_t count, std::vector<std::string>* members, int64_t* next_cursor);
 
+  // See the Scan with a string cursor for its documentation.
+  Status SScan(const Slice& key, const std::string& cursor, const std::string& pattern,
+               int64_t count, std::vector<std::string>* members, std::string* next_cursor);
+
   // Lists Commands
 
   // Insert all the specified values at the head of the list stored at key. If
@@ -584,6 +874,10 @@ class BlackWidow {
   // (the head of the list), 1 being the next element and so on.
   Status LRange(const Slice& key, int64_t start, int64_t stop,
                 std::vector<std::string>* ret);
+  Status LRange(const Slice& key, int64_t start, int64_t stop,
+                const ElementVisitor& visitor);
+  Status LRange(const Slice& key, int64_t start, int64_t stop,
+                ReplySink* sink);
 
   // Removes the first count occurrences of elements equal to value from the
   // list stored at key. The count argument influences the operation in the
@@ -764,6 +1058,17 @@ class BlackWidow {
                 int32_t start,
                 int32_t stop,
                 std::vector<ScoreMember>* score_members);
+  Status ZRange(const Slice& key,
+                int32_t start,
+                int32_t stop,
+                const ScoreMemberVisitor& visitor);
+  // Writes the members, or the pairs of members and scores with_scores,
+  // into sink
+  Status ZRange(const Slice& key,
+                int32_t start,
+                int32_t stop,
+                bool with_scores,
+                ReplySink* sink);
 
   // Returns all the elements in the sorted set at key with a score between min
   // and max (including elements with score equal to min or max). The elements
@@ -852,6 +1157,14 @@ class BlackWidow {
                        int64_t count,
                        int64_t offset,
                        std::vector<ScoreMember>* score_members);
+  Status ZRangebyscore(const Slice& key,
+                       double min,
+                       double max,
+                       bool left_close,
+                       bool right_close,
+                       int64_t count,
+                       int64_t offset,
+                       const ScoreMemberVisitor& visitor);
 
   // Returns the rank of member in the sorted set stored at key, with the scores
   // ordered from low to high. The rank (or index) is 0-based, which means that
@@ -902,6 +1215,15 @@ class BlackWidow {
                    int32_t start,
                    int32_t stop,
                    std::vector<ScoreMember>* score_members);
+  Status ZRevrange(const Slice& key,
+                   int32_t start,
+                   int32_t stop,
+                   const ScoreMemberVisitor& visitor);
+  Status ZRevrange(const Slice& key,
+                   int32_t start,
+                   int32_t stop,
+                   bool with_scores,
+                   ReplySink* sink);
 
   // Returns all the elements in the sorted set at key with a score between max
   // and min (including elements with score equal to max or min). In contrary to
@@ -938,6 +1260,14 @@ class BlackWidow {
                           int64_t count,
                           int64_t offset,
                           std::vector<ScoreMember>* score_members);
+  Status ZRevrangebyscore(const Slice& key,
+                          double min,
+                          double max,
+                          bool left_close,
+                          bool right_close,
+                          int64_t count,
+                          int64_t offset,
+                          const ScoreMemberVisitor& visitor);
 
   // Returns the rank of member in the sorted set stored at key, with the scores
   // ordered from high to low. The rank (or index) is 0-based, which means that
@@ -1058,11 +1388,19 @@ class BlackWidow {
   Status ZScan(const Slice& key, int64_t cursor, const std::string& pattern,
                int64_t count, std::vector<ScoreMember>* score_members, int64_t* next_cursor);
 
+  // See the Scan with a string cursor for its documentation.
+  Status ZScan(const Slice& key, const std::string& cursor, const std::string& pattern,
+               int64_t count, std::vector<ScoreMember>* score_members, std::string* next_cursor);
+
   // Keys Commands
 
   // Note:
   // While any error happens, you need to check type_status for
-  // the error message
+  // the error message. The types whose record lock was not taken before
+  // the LockDeadline are skipped with Status::Busy or Status::TimedOut
+  // in type_status, and the result counts the changes made to the other
+  // types instead of being -1, so the command can be run again for the
+  // skipped ones
 
   // Set a timeout on key
   // return -1 operation exception errors happen in database
@@ -1076,7 +1414,8 @@ class BlackWidow {
   int64_t Del(const std::vector<std::string>& keys,
               std::map<DataType, Status>* type_status);
 
-  // Removes the specified keys of the specified type
+  // Removes the specified keys of the specified type, the keys whose
+  // record lock was not taken before the LockDeadline are skipped
   // return -1 operation exception errors happen in database
   // return >= 0 the number of keys that were removed
   int64_t DelByType(const std::vector<std::string>& keys,
@@ -1089,6 +1428,13 @@ class BlackWidow {
                const std::string& pattern, int64_t count,
                std::vector<std::string>* keys);
 
+  // Same as Scan, but the position is kept in the returned cursor instead
+  // of the cursors store, so a scan never restarts because of evictions.
+  // An empty cursor starts the scan, an empty next_cursor ends it
+  Status Scan(const DataType& dtype, const std::string& cursor,
+              const std::string& pattern, int64_t count,
+              std::vector<std::string>* keys, std::string* next_cursor);
+
   // Iterate over a collection of elements, obtaining the item which timeout
   // conforms to the inequality (min_ttl < item_ttl < max_ttl)
   // return an updated cursor that the user need to use as the cursor argument
@@ -1169,6 +1515,10 @@ class BlackWidow {
   Status Keys(const DataType& data_type,
               const std::string& pattern,
               std::vector<std::string>* keys);
+  // Streams the keys of one db after the other, from the calling thread
+  Status Keys(const DataType& data_type,
+              const std::string& pattern,
+              const ElementVisitor& visitor);
 
 
   // Iterate through all the data in the database.
@@ -1196,13 +1546,36 @@ class BlackWidow {
 
   // Admin Commands
   Status StartBGThread();
-  Status RunBGTask();
+  Status RunBGTask(const BGTask& bg_task);
+
+  // Queue a background task, a pending task equal to bg_task is coalesced
   Status AddBGTask(const BGTask& bg_task);
 
+  // Drop a pending background task, return Status::NotFound if
+  // it is not queued (tasks that already started can not be cancelled)
+  Status CancelBGTask(const BGTask& bg_task);
+
+  // Drop all pending background tasks
+  Status CancelAllBGTasks();
+
+  // Queue depth, worker usage and per priority timing of background tasks
+  Status GetBGTaskStats(BGTaskStats* stats);
+
   Status Compact(const DataType& type, bool sync = false);
   Status DoCompact(const DataType& type);
   Status CompactKey(const DataType& type, const std::string& key);
 
+  // Compact the SSTs holding the most garbage according to their
+  // table properties
+  Status CompactGarbage(const DataType& type, bool sync = false);
+  Status DoCompactGarbage(const DataType& type);
+
+  // Compact the SSTs whose records are mostly expired by now and the
+  // data of their keys, an estimate of the disk space reclaimed is
+  // reported by PROPERTY_TYPE_BLACKWIDOW_EXPIRED_RECLAIMED
+  Status CompactExpired(const DataType& type, bool sync = false);
+  Status DoCompactExpired(const DataType& type);
+
   Status SetMaxCacheStatisticKeys(uint32_t max_cache_statistic_keys);
   Status SetSmallCompactionThreshold(uint32_t small_compaction_threshold);
 
@@ -1212,8 +1585,58 @@ class BlackWidow {
                   std::map<std::string, uint64_t>* const type_result);
   uint64_t GetProperty(const std::string& db_type, const std::string& property);
 
+  // Calls and latency of every command run since the last reset, the
+  // counters are shared by all BlackWidow instances of the process
+  void EnableCommandStats(bool enable);
+  Status GetCommandStats(std::vector<CommandStats>* stats);
+  Status ResetCommandStats();
+
+  // Record lock contention of every db type, keyed by the db type names
+  // (STRINGS_DB, HASHES_DB ...)
+  void EnableLockStats(bool enable);
+  Status GetLockStats(std::map<std::string, LockStats>* type_stats);
+  Status ResetLockStats();
+
+  // Let the thread holding the lock of a key apply the HIncrby, SAdd and
+  // ZIncrby waiting for it in one batch
+  void EnableWriteCombining(bool enable);
+
+  // Change the scan_large_read_threshold and scan_readahead_size options,
+  // the reads picked by them are counted per db type
+  void SetScanPolicy(uint64_t large_read_threshold, size_t readahead_size);
+  Status GetScanPolicyStats(std::map<std::string, ScanPolicyStats>* type_stats);
+  Status ResetScanPolicyStats();
+
+  // Change the memory_budget_weights option, the memtable bytes and
+  // limits of every type are reported by GetUsage with
+  // PROPERTY_TYPE_BLACKWIDOW_WRITE_BUFFER_USAGE and _LIMIT
+  Status SetMemoryBudgetWeights(const std::map<DataType, double>& weights);
+
+  // Sample the reads and writes of the keys of every type, the commands
+  // of more than one type (Del, Expire ...) and the multi key set
+  // commands are not recorded. 0 disables it
+  void EnableHotKeys(uint32_t sample_rate);
+  // The k most accessed keys of type, most accessed first
+  Status GetHotKeys(const DataType& type, size_t k,
+                    std::vector<HotKey>* hot_keys);
+  Status ResetHotKeys();
+
   Status GetKeyNum(std::vector<KeyInfo>* key_infos);
   Status StopScanKeyNum();
+  // Same as GetKeyNum, estimated from the table properties of the SSTs
+  // and the memtables instead of a scan
+  Status GetKeyNumApprox(std::vector<KeyInfo>* key_infos);
+  // Collect the key size histograms and the largest keys of every type
+  // on a background worker, one analysis runs at a time
+  Status AnalyzeKeyspace(const KeyspaceAnalysisOptions& options,
+                         bool sync = false);
+  Status DoAnalyzeKeyspace();
+  Status StopKeyspaceAnalysis();
+  // Progress of the running analysis, or the result of the last one
+  Status GetKeyspaceAnalysis(KeyspaceAnalysis* analysis);
+  // Key ranges scanned so far by the running GetKeyNum, out of total
+  Status GetScanKeyNumProgress(uint64_t* scanned_ranges,
+                               uint64_t* total_ranges);
 
   rocksdb::DB* GetDBByType(const std::string& type);
 
@@ -1228,19 +1651,42 @@ class BlackWidow {
   RedisLists* lists_db_;
   std::atomic<bool> is_opened_;
 
-  LRUCache<std::string, std::string>* cursors_store_;
+  ShardedLRUCache<std::string, std::string>* cursors_store_;
+  HotKeys* hot_keys_;
+  // The shared block cache and memtable limits, nullptr without a budget
+  MemoryBudget* memory_budget_;
 
-  // Blackwidow start the background thread for compaction task
-  pthread_t bg_tasks_thread_id_;
-  slash::Mutex bg_tasks_mutex_;
-  slash::CondVar bg_tasks_cond_var_;
-  std::queue<BGTask> bg_tasks_queue_;
+  // Scans from start_key, tagged by the type of its database, and returns
+  // the tagged key the scan resumes from, empty once dtype is exhausted
+  std::string ScanFromStartKey(const DataType& dtype, std::string start_key,
+                               const std::string& pattern, int64_t count,
+                               std::vector<std::string>* keys);
 
-  std::atomic<int> current_task_type_;
-  std::atomic<bool> bg_tasks_should_exit_;
+  // The databases holding the keys of data_type, all of them for kAll
+  void GetTypeDBs(const DataType& data_type, std::vector<Redis*>* dbs);
+
+  // Blackwidow start the background workers for compaction task
+  BGTaskScheduler* bg_tasks_scheduler_;
+
+  // Full compactions currently running, indexed by their Operation
+  // (kCleanAll .. kCleanLists), both the scheduled and the sync ones
+  std::atomic<int> running_compactions_[kCleanLists + 1];
 
   // For scan keys in data base
   std::atomic<bool> scan_keynum_exit_;
+  std::atomic<uint64_t> scan_keynum_scanned_ranges_;
+  std::atomic<uint64_t> scan_keynum_total_ranges_;
+
+  // For stop the keyspace analysis
+  std::atomic<bool> analysis_exit_;
+
+  size_t keyspace_scan_threads_;
+  KeyRangeWorkers* key_range_workers_;
+
+  // For the keyspace analysis
+  slash::Mutex analysis_mutex_;
+  KeyspaceAnalysisOptions analysis_options_;
+  KeyspaceAnalysis analysis_;
 
 };
 
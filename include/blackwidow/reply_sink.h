@@ -0,0 +1,92 @@
+//  Copyright (c) 2017-present The blackwidow Authors.  All rights reserved.
+//  This source code is licensed under the BSD-style license found in the
+//  LICENSE file in the root directory of this source tree. An additional grant
+//  of patent rights can be found in the PATENTS file in the same directory.
+
+#ifndef INCLUDE_BLACKWIDOW_REPLY_SINK_H_
+#define INCLUDE_BLACKWIDOW_REPLY_SINK_H_
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+#include "rocksdb/slice.h"
+
+namespace blackwidow {
+
+using Slice = rocksdb::Slice;
+
+// Receives the reply of a read command while it is read, so a server
+// can encode the elements straight from the iterators into its output
+// buffer.
+//
+// An aggregate is opened with the number of elements the command
+// expects to write, which is only a hint, and closed with the number it
+// actually wrote. A map and a list of pairs count their pairs.
+class ReplySink {
+ public:
+  virtual ~ReplySink() {}
+
+  virtual void StartArray(int64_t expected_len) = 0;
+  virtual void EndArray(int64_t len) = 0;
+  virtual void StartMap(int64_t expected_len) = 0;
+  virtual void EndMap(int64_t len) = 0;
+  // A list of (element, element) pairs, such as members and their scores
+  virtual void StartPairs(int64_t expected_len) = 0;
+  virtual void EndPairs(int64_t len) = 0;
+
+  virtual void AppendBulkString(const Slice& value) = 0;
+  virtual void AppendDouble(double value) = 0;
+};
+
+enum RespVersion {
+  kResp2 = 2,
+  kResp3 = 3
+};
+
+// Encodes the replies in RESP at the end of a buffer owned by the caller.
+//
+// RESP2 writes the maps and the lists of pairs as flat arrays and the
+// doubles as bulk strings; RESP3 writes maps, arrays of two element
+// arrays and doubles. The header of an aggregate is written with the
+// digits of its expected length and rewritten in place when it is
+// closed, the elements are only moved when the hint had another number
+// of digits.
+class RespReplySink : public ReplySink {
+ public:
+  RespReplySink(std::string* buf, RespVersion version);
+
+  void StartArray(int64_t expected_len) override;
+  void EndArray(int64_t len) override;
+  void StartMap(int64_t expected_len) override;
+  void EndMap(int64_t len) override;
+  void StartPairs(int64_t expected_len) override;
+  void EndPairs(int64_t len) override;
+
+  void AppendBulkString(const Slice& value) override;
+  void AppendDouble(double value) override;
+
+ private:
+  struct Aggregate {
+    size_t header_pos;
+    size_t digits_len;
+    // Elements written, to open the pairs of a RESP3 list of pairs
+    int64_t elements;
+    bool pairs;
+  };
+
+  void StartAggregate(char type, int64_t expected_len, bool pairs);
+  void EndAggregate(int64_t len);
+  void BeforeElement();
+
+  std::string* buf_;
+  RespVersion version_;
+  std::vector<Aggregate> open_;
+
+  // No copying allowed
+  RespReplySink(const RespReplySink&);
+  void operator=(const RespReplySink&);
+};
+
+}  //  namespace blackwidow
+#endif  //  INCLUDE_BLACKWIDOW_REPLY_SINK_H_
@@ -29,6 +29,11 @@ namespace blackwidow {
   int CalculateMetaStartAndEndKey(const std::string& key, std::string* meta_start_key, std::string* meta_end_key);
   int CalculateDataStartAndEndKey(const std::string& key, std::string* data_start_key, std::string* data_end_key);
   bool isTailWildcard(const std::string& pattern);
+  // Cursor of the stateless scans, the tag of the data type followed by
+  // the key, field or member the next call resumes from
+  std::string EncodeScanCursor(char type_tag, const std::string& position);
+  bool DecodeScanCursor(const std::string& cursor, char* type_tag,
+                        std::string* position);
 }
 
 #endif  //  SRC_UTIL_H_
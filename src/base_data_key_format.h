@@ -6,34 +6,22 @@
 #ifndef SRC_BASE_DATA_KEY_FORMAT_H_
 #define SRC_BASE_DATA_KEY_FORMAT_H_
 
+#include "src/encode_buffer.h"
+
 namespace blackwidow {
 class BaseDataKey {
  public:
   BaseDataKey(const Slice& key, int32_t version, const Slice& data) :
-    start_(nullptr), key_(key), version_(version), data_(data) {}
-
-  ~BaseDataKey() {
-    if (start_ != space_) {
-      delete[] start_;
-    }
-  }
+    encoded_size_(0), key_(key), version_(version), data_(data) {}
 
+  // Encoded once, the next calls return the same slice
   const Slice Encode() {
+    if (encoded_size_ != 0) {
+      return Slice(buffer_.data(), encoded_size_);
+    }
     size_t usize = key_.size() + data_.size();
     size_t needed = usize + sizeof(int32_t) * 2;
-    char* dst;
-    if (needed <= sizeof(space_)) {
-      dst = space_;
-    } else {
-      dst = new char[needed];
-
-      // Need to allocate space, delete previous space
-      if (start_ != space_) {
-        delete[] start_;
-      }
-    }
-
-    start_ = dst;
+    char* dst = buffer_.Reserve(needed);
     EncodeFixed32(dst, key_.size());
     dst += sizeof(int32_t);
     memcpy(dst, key_.data(), key_.size());
@@ -41,12 +29,13 @@ class BaseDataKey {
     EncodeFixed32(dst, version_);
     dst += sizeof(int32_t);
     memcpy(dst, data_.data(), data_.size());
-    return Slice(start_, needed);
+    encoded_size_ = needed;
+    return Slice(buffer_.data(), needed);
   }
 
  private:
-  char space_[200];
-  char* start_;
+  EncodeBuffer buffer_;
+  size_t encoded_size_;
   Slice key_;
   int32_t version_;
   Slice data_;
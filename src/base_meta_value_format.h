@@ -29,8 +29,7 @@ class BaseMetaValue : public InternalValue {
   }
 
   int32_t UpdateVersion() {
-    int64_t unix_time;
-    rocksdb::Env::Default()->GetCurrentTime(&unix_time);
+    int64_t unix_time = CoarseClock::Now();
     if (version_ >= static_cast<int32_t>(unix_time)) {
       version_++;
     } else {
@@ -121,8 +120,7 @@ class ParsedBaseMetaValue : public ParsedInternalValue {
   }
 
   int32_t UpdateVersion() {
-    int64_t unix_time;
-    rocksdb::Env::Default()->GetCurrentTime(&unix_time);
+    int64_t unix_time = CoarseClock::Now();
     if (version_ >= static_cast<int32_t>(unix_time)) {
       version_++;
     } else {
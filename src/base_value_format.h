@@ -9,6 +9,8 @@
 #include <string>
 
 #include "src/coding.h"
+#include "src/coarse_clock.h"
+#include "src/encode_buffer.h"
 #include "rocksdb/env.h"
 #include "rocksdb/slice.h"
 
@@ -22,17 +24,12 @@ class InternalValue {
     version_(0),
     timestamp_(0) {
   }
-  virtual ~InternalValue() {
-    if (start_ != space_) {
-      delete[] start_;
-    }
-  }
+  virtual ~InternalValue() {}
   void set_timestamp(int32_t timestamp = 0) {
     timestamp_ = timestamp;
   }
   void SetRelativeTimestamp(int32_t ttl) {
-    int64_t unix_time;
-    rocksdb::Env::Default()->GetCurrentTime(&unix_time);
+    int64_t unix_time = CoarseClock::Now();
     timestamp_ = static_cast<int32_t>(unix_time) + ttl;
   }
   void set_version(int32_t version = 0) {
@@ -42,25 +39,14 @@ class InternalValue {
   virtual const Slice Encode() {
     size_t usize = user_value_.size();
     size_t needed = usize + kDefaultValueSuffixLength;
-    char* dst;
-    if (needed <= sizeof(space_)) {
-      dst = space_;
-    } else {
-      dst = new char[needed];
-
-      // Need to allocate space, delete previous space
-      if (start_ != space_) {
-        delete[] start_;
-      }
-    }
-    start_ = dst;
+    start_ = buffer_.Reserve(needed);
     size_t len = AppendTimestampAndVersion();
     return Slice(start_, len);
   }
   virtual size_t AppendTimestampAndVersion() = 0;
 
  protected:
-  char space_[200];
+  EncodeBuffer buffer_;
   char* start_;
   Slice user_value_;
   int32_t version_;
@@ -113,8 +99,7 @@ class ParsedInternalValue {
   }
 
   void SetRelativeTimestamp(int32_t ttl) {
-    int64_t unix_time;
-    rocksdb::Env::Default()->GetCurrentTime(&unix_time);
+    int64_t unix_time = CoarseClock::Now();
     timestamp_ = static_cast<int32_t>(unix_time) + ttl;
     SetTimestampToValue();
   }
@@ -127,8 +112,7 @@ class ParsedInternalValue {
     if (timestamp_ == 0) {
       return false;
     }
-    int64_t unix_time;
-    rocksdb::Env::Default()->GetCurrentTime(&unix_time);
+    int64_t unix_time = CoarseClock::Now();
     return timestamp_ < unix_time;
   }
 
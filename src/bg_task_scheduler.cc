@@ -0,0 +1,285 @@
+//  Copyright (c) 2017-present, Qihoo, Inc.  All rights reserved.
+//  This source code is licensed under the BSD-style license found in the
+//  LICENSE file in the root directory of this source tree. An additional grant
+//  of patent rights can be found in the PATENTS file in the same directory.
+
+#include "src/bg_task_scheduler.h"
+
+#include <string.h>
+#include <stdint.h>
+#include <algorithm>
+
+#include "slash/include/env.h"
+
+namespace blackwidow {
+
+static std::string TaskIdentity(const BGTask& task) {
+  std::string identity;
+  identity.reserve(task.argv.size() + 2);
+  identity.push_back(DataTypeTag[task.type]);
+  identity.push_back(static_cast<char>(task.operation));
+  identity.append(task.argv);
+  return identity;
+}
+
+BGTaskScheduler::BGTaskScheduler(const Handler& handler)
+    : handler_(handler),
+      cond_var_(&mutex_),
+      should_exit_(false),
+      running_(0),
+      running_heavy_(0),
+      scheduled_(0),
+      coalesced_(0),
+      cancelled_(0) {
+  memset(timing_, 0, sizeof(timing_));
+}
+
+BGTaskScheduler::~BGTaskScheduler() {
+  Stop();
+}
+
+BGTaskPriority BGTaskScheduler::PriorityOf(const BGTask& task) {
+  if (task.operation == kCompactKey) {
+    return kKeyPriority;
+  } else if (task.operation == kCleanAll && task.type == kAll) {
+    return kFullPriority;
+  } else {
+    return kTypePriority;
+  }
+}
+
+void* BGTaskScheduler::WorkerMain(void* arg) {
+  BGTaskScheduler* scheduler = reinterpret_cast<BGTaskScheduler*>(arg);
+  scheduler->WorkerLoop();
+  return NULL;
+}
+
+Status BGTaskScheduler::Start(size_t num_workers) {
+  slash::MutexLock l(&mutex_);
+  if (should_exit_) {
+    return Status::Incomplete("bg task scheduler is stopped");
+  }
+  while (workers_.size() < num_workers) {
+    pthread_t thread_id;
+    int result = pthread_create(&thread_id, NULL, WorkerMain, this);
+    if (result != 0) {
+      char msg[128];
+      snprintf(msg, sizeof(msg), "pthread create: %s", strerror(result));
+      return Status::Corruption(msg);
+    }
+    workers_.push_back(thread_id);
+  }
+  return Status::OK();
+}
+
+void BGTaskScheduler::Stop() {
+  std::vector<pthread_t> workers;
+  mutex_.Lock();
+  should_exit_ = true;
+  ClearPendingLocked();
+  workers.swap(workers_);
+  cond_var_.SignalAll();
+  mutex_.Unlock();
+
+  int ret = 0;
+  for (const auto& thread_id : workers) {
+    if ((ret = pthread_join(thread_id, NULL)) != 0) {
+      fprintf(stderr, "pthread_join failed with bgtask thread error %d\n", ret);
+    }
+  }
+}
+
+Status BGTaskScheduler::Schedule(const BGTask& task) {
+  slash::MutexLock l(&mutex_);
+  if (should_exit_) {
+    return Status::Incomplete("bg task scheduler is stopped");
+  }
+  ScheduleLocked(task);
+  return Status::OK();
+}
+
+void BGTaskScheduler::ScheduleLocked(const BGTask& task) {
+  BGTaskPriority priority = PriorityOf(task);
+  std::string identity = TaskIdentity(task);
+  if (priority == kFullPriority) {
+    // Compact the whole data base covers every pending compaction
+    coalesced_ += ClearCompactionsLocked();
+  }
+  if (pending_.find(identity) != pending_.end()) {
+    coalesced_++;
+    return;
+  }
+  pending_.insert(identity);
+  queues_[priority].push_back(task);
+  scheduled_++;
+  cond_var_.Signal();
+}
+
+void BGTaskScheduler::AddPeriodicTask(const BGTask& task,
+                                      uint64_t interval_us) {
+  slash::MutexLock l(&mutex_);
+  periodic_tasks_.push_back({task, interval_us,
+                             slash::NowMicros() + interval_us});
+  // Let a waiting worker pick up the new deadline
+  cond_var_.SignalAll();
+}
+
+// Queue the periodic tasks that are due, return how many milliseconds
+// to wait for the next one, 0 if there is none
+uint32_t BGTaskScheduler::SchedulePeriodicLocked() {
+  if (periodic_tasks_.empty()) {
+    return 0;
+  }
+  uint64_t now_us = slash::NowMicros();
+  uint64_t wait_us = UINT64_MAX;
+  for (auto& periodic_task : periodic_tasks_) {
+    if (periodic_task.next_run_us <= now_us) {
+      ScheduleLocked(periodic_task.task);
+      periodic_task.next_run_us = now_us + periodic_task.interval_us;
+    }
+    wait_us = std::min(wait_us, periodic_task.next_run_us - now_us);
+  }
+  return static_cast<uint32_t>(std::max<uint64_t>(wait_us / 1000, 1));
+}
+
+Status BGTaskScheduler::Cancel(const BGTask& task) {
+  BGTaskPriority priority = PriorityOf(task);
+  std::string identity = TaskIdentity(task);
+
+  slash::MutexLock l(&mutex_);
+  if (pending_.erase(identity) == 0) {
+    return Status::NotFound("bg task is not pending");
+  }
+  std::deque<BGTask>& queue = queues_[priority];
+  for (auto iter = queue.begin(); iter != queue.end(); ++iter) {
+    if (iter->type == task.type
+      && iter->operation == task.operation
+      && iter->argv == task.argv) {
+      queue.erase(iter);
+      break;
+    }
+  }
+  cancelled_++;
+  return Status::OK();
+}
+
+size_t BGTaskScheduler::CancelAll() {
+  slash::MutexLock l(&mutex_);
+  size_t num = ClearPendingLocked();
+  cancelled_ += num;
+  return num;
+}
+
+size_t BGTaskScheduler::QueueDepth() {
+  slash::MutexLock l(&mutex_);
+  return pending_.size();
+}
+
+void BGTaskScheduler::GetStats(BGTaskStats* stats) {
+  slash::MutexLock l(&mutex_);
+  stats->pending = pending_.size();
+  stats->running = running_;
+  stats->workers = workers_.size();
+  stats->scheduled = scheduled_;
+  stats->coalesced = coalesced_;
+  stats->cancelled = cancelled_;
+  for (int idx = 0; idx < kPriorityNum; ++idx) {
+    stats->pending_by_priority[idx] = queues_[idx].size();
+    stats->timing_by_priority[idx] = timing_[idx];
+  }
+}
+
+size_t BGTaskScheduler::ClearPendingLocked() {
+  size_t num = pending_.size();
+  pending_.clear();
+  for (int idx = 0; idx < kPriorityNum; ++idx) {
+    queues_[idx].clear();
+  }
+  return num;
+}
+
+size_t BGTaskScheduler::ClearCompactionsLocked() {
+  size_t num = 0;
+  for (int idx = 0; idx < kPriorityNum; ++idx) {
+    std::deque<BGTask> kept;
+    for (const auto& task : queues_[idx]) {
+      if (task.operation == kAnalyzeKeyspace) {
+        kept.push_back(task);
+      } else {
+        pending_.erase(TaskIdentity(task));
+        num++;
+      }
+    }
+    queues_[idx].swap(kept);
+  }
+  return num;
+}
+
+bool BGTaskScheduler::PickTask(BGTask* task, BGTaskPriority* priority) {
+  for (int idx = 0; idx < kPriorityNum; ++idx) {
+    if (queues_[idx].empty()) {
+      continue;
+    }
+    if (idx != kKeyPriority
+      && workers_.size() > 1
+      && running_heavy_ + 1 >= workers_.size()) {
+      // Keep one worker for per key compactions
+      break;
+    }
+    *task = queues_[idx].front();
+    *priority = static_cast<BGTaskPriority>(idx);
+    queues_[idx].pop_front();
+    pending_.erase(TaskIdentity(*task));
+    return true;
+  }
+  return false;
+}
+
+void BGTaskScheduler::WorkerLoop() {
+  BGTask task;
+  BGTaskPriority priority;
+  mutex_.Lock();
+  while (true) {
+    while (!should_exit_) {
+      uint32_t wait_ms = SchedulePeriodicLocked();
+      if (PickTask(&task, &priority)) {
+        break;
+      }
+      if (wait_ms == 0) {
+        cond_var_.Wait();
+      } else {
+        cond_var_.TimedWait(wait_ms);
+      }
+    }
+    if (should_exit_) {
+      break;
+    }
+    running_++;
+    if (priority != kKeyPriority) {
+      running_heavy_++;
+    }
+    mutex_.Unlock();
+
+    uint64_t start_us = slash::NowMicros();
+    handler_(task);
+    uint64_t duration = slash::NowMicros() - start_us;
+
+    mutex_.Lock();
+    running_--;
+    if (priority != kKeyPriority) {
+      running_heavy_--;
+    }
+    BGTaskTiming& timing = timing_[priority];
+    timing.count++;
+    timing.total_micros += duration;
+    timing.last_micros = duration;
+    if (duration > timing.max_micros) {
+      timing.max_micros = duration;
+    }
+    // A heavy task finished, another worker may be able to take one now
+    cond_var_.Signal();
+  }
+  mutex_.Unlock();
+}
+
+}  //  namespace blackwidow
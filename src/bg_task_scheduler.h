@@ -0,0 +1,97 @@
+//  Copyright (c) 2017-present, Qihoo, Inc.  All rights reserved.
+//  This source code is licensed under the BSD-style license found in the
+//  LICENSE file in the root directory of this source tree. An additional grant
+//  of patent rights can be found in the PATENTS file in the same directory.
+
+#ifndef SRC_BG_TASK_SCHEDULER_H_
+#define SRC_BG_TASK_SCHEDULER_H_
+
+#include <deque>
+#include <string>
+#include <vector>
+#include <functional>
+#include <unordered_set>
+#include <pthread.h>
+
+#include "rocksdb/status.h"
+
+#include "slash/include/slash_mutex.h"
+#include "blackwidow/blackwidow.h"
+
+namespace blackwidow {
+
+// Runs BGTask on a pool of worker threads.
+//
+// Pending tasks are kept in one fifo per BGTaskPriority, workers always
+// take the task with the lowest priority value first. Queueing a task
+// that is equal to a pending one is a no-op, and a full compaction of
+// all dbs supersedes every pending compaction. Periodic tasks are queued by
+// the idle workers once their interval elapsed. When the pool has more
+// than one worker, one of them is reserved for per key compactions so
+// that a long full compaction can not hold them back.
+class BGTaskScheduler {
+ public:
+  typedef std::function<void(const BGTask&)> Handler;
+
+  explicit BGTaskScheduler(const Handler& handler);
+  ~BGTaskScheduler();
+
+  // Grow the pool to num_workers threads, the pool never shrinks
+  Status Start(size_t num_workers);
+
+  // Wait for the running tasks, drop the pending ones and join the workers
+  void Stop();
+
+  Status Schedule(const BGTask& task);
+
+  // Queue task every interval_us microseconds, the first time after
+  // one interval
+  void AddPeriodicTask(const BGTask& task, uint64_t interval_us);
+
+  Status Cancel(const BGTask& task);
+  size_t CancelAll();
+
+  size_t QueueDepth();
+  void GetStats(BGTaskStats* stats);
+
+  static BGTaskPriority PriorityOf(const BGTask& task);
+
+ private:
+  static void* WorkerMain(void* arg);
+  void WorkerLoop();
+  bool PickTask(BGTask* task, BGTaskPriority* priority);
+  void ScheduleLocked(const BGTask& task);
+  uint32_t SchedulePeriodicLocked();
+  size_t ClearPendingLocked();
+  size_t ClearCompactionsLocked();
+
+  struct PeriodicTask {
+    BGTask task;
+    uint64_t interval_us;
+    uint64_t next_run_us;
+  };
+
+  Handler handler_;
+
+  slash::Mutex mutex_;
+  slash::CondVar cond_var_;
+  bool should_exit_;
+  std::vector<pthread_t> workers_;
+  std::deque<BGTask> queues_[kPriorityNum];
+  std::unordered_set<std::string> pending_;
+  std::vector<PeriodicTask> periodic_tasks_;
+
+  size_t running_;
+  size_t running_heavy_;
+  uint64_t scheduled_;
+  uint64_t coalesced_;
+  uint64_t cancelled_;
+  BGTaskTiming timing_[kPriorityNum];
+
+  // No copying allowed
+  BGTaskScheduler(const BGTaskScheduler&);
+  void operator=(const BGTaskScheduler&);
+};
+
+}  //  namespace blackwidow
+#endif  // SRC_BG_TASK_SCHEDULER_H_
@@ -4,9 +4,18 @@
 //  of patent rights can be found in the PATENTS file in the same directory.
 
 #include "blackwidow/blackwidow.h"
+
 #include "blackwidow/util.h"
+#include "blackwidow/reply_sink.h"
 
 #include "src/options_helper.h"
+#include "src/bg_task_scheduler.h"
+#include "src/coarse_clock.h"
+#include "src/command_stats.h"
+#include "src/glob_pattern.h"
+#include "src/hot_keys.h"
+#include "src/key_range_workers.h"
+#include "src/memory_budget.h"
 #include "src/mutex_impl.h"
 #include "src/redis_strings.h"
 #include "src/redis_hashes.h"
@@ -15,9 +24,77 @@
 #include "src/redis_zsets.h"
 #include "src/redis_hyperloglog.h"
 #include "src/lru_cache.h"
+#include "src/sharded_lru_cache.h"
 
 namespace blackwidow {
 
+// Number of elements from start to stop of a collection of size
+// elements, the negative indexes counting from its end
+static int64_t RangeLength(int64_t size, int64_t start, int64_t stop) {
+  if (start < 0) {
+    start = std::max(start + size, static_cast<int64_t>(0));
+  }
+  if (stop < 0) {
+    stop += size;
+  }
+  if (stop >= size) {
+    stop = size - 1;
+  }
+  return start > stop ? 0 : stop - start + 1;
+}
+
+// Writes the members a sorted set range read passes to its visitor into
+// sink, with their scores when with_scores
+template <typename Read>
+static Status WriteScoreMembers(int64_t expected_len, bool with_scores,
+                                ReplySink* sink, const Read& read) {
+  int64_t len = 0;
+  if (with_scores) {
+    sink->StartPairs(expected_len);
+  } else {
+    sink->StartArray(expected_len);
+  }
+  Status s = read([sink, with_scores, &len](double score,
+                                            const Slice& member) {
+      sink->AppendBulkString(member);
+      if (with_scores) {
+        sink->AppendDouble(score);
+      }
+      len++;
+      return true;
+    });
+  if (with_scores) {
+    sink->EndPairs(len);
+  } else {
+    sink->EndArray(len);
+  }
+  return s;
+}
+
+// A key range of the meta keys of one of the databases
+struct KeyRangeTask {
+  size_t db_index;
+  Redis* db;
+  KeyRange range;
+};
+
+// Every scan thread gets a few ranges, so that one slow range does not
+// leave the other threads idle
+static const size_t kRangesPerScanThread = 4;
+
+static void SplitKeyRanges(const std::vector<Redis*>& dbs,
+                           size_t num_threads,
+                           std::vector<KeyRangeTask>* tasks) {
+  size_t max_ranges = num_threads > 1 ? num_threads * kRangesPerScanThread : 1;
+  for (size_t idx = 0; idx < dbs.size(); ++idx) {
+    std::vector<KeyRange> ranges;
+    dbs[idx]->GetMetaKeyRanges(max_ranges, &ranges);
+    for (const auto& range : ranges) {
+      tasks->push_back({idx, dbs[idx], range});
+    }
+  }
+}
+
 Status BlackwidowOptions::ResetOptions(const OptionType& option_type,
     const std::unordered_map<std::string, std::string>& options_map) {
   std::unordered_map<std::string, MemberTypeInfo>& options_member_type_info = mutable_cf_options_member_type_info;
@@ -51,12 +128,21 @@ BlackWidow::BlackWidow() :
   zsets_db_(nullptr),
   lists_db_(nullptr),
   is_opened_(false),
-  bg_tasks_cond_var_(&bg_tasks_mutex_),
-  current_task_type_(kNone),
-  bg_tasks_should_exit_(false),
-  scan_keynum_exit_(false) {
-  cursors_store_ = new LRUCache<std::string, std::string>();
+  memory_budget_(nullptr),
+  scan_keynum_exit_(false),
+  scan_keynum_scanned_ranges_(0),
+  scan_keynum_total_ranges_(0),
+  analysis_exit_(false),
+  keyspace_scan_threads_(1),
+  key_range_workers_(new KeyRangeWorkers()) {
+  for (int idx = 0; idx <= kCleanLists; ++idx) {
+    running_compactions_[idx] = 0;
+  }
+  cursors_store_ = new ShardedLRUCache<std::string, std::string>();
   cursors_store_->SetCapacity(5000);
+  hot_keys_ = new HotKeys();
+  bg_tasks_scheduler_ = new BGTaskScheduler(
+      std::bind(&BlackWidow::RunBGTask, this, std::placeholders::_1));
 
   Status s = StartBGThread();
   if (!s.ok()) {
@@ -67,8 +153,9 @@ BlackWidow::BlackWidow() :
 }
 
 BlackWidow::~BlackWidow() {
-  bg_tasks_should_exit_ = true;
-  bg_tasks_cond_var_.Signal();
+  // Stop a running keyspace analysis
+  analysis_exit_ = true;
+  bg_tasks_scheduler_->CancelAll();
 
   if (is_opened_) {
     rocksdb::CancelAllBackgroundWork(strings_db_->GetDB(), true);
@@ -78,9 +165,12 @@ BlackWidow::~BlackWidow() {
     rocksdb::CancelAllBackgroundWork(zsets_db_->GetDB(), true);
   }
 
-  int ret = 0;
-  if ((ret = pthread_join(bg_tasks_thread_id_, NULL)) != 0) {
-    fprintf(stderr, "pthread_join failed with bgtask thread error %d\n", ret);
+  bg_tasks_scheduler_->Stop();
+  delete bg_tasks_scheduler_;
+  delete key_range_workers_;
+
+  if (is_opened_) {
+    CoarseClock::Stop();
   }
 
   delete strings_db_;
@@ -89,6 +179,8 @@ BlackWidow::~BlackWidow() {
   delete lists_db_;
   delete zsets_db_;
   delete cursors_store_;
+  delete hot_keys_;
+  delete memory_budget_;
 }
 
 static std::string AppendSubDirectory(const std::string& db_path,
@@ -103,10 +195,37 @@ static std::string AppendSubDirectory(const std::string& db_path,
 Status BlackWidow::Open(const BlackwidowOptions& bw_options,
                         const std::string& db_path) {
   mkpath(db_path.c_str(), 0755);
+  keyspace_scan_threads_ = std::max<size_t>(bw_options.keyspace_scan_threads, 1);
+  // The calling thread scans too
+  key_range_workers_->Start(keyspace_scan_threads_ - 1);
+
+  if (bw_options.memory_budget > 0) {
+    Status s = MemoryBudget::CheckWeights(bw_options.memory_budget_weights);
+    if (!s.ok()) {
+      return s;
+    }
+    s = MemoryBudget::CheckWriteBufferRatio(
+        bw_options.memory_budget_write_buffer_ratio);
+    if (!s.ok()) {
+      return s;
+    }
+    memory_budget_ = new MemoryBudget(bw_options.memory_budget,
+        bw_options.memory_budget_write_buffer_ratio,
+        bw_options.memory_budget_weights);
+  }
+  // The options of every type share the block cache of the budget and
+  // get the memtable limit of the type
+  auto type_options = [this, &bw_options](const DataType& type) {
+    BlackwidowOptions options(bw_options);
+    if (memory_budget_ != nullptr) {
+      memory_budget_->Apply(type, &options);
+    }
+    return options;
+  };
 
   strings_db_ = new RedisStrings(this, kStrings);
   Status s = strings_db_->Open(
-      bw_options, AppendSubDirectory(db_path, "strings"));
+      type_options(kStrings), AppendSubDirectory(db_path, "strings"));
   if (!s.ok()) {
     fprintf(stderr,
         "[FATAL] open kv db failed, %s\n", s.ToString().c_str());
@@ -114,7 +233,8 @@ Status BlackWidow::Open(const BlackwidowOptions& bw_options,
   }
 
   hashes_db_ = new RedisHashes(this, kHashes);
-  s = hashes_db_->Open(bw_options, AppendSubDirectory(db_path, "hashes"));
+  s = hashes_db_->Open(type_options(kHashes),
+                       AppendSubDirectory(db_path, "hashes"));
   if (!s.ok()) {
     fprintf(stderr,
         "[FATAL] open hashes db failed, %s\n", s.ToString().c_str());
@@ -122,7 +242,7 @@ Status BlackWidow::Open(const BlackwidowOptions& bw_options,
   }
 
   sets_db_ = new RedisSets(this, kSets);
-  s = sets_db_->Open(bw_options, AppendSubDirectory(db_path, "sets"));
+  s = sets_db_->Open(type_options(kSets), AppendSubDirectory(db_path, "sets"));
   if (!s.ok()) {
     fprintf(stderr,
         "[FATAL] open set db failed, %s\n", s.ToString().c_str());
@@ -130,7 +250,8 @@ Status BlackWidow::Open(const BlackwidowOptions& bw_options,
   }
 
   lists_db_ = new RedisLists(this, kLists);
-  s = lists_db_->Open(bw_options, AppendSubDirectory(db_path, "lists"));
+  s = lists_db_->Open(type_options(kLists),
+                      AppendSubDirectory(db_path, "lists"));
   if (!s.ok()) {
     fprintf(stderr,
         "[FATAL] open list db failed, %s\n", s.ToString().c_str());
@@ -138,12 +259,43 @@ Status BlackWidow::Open(const BlackwidowOptions& bw_options,
   }
 
   zsets_db_ = new RedisZSets(this, kZSets);
-  s = zsets_db_->Open(bw_options, AppendSubDirectory(db_path, "zsets"));
+  s = zsets_db_->Open(type_options(kZSets),
+                      AppendSubDirectory(db_path, "zsets"));
   if (!s.ok()) {
     fprintf(stderr,
         "[FATAL] open zset db failed, %s\n", s.ToString().c_str());
     exit(-1);
   }
+
+  s = bg_tasks_scheduler_->Start(bw_options.max_bg_task_threads);
+  if (!s.ok()) {
+    fprintf(stderr,
+        "[FATAL] start bg task workers failed, %s\n", s.ToString().c_str());
+    exit(-1);
+  }
+  if (bw_options.expired_compaction_interval > 0) {
+    bg_tasks_scheduler_->AddPeriodicTask({kAll, kCompactExpired},
+        bw_options.expired_compaction_interval * 1000000ULL);
+  }
+  if (bw_options.enable_command_stats) {
+    EnableCommandStats(true);
+  }
+  if (bw_options.enable_lock_stats) {
+    EnableLockStats(true);
+  }
+  if (bw_options.hot_keys_sample_rate > 0) {
+    EnableHotKeys(bw_options.hot_keys_sample_rate);
+  }
+  if (bw_options.combine_hot_key_writes) {
+    EnableWriteCombining(true);
+  }
+  SetScanPolicy(bw_options.scan_large_read_threshold,
+                bw_options.scan_readahead_size);
+  if (bw_options.iterator_pool_size > 0) {
+    hashes_db_->CreateIteratorPools(bw_options.iterator_pool_size);
+    sets_db_->CreateIteratorPools(bw_options.iterator_pool_size);
+  }
+  CoarseClock::Start();
   is_opened_.store(true);
   return Status::OK();
 }
@@ -162,6 +314,8 @@ Status BlackWidow::StoreCursorStartKey(const DataType& dtype, int64_t cursor,
 // Strings Commands
 Status BlackWidow::Set(const Slice& key,
                        const Slice& value) {
+  CommandStatsScope scope(kCmdSet);
+  hot_keys_->RecordWrite(kStrings, key);
   return strings_db_->Set(key, value);
 }
 
@@ -169,191 +323,367 @@ Status BlackWidow::Setxx(const Slice& key,
                          const Slice& value,
                          int32_t* ret,
                          const int32_t ttl) {
+  CommandStatsScope scope(kCmdSetxx);
+  hot_keys_->RecordWrite(kStrings, key);
   return strings_db_->Setxx(key, value, ret, ttl);
 }
 
 Status BlackWidow::Get(const Slice& key, std::string* value) {
+  CommandStatsScope scope(kCmdGet);
+  hot_keys_->RecordRead(kStrings, key);
+  return strings_db_->Get(key, value);
+}
+
+Status BlackWidow::Get(const Slice& key, PinnableSlice* value) {
+  CommandStatsScope scope(kCmdGet);
+  hot_keys_->RecordRead(kStrings, key);
   return strings_db_->Get(key, value);
 }
 
 Status BlackWidow::GetSet(const Slice& key, const Slice& value,
                           std::string* old_value) {
+  CommandStatsScope scope(kCmdGetSet);
+  hot_keys_->RecordWrite(kStrings, key);
   return strings_db_->GetSet(key, value, old_value);
 }
 
 Status BlackWidow::SetBit(const Slice& key, int64_t offset,
                           int32_t value, int32_t* ret) {
+  CommandStatsScope scope(kCmdSetBit);
+  hot_keys_->RecordWrite(kStrings, key);
   return strings_db_->SetBit(key, offset, value, ret);
 }
 
 Status BlackWidow::GetBit(const Slice& key, int64_t offset, int32_t* ret) {
+  CommandStatsScope scope(kCmdGetBit);
+  hot_keys_->RecordRead(kStrings, key);
   return strings_db_->GetBit(key, offset, ret);
 }
 
 Status BlackWidow::MSet(const std::vector<KeyValue>& kvs) {
+  CommandStatsScope scope(kCmdMSet);
+  for (const auto& kv : kvs) {
+    hot_keys_->RecordWrite(kStrings, kv.key);
+  }
   return strings_db_->MSet(kvs);
 }
 
 Status BlackWidow::MGet(const std::vector<std::string>& keys,
                         std::vector<ValueStatus>* vss) {
+  CommandStatsScope scope(kCmdMGet);
+  for (const auto& key : keys) {
+    hot_keys_->RecordRead(kStrings, key);
+  }
   return strings_db_->MGet(keys, vss);
 }
 
+Status BlackWidow::MGet(const std::vector<std::string>& keys,
+                        PinnableSlice* values, Status* statuses) {
+  CommandStatsScope scope(kCmdMGet);
+  for (const auto& key : keys) {
+    hot_keys_->RecordRead(kStrings, key);
+  }
+  return strings_db_->MGet(keys, values, statuses);
+}
+
 Status BlackWidow::Setnx(const Slice& key, const Slice& value,
                          int32_t* ret, const int32_t ttl) {
+  CommandStatsScope scope(kCmdSetnx);
+  hot_keys_->RecordWrite(kStrings, key);
   return strings_db_->Setnx(key, value, ret, ttl);
 }
 
 Status BlackWidow::MSetnx(const std::vector<KeyValue>& kvs,
                           int32_t* ret) {
+  CommandStatsScope scope(kCmdMSetnx);
+  for (const auto& kv : kvs) {
+    hot_keys_->RecordWrite(kStrings, kv.key);
+  }
   return strings_db_->MSetnx(kvs, ret);
 }
 
 Status BlackWidow::Setvx(const Slice& key, const Slice& value,
                          const Slice& new_value, int32_t* ret,
                          const int32_t ttl) {
+  CommandStatsScope scope(kCmdSetvx);
+  hot_keys_->RecordWrite(kStrings, key);
   return strings_db_->Setvx(key, value, new_value, ret, ttl);
 }
 
 Status BlackWidow::Delvx(const Slice& key, const Slice& value, int32_t* ret) {
+  CommandStatsScope scope(kCmdDelvx);
+  hot_keys_->RecordWrite(kStrings, key);
   return strings_db_->Delvx(key, value, ret);
 }
 
 Status BlackWidow::Setrange(const Slice& key, int64_t start_offset,
                             const Slice& value, int32_t* ret) {
+  CommandStatsScope scope(kCmdSetrange);
+  hot_keys_->RecordWrite(kStrings, key);
   return strings_db_->Setrange(key, start_offset, value, ret);
 }
 
 Status BlackWidow::Getrange(const Slice& key, int64_t start_offset,
                             int64_t end_offset, std::string* ret) {
+  CommandStatsScope scope(kCmdGetrange);
+  hot_keys_->RecordRead(kStrings, key);
   return strings_db_->Getrange(key, start_offset, end_offset, ret);
 }
 
 Status BlackWidow::Append(const Slice& key, const Slice& value, int32_t* ret) {
+  CommandStatsScope scope(kCmdAppend);
+  hot_keys_->RecordWrite(kStrings, key);
   return strings_db_->Append(key, value, ret);
 }
 
 Status BlackWidow::BitCount(const Slice& key, int64_t start_offset,
                             int64_t end_offset, int32_t *ret, bool have_range) {
+  CommandStatsScope scope(kCmdBitCount);
+  hot_keys_->RecordRead(kStrings, key);
   return strings_db_->BitCount(key, start_offset, end_offset, ret, have_range);
 }
 
 Status BlackWidow::BitOp(BitOpType op, const std::string& dest_key,
                          const std::vector<std::string>& src_keys,
                          int64_t* ret) {
+  CommandStatsScope scope(kCmdBitOp);
   return strings_db_->BitOp(op, dest_key, src_keys, ret);
 }
 
 Status BlackWidow::BitPos(const Slice& key, int32_t bit,
                           int64_t* ret) {
+  CommandStatsScope scope(kCmdBitPos);
+  hot_keys_->RecordRead(kStrings, key);
   return strings_db_->BitPos(key, bit, ret);
 }
 
 Status BlackWidow::BitPos(const Slice& key, int32_t bit,
                           int64_t start_offset, int64_t* ret) {
+  CommandStatsScope scope(kCmdBitPos);
+  hot_keys_->RecordRead(kStrings, key);
   return strings_db_->BitPos(key, bit, start_offset, ret);
 }
 
 Status BlackWidow::BitPos(const Slice& key, int32_t bit,
                           int64_t start_offset, int64_t end_offset,
                           int64_t* ret) {
+  CommandStatsScope scope(kCmdBitPos);
+  hot_keys_->RecordRead(kStrings, key);
   return strings_db_->BitPos(key, bit, start_offset, end_offset, ret);
 }
 
 Status BlackWidow::Decrby(const Slice& key, int64_t value, int64_t* ret) {
+  CommandStatsScope scope(kCmdDecrby);
+  hot_keys_->RecordWrite(kStrings, key);
   return strings_db_->Decrby(key, value, ret);
 }
 
 Status BlackWidow::Incrby(const Slice& key, int64_t value, int64_t* ret) {
+  CommandStatsScope scope(kCmdIncrby);
+  hot_keys_->RecordWrite(kStrings, key);
   return strings_db_->Incrby(key, value, ret);
 }
 
 Status BlackWidow::Incrbyfloat(const Slice& key, const Slice& value,
                                std::string* ret) {
+  CommandStatsScope scope(kCmdIncrbyfloat);
+  hot_keys_->RecordWrite(kStrings, key);
   return strings_db_->Incrbyfloat(key, value, ret);
 }
 
 Status BlackWidow::Setex(const Slice& key, const Slice& value, int32_t ttl) {
+  CommandStatsScope scope(kCmdSetex);
+  hot_keys_->RecordWrite(kStrings, key);
   return strings_db_->Setex(key, value, ttl);
 }
 
 Status BlackWidow::Strlen(const Slice& key, int32_t* len) {
+  CommandStatsScope scope(kCmdStrlen);
+  hot_keys_->RecordRead(kStrings, key);
   return strings_db_->Strlen(key, len);
 }
 
 Status BlackWidow::PKSetexAt(const Slice& key,
                              const Slice& value,
                              int32_t timestamp) {
+  CommandStatsScope scope(kCmdPKSetexAt);
+  hot_keys_->RecordWrite(kStrings, key);
   return strings_db_->PKSetexAt(key, value, timestamp);
 }
 
 // Hashes Commands
 Status BlackWidow::HSet(const Slice& key, const Slice& field,
     const Slice& value, int32_t* res) {
+  CommandStatsScope scope(kCmdHSet);
+  hot_keys_->RecordWrite(kHashes, key);
   return hashes_db_->HSet(key, field, value, res);
 }
 
 Status BlackWidow::HGet(const Slice& key, const Slice& field,
     std::string* value) {
+  CommandStatsScope scope(kCmdHGet);
+  hot_keys_->RecordRead(kHashes, key);
+  return hashes_db_->HGet(key, field, value);
+}
+
+Status BlackWidow::HGet(const Slice& key, const Slice& field,
+                        PinnableSlice* value) {
+  CommandStatsScope scope(kCmdHGet);
+  hot_keys_->RecordRead(kHashes, key);
   return hashes_db_->HGet(key, field, value);
 }
 
 Status BlackWidow::HMSet(const Slice& key,
                          const std::vector<FieldValue>& fvs) {
+  CommandStatsScope scope(kCmdHMSet);
+  hot_keys_->RecordWrite(kHashes, key);
   return hashes_db_->HMSet(key, fvs);
 }
 
 Status BlackWidow::HMGet(const Slice& key,
                          const std::vector<std::string>& fields,
                          std::vector<ValueStatus>* vss) {
+  CommandStatsScope scope(kCmdHMGet);
+  hot_keys_->RecordRead(kHashes, key);
   return hashes_db_->HMGet(key, fields, vss);
 }
 
 Status BlackWidow::HGetall(const Slice& key,
                            std::vector<FieldValue>* fvs) {
+  CommandStatsScope scope(kCmdHGetall);
+  hot_keys_->RecordRead(kHashes, key);
   return hashes_db_->HGetall(key, fvs);
 }
 
+Status BlackWidow::HGetall(const Slice& key,
+                           const FieldValueVisitor& visitor) {
+  CommandStatsScope scope(kCmdHGetall);
+  hot_keys_->RecordRead(kHashes, key);
+  return hashes_db_->HGetall(key, visitor);
+}
+
+Status BlackWidow::HGetall(const Slice& key, ReplySink* sink) {
+  CommandStatsScope scope(kCmdHGetall);
+  hot_keys_->RecordRead(kHashes, key);
+  int32_t expected_len;
+  hashes_db_->HLen(key, &expected_len);
+  int64_t len = 0;
+  sink->StartMap(expected_len);
+  Status s = hashes_db_->HGetall(key,
+    [sink, &len](const Slice& field, const Slice& value) {
+      sink->AppendBulkString(field);
+      sink->AppendBulkString(value);
+      len++;
+      return true;
+    });
+  sink->EndMap(len);
+  return s;
+}
+
 Status BlackWidow::HKeys(const Slice& key,
                          std::vector<std::string>* fields) {
+  CommandStatsScope scope(kCmdHKeys);
+  hot_keys_->RecordRead(kHashes, key);
   return hashes_db_->HKeys(key, fields);
 }
 
+Status BlackWidow::HKeys(const Slice& key,
+                         const ElementVisitor& visitor) {
+  CommandStatsScope scope(kCmdHKeys);
+  hot_keys_->RecordRead(kHashes, key);
+  return hashes_db_->HKeys(key, visitor);
+}
+
+Status BlackWidow::HKeys(const Slice& key, ReplySink* sink) {
+  CommandStatsScope scope(kCmdHKeys);
+  hot_keys_->RecordRead(kHashes, key);
+  int32_t expected_len;
+  hashes_db_->HLen(key, &expected_len);
+  int64_t len = 0;
+  sink->StartArray(expected_len);
+  Status s = hashes_db_->HKeys(key, [sink, &len](const Slice& field) {
+      sink->AppendBulkString(field);
+      len++;
+      return true;
+    });
+  sink->EndArray(len);
+  return s;
+}
+
 Status BlackWidow::HVals(const Slice& key,
                          std::vector<std::string>* values) {
+  CommandStatsScope scope(kCmdHVals);
+  hot_keys_->RecordRead(kHashes, key);
   return hashes_db_->HVals(key, values);
 }
 
+Status BlackWidow::HVals(const Slice& key,
+                         const ElementVisitor& visitor) {
+  CommandStatsScope scope(kCmdHVals);
+  hot_keys_->RecordRead(kHashes, key);
+  return hashes_db_->HVals(key, visitor);
+}
+
+Status BlackWidow::HVals(const Slice& key, ReplySink* sink) {
+  CommandStatsScope scope(kCmdHVals);
+  hot_keys_->RecordRead(kHashes, key);
+  int32_t expected_len;
+  hashes_db_->HLen(key, &expected_len);
+  int64_t len = 0;
+  sink->StartArray(expected_len);
+  Status s = hashes_db_->HVals(key, [sink, &len](const Slice& value) {
+      sink->AppendBulkString(value);
+      len++;
+      return true;
+    });
+  sink->EndArray(len);
+  return s;
+}
+
 Status BlackWidow::HSetnx(const Slice& key, const Slice& field,
                           const Slice& value, int32_t* ret) {
+  CommandStatsScope scope(kCmdHSetnx);
+  hot_keys_->RecordWrite(kHashes, key);
   return hashes_db_->HSetnx(key, field, value, ret);
 }
 
 Status BlackWidow::HLen(const Slice& key, int32_t* ret) {
+  CommandStatsScope scope(kCmdHLen);
+  hot_keys_->RecordRead(kHashes, key);
   return hashes_db_->HLen(key, ret);
 }
 
 Status BlackWidow::HStrlen(const Slice& key, const Slice& field, int32_t* len) {
+  CommandStatsScope scope(kCmdHStrlen);
+  hot_keys_->RecordRead(kHashes, key);
   return hashes_db_->HStrlen(key, field, len);
 }
 
 Status BlackWidow::HExists(const Slice& key, const Slice& field) {
+  CommandStatsScope scope(kCmdHExists);
+  hot_keys_->RecordRead(kHashes, key);
   return hashes_db_->HExists(key, field);
 }
 
 Status BlackWidow::HIncrby(const Slice& key, const Slice& field, int64_t value,
                            int64_t* ret) {
+  CommandStatsScope scope(kCmdHIncrby);
+  hot_keys_->RecordWrite(kHashes, key);
   return hashes_db_->HIncrby(key, field, value, ret);
 }
 
 Status BlackWidow::HIncrbyfloat(const Slice& key, const Slice& field,
                                 const Slice& by, std::string* new_value) {
+  CommandStatsScope scope(kCmdHIncrbyfloat);
+  hot_keys_->RecordWrite(kHashes, key);
   return hashes_db_->HIncrbyfloat(key, field, by, new_value);
 }
 
 Status BlackWidow::HDel(const Slice& key,
                         const std::vector<std::string>& fields,
                         int32_t* ret) {
+  CommandStatsScope scope(kCmdHDel);
+  hot_keys_->RecordWrite(kHashes, key);
   return hashes_db_->HDel(key, fields, ret);
 }
 
@@ -361,6 +691,18 @@ Status BlackWidow::HScan(const Slice& key, int64_t cursor,
                          const std::string& pattern, int64_t count,
                          std::vector<FieldValue>* field_values,
                          int64_t* next_cursor) {
+  CommandStatsScope scope(kCmdHScan);
+  hot_keys_->RecordRead(kHashes, key);
+  return hashes_db_->HScan(key, cursor,
+      pattern, count, field_values, next_cursor);
+}
+
+Status BlackWidow::HScan(const Slice& key, const std::string& cursor,
+                         const std::string& pattern, int64_t count,
+                         std::vector<FieldValue>* field_values,
+                         std::string* next_cursor) {
+  CommandStatsScope scope(kCmdHScan);
+  hot_keys_->RecordRead(kHashes, key);
   return hashes_db_->HScan(key, cursor,
       pattern, count, field_values, next_cursor);
 }
@@ -369,6 +711,8 @@ Status BlackWidow::HScanx(const Slice& key, const std::string start_field,
                           const std::string& pattern, int64_t count,
                           std::vector<FieldValue>* field_values,
                           std::string* next_field) {
+  CommandStatsScope scope(kCmdHScanx);
+  hot_keys_->RecordRead(kHashes, key);
   return hashes_db_->HScanx(key, start_field,
       pattern, count, field_values, next_field);
 }
@@ -378,6 +722,8 @@ Status BlackWidow::PKHScanRange(const Slice& key, const Slice& field_start,
                                 const Slice& pattern, int32_t limit,
                                 std::vector<FieldValue>* field_values,
                                 std::string* next_field) {
+  CommandStatsScope scope(kCmdPKHScanRange);
+  hot_keys_->RecordRead(kHashes, key);
   return hashes_db_->PKHScanRange(key, field_start,
       field_end, pattern, limit, field_values, next_field);
 }
@@ -387,6 +733,8 @@ Status BlackWidow::PKHRScanRange(const Slice& key, const Slice& field_start,
                                  const Slice& pattern, int32_t limit,
                                  std::vector<FieldValue>* field_values,
                                  std::string* next_field) {
+  CommandStatsScope scope(kCmdPKHRScanRange);
+  hot_keys_->RecordRead(kHashes, key);
   return hashes_db_->PKHRScanRange(key, field_start,
       field_end, pattern, limit, field_values, next_field);
 }
@@ -395,52 +743,92 @@ Status BlackWidow::PKHRScanRange(const Slice& key, const Slice& field_start,
 Status BlackWidow::SAdd(const Slice& key,
                         const std::vector<std::string>& members,
                         int32_t* ret) {
+  CommandStatsScope scope(kCmdSAdd);
+  hot_keys_->RecordWrite(kSets, key);
   return sets_db_->SAdd(key, members, ret);
 }
 
 Status BlackWidow::SCard(const Slice& key,
                          int32_t* ret) {
+  CommandStatsScope scope(kCmdSCard);
+  hot_keys_->RecordRead(kSets, key);
   return sets_db_->SCard(key, ret);
 }
 
 Status BlackWidow::SDiff(const std::vector<std::string>& keys,
                          std::vector<std::string>* members) {
+  CommandStatsScope scope(kCmdSDiff);
   return sets_db_->SDiff(keys, members);
 }
 
 Status BlackWidow::SDiffstore(const Slice& destination,
                               const std::vector<std::string>& keys,
                               int32_t* ret) {
+  CommandStatsScope scope(kCmdSDiffstore);
   return sets_db_->SDiffstore(destination, keys, ret);
 }
 
 Status BlackWidow::SInter(const std::vector<std::string>& keys,
                           std::vector<std::string>* members) {
+  CommandStatsScope scope(kCmdSInter);
   return sets_db_->SInter(keys, members);
 }
 
 Status BlackWidow::SInterstore(const Slice& destination,
                                const std::vector<std::string>& keys,
                                int32_t* ret) {
+  CommandStatsScope scope(kCmdSInterstore);
   return sets_db_->SInterstore(destination, keys, ret);
 }
 
 Status BlackWidow::SIsmember(const Slice& key, const Slice& member,
                              int32_t* ret) {
+  CommandStatsScope scope(kCmdSIsmember);
+  hot_keys_->RecordRead(kSets, key);
   return sets_db_->SIsmember(key, member, ret);
 }
 
 Status BlackWidow::SMembers(const Slice& key,
                             std::vector<std::string>* members) {
+  CommandStatsScope scope(kCmdSMembers);
+  hot_keys_->RecordRead(kSets, key);
   return sets_db_->SMembers(key, members);
 }
 
+Status BlackWidow::SMembers(const Slice& key,
+                            const ElementVisitor& visitor) {
+  CommandStatsScope scope(kCmdSMembers);
+  hot_keys_->RecordRead(kSets, key);
+  return sets_db_->SMembers(key, visitor);
+}
+
+Status BlackWidow::SMembers(const Slice& key, ReplySink* sink) {
+  CommandStatsScope scope(kCmdSMembers);
+  hot_keys_->RecordRead(kSets, key);
+  int32_t expected_len;
+  sets_db_->SCard(key, &expected_len);
+  int64_t len = 0;
+  sink->StartArray(expected_len);
+  Status s = sets_db_->SMembers(key, [sink, &len](const Slice& member) {
+      sink->AppendBulkString(member);
+      len++;
+      return true;
+    });
+  sink->EndArray(len);
+  return s;
+}
+
 Status BlackWidow::SMove(const Slice& source, const Slice& destination,
                          const Slice& member, int32_t* ret) {
+  CommandStatsScope scope(kCmdSMove);
+  hot_keys_->RecordWrite(kSets, source);
+  hot_keys_->RecordWrite(kSets, destination);
   return sets_db_->SMove(source, destination, member, ret);
 }
 
 Status BlackWidow::SPop(const Slice& key, std::string* member) {
+  CommandStatsScope scope(kCmdSPop);
+  hot_keys_->RecordWrite(kSets, key);
   bool need_compact = false;
   Status status = sets_db_->SPop(key, member, &need_compact);
   if (need_compact) {
@@ -451,23 +839,35 @@ Status BlackWidow::SPop(const Slice& key, std::string* member) {
 
 Status BlackWidow::SRandmember(const Slice& key, int32_t count,
                                std::vector<std::string>* members) {
+  CommandStatsScope scope(kCmdSRandmember);
+  hot_keys_->RecordRead(kSets, key);
   return sets_db_->SRandmember(key, count, members);
 }
 
 Status BlackWidow::SRem(const Slice& key,
                         const std::vector<std::string>& members,
                         int32_t* ret) {
+  CommandStatsScope scope(kCmdSRem);
+  hot_keys_->RecordWrite(kSets, key);
   return sets_db_->SRem(key, members, ret);
 }
 
 Status BlackWidow::SUnion(const std::vector<std::string>& keys,
                           std::vector<std::string>* members) {
+  CommandStatsScope scope(kCmdSUnion);
   return sets_db_->SUnion(keys, members);
 }
 
+Status BlackWidow::SUnion(const std::vector<std::string>& keys,
+                          const ElementVisitor& visitor) {
+  CommandStatsScope scope(kCmdSUnion);
+  return sets_db_->SUnion(keys, visitor);
+}
+
 Status BlackWidow::SUnionstore(const Slice& destination,
                                const std::vector<std::string>& keys,
                                int32_t* ret) {
+  CommandStatsScope scope(kCmdSUnionstore);
   return sets_db_->SUnionstore(destination, keys, ret);
 }
 
@@ -475,45 +875,98 @@ Status BlackWidow::SScan(const Slice& key, int64_t cursor,
                          const std::string& pattern, int64_t count,
                          std::vector<std::string>* members,
                          int64_t* next_cursor) {
+  CommandStatsScope scope(kCmdSScan);
+  hot_keys_->RecordRead(kSets, key);
   return sets_db_->SScan(key, cursor, pattern, count, members, next_cursor);
 }
 
+Status BlackWidow::SScan(const Slice& key, const std::string& cursor,
+                         const std::string& pattern, int64_t count,
+                         std::vector<std::string>* members,
+                         std::string* next_cursor) {
+  CommandStatsScope scope(kCmdSScan);
+  hot_keys_->RecordRead(kSets, key);
+  return sets_db_->SScan(key, cursor,
+      pattern, count, members, next_cursor);
+}
+
 Status BlackWidow::LPush(const Slice& key,
                          const std::vector<std::string>& values,
                          uint64_t* ret) {
+  CommandStatsScope scope(kCmdLPush);
+  hot_keys_->RecordWrite(kLists, key);
   return lists_db_->LPush(key, values, ret);
 }
 
 Status BlackWidow::RPush(const Slice& key,
                          const std::vector<std::string>& values,
                          uint64_t* ret) {
+  CommandStatsScope scope(kCmdRPush);
+  hot_keys_->RecordWrite(kLists, key);
   return lists_db_->RPush(key, values, ret);
 }
 
 Status BlackWidow::LRange(const Slice& key, int64_t start, int64_t stop,
                           std::vector<std::string>* ret) {
+  CommandStatsScope scope(kCmdLRange);
+  hot_keys_->RecordRead(kLists, key);
   return lists_db_->LRange(key, start, stop, ret);
 }
 
+Status BlackWidow::LRange(const Slice& key, int64_t start, int64_t stop,
+                          const ElementVisitor& visitor) {
+  CommandStatsScope scope(kCmdLRange);
+  hot_keys_->RecordRead(kLists, key);
+  return lists_db_->LRange(key, start, stop, visitor);
+}
+
+Status BlackWidow::LRange(const Slice& key, int64_t start, int64_t stop,
+                          ReplySink* sink) {
+  CommandStatsScope scope(kCmdLRange);
+  hot_keys_->RecordRead(kLists, key);
+  uint64_t size;
+  lists_db_->LLen(key, &size);
+  int64_t len = 0;
+  sink->StartArray(RangeLength(size, start, stop));
+  Status s = lists_db_->LRange(key, start, stop,
+    [sink, &len](const Slice& element) {
+      sink->AppendBulkString(element);
+      len++;
+      return true;
+    });
+  sink->EndArray(len);
+  return s;
+}
+
 Status BlackWidow::LTrim(const Slice& key, int64_t start, int64_t stop) {
+  CommandStatsScope scope(kCmdLTrim);
+  hot_keys_->RecordWrite(kLists, key);
   return lists_db_->LTrim(key, start, stop);
 }
 
 Status BlackWidow::LLen(const Slice& key, uint64_t* len) {
+  CommandStatsScope scope(kCmdLLen);
+  hot_keys_->RecordRead(kLists, key);
   return lists_db_->LLen(key, len);
 }
 
 Status BlackWidow::LPop(const Slice& key, std::string* element) {
+  CommandStatsScope scope(kCmdLPop);
+  hot_keys_->RecordWrite(kLists, key);
   return lists_db_->LPop(key, element);
 }
 
 Status BlackWidow::RPop(const Slice& key, std::string* element) {
+  CommandStatsScope scope(kCmdRPop);
+  hot_keys_->RecordWrite(kLists, key);
   return lists_db_->RPop(key, element);
 }
 
 Status BlackWidow::LIndex(const Slice& key,
                           int64_t index,
                           std::string* element) {
+  CommandStatsScope scope(kCmdLIndex);
+  hot_keys_->RecordRead(kLists, key);
   return lists_db_->LIndex(key, index, element);
 }
 
@@ -522,52 +975,73 @@ Status BlackWidow::LInsert(const Slice& key,
                            const std::string& pivot,
                            const std::string& value,
                            int64_t* ret) {
+  CommandStatsScope scope(kCmdLInsert);
+  hot_keys_->RecordWrite(kLists, key);
   return lists_db_->LInsert(key, before_or_after, pivot, value, ret);
 }
 
 Status BlackWidow::LPushx(const Slice& key, const Slice& value, uint64_t* len) {
+  CommandStatsScope scope(kCmdLPushx);
+  hot_keys_->RecordWrite(kLists, key);
   return lists_db_->LPushx(key, value, len);
 }
 
 Status BlackWidow::RPushx(const Slice& key, const Slice& value, uint64_t* len) {
+  CommandStatsScope scope(kCmdRPushx);
+  hot_keys_->RecordWrite(kLists, key);
   return lists_db_->RPushx(key, value, len);
 }
 
 Status BlackWidow::LRem(const Slice& key, int64_t count,
                         const Slice& value, uint64_t* ret) {
+  CommandStatsScope scope(kCmdLRem);
+  hot_keys_->RecordWrite(kLists, key);
   return lists_db_->LRem(key, count, value, ret);
 }
 
 Status BlackWidow::LSet(const Slice& key, int64_t index, const Slice& value) {
+  CommandStatsScope scope(kCmdLSet);
+  hot_keys_->RecordWrite(kLists, key);
   return lists_db_->LSet(key, index, value);
 }
 
 Status BlackWidow::RPoplpush(const Slice& source,
                              const Slice& destination,
                              std::string* element) {
+  CommandStatsScope scope(kCmdRPoplpush);
+  hot_keys_->RecordWrite(kLists, source);
+  hot_keys_->RecordWrite(kLists, destination);
   return lists_db_->RPoplpush(source, destination, element);
 }
 
 Status BlackWidow::ZPopMax(const Slice& key,
 			   const int64_t count,
 			   std::vector<ScoreMember>* score_members){
+  CommandStatsScope scope(kCmdZPopMax);
+  hot_keys_->RecordWrite(kZSets, key);
   return zsets_db_->ZPopMax(key, count, score_members);
 }
 
 Status BlackWidow::ZPopMin(const Slice& key,
 			   const int64_t count,
                            std::vector<ScoreMember>* score_members){
+  CommandStatsScope scope(kCmdZPopMin);
+  hot_keys_->RecordWrite(kZSets, key);
   return zsets_db_->ZPopMin(key, count, score_members);
 }
 
 Status BlackWidow::ZAdd(const Slice& key,
                         const std::vector<ScoreMember>& score_members,
                         int32_t* ret) {
+  CommandStatsScope scope(kCmdZAdd);
+  hot_keys_->RecordWrite(kZSets, key);
   return zsets_db_->ZAdd(key, score_members, ret);
 }
 
 Status BlackWidow::ZCard(const Slice& key,
                          int32_t* ret) {
+  CommandStatsScope scope(kCmdZCard);
+  hot_keys_->RecordRead(kZSets, key);
   return zsets_db_->ZCard(key, ret);
 }
 
@@ -577,6 +1051,8 @@ Status BlackWidow::ZCount(const Slice& key,
                           bool left_close,
                           bool right_close,
                           int32_t* ret) {
+  CommandStatsScope scope(kCmdZCount);
+  hot_keys_->RecordRead(kZSets, key);
   return zsets_db_->ZCount(key, min, max, left_close, right_close, ret);
 }
 
@@ -584,6 +1060,8 @@ Status BlackWidow::ZIncrby(const Slice& key,
                            const Slice& member,
                            double increment,
                            double* ret) {
+  CommandStatsScope scope(kCmdZIncrby);
+  hot_keys_->RecordWrite(kZSets, key);
   return zsets_db_->ZIncrby(key, member, increment, ret);
 }
 
@@ -591,15 +1069,43 @@ Status BlackWidow::ZRange(const Slice& key,
                           int32_t start,
                           int32_t stop,
                           std::vector<ScoreMember>* score_members) {
+  CommandStatsScope scope(kCmdZRange);
+  hot_keys_->RecordRead(kZSets, key);
   return zsets_db_->ZRange(key, start, stop, score_members);
 }
 
+Status BlackWidow::ZRange(const Slice& key,
+                          int32_t start,
+                          int32_t stop,
+                          const ScoreMemberVisitor& visitor) {
+  CommandStatsScope scope(kCmdZRange);
+  hot_keys_->RecordRead(kZSets, key);
+  return zsets_db_->ZRange(key, start, stop, visitor);
+}
+
+Status BlackWidow::ZRange(const Slice& key,
+                          int32_t start,
+                          int32_t stop,
+                          bool with_scores,
+                          ReplySink* sink) {
+  CommandStatsScope scope(kCmdZRange);
+  hot_keys_->RecordRead(kZSets, key);
+  int32_t size;
+  zsets_db_->ZCard(key, &size);
+  return WriteScoreMembers(RangeLength(size, start, stop), with_scores, sink,
+    [&](const ScoreMemberVisitor& visitor) {
+      return zsets_db_->ZRange(key, start, stop, visitor);
+    });
+}
+
 Status BlackWidow::ZRangebyscore(const Slice& key,
                                  double min,
                                  double max,
                                  bool left_close,
                                  bool right_close,
                                  std::vector<ScoreMember>* score_members) {
+  CommandStatsScope scope(kCmdZRangebyscore);
+  hot_keys_->RecordRead(kZSets, key);
   // maximum number of zset is std::numeric_limits<int32_t>::max()
   return zsets_db_->ZRangebyscore(key, min, max,
       left_close, right_close, std::numeric_limits<int32_t>::max(), 0, score_members);
@@ -613,19 +1119,39 @@ Status BlackWidow::ZRangebyscore(const Slice& key,
                                  int64_t count,
                                  int64_t offset,
                                  std::vector<ScoreMember>* score_members) {
+  CommandStatsScope scope(kCmdZRangebyscore);
+  hot_keys_->RecordRead(kZSets, key);
   return zsets_db_->ZRangebyscore(key, min, max,
       left_close, right_close, count, offset, score_members);
 }
 
+Status BlackWidow::ZRangebyscore(const Slice& key,
+                                 double min,
+                                 double max,
+                                 bool left_close,
+                                 bool right_close,
+                                 int64_t count,
+                                 int64_t offset,
+                                 const ScoreMemberVisitor& visitor) {
+  CommandStatsScope scope(kCmdZRangebyscore);
+  hot_keys_->RecordRead(kZSets, key);
+  return zsets_db_->ZRangebyscore(key, min, max,
+      left_close, right_close, count, offset, visitor);
+}
+
 Status BlackWidow::ZRank(const Slice& key,
                          const Slice& member,
                          int32_t* rank) {
+  CommandStatsScope scope(kCmdZRank);
+  hot_keys_->RecordRead(kZSets, key);
   return zsets_db_->ZRank(key, member, rank);
 }
 
 Status BlackWidow::ZRem(const Slice& key,
                         std::vector<std::string> members,
                         int32_t* ret) {
+  CommandStatsScope scope(kCmdZRem);
+  hot_keys_->RecordWrite(kZSets, key);
   return zsets_db_->ZRem(key, members, ret);
 }
 
@@ -633,6 +1159,8 @@ Status BlackWidow::ZRemrangebyrank(const Slice& key,
                                    int32_t start,
                                    int32_t stop,
                                    int32_t* ret) {
+  CommandStatsScope scope(kCmdZRemrangebyrank);
+  hot_keys_->RecordWrite(kZSets, key);
   return zsets_db_->ZRemrangebyrank(key, start, stop, ret);
 }
 
@@ -642,6 +1170,8 @@ Status BlackWidow::ZRemrangebyscore(const Slice& key,
                                     bool left_close,
                                     bool right_close,
                                     int32_t* ret) {
+  CommandStatsScope scope(kCmdZRemrangebyscore);
+  hot_keys_->RecordWrite(kZSets, key);
   return zsets_db_->ZRemrangebyscore(key, min, max,
       left_close, right_close, ret);
 }
@@ -654,23 +1184,67 @@ Status BlackWidow::ZRevrangebyscore(const Slice& key,
                                     int64_t count,
                                     int64_t offset,
                                     std::vector<ScoreMember>* score_members) {
+  CommandStatsScope scope(kCmdZRevrangebyscore);
+  hot_keys_->RecordRead(kZSets, key);
   return zsets_db_->ZRevrangebyscore(key, min, max,
       left_close, right_close, count, offset, score_members);
 }
 
+Status BlackWidow::ZRevrangebyscore(const Slice& key,
+                                    double min,
+                                    double max,
+                                    bool left_close,
+                                    bool right_close,
+                                    int64_t count,
+                                    int64_t offset,
+                                    const ScoreMemberVisitor& visitor) {
+  CommandStatsScope scope(kCmdZRevrangebyscore);
+  hot_keys_->RecordRead(kZSets, key);
+  return zsets_db_->ZRevrangebyscore(key, min, max,
+      left_close, right_close, count, offset, visitor);
+}
+
 Status BlackWidow::ZRevrange(const Slice& key,
                              int32_t start,
                              int32_t stop,
                              std::vector<ScoreMember>* score_members) {
+  CommandStatsScope scope(kCmdZRevrange);
+  hot_keys_->RecordRead(kZSets, key);
   return zsets_db_->ZRevrange(key, start, stop, score_members);
 }
 
+Status BlackWidow::ZRevrange(const Slice& key,
+                             int32_t start,
+                             int32_t stop,
+                             const ScoreMemberVisitor& visitor) {
+  CommandStatsScope scope(kCmdZRevrange);
+  hot_keys_->RecordRead(kZSets, key);
+  return zsets_db_->ZRevrange(key, start, stop, visitor);
+}
+
+Status BlackWidow::ZRevrange(const Slice& key,
+                             int32_t start,
+                             int32_t stop,
+                             bool with_scores,
+                             ReplySink* sink) {
+  CommandStatsScope scope(kCmdZRevrange);
+  hot_keys_->RecordRead(kZSets, key);
+  int32_t size;
+  zsets_db_->ZCard(key, &size);
+  return WriteScoreMembers(RangeLength(size, start, stop), with_scores, sink,
+    [&](const ScoreMemberVisitor& visitor) {
+      return zsets_db_->ZRevrange(key, start, stop, visitor);
+    });
+}
+
 Status BlackWidow::ZRevrangebyscore(const Slice& key,
                                     double min,
                                     double max,
                                     bool left_close,
                                     bool right_close,
                                     std::vector<ScoreMember>* score_members) {
+  CommandStatsScope scope(kCmdZRevrangebyscore);
+  hot_keys_->RecordRead(kZSets, key);
   // maximum number of zset is std::numeric_limits<int32_t>::max()
   return zsets_db_->ZRevrangebyscore(key, min, max,
       left_close, right_close, std::numeric_limits<int32_t>::max(), 0, score_members);
@@ -679,12 +1253,16 @@ Status BlackWidow::ZRevrangebyscore(const Slice& key,
 Status BlackWidow::ZRevrank(const Slice& key,
                             const Slice& member,
                             int32_t* rank) {
+  CommandStatsScope scope(kCmdZRevrank);
+  hot_keys_->RecordRead(kZSets, key);
   return zsets_db_->ZRevrank(key, member, rank);
 }
 
 Status BlackWidow::ZScore(const Slice& key,
                           const Slice& member,
                           double* ret) {
+  CommandStatsScope scope(kCmdZScore);
+  hot_keys_->RecordRead(kZSets, key);
   return zsets_db_->ZScore(key, member, ret);
 }
 
@@ -693,6 +1271,7 @@ Status BlackWidow::ZUnionstore(const Slice& destination,
                                const std::vector<double>& weights,
                                const AGGREGATE agg,
                                int32_t* ret) {
+  CommandStatsScope scope(kCmdZUnionstore);
   return zsets_db_->ZUnionstore(destination, keys, weights, agg, ret);
 }
 
@@ -701,6 +1280,7 @@ Status BlackWidow::ZInterstore(const Slice& destination,
                                const std::vector<double>& weights,
                                const AGGREGATE agg,
                                int32_t* ret) {
+  CommandStatsScope scope(kCmdZInterstore);
   return zsets_db_->ZInterstore(destination, keys, weights, agg, ret);
 }
 
@@ -710,6 +1290,8 @@ Status BlackWidow::ZRangebylex(const Slice& key,
                                bool left_close,
                                bool right_close,
                                std::vector<std::string>* members) {
+  CommandStatsScope scope(kCmdZRangebylex);
+  hot_keys_->RecordRead(kZSets, key);
   return zsets_db_->ZRangebylex(key, min, max,
       left_close, right_close, members);
 }
@@ -720,6 +1302,8 @@ Status BlackWidow::ZLexcount(const Slice& key,
                              bool left_close,
                              bool right_close,
                              int32_t* ret) {
+  CommandStatsScope scope(kCmdZLexcount);
+  hot_keys_->RecordRead(kZSets, key);
   return zsets_db_->ZLexcount(key, min, max, left_close, right_close, ret);
 }
 
@@ -729,6 +1313,8 @@ Status BlackWidow::ZRemrangebylex(const Slice& key,
                                   bool left_close,
                                   bool right_close,
                                   int32_t* ret) {
+  CommandStatsScope scope(kCmdZRemrangebylex);
+  hot_keys_->RecordWrite(kZSets, key);
   return zsets_db_->ZRemrangebylex(key, min, max, left_close, right_close, ret);
 }
 
@@ -736,6 +1322,18 @@ Status BlackWidow::ZScan(const Slice& key, int64_t cursor,
                          const std::string& pattern, int64_t count,
                          std::vector<ScoreMember>* score_members,
                          int64_t* next_cursor) {
+  CommandStatsScope scope(kCmdZScan);
+  hot_keys_->RecordRead(kZSets, key);
+  return zsets_db_->ZScan(key, cursor,
+      pattern, count, score_members, next_cursor);
+}
+
+Status BlackWidow::ZScan(const Slice& key, const std::string& cursor,
+                         const std::string& pattern, int64_t count,
+                         std::vector<ScoreMember>* score_members,
+                         std::string* next_cursor) {
+  CommandStatsScope scope(kCmdZScan);
+  hot_keys_->RecordRead(kZSets, key);
   return zsets_db_->ZScan(key, cursor,
       pattern, count, score_members, next_cursor);
 }
@@ -744,6 +1342,7 @@ Status BlackWidow::ZScan(const Slice& key, int64_t cursor,
 // Keys Commands
 int32_t BlackWidow::Expire(const Slice& key, int32_t ttl,
                            std::map<DataType, Status>* type_status) {
+  CommandStatsScope scope(kCmdExpire);
   int32_t ret = 0;
   bool is_corruption = false;
 
@@ -751,6 +1350,8 @@ int32_t BlackWidow::Expire(const Slice& key, int32_t ttl,
   Status s = strings_db_->Expire(key, ttl);
   if (s.ok()) {
     ret++;
+  } else if (LockMgr::IsLockFailure(s)) {
+    (*type_status)[DataType::kStrings] = s;
   } else if (!s.IsNotFound()) {
     is_corruption = true;
     (*type_status)[DataType::kStrings] = s;
@@ -760,6 +1361,8 @@ int32_t BlackWidow::Expire(const Slice& key, int32_t ttl,
   s = hashes_db_->Expire(key, ttl);
   if (s.ok()) {
     ret++;
+  } else if (LockMgr::IsLockFailure(s)) {
+    (*type_status)[DataType::kHashes] = s;
   } else if (!s.IsNotFound()) {
     is_corruption = true;
     (*type_status)[DataType::kHashes] = s;
@@ -769,6 +1372,8 @@ int32_t BlackWidow::Expire(const Slice& key, int32_t ttl,
   s = sets_db_->Expire(key, ttl);
   if (s.ok()) {
     ret++;
+  } else if (LockMgr::IsLockFailure(s)) {
+    (*type_status)[DataType::kSets] = s;
   } else if (!s.IsNotFound()) {
     is_corruption = true;
     (*type_status)[DataType::kSets] = s;
@@ -778,6 +1383,8 @@ int32_t BlackWidow::Expire(const Slice& key, int32_t ttl,
   s = lists_db_->Expire(key, ttl);
   if (s.ok()) {
     ret++;
+  } else if (LockMgr::IsLockFailure(s)) {
+    (*type_status)[DataType::kLists] = s;
   } else if (!s.IsNotFound()) {
     is_corruption = true;
     (*type_status)[DataType::kLists] = s;
@@ -787,6 +1394,8 @@ int32_t BlackWidow::Expire(const Slice& key, int32_t ttl,
   s = zsets_db_->Expire(key, ttl);
   if (s.ok()) {
     ret++;
+  } else if (LockMgr::IsLockFailure(s)) {
+    (*type_status)[DataType::kZSets] = s;
   } else if (!s.IsNotFound()) {
     is_corruption = true;
     (*type_status)[DataType::kZSets] = s;
@@ -801,6 +1410,7 @@ int32_t BlackWidow::Expire(const Slice& key, int32_t ttl,
 
 int64_t BlackWidow::Del(const std::vector<std::string>& keys,
                         std::map<DataType, Status>* type_status) {
+  CommandStatsScope scope(kCmdDel);
   Status s;
   int64_t count = 0;
   bool is_corruption = false;
@@ -810,6 +1420,8 @@ int64_t BlackWidow::Del(const std::vector<std::string>& keys,
     Status s = strings_db_->Del(key);
     if (s.ok()) {
       count++;
+    } else if (LockMgr::IsLockFailure(s)) {
+      (*type_status)[DataType::kStrings] = s;
     } else if (!s.IsNotFound()) {
       is_corruption = true;
       (*type_status)[DataType::kStrings] = s;
@@ -819,6 +1431,8 @@ int64_t BlackWidow::Del(const std::vector<std::string>& keys,
     s = hashes_db_->Del(key);
     if (s.ok()) {
       count++;
+    } else if (LockMgr::IsLockFailure(s)) {
+      (*type_status)[DataType::kHashes] = s;
     } else if (!s.IsNotFound()) {
       is_corruption = true;
       (*type_status)[DataType::kHashes] = s;
@@ -828,6 +1442,8 @@ int64_t BlackWidow::Del(const std::vector<std::string>& keys,
     s = sets_db_->Del(key);
     if (s.ok()) {
       count++;
+    } else if (LockMgr::IsLockFailure(s)) {
+      (*type_status)[DataType::kSets] = s;
     } else if (!s.IsNotFound()) {
       is_corruption = true;
       (*type_status)[DataType::kSets] = s;
@@ -837,6 +1453,8 @@ int64_t BlackWidow::Del(const std::vector<std::string>& keys,
     s = lists_db_->Del(key);
     if (s.ok()) {
       count++;
+    } else if (LockMgr::IsLockFailure(s)) {
+      (*type_status)[DataType::kLists] = s;
     } else if (!s.IsNotFound()) {
       is_corruption = true;
       (*type_status)[DataType::kLists] = s;
@@ -846,6 +1464,8 @@ int64_t BlackWidow::Del(const std::vector<std::string>& keys,
     s = zsets_db_->Del(key);
     if (s.ok()) {
       count++;
+    } else if (LockMgr::IsLockFailure(s)) {
+      (*type_status)[DataType::kZSets] = s;
     } else if (!s.IsNotFound()) {
       is_corruption = true;
       (*type_status)[DataType::kZSets] = s;
@@ -861,6 +1481,7 @@ int64_t BlackWidow::Del(const std::vector<std::string>& keys,
 
 int64_t BlackWidow::DelByType(const std::vector<std::string>& keys,
                               const DataType& type) {
+  CommandStatsScope scope(kCmdDelByType);
   Status s;
   int64_t count = 0;
   bool is_corruption = false;
@@ -873,7 +1494,7 @@ int64_t BlackWidow::DelByType(const std::vector<std::string>& keys,
         s = strings_db_->Del(key);
         if (s.ok()) {
           count++;
-        } else if (!s.IsNotFound()) {
+        } else if (!s.IsNotFound() && !LockMgr::IsLockFailure(s)) {
           is_corruption = true;
         }
         break;
@@ -884,7 +1505,7 @@ int64_t BlackWidow::DelByType(const std::vector<std::string>& keys,
         s = hashes_db_->Del(key);
         if (s.ok()) {
           count++;
-        } else if (!s.IsNotFound()) {
+        } else if (!s.IsNotFound() && !LockMgr::IsLockFailure(s)) {
           is_corruption = true;
         }
         break;
@@ -895,7 +1516,7 @@ int64_t BlackWidow::DelByType(const std::vector<std::string>& keys,
         s = sets_db_->Del(key);
         if (s.ok()) {
           count++;
-        } else if (!s.IsNotFound()) {
+        } else if (!s.IsNotFound() && !LockMgr::IsLockFailure(s)) {
           is_corruption = true;
         }
         break;
@@ -906,7 +1527,7 @@ int64_t BlackWidow::DelByType(const std::vector<std::string>& keys,
         s = lists_db_->Del(key);
         if (s.ok()) {
           count++;
-        } else if (!s.IsNotFound()) {
+        } else if (!s.IsNotFound() && !LockMgr::IsLockFailure(s)) {
           is_corruption = true;
         }
         break;
@@ -917,7 +1538,7 @@ int64_t BlackWidow::DelByType(const std::vector<std::string>& keys,
         s = zsets_db_->Del(key);
         if (s.ok()) {
           count++;
-        } else if (!s.IsNotFound()) {
+        } else if (!s.IsNotFound() && !LockMgr::IsLockFailure(s)) {
           is_corruption = true;
         }
         break;
@@ -939,6 +1560,7 @@ int64_t BlackWidow::DelByType(const std::vector<std::string>& keys,
 
 int64_t BlackWidow::Exists(const std::vector<std::string>& keys,
                        std::map<DataType, Status>* type_status) {
+  CommandStatsScope scope(kCmdExists);
   int64_t count = 0;
   int32_t ret;
   uint64_t llen;
@@ -998,27 +1620,65 @@ int64_t BlackWidow::Exists(const std::vector<std::string>& keys,
 int64_t BlackWidow::Scan(const DataType& dtype, int64_t cursor,
                          const std::string& pattern, int64_t count,
                          std::vector<std::string>* keys) {
+  CommandStatsScope scope(kCmdScan);
   keys->clear();
-  bool is_finish;
-  int64_t leftover_visits = count;
-  int64_t step_length = count, cursor_ret = 0;
-  std::string start_key, next_key, prefix;
-
-  prefix = isTailWildcard(pattern) ?
-    pattern.substr(0, pattern.size() - 1) : "";
-
+  std::string start_key, next_start_key;
   if (cursor < 0) {
-    return cursor_ret;
+    return 0;
   } else {
     Status s = GetStartKey(dtype, cursor, &start_key);
     if (s.IsNotFound()) {
       // If want to scan all the databases, we start with the strings database
       start_key = (dtype == DataType::kAll
-          ? DataTypeTag[kStrings] : DataTypeTag[dtype]) + prefix;
+          ? DataTypeTag[kStrings] : DataTypeTag[dtype])
+        + GlobPattern(pattern).prefix();
       cursor = 0;
     }
   }
 
+  next_start_key = ScanFromStartKey(dtype, start_key, pattern, count, keys);
+  if (next_start_key.empty()) {
+    return 0;
+  }
+  int64_t cursor_ret = cursor + count;
+  StoreCursorStartKey(dtype, cursor_ret, next_start_key);
+  return cursor_ret;
+}
+
+Status BlackWidow::Scan(const DataType& dtype, const std::string& cursor,
+                        const std::string& pattern, int64_t count,
+                        std::vector<std::string>* keys,
+                        std::string* next_cursor) {
+  CommandStatsScope scope(kCmdScan);
+  keys->clear();
+  next_cursor->clear();
+  char type_tag = dtype == DataType::kAll
+    ? DataTypeTag[kStrings] : DataTypeTag[dtype];
+  std::string start_key;
+  if (!cursor.empty()
+    && (!DecodeScanCursor(cursor, &type_tag, &start_key)
+      || strchr("khslz", type_tag) == NULL
+      || (dtype != DataType::kAll && type_tag != DataTypeTag[dtype]))) {
+    return Status::InvalidArgument("invalid cursor");
+  }
+  // The start keys are already tagged by their data type
+  *next_cursor = ScanFromStartKey(dtype,
+                                  EncodeScanCursor(type_tag, start_key),
+                                  pattern, count, keys);
+  return Status::OK();
+}
+
+std::string BlackWidow::ScanFromStartKey(const DataType& dtype,
+                                         std::string start_key,
+                                         const std::string& pattern,
+                                         int64_t count,
+                                         std::vector<std::string>* keys) {
+  bool is_finish;
+  int64_t leftover_visits = count;
+  std::string next_key, next_start_key;
+  // The databases are scanned from the literal prefix of pattern
+  std::string prefix = GlobPattern(pattern).prefix();
+
   char key_type = start_key.at(0);
   start_key.erase(start_key.begin());
   switch (key_type) {
@@ -1026,16 +1686,13 @@ int64_t BlackWidow::Scan(const DataType& dtype, int64_t cursor,
       is_finish = strings_db_->Scan(start_key, pattern,
                                     keys, &leftover_visits, &next_key);
       if (!leftover_visits && !is_finish) {
-        cursor_ret = cursor + step_length;
-        StoreCursorStartKey(dtype, cursor_ret, std::string("k") + next_key);
+        next_start_key = std::string("k") + next_key;
         break;
       } else if (is_finish) {
         if (DataType::kStrings == dtype) {
-          cursor_ret = 0;
           break;
         } else if (!leftover_visits) {
-          cursor_ret = cursor + step_length;
-          StoreCursorStartKey(dtype, cursor_ret, std::string("h") + prefix);
+          next_start_key = std::string("h") + prefix;
           break;
         }
       }
@@ -1044,16 +1701,13 @@ int64_t BlackWidow::Scan(const DataType& dtype, int64_t cursor,
       is_finish = hashes_db_->Scan(start_key, pattern,
                                    keys, &leftover_visits, &next_key);
       if (!leftover_visits && !is_finish) {
-        cursor_ret = cursor + step_length;
-        StoreCursorStartKey(dtype, cursor_ret, std::string("h") + next_key);
+        next_start_key = std::string("h") + next_key;
         break;
       } else if (is_finish) {
         if (DataType::kHashes == dtype) {
-          cursor_ret = 0;
           break;
         } else if (!leftover_visits) {
-          cursor_ret = cursor + step_length;
-          StoreCursorStartKey(dtype, cursor_ret, std::string("s") + prefix);
+          next_start_key = std::string("s") + prefix;
           break;
         }
       }
@@ -1062,16 +1716,13 @@ int64_t BlackWidow::Scan(const DataType& dtype, int64_t cursor,
       is_finish = sets_db_->Scan(start_key, pattern,
                                  keys, &leftover_visits, &next_key);
       if (!leftover_visits && !is_finish) {
-        cursor_ret = cursor + step_length;
-        StoreCursorStartKey(dtype, cursor_ret, std::string("s") + next_key);
+        next_start_key = std::string("s") + next_key;
         break;
       } else if (is_finish) {
         if (DataType::kSets == dtype) {
-          cursor_ret = 0;
           break;
         } else if (!leftover_visits) {
-          cursor_ret = cursor + step_length;
-          StoreCursorStartKey(dtype, cursor_ret, std::string("l") + prefix);
+          next_start_key = std::string("l") + prefix;
           break;
         }
       }
@@ -1080,16 +1731,13 @@ int64_t BlackWidow::Scan(const DataType& dtype, int64_t cursor,
       is_finish = lists_db_->Scan(start_key, pattern,
                                   keys, &leftover_visits, &next_key);
       if (!leftover_visits && !is_finish) {
-        cursor_ret = cursor + step_length;
-        StoreCursorStartKey(dtype, cursor_ret, std::string("l") + next_key);
+        next_start_key = std::string("l") + next_key;
         break;
       } else if (is_finish) {
         if (DataType::kLists == dtype) {
-          cursor_ret = 0;
           break;
         } else if (!leftover_visits) {
-          cursor_ret = cursor + step_length;
-          StoreCursorStartKey(dtype, cursor_ret, std::string("z") + prefix);
+          next_start_key = std::string("z") + prefix;
           break;
         }
       }
@@ -1098,28 +1746,26 @@ int64_t BlackWidow::Scan(const DataType& dtype, int64_t cursor,
       is_finish = zsets_db_->Scan(start_key, pattern,
                                   keys, &leftover_visits, &next_key);
       if (!leftover_visits && !is_finish) {
-        cursor_ret = cursor + step_length;
-        StoreCursorStartKey(dtype, cursor_ret, std::string("z") + next_key);
+        next_start_key = std::string("z") + next_key;
         break;
       } else if (is_finish) {
-        cursor_ret = 0;
         break;
       }
   }
-  return cursor_ret;
+  return next_start_key;
 }
 
 int64_t BlackWidow::PKExpireScan(const DataType& dtype, int64_t cursor,
                                  int32_t min_ttl, int32_t max_ttl,
                                  int64_t count, std::vector<std::string>* keys) {
+  CommandStatsScope scope(kCmdPKExpireScan);
   keys->clear();
   bool is_finish;
   int64_t leftover_visits = count;
   int64_t step_length = count, cursor_ret = 0;
   std::string start_key, next_key;
 
-  int64_t curtime;
-  rocksdb::Env::Default()->GetCurrentTime(&curtime);
+  int64_t curtime = CoarseClock::Now();
 
   if (cursor < 0) {
     return cursor_ret;
@@ -1231,6 +1877,7 @@ Status BlackWidow::PKScanRange(const DataType& data_type,
                                std::vector<std::string>* keys,
                                std::vector<KeyValue>* kvs,
                                std::string* next_key) {
+  CommandStatsScope scope(kCmdPKScanRange);
   Status s;
   keys->clear();
   next_key->clear();
@@ -1268,6 +1915,7 @@ Status BlackWidow::PKRScanRange(const DataType& data_type,
                                 std::vector<std::string>* keys,
                                 std::vector<KeyValue>* kvs,
                                 std::string* next_key) {
+  CommandStatsScope scope(kCmdPKRScanRange);
   Status s;
   keys->clear();
   next_key->clear();
@@ -1302,27 +1950,38 @@ Status BlackWidow::PKRScanRange(const DataType& data_type,
 Status BlackWidow::PKPatternMatchDel(const DataType& data_type,
                                      const std::string& pattern,
                                      int32_t* ret) {
-  Status s;
+  CommandStatsScope scope(kCmdPKPatternMatchDel);
+  Redis* db;
   switch (data_type) {
     case DataType::kStrings:
-      s = strings_db_->PKPatternMatchDel(pattern, ret);
+      db = strings_db_;
       break;
     case DataType::kHashes:
-      s = hashes_db_->PKPatternMatchDel(pattern, ret);
+      db = hashes_db_;
       break;
     case DataType::kLists:
-      s = lists_db_->PKPatternMatchDel(pattern, ret);
+      db = lists_db_;
       break;
     case DataType::kZSets:
-      s = zsets_db_->PKPatternMatchDel(pattern, ret);
+      db = zsets_db_;
       break;
     case DataType::kSets:
-      s = sets_db_->PKPatternMatchDel(pattern, ret);
+      db = sets_db_;
       break;
     default:
-      s = Status::Corruption("Unsupported data type");
-      break;
-  }
+      return Status::Corruption("Unsupported data type");
+  }
+  std::vector<KeyRangeTask> tasks;
+  SplitKeyRanges({db}, keyspace_scan_threads_, &tasks);
+  std::atomic<int32_t> total_deleted(0);
+  Status s = key_range_workers_->Run(tasks.size(),
+    [&](size_t idx) {
+      int32_t deleted = 0;
+      Status s = db->PKPatternMatchDel(pattern, tasks[idx].range, &deleted);
+      total_deleted += deleted;
+      return s;
+    });
+  *ret = total_deleted;
   return s;
 }
 
@@ -1332,6 +1991,7 @@ Status BlackWidow::Scanx(const DataType& data_type,
                          int64_t count,
                          std::vector<std::string>* keys,
                          std::string* next_key) {
+  CommandStatsScope scope(kCmdScanx);
   Status s;
   keys->clear();
   next_key->clear();
@@ -1360,6 +2020,7 @@ Status BlackWidow::Scanx(const DataType& data_type,
 
 int32_t BlackWidow::Expireat(const Slice& key, int32_t timestamp,
                              std::map<DataType, Status>* type_status) {
+  CommandStatsScope scope(kCmdExpireat);
   Status s;
   int32_t count = 0;
   bool is_corruption = false;
@@ -1367,6 +2028,8 @@ int32_t BlackWidow::Expireat(const Slice& key, int32_t timestamp,
   s = strings_db_->Expireat(key, timestamp);
   if (s.ok()) {
     count++;
+  } else if (LockMgr::IsLockFailure(s)) {
+    (*type_status)[DataType::kStrings] = s;
   } else if (!s.IsNotFound()) {
     is_corruption = true;
     (*type_status)[DataType::kStrings] = s;
@@ -1375,6 +2038,8 @@ int32_t BlackWidow::Expireat(const Slice& key, int32_t timestamp,
   s = hashes_db_->Expireat(key, timestamp);
   if (s.ok()) {
     count++;
+  } else if (LockMgr::IsLockFailure(s)) {
+    (*type_status)[DataType::kHashes] = s;
   } else if (!s.IsNotFound()) {
     is_corruption = true;
     (*type_status)[DataType::kHashes] = s;
@@ -1383,6 +2048,8 @@ int32_t BlackWidow::Expireat(const Slice& key, int32_t timestamp,
   s = sets_db_->Expireat(key, timestamp);
   if (s.ok()) {
     count++;
+  } else if (LockMgr::IsLockFailure(s)) {
+    (*type_status)[DataType::kSets] = s;
   } else if (!s.IsNotFound()) {
     is_corruption = true;
     (*type_status)[DataType::kSets] = s;
@@ -1391,6 +2058,8 @@ int32_t BlackWidow::Expireat(const Slice& key, int32_t timestamp,
   s = lists_db_->Expireat(key, timestamp);
   if (s.ok()) {
     count++;
+  } else if (LockMgr::IsLockFailure(s)) {
+    (*type_status)[DataType::kLists] = s;
   } else if (!s.IsNotFound()) {
     is_corruption = true;
     (*type_status)[DataType::kLists] = s;
@@ -1399,6 +2068,8 @@ int32_t BlackWidow::Expireat(const Slice& key, int32_t timestamp,
   s = zsets_db_->Expireat(key, timestamp);
   if (s.ok()) {
     count++;
+  } else if (LockMgr::IsLockFailure(s)) {
+    (*type_status)[DataType::kLists] = s;
   } else if (!s.IsNotFound()) {
     is_corruption = true;
     (*type_status)[DataType::kLists] = s;
@@ -1413,6 +2084,7 @@ int32_t BlackWidow::Expireat(const Slice& key, int32_t timestamp,
 
 int32_t BlackWidow::Persist(const Slice& key,
                             std::map<DataType, Status>* type_status) {
+  CommandStatsScope scope(kCmdPersist);
   Status s;
   int32_t count = 0;
   bool is_corruption = false;
@@ -1420,6 +2092,8 @@ int32_t BlackWidow::Persist(const Slice& key,
   s = strings_db_->Persist(key);
   if (s.ok()) {
     count++;
+  } else if (LockMgr::IsLockFailure(s)) {
+    (*type_status)[DataType::kStrings] = s;
   } else if (!s.IsNotFound()) {
     is_corruption = true;
     (*type_status)[DataType::kStrings] = s;
@@ -1428,6 +2102,8 @@ int32_t BlackWidow::Persist(const Slice& key,
   s = hashes_db_->Persist(key);
   if (s.ok()) {
     count++;
+  } else if (LockMgr::IsLockFailure(s)) {
+    (*type_status)[DataType::kHashes] = s;
   } else if (!s.IsNotFound()) {
     is_corruption = true;
     (*type_status)[DataType::kHashes] = s;
@@ -1436,6 +2112,8 @@ int32_t BlackWidow::Persist(const Slice& key,
   s = sets_db_->Persist(key);
   if (s.ok()) {
     count++;
+  } else if (LockMgr::IsLockFailure(s)) {
+    (*type_status)[DataType::kSets] = s;
   } else if (!s.IsNotFound()) {
     is_corruption = true;
     (*type_status)[DataType::kSets] = s;
@@ -1444,6 +2122,8 @@ int32_t BlackWidow::Persist(const Slice& key,
   s = lists_db_->Persist(key);
   if (s.ok()) {
     count++;
+  } else if (LockMgr::IsLockFailure(s)) {
+    (*type_status)[DataType::kLists] = s;
   } else if (!s.IsNotFound()) {
     is_corruption = true;
     (*type_status)[DataType::kLists] = s;
@@ -1452,6 +2132,8 @@ int32_t BlackWidow::Persist(const Slice& key,
   s = zsets_db_->Persist(key);
   if (s.ok()) {
     count++;
+  } else if (LockMgr::IsLockFailure(s)) {
+    (*type_status)[DataType::kLists] = s;
   } else if (!s.IsNotFound()) {
     is_corruption = true;
     (*type_status)[DataType::kLists] = s;
@@ -1466,6 +2148,7 @@ int32_t BlackWidow::Persist(const Slice& key,
 
 std::map<DataType, int64_t> BlackWidow::TTL(const Slice& key,
                         std::map<DataType, Status>* type_status) {
+  CommandStatsScope scope(kCmdTTL);
   Status s;
   std::map<DataType, int64_t> ret;
   int64_t timestamp = 0;
@@ -1514,6 +2197,7 @@ std::map<DataType, int64_t> BlackWidow::TTL(const Slice& key,
 
 // the sequence is kv, hash, list, zset, set
 Status BlackWidow::Type(const std::string &key, std::string* type) {
+  CommandStatsScope scope(kCmdType);
   type->clear();
 
   Status s;
@@ -1566,40 +2250,71 @@ Status BlackWidow::Type(const std::string &key, std::string* type) {
   return Status::OK();
 }
 
-Status BlackWidow::Keys(const DataType& data_type,
-                        const std::string& pattern,
-                        std::vector<std::string>* keys) {
-  Status s;
+void BlackWidow::GetTypeDBs(const DataType& data_type,
+                            std::vector<Redis*>* dbs) {
   if (data_type == DataType::kStrings) {
-    s = strings_db_->ScanKeys(pattern, keys);
-    if (!s.ok()) return s;
+    *dbs = {strings_db_};
   } else if (data_type == DataType::kHashes) {
-    s = hashes_db_->ScanKeys(pattern, keys);
-    if (!s.ok()) return s;
+    *dbs = {hashes_db_};
   } else if (data_type == DataType::kZSets) {
-    s = zsets_db_->ScanKeys(pattern, keys);
-    if (!s.ok()) return s;
+    *dbs = {zsets_db_};
   } else if (data_type == DataType::kSets) {
-    s = sets_db_->ScanKeys(pattern, keys);
-    if (!s.ok()) return s;
+    *dbs = {sets_db_};
   } else if (data_type == DataType::kLists) {
-    s = lists_db_->ScanKeys(pattern, keys);
-    if (!s.ok()) return s;
+    *dbs = {lists_db_};
   } else {
-    s = strings_db_->ScanKeys(pattern, keys);
-    if (!s.ok()) return s;
-    s = hashes_db_->ScanKeys(pattern, keys);
-    if (!s.ok()) return s;
-    s = zsets_db_->ScanKeys(pattern, keys);
-    if (!s.ok()) return s;
-    s = sets_db_->ScanKeys(pattern, keys);
-    if (!s.ok()) return s;
-    s = lists_db_->ScanKeys(pattern, keys);
-    if (!s.ok()) return s;
+    *dbs = {strings_db_, hashes_db_, zsets_db_, sets_db_, lists_db_};
+  }
+}
+
+Status BlackWidow::Keys(const DataType& data_type,
+                        const std::string& pattern,
+                        std::vector<std::string>* keys) {
+  CommandStatsScope scope(kCmdKeys);
+  std::vector<Redis*> dbs;
+  GetTypeDBs(data_type, &dbs);
+
+  std::vector<KeyRangeTask> tasks;
+  SplitKeyRanges(dbs, keyspace_scan_threads_, &tasks);
+  std::vector<std::vector<std::string>> range_keys(tasks.size());
+  Status s = key_range_workers_->Run(tasks.size(),
+    [&](size_t idx) {
+      std::vector<std::string>* part = &range_keys[idx];
+      return tasks[idx].db->ScanKeys(pattern, tasks[idx].range,
+        [part](const Slice& key) {
+          part->push_back(key.ToString());
+          return true;
+        });
+    });
+  // The tasks are in db order, then in key order
+  for (auto& part : range_keys) {
+    keys->insert(keys->end(), std::make_move_iterator(part.begin()),
+                 std::make_move_iterator(part.end()));
   }
   return s;
 }
 
+Status BlackWidow::Keys(const DataType& data_type,
+                        const std::string& pattern,
+                        const ElementVisitor& visitor) {
+  CommandStatsScope scope(kCmdKeys);
+  std::vector<Redis*> dbs;
+  GetTypeDBs(data_type, &dbs);
+
+  bool stopped = false;
+  auto db_visitor = [&visitor, &stopped](const Slice& key) {
+    stopped = !visitor(key);
+    return !stopped;
+  };
+  for (auto db : dbs) {
+    Status s = db->ScanKeys(pattern, KeyRange(), db_visitor);
+    if (!s.ok() || stopped) {
+      return s;
+    }
+  }
+  return Status::OK();
+}
+
 void BlackWidow::ScanDatabase(const DataType& type) {
   switch (type) {
     case kStrings:
@@ -1631,6 +2346,7 @@ void BlackWidow::ScanDatabase(const DataType& type) {
 Status BlackWidow::PfAdd(const Slice& key,
                          const std::vector<std::string>& values,
                          bool* update) {
+  CommandStatsScope scope(kCmdPfAdd);
   *update = false;
   if (values.size() >= kMaxKeys) {
     return Status::InvalidArgument("Invalid the number of key");
@@ -1661,6 +2377,7 @@ Status BlackWidow::PfAdd(const Slice& key,
 
 Status BlackWidow::PfCount(const std::vector<std::string>& keys,
                            int64_t* result) {
+  CommandStatsScope scope(kCmdPfCount);
   if (keys.size() >= kMaxKeys || keys.size() <= 0) {
     return Status::InvalidArgument("Invalid the number of key");
   }
@@ -1692,6 +2409,7 @@ Status BlackWidow::PfCount(const std::vector<std::string>& keys,
 }
 
 Status BlackWidow::PfMerge(const std::vector<std::string>& keys) {
+  CommandStatsScope scope(kCmdPfMerge);
   if (keys.size() >= kMaxKeys || keys.size() <= 0) {
     return Status::InvalidArgument("Invalid the number of key");
   }
@@ -1724,60 +2442,39 @@ Status BlackWidow::PfMerge(const std::vector<std::string>& keys) {
   return s;
 }
 
-static void* StartBGThreadWrapper(void* arg) {
-  BlackWidow* bw = reinterpret_cast<BlackWidow*>(arg);
-  bw->RunBGTask();
-  return NULL;
-}
-
 Status BlackWidow::StartBGThread() {
-  int result = pthread_create(&bg_tasks_thread_id_,
-      NULL, StartBGThreadWrapper, this);
-  if (result != 0) {
-    char msg[128];
-    snprintf(msg, sizeof(msg), "pthread create: %s", strerror(result));
-    return Status::Corruption(msg);
-  }
-  return Status::OK();
+  return bg_tasks_scheduler_->Start(1);
 }
 
 Status BlackWidow::AddBGTask(const BGTask& bg_task) {
-  bg_tasks_mutex_.Lock();
-  if (bg_task.type == kAll) {
-    // if current task it is global compact,
-    // clear the bg_tasks_queue_;
-    std::queue<BGTask> empty_queue;
-    bg_tasks_queue_.swap(empty_queue);
-  }
-  bg_tasks_queue_.push(bg_task);
-  bg_tasks_cond_var_.Signal();
-  bg_tasks_mutex_.Unlock();
-  return Status::OK();
+  return bg_tasks_scheduler_->Schedule(bg_task);
 }
 
-Status BlackWidow::RunBGTask() {
-  BGTask task;
-  while (!bg_tasks_should_exit_) {
-    bg_tasks_mutex_.Lock();
-    while (bg_tasks_queue_.empty() && !bg_tasks_should_exit_) {
-      bg_tasks_cond_var_.Wait();
-    }
+Status BlackWidow::CancelBGTask(const BGTask& bg_task) {
+  return bg_tasks_scheduler_->Cancel(bg_task);
+}
 
-    if (!bg_tasks_queue_.empty()) {
-      task = bg_tasks_queue_.front();
-      bg_tasks_queue_.pop();
-    }
-    bg_tasks_mutex_.Unlock();
+Status BlackWidow::CancelAllBGTasks() {
+  bg_tasks_scheduler_->CancelAll();
+  return Status::OK();
+}
 
-    if (bg_tasks_should_exit_) {
-      return Status::Incomplete("bgtask return with bg_tasks_should_exit true");
-    }
+Status BlackWidow::GetBGTaskStats(BGTaskStats* stats) {
+  bg_tasks_scheduler_->GetStats(stats);
+  return Status::OK();
+}
 
-    if (task.operation == kCleanAll) {
-      DoCompact(task.type);
-    } else if (task.operation == kCompactKey) {
-      CompactKey(task.type, task.argv);
-    }
+Status BlackWidow::RunBGTask(const BGTask& bg_task) {
+  if (bg_task.operation == kCleanAll) {
+    return DoCompact(bg_task.type);
+  } else if (bg_task.operation == kCompactKey) {
+    return CompactKey(bg_task.type, bg_task.argv);
+  } else if (bg_task.operation == kCompactGarbage) {
+    return DoCompactGarbage(bg_task.type);
+  } else if (bg_task.operation == kCompactExpired) {
+    return DoCompactExpired(bg_task.type);
+  } else if (bg_task.operation == kAnalyzeKeyspace) {
+    return DoAnalyzeKeyspace();
   }
   return Status::OK();
 }
@@ -1801,31 +2498,36 @@ Status BlackWidow::DoCompact(const DataType& type) {
     return Status::InvalidArgument("");
   }
 
+  Operation operation;
+  switch (type) {
+    case kStrings: operation = kCleanStrings; break;
+    case kHashes: operation = kCleanHashes; break;
+    case kSets: operation = kCleanSets; break;
+    case kZSets: operation = kCleanZSets; break;
+    case kLists: operation = kCleanLists; break;
+    default: operation = kCleanAll; break;
+  }
+  running_compactions_[operation]++;
+
   Status s;
   if (type == kStrings) {
-    current_task_type_ = Operation::kCleanStrings;
     s = strings_db_->CompactRange(NULL, NULL);
   } else if (type == kHashes) {
-    current_task_type_ = Operation::kCleanHashes;
     s = hashes_db_->CompactRange(NULL, NULL);
   } else if (type == kSets) {
-    current_task_type_ = Operation::kCleanSets;
     s = sets_db_->CompactRange(NULL, NULL);
   } else if (type == kZSets) {
-    current_task_type_ = Operation::kCleanZSets;
     s = zsets_db_->CompactRange(NULL, NULL);
   } else if (type == kLists) {
-    current_task_type_ = Operation::kCleanLists;
     s = lists_db_->CompactRange(NULL, NULL);
   } else {
-    current_task_type_ = Operation::kCleanAll;
     s = strings_db_->CompactRange(NULL, NULL);
     s = hashes_db_->CompactRange(NULL, NULL);
     s = sets_db_->CompactRange(NULL, NULL);
     s = zsets_db_->CompactRange(NULL, NULL);
     s = lists_db_->CompactRange(NULL, NULL);
   }
-  current_task_type_ = Operation::kNone;
+  running_compactions_[operation]--;
   return s;
 }
 
@@ -1854,6 +2556,71 @@ Status BlackWidow::CompactKey(const DataType& type, const std::string& key) {
   return Status::OK();
 }
 
+Status BlackWidow::CompactGarbage(const DataType& type, bool sync) {
+  if (sync) {
+    return DoCompactGarbage(type);
+  } else {
+    AddBGTask({type, kCompactGarbage});
+  }
+  return Status::OK();
+}
+
+static std::vector<Redis*> SelectDBs(const DataType& type,
+                                     const std::vector<Redis*>& all_dbs) {
+  std::vector<Redis*> dbs;
+  if (type == kAll) {
+    dbs = all_dbs;
+  } else if (type >= kStrings && type <= kSets) {
+    dbs.push_back(all_dbs[type - 1]);
+  }
+  return dbs;
+}
+
+Status BlackWidow::DoCompactGarbage(const DataType& type) {
+  std::vector<Redis*> dbs = SelectDBs(type,
+      {strings_db_, hashes_db_, lists_db_, zsets_db_, sets_db_});
+  if (dbs.empty()) {
+    return Status::InvalidArgument("");
+  }
+
+  Status s;
+  size_t compacted_files = 0;
+  for (const auto& db : dbs) {
+    s = db->CompactGarbageFiles(GARBAGE_COMPACTION_MAX_FILES, &compacted_files);
+    if (!s.ok()) {
+      return s;
+    }
+  }
+  return s;
+}
+
+Status BlackWidow::CompactExpired(const DataType& type, bool sync) {
+  if (sync) {
+    return DoCompactExpired(type);
+  } else {
+    AddBGTask({type, kCompactExpired});
+  }
+  return Status::OK();
+}
+
+Status BlackWidow::DoCompactExpired(const DataType& type) {
+  std::vector<Redis*> dbs = SelectDBs(type,
+      {strings_db_, hashes_db_, lists_db_, zsets_db_, sets_db_});
+  if (dbs.empty()) {
+    return Status::InvalidArgument("");
+  }
+
+  Status s;
+  size_t compacted_files = 0;
+  for (const auto& db : dbs) {
+    s = db->CompactExpiredFiles(GARBAGE_COMPACTION_MAX_FILES, &compacted_files);
+    if (!s.ok()) {
+      return s;
+    }
+  }
+  return s;
+}
+
 Status BlackWidow::SetMaxCacheStatisticKeys(uint32_t max_cache_statistic_keys) {
   std::vector<Redis*> dbs = {sets_db_, zsets_db_, hashes_db_, lists_db_};
   for (const auto& db : dbs) {
@@ -1871,7 +2638,15 @@ Status BlackWidow::SetSmallCompactionThreshold(uint32_t small_compaction_thresho
 }
 
 std::string BlackWidow::GetCurrentTaskType() {
-  int type = current_task_type_;
+  // Several compactions may run at once on the bg workers and the
+  // callers of a sync Compact, report the widest one still running
+  int type = kNone;
+  for (int idx = kCleanAll; idx <= kCleanLists; ++idx) {
+    if (running_compactions_[idx] > 0) {
+      type = idx;
+      break;
+    }
+  }
   switch (type) {
     case kCleanAll:
       return "All";
@@ -1891,6 +2666,14 @@ std::string BlackWidow::GetCurrentTaskType() {
   }
 }
 
+Status BlackWidow::SetMemoryBudgetWeights(
+    const std::map<DataType, double>& weights) {
+  if (memory_budget_ == nullptr) {
+    return Status::NotSupported("no memory budget");
+  }
+  return memory_budget_->SetWeights(weights);
+}
+
 Status BlackWidow::GetUsage(const std::string& property, uint64_t* const result) {
   *result = GetProperty(ALL_DB, property);
   return Status::OK();
@@ -1907,49 +2690,198 @@ Status BlackWidow::GetUsage(const std::string& property,
   return Status::OK();
 }
 
+static void GetRedisProperty(Redis* db, const DataType& type,
+                             MemoryBudget* memory_budget,
+                             const std::string& property, uint64_t* out) {
+  if (property == PROPERTY_TYPE_BLACKWIDOW_EXPIRED_RECLAIMED) {
+    *out = db->GetExpiredReclaimedBytes();
+  } else if (property == PROPERTY_TYPE_BLACKWIDOW_WRITE_BUFFER_USAGE) {
+    *out = memory_budget != nullptr
+      ? memory_budget->GetWriteBufferUsage(type) : 0;
+  } else if (property == PROPERTY_TYPE_BLACKWIDOW_WRITE_BUFFER_LIMIT) {
+    *out = memory_budget != nullptr
+      ? memory_budget->GetWriteBufferLimit(type) : 0;
+  } else {
+    db->GetProperty(property, out);
+  }
+}
+
 uint64_t BlackWidow::GetProperty(const std::string& db_type,
                                  const std::string& property) {
   uint64_t out = 0, result = 0;
   if (db_type == ALL_DB || db_type == STRINGS_DB) {
-    strings_db_->GetProperty(property, &out);
+    GetRedisProperty(strings_db_, kStrings, memory_budget_, property, &out);
     result += out;
   }
   if (db_type == ALL_DB || db_type == HASHES_DB) {
-    hashes_db_->GetProperty(property, &out);
+    GetRedisProperty(hashes_db_, kHashes, memory_budget_, property, &out);
     result += out;
   }
   if (db_type == ALL_DB || db_type == LISTS_DB) {
-    lists_db_->GetProperty(property, &out);
+    GetRedisProperty(lists_db_, kLists, memory_budget_, property, &out);
     result += out;
   }
   if (db_type == ALL_DB || db_type == ZSETS_DB) {
-    zsets_db_->GetProperty(property, &out);
+    GetRedisProperty(zsets_db_, kZSets, memory_budget_, property, &out);
     result += out;
   }
   if (db_type == ALL_DB || db_type == SETS_DB) {
-    sets_db_->GetProperty(property, &out);
+    GetRedisProperty(sets_db_, kSets, memory_budget_, property, &out);
     result += out;
   }
   return result;
 }
 
+void BlackWidow::EnableCommandStats(bool enable) {
+  blackwidow::EnableCommandStats(enable);
+}
+
+Status BlackWidow::GetCommandStats(std::vector<CommandStats>* stats) {
+  blackwidow::GetCommandStats(stats);
+  return Status::OK();
+}
+
+Status BlackWidow::ResetCommandStats() {
+  blackwidow::ResetCommandStats();
+  return Status::OK();
+}
+
+void BlackWidow::EnableLockStats(bool enable) {
+  strings_db_->GetLockMgr()->EnableStats(enable);
+  hashes_db_->GetLockMgr()->EnableStats(enable);
+  lists_db_->GetLockMgr()->EnableStats(enable);
+  zsets_db_->GetLockMgr()->EnableStats(enable);
+  sets_db_->GetLockMgr()->EnableStats(enable);
+}
+
+Status BlackWidow::GetLockStats(std::map<std::string, LockStats>* type_stats) {
+  type_stats->clear();
+  strings_db_->GetLockMgr()->GetStats(&(*type_stats)[STRINGS_DB]);
+  hashes_db_->GetLockMgr()->GetStats(&(*type_stats)[HASHES_DB]);
+  lists_db_->GetLockMgr()->GetStats(&(*type_stats)[LISTS_DB]);
+  zsets_db_->GetLockMgr()->GetStats(&(*type_stats)[ZSETS_DB]);
+  sets_db_->GetLockMgr()->GetStats(&(*type_stats)[SETS_DB]);
+  return Status::OK();
+}
+
+Status BlackWidow::ResetLockStats() {
+  strings_db_->GetLockMgr()->ResetStats();
+  hashes_db_->GetLockMgr()->ResetStats();
+  lists_db_->GetLockMgr()->ResetStats();
+  zsets_db_->GetLockMgr()->ResetStats();
+  sets_db_->GetLockMgr()->ResetStats();
+  return Status::OK();
+}
+
+void BlackWidow::EnableWriteCombining(bool enable) {
+  hashes_db_->SetWriteCombining(enable);
+  sets_db_->SetWriteCombining(enable);
+  zsets_db_->SetWriteCombining(enable);
+}
+
+void BlackWidow::SetScanPolicy(uint64_t large_read_threshold,
+                               size_t readahead_size) {
+  strings_db_->GetScanPolicy()->SetOptions(large_read_threshold, readahead_size);
+  hashes_db_->GetScanPolicy()->SetOptions(large_read_threshold, readahead_size);
+  lists_db_->GetScanPolicy()->SetOptions(large_read_threshold, readahead_size);
+  zsets_db_->GetScanPolicy()->SetOptions(large_read_threshold, readahead_size);
+  sets_db_->GetScanPolicy()->SetOptions(large_read_threshold, readahead_size);
+}
+
+Status BlackWidow::GetScanPolicyStats(
+    std::map<std::string, ScanPolicyStats>* type_stats) {
+  type_stats->clear();
+  strings_db_->GetScanPolicy()->GetStats(&(*type_stats)[STRINGS_DB]);
+  hashes_db_->GetScanPolicy()->GetStats(&(*type_stats)[HASHES_DB]);
+  lists_db_->GetScanPolicy()->GetStats(&(*type_stats)[LISTS_DB]);
+  zsets_db_->GetScanPolicy()->GetStats(&(*type_stats)[ZSETS_DB]);
+  sets_db_->GetScanPolicy()->GetStats(&(*type_stats)[SETS_DB]);
+  return Status::OK();
+}
+
+Status BlackWidow::ResetScanPolicyStats() {
+  strings_db_->GetScanPolicy()->ResetStats();
+  hashes_db_->GetScanPolicy()->ResetStats();
+  lists_db_->GetScanPolicy()->ResetStats();
+  zsets_db_->GetScanPolicy()->ResetStats();
+  sets_db_->GetScanPolicy()->ResetStats();
+  return Status::OK();
+}
+
+void BlackWidow::EnableHotKeys(uint32_t sample_rate) {
+  hot_keys_->SetSampleRate(sample_rate);
+}
+
+Status BlackWidow::GetHotKeys(const DataType& type, size_t k,
+                              std::vector<HotKey>* hot_keys) {
+  return hot_keys_->GetHotKeys(type, k, hot_keys);
+}
+
+Status BlackWidow::ResetHotKeys() {
+  hot_keys_->Reset();
+  return Status::OK();
+}
+
 Status BlackWidow::GetKeyNum(std::vector<KeyInfo>* key_infos) {
-  KeyInfo key_info;
   // NOTE: keep the db order with string, hash, list, zset, set
   std::vector<Redis*> dbs = {strings_db_, hashes_db_,
     lists_db_, zsets_db_, sets_db_};
-  for (const auto& db : dbs) {
-    // check the scanner was stopped or not, before scanning the next db
-    if (scan_keynum_exit_) {
-      break;
-    }
-    db->ScanKeyNum(&key_info);
-    key_infos->push_back(key_info);
-  }
+  std::vector<KeyRangeTask> tasks;
+  SplitKeyRanges(dbs, keyspace_scan_threads_, &tasks);
+  std::vector<KeyInfo> range_infos(tasks.size());
+  scan_keynum_scanned_ranges_ = 0;
+  scan_keynum_total_ranges_ = tasks.size();
+  Status s = key_range_workers_->Run(tasks.size(),
+    [&](size_t idx) {
+      // check the scanner was stopped or not, before scanning the next range
+      if (scan_keynum_exit_) {
+        return Status::Incomplete("exit");
+      }
+      Status s = tasks[idx].db->ScanKeyNum(tasks[idx].range, scan_keynum_exit_,
+                                           &range_infos[idx]);
+      scan_keynum_scanned_ranges_++;
+      return s;
+    });
   if (scan_keynum_exit_) {
     scan_keynum_exit_ = false;
     return Status::Corruption("exit");
   }
+  if (!s.ok()) {
+    return s;
+  }
+
+  // Merge the ranges of every db, the average ttl is weighted by the
+  // expiring keys of each range
+  std::vector<KeyInfo> db_infos(dbs.size());
+  std::vector<uint64_t> ttl_sums(dbs.size(), 0);
+  for (size_t idx = 0; idx < tasks.size(); ++idx) {
+    const KeyInfo& range_info = range_infos[idx];
+    KeyInfo& db_info = db_infos[tasks[idx].db_index];
+    db_info.keys += range_info.keys;
+    db_info.expires += range_info.expires;
+    db_info.invaild_keys += range_info.invaild_keys;
+    ttl_sums[tasks[idx].db_index] += range_info.avg_ttl * range_info.expires;
+  }
+  for (size_t idx = 0; idx < dbs.size(); ++idx) {
+    db_infos[idx].avg_ttl = db_infos[idx].expires != 0
+      ? ttl_sums[idx] / db_infos[idx].expires : 0;
+    key_infos->push_back(db_infos[idx]);
+  }
+  return Status::OK();
+}
+
+Status BlackWidow::GetKeyNumApprox(std::vector<KeyInfo>* key_infos) {
+  // NOTE: keep the db order with string, hash, list, zset, set
+  std::vector<Redis*> dbs = {strings_db_, hashes_db_,
+    lists_db_, zsets_db_, sets_db_};
+  for (const auto& db : dbs) {
+    KeyInfo key_info;
+    Status s = db->GetKeyNumApprox(&key_info);
+    if (!s.ok()) {
+      return s;
+    }
+    key_infos->push_back(key_info);
+  }
   return Status::OK();
 }
 
@@ -1958,6 +2890,224 @@ Status BlackWidow::StopScanKeyNum() {
   return Status::OK();
 }
 
+Status BlackWidow::GetScanKeyNumProgress(uint64_t* scanned_ranges,
+                                         uint64_t* total_ranges) {
+  *scanned_ranges = scan_keynum_scanned_ranges_;
+  *total_ranges = scan_keynum_total_ranges_;
+  return Status::OK();
+}
+
+// The analysis throttling sleeps at most every that many keys
+static const uint64_t kAnalysisThrottleKeys = 128;
+
+static const std::vector<std::string> kAnalysisTypeNames = {
+  STRINGS_DB, HASHES_DB, LISTS_DB, ZSETS_DB, SETS_DB};
+
+static size_t KeySizeBucket(uint64_t size) {
+  size_t bucket = 0;
+  while (size != 0) {
+    bucket++;
+    size >>= 1;
+  }
+  return bucket;
+}
+
+static bool LargerKeySize(const KeySize& a, const KeySize& b) {
+  return a.size > b.size;
+}
+
+// Appends key double quoted, with the quotes, the backslashes and the
+// bytes outside of the printable ASCII escaped, so that binary keys keep
+// the report one record per line
+static void AppendQuotedKey(const std::string& key, std::string* out) {
+  out->push_back('"');
+  for (unsigned char c : key) {
+    if (c == '"' || c == '\\') {
+      out->push_back('\\');
+      out->push_back(c);
+    } else if (c == '\n') {
+      out->append("\\n");
+    } else if (c == '\r') {
+      out->append("\\r");
+    } else if (c == '\t') {
+      out->append("\\t");
+    } else if (c < 0x20 || c > 0x7e) {
+      char buf[5];
+      snprintf(buf, sizeof(buf), "\\x%02x", c);
+      out->append(buf);
+    } else {
+      out->push_back(c);
+    }
+  }
+  out->push_back('"');
+}
+
+static Status WriteKeyspaceAnalysis(const std::string& path,
+                                    const KeyspaceAnalysis& analysis) {
+  std::string tmp_path = path + ".tmp";
+  FILE* file = fopen(tmp_path.c_str(), "w");
+  if (file == NULL) {
+    return Status::IOError("open " + tmp_path + " failed");
+  }
+  fprintf(file, "start_time %ld end_time %ld scanned_keys %lu\n",
+          static_cast<long>(analysis.start_time),
+          static_cast<long>(analysis.end_time),
+          static_cast<unsigned long>(analysis.scanned_keys));
+  for (size_t idx = 0; idx < analysis.type_stats.size(); ++idx) {
+    const KeySizeStats& stats = analysis.type_stats[idx];
+    fprintf(file, "type %s keys %lu total_size %lu\n",
+            kAnalysisTypeNames[idx].c_str(),
+            static_cast<unsigned long>(stats.keys),
+            static_cast<unsigned long>(stats.total_size));
+    for (size_t bucket = 0; bucket < stats.histogram.size(); ++bucket) {
+      if (stats.histogram[bucket] != 0) {
+        // Sizes below 2^bucket
+        fprintf(file, "bucket %lu keys %lu\n",
+                static_cast<unsigned long>(bucket),
+                static_cast<unsigned long>(stats.histogram[bucket]));
+      }
+    }
+    for (const auto& key_size : stats.largest_keys) {
+      std::string quoted_key;
+      AppendQuotedKey(key_size.key, &quoted_key);
+      fprintf(file, "largest %lu %s\n",
+              static_cast<unsigned long>(key_size.size),
+              quoted_key.c_str());
+    }
+  }
+  bool failed = ferror(file) != 0;
+  failed = fclose(file) != 0 || failed;
+  if (failed || rename(tmp_path.c_str(), path.c_str()) != 0) {
+    return Status::IOError("write " + path + " failed");
+  }
+  return Status::OK();
+}
+
+Status BlackWidow::AnalyzeKeyspace(const KeyspaceAnalysisOptions& options,
+                                   bool sync) {
+  {
+    slash::MutexLock l(&analysis_mutex_);
+    if (analysis_.running) {
+      return Status::Busy("keyspace analysis is running");
+    }
+    analysis_options_ = options;
+  }
+  if (sync) {
+    return DoAnalyzeKeyspace();
+  }
+  return AddBGTask({kAll, kAnalyzeKeyspace});
+}
+
+Status BlackWidow::DoAnalyzeKeyspace() {
+  rocksdb::Env* env = rocksdb::Env::Default();
+  int64_t unix_time;
+  env->GetCurrentTime(&unix_time);
+  KeyspaceAnalysisOptions options;
+  {
+    slash::MutexLock l(&analysis_mutex_);
+    if (analysis_.running) {
+      return Status::Busy("keyspace analysis is running");
+    }
+    options = analysis_options_;
+    analysis_ = KeyspaceAnalysis();
+    analysis_.running = true;
+    analysis_.start_time = unix_time;
+  }
+
+  // NOTE: keep the db order with string, hash, list, zset, set
+  std::vector<Redis*> dbs = {strings_db_, hashes_db_,
+    lists_db_, zsets_db_, sets_db_};
+  uint64_t start_us = env->NowMicros();
+  uint64_t scanned_keys = 0;
+  Status s;
+  for (const auto& db : dbs) {
+    KeySizeStats stats;
+    // Min heap of the largest keys seen so far
+    std::vector<KeySize> largest_keys;
+    s = db->ScanKeySizes(analysis_exit_,
+      [&](const Slice& key, uint64_t size) {
+        stats.keys++;
+        stats.total_size += size;
+        size_t bucket = KeySizeBucket(size);
+        if (stats.histogram.size() <= bucket) {
+          stats.histogram.resize(bucket + 1, 0);
+        }
+        stats.histogram[bucket]++;
+        if (largest_keys.size() < options.top_n) {
+          largest_keys.push_back({key.ToString(), size});
+          std::push_heap(largest_keys.begin(), largest_keys.end(),
+                         LargerKeySize);
+        } else if (options.top_n != 0 && size > largest_keys.front().size) {
+          std::pop_heap(largest_keys.begin(), largest_keys.end(),
+                        LargerKeySize);
+          largest_keys.back() = {key.ToString(), size};
+          std::push_heap(largest_keys.begin(), largest_keys.end(),
+                         LargerKeySize);
+        }
+
+        if (++scanned_keys % kAnalysisThrottleKeys != 0) {
+          return;
+        }
+        {
+          slash::MutexLock l(&analysis_mutex_);
+          analysis_.scanned_keys = scanned_keys;
+        }
+        if (options.max_keys_per_sec != 0) {
+          uint64_t expect_us = scanned_keys * 1000000 / options.max_keys_per_sec;
+          uint64_t elapsed_us = env->NowMicros() - start_us;
+          if (expect_us > elapsed_us) {
+            env->SleepForMicroseconds(static_cast<int>(expect_us - elapsed_us));
+          }
+        }
+      });
+    if (!s.ok() || analysis_exit_) {
+      break;
+    }
+    std::sort_heap(largest_keys.begin(), largest_keys.end(), LargerKeySize);
+    stats.largest_keys.swap(largest_keys);
+
+    slash::MutexLock l(&analysis_mutex_);
+    analysis_.scanned_keys = scanned_keys;
+    analysis_.type_stats.push_back(stats);
+  }
+
+  env->GetCurrentTime(&unix_time);
+  KeyspaceAnalysis analysis;
+  bool stopped;
+  {
+    slash::MutexLock l(&analysis_mutex_);
+    stopped = analysis_exit_;
+    analysis_exit_ = false;
+    analysis_.running = false;
+    analysis_.completed = s.ok() && !stopped;
+    analysis_.end_time = unix_time;
+    analysis = analysis_;
+  }
+  if (!s.ok()) {
+    return s;
+  } else if (stopped) {
+    return Status::Corruption("exit");
+  }
+  if (!options.result_path.empty()) {
+    return WriteKeyspaceAnalysis(options.result_path, analysis);
+  }
+  return Status::OK();
+}
+
+Status BlackWidow::StopKeyspaceAnalysis() {
+  slash::MutexLock l(&analysis_mutex_);
+  if (analysis_.running) {
+    analysis_exit_ = true;
+  }
+  return Status::OK();
+}
+
+Status BlackWidow::GetKeyspaceAnalysis(KeyspaceAnalysis* analysis) {
+  slash::MutexLock l(&analysis_mutex_);
+  *analysis = analysis_;
+  return Status::OK();
+}
+
 rocksdb::DB* BlackWidow::GetDBByType(const std::string& type) {
   if (type == STRINGS_DB) {
     return strings_db_->GetDB();
@@ -0,0 +1,95 @@
+//  Copyright (c) 2017-present, Qihoo, Inc.  All rights reserved.
+//  This source code is licensed under the BSD-style license found in the
+//  LICENSE file in the root directory of this source tree. An additional grant
+//  of patent rights can be found in the PATENTS file in the same directory.
+
+#include "src/coarse_clock.h"
+
+#include <chrono>
+#include <thread>
+
+#include "rocksdb/env.h"
+#include "slash/include/slash_mutex.h"
+
+namespace blackwidow {
+
+std::atomic<int64_t> CoarseClock::now_(0);
+std::atomic<int64_t> CoarseClock::fixed_now_(0);
+
+namespace {
+
+// Now() runs at most this late behind a change of the second
+const int kTickIntervalMs = 10;
+
+struct Ticker {
+  slash::Mutex mutex;
+  int users;
+  std::atomic<bool> stop;
+  std::thread thread;
+
+  Ticker() : users(0), stop(false) {}
+};
+
+// Never destroyed, a db left open at exit keeps its ticker running
+Ticker* GetTicker() {
+  static Ticker* ticker = new Ticker();
+  return ticker;
+}
+
+}  // namespace
+
+int64_t CoarseClock::EnvNow() {
+  int64_t unix_time;
+  rocksdb::Env::Default()->GetCurrentTime(&unix_time);
+  return unix_time;
+}
+
+void CoarseClock::Tick() {
+  // A time fixed by SetNow() after the load fails the exchange
+  int64_t now = now_.load();
+  if (fixed_now_.load() == 0) {
+    now_.compare_exchange_strong(now, EnvNow());
+  }
+}
+
+void CoarseClock::Start() {
+  Ticker* ticker = GetTicker();
+  slash::MutexLock l(&ticker->mutex);
+  if (ticker->users++ > 0) {
+    return;
+  }
+  ticker->stop.store(false);
+  Tick();
+  ticker->thread = std::thread([ticker]() {
+    while (!ticker->stop.load(std::memory_order_relaxed)) {
+      std::this_thread::sleep_for(std::chrono::milliseconds(kTickIntervalMs));
+      Tick();
+    }
+  });
+}
+
+void CoarseClock::Stop() {
+  Ticker* ticker = GetTicker();
+  slash::MutexLock l(&ticker->mutex);
+  if (ticker->users == 0 || --ticker->users > 0) {
+    return;
+  }
+  ticker->stop.store(true);
+  ticker->thread.join();
+  if (fixed_now_.load() == 0) {
+    now_.store(0);
+  }
+}
+
+void CoarseClock::SetNow(int64_t now) {
+  Ticker* ticker = GetTicker();
+  slash::MutexLock l(&ticker->mutex);
+  fixed_now_.store(now);
+  if (now != 0) {
+    now_.store(now);
+  } else {
+    now_.store(ticker->users > 0 ? EnvNow() : 0);
+  }
+}
+
+}  //  namespace blackwidow
@@ -0,0 +1,44 @@
+//  Copyright (c) 2017-present, Qihoo, Inc.  All rights reserved.
+//  This source code is licensed under the BSD-style license found in the
+//  LICENSE file in the root directory of this source tree. An additional grant
+//  of patent rights can be found in the PATENTS file in the same directory.
+
+#ifndef SRC_COARSE_CLOCK_H_
+#define SRC_COARSE_CLOCK_H_
+
+#include <stdint.h>
+#include <atomic>
+
+namespace blackwidow {
+
+// Unix time in seconds for the TTL checks, the versions of new keys and
+// the compaction filters, which read it for every record.
+//
+// While a db is open a ticker thread refreshes it every 10 milliseconds,
+// so a read is a relaxed load, and Now() turns to the next second up to
+// 10 milliseconds after the clock of the Env does.
+// Without a ticker the reads fall back to the clock of the default Env.
+class CoarseClock {
+ public:
+  static int64_t Now() {
+    int64_t now = now_.load(std::memory_order_relaxed);
+    return now != 0 ? now : EnvNow();
+  }
+
+  // The ticker runs from the first Start() to the matching last Stop()
+  static void Start();
+  static void Stop();
+
+  // Fixes Now() to now, for tests, 0 gives back the real time
+  static void SetNow(int64_t now);
+
+ private:
+  static int64_t EnvNow();
+  static void Tick();
+
+  static std::atomic<int64_t> now_;
+  static std::atomic<int64_t> fixed_now_;
+};
+
+}  //  namespace blackwidow
+#endif  // SRC_COARSE_CLOCK_H_
@@ -0,0 +1,264 @@
+//  Copyright (c) 2017-present, Qihoo, Inc.  All rights reserved.
+//  This source code is licensed under the BSD-style license found in the
+//  LICENSE file in the root directory of this source tree. An additional grant
+//  of patent rights can be found in the PATENTS file in the same directory.
+
+#include "src/command_stats.h"
+
+#include <set>
+#include <memory>
+#include <algorithm>
+
+#include "slash/include/slash_mutex.h"
+
+namespace blackwidow {
+
+const char* const CommandNames[kCmdNum] = {
+  "set", "setxx", "get", "getset", "setbit", "getbit", "mset", "mget",
+  "setnx", "msetnx", "setvx", "delvx", "setrange", "getrange", "append",
+  "bitcount", "bitop", "bitpos", "decrby", "incrby", "incrbyfloat", "setex",
+  "strlen", "pksetexat", "hset", "hget", "hmset", "hmget", "hgetall", "hkeys",
+  "hvals", "hsetnx", "hlen", "hstrlen", "hexists", "hincrby", "hincrbyfloat",
+  "hdel", "hscan", "hscanx", "pkhscanrange", "pkhrscanrange", "sadd", "scard",
+  "sdiff", "sdiffstore", "sinter", "sinterstore", "sismember", "smembers",
+  "smove", "spop", "srandmember", "srem", "sunion", "sunionstore", "sscan",
+  "lpush", "rpush", "lrange", "ltrim", "llen", "lpop", "rpop", "lindex",
+  "linsert", "lpushx", "rpushx", "lrem", "lset", "rpoplpush", "zpopmax",
+  "zpopmin", "zadd", "zcard", "zcount", "zincrby", "zrange", "zrangebyscore",
+  "zrank", "zrem", "zremrangebyrank", "zremrangebyscore", "zrevrangebyscore",
+  "zrevrange", "zrevrank", "zscore", "zunionstore", "zinterstore",
+  "zrangebylex", "zlexcount", "zremrangebylex", "zscan", "expire", "del",
+  "delbytype", "exists", "scan", "pkexpirescan", "pkscanrange",
+  "pkrscanrange", "pkpatternmatchdel", "scanx", "expireat", "persist", "ttl",
+  "type", "keys", "pfadd", "pfcount", "pfmerge"
+};
+
+struct CommandStatsRegistry {
+  slash::Mutex mutex;
+  std::set<ThreadCommandStats*> threads;
+  // Counters of the threads that exited
+  CommandCounters retired[kCmdNum];
+  uint64_t reset_nanos;
+
+  CommandStatsRegistry() : reset_nanos(CommandStatsNowNanos()) {}
+};
+
+// Never destructed, threads may still exit after the static destructors ran
+static CommandStatsRegistry* Registry() {
+  static CommandStatsRegistry* registry = new CommandStatsRegistry();
+  return registry;
+}
+
+static std::atomic<bool> command_stats_enabled(false);
+
+const uint64_t LatencyHistogram::kLinearBuckets;
+const uint64_t LatencyHistogram::kSubBuckets;
+const uint64_t LatencyHistogram::kMaxPower;
+const size_t LatencyHistogram::kNumBuckets;
+
+size_t LatencyHistogram::BucketIndex(uint64_t micros) {
+  if (micros < kLinearBuckets) {
+    return micros;
+  }
+  uint64_t power = 63 - __builtin_clzll(micros);
+  if (power >= kMaxPower) {
+    return kNumBuckets - 1;
+  }
+  uint64_t sub_bucket = (micros >> (power - 3)) & (kSubBuckets - 1);
+  return kLinearBuckets + (power - 4) * kSubBuckets + sub_bucket;
+}
+
+uint64_t LatencyHistogram::BucketLimit(size_t index) {
+  if (index < kLinearBuckets) {
+    return index;
+  }
+  uint64_t power = 4 + (index - kLinearBuckets) / kSubBuckets;
+  uint64_t sub_bucket = (index - kLinearBuckets) % kSubBuckets;
+  uint64_t width = 1ULL << (power - 3);
+  return (kSubBuckets + sub_bucket) * width + width - 1;
+}
+
+void LatencyHistogram::Merge(const LatencyHistogram& other) {
+  for (size_t idx = 0; idx < kNumBuckets; ++idx) {
+    Increase(&buckets_[idx], other.buckets_[idx].load(std::memory_order_relaxed));
+  }
+  Increase(&count_, other.count_.load(std::memory_order_relaxed));
+  Increase(&sum_, other.sum_.load(std::memory_order_relaxed));
+  uint64_t other_max = other.max_.load(std::memory_order_relaxed);
+  if (other_max > max_.load(std::memory_order_relaxed)) {
+    max_.store(other_max, std::memory_order_relaxed);
+  }
+}
+
+void LatencyHistogram::Clear() {
+  for (size_t idx = 0; idx < kNumBuckets; ++idx) {
+    buckets_[idx].store(0, std::memory_order_relaxed);
+  }
+  count_.store(0, std::memory_order_relaxed);
+  sum_.store(0, std::memory_order_relaxed);
+  max_.store(0, std::memory_order_relaxed);
+}
+
+void LatencyHistogram::Report(LatencyStats* stats) const {
+  stats->count = count_.load(std::memory_order_relaxed);
+  stats->total_micros = sum_.load(std::memory_order_relaxed);
+  stats->max_micros = max_.load(std::memory_order_relaxed);
+
+  const double quantiles[] = {0.5, 0.99, 0.999};
+  uint64_t* percentiles[] = {&stats->p50_micros,
+                             &stats->p99_micros,
+                             &stats->p999_micros};
+  uint64_t total = 0;
+  for (size_t idx = 0; idx < kNumBuckets; ++idx) {
+    total += buckets_[idx].load(std::memory_order_relaxed);
+  }
+  size_t bucket = 0;
+  uint64_t cumulative = 0;
+  for (size_t pos = 0; pos < 3; ++pos) {
+    *percentiles[pos] = 0;
+    if (total == 0) {
+      continue;
+    }
+    uint64_t rank = std::max<uint64_t>(
+        static_cast<uint64_t>(quantiles[pos] * total + 0.5), 1);
+    while (bucket < kNumBuckets) {
+      uint64_t num = buckets_[bucket].load(std::memory_order_relaxed);
+      if (cumulative + num >= rank) {
+        break;
+      }
+      cumulative += num;
+      bucket++;
+    }
+    *percentiles[pos] = std::min(BucketLimit(bucket), stats->max_micros);
+  }
+}
+
+ThreadCommandStats::ThreadCommandStats() : active_command(kCmdNum) {
+  for (int idx = 0; idx < kCmdNum; ++idx) {
+    counters_[idx].store(nullptr, std::memory_order_relaxed);
+  }
+  CommandStatsRegistry* registry = Registry();
+  slash::MutexLock l(&registry->mutex);
+  registry->threads.insert(this);
+}
+
+ThreadCommandStats::~ThreadCommandStats() {
+  CommandStatsRegistry* registry = Registry();
+  slash::MutexLock l(&registry->mutex);
+  registry->threads.erase(this);
+  for (int idx = 0; idx < kCmdNum; ++idx) {
+    CommandCounters* counters = counters_[idx].load(std::memory_order_relaxed);
+    if (counters == nullptr) {
+      continue;
+    }
+    CommandCounters& retired = registry->retired[idx];
+    retired.calls += counters->calls.load(std::memory_order_relaxed);
+    for (int phase = 0; phase < kPhaseNum; ++phase) {
+      retired.phases[phase].Merge(counters->phases[phase]);
+    }
+    delete counters;
+  }
+}
+
+ThreadCommandStats* ThreadCommandStats::Current() {
+  static thread_local ThreadCommandStats stats;
+  return &stats;
+}
+
+CommandCounters* ThreadCommandStats::Counters(CommandType command) {
+  CommandCounters* counters =
+    counters_[command].load(std::memory_order_relaxed);
+  if (counters == nullptr) {
+    counters = new CommandCounters();
+    counters_[command].store(counters, std::memory_order_release);
+  }
+  return counters;
+}
+
+void CommandStatsScope::Finish() {
+  uint64_t duration = CommandStatsNowNanos() - start_nanos_;
+  CommandCounters* counters = stats_->Counters(stats_->active_command);
+  counters->calls.store(counters->calls.load(std::memory_order_relaxed) + 1,
+                        std::memory_order_relaxed);
+  counters->phases[kPhaseTotal].Add(duration / 1000);
+  for (int idx = kPhaseTotal + 1; idx < kPhaseNum; ++idx) {
+    if (stats_->phase_entered[idx]) {
+      counters->phases[idx].Add(stats_->phase_nanos[idx] / 1000);
+    }
+  }
+  stats_->active_command = kCmdNum;
+}
+
+void EnableCommandStats(bool enable) {
+  command_stats_enabled.store(enable, std::memory_order_relaxed);
+}
+
+bool CommandStatsEnabled() {
+  return command_stats_enabled.load(std::memory_order_relaxed);
+}
+
+void GetCommandStats(std::vector<CommandStats>* stats) {
+  stats->clear();
+  CommandStatsRegistry* registry = Registry();
+  slash::MutexLock l(&registry->mutex);
+  double elapsed_seconds =
+    (CommandStatsNowNanos() - registry->reset_nanos) / 1e9;
+
+  std::unique_ptr<CommandCounters> total(new CommandCounters());
+  for (int cmd = 0; cmd < kCmdNum; ++cmd) {
+    total->calls = registry->retired[cmd].calls.load();
+    for (int phase = 0; phase < kPhaseNum; ++phase) {
+      total->phases[phase].Clear();
+      total->phases[phase].Merge(registry->retired[cmd].phases[phase]);
+    }
+    for (const auto thread_stats : registry->threads) {
+      const CommandCounters* counters =
+        thread_stats->PeekCounters(static_cast<CommandType>(cmd));
+      if (counters == nullptr) {
+        continue;
+      }
+      total->calls += counters->calls.load(std::memory_order_relaxed);
+      for (int phase = 0; phase < kPhaseNum; ++phase) {
+        total->phases[phase].Merge(counters->phases[phase]);
+      }
+    }
+    if (total->calls == 0) {
+      continue;
+    }
+
+    CommandStats command_stats;
+    command_stats.command = CommandNames[cmd];
+    command_stats.calls = total->calls;
+    command_stats.qps = elapsed_seconds > 0
+      ? total->calls / elapsed_seconds : 0;
+    for (int phase = 0; phase < kPhaseNum; ++phase) {
+      total->phases[phase].Report(&command_stats.latency[phase]);
+    }
+    stats->push_back(command_stats);
+  }
+}
+
+void ResetCommandStats() {
+  CommandStatsRegistry* registry = Registry();
+  slash::MutexLock l(&registry->mutex);
+  std::vector<CommandCounters*> all_counters;
+  for (int cmd = 0; cmd < kCmdNum; ++cmd) {
+    all_counters.push_back(&registry->retired[cmd]);
+    for (const auto thread_stats : registry->threads) {
+      CommandCounters* counters =
+        thread_stats->PeekCounters(static_cast<CommandType>(cmd));
+      if (counters != nullptr) {
+        all_counters.push_back(counters);
+      }
+    }
+  }
+  for (auto counters : all_counters) {
+    counters->calls.store(0, std::memory_order_relaxed);
+    for (int phase = 0; phase < kPhaseNum; ++phase) {
+      counters->phases[phase].Clear();
+    }
+  }
+  registry->reset_nanos = CommandStatsNowNanos();
+}
+
+}  //  namespace blackwidow
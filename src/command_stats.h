@@ -0,0 +1,307 @@
+//  Copyright (c) 2017-present, Qihoo, Inc.  All rights reserved.
+//  This source code is licensed under the BSD-style license found in the
+//  LICENSE file in the root directory of this source tree. An additional grant
+//  of patent rights can be found in the PATENTS file in the same directory.
+
+#ifndef SRC_COMMAND_STATS_H_
+#define SRC_COMMAND_STATS_H_
+
+#include <atomic>
+#include <chrono>
+#include <vector>
+
+#include "blackwidow/blackwidow.h"
+
+namespace blackwidow {
+
+// Public commands of BlackWidow, the overloads of a command share an id
+enum CommandType {
+  kCmdSet = 0,
+  kCmdSetxx,
+  kCmdGet,
+  kCmdGetSet,
+  kCmdSetBit,
+  kCmdGetBit,
+  kCmdMSet,
+  kCmdMGet,
+  kCmdSetnx,
+  kCmdMSetnx,
+  kCmdSetvx,
+  kCmdDelvx,
+  kCmdSetrange,
+  kCmdGetrange,
+  kCmdAppend,
+  kCmdBitCount,
+  kCmdBitOp,
+  kCmdBitPos,
+  kCmdDecrby,
+  kCmdIncrby,
+  kCmdIncrbyfloat,
+  kCmdSetex,
+  kCmdStrlen,
+  kCmdPKSetexAt,
+  kCmdHSet,
+  kCmdHGet,
+  kCmdHMSet,
+  kCmdHMGet,
+  kCmdHGetall,
+  kCmdHKeys,
+  kCmdHVals,
+  kCmdHSetnx,
+  kCmdHLen,
+  kCmdHStrlen,
+  kCmdHExists,
+  kCmdHIncrby,
+  kCmdHIncrbyfloat,
+  kCmdHDel,
+  kCmdHScan,
+  kCmdHScanx,
+  kCmdPKHScanRange,
+  kCmdPKHRScanRange,
+  kCmdSAdd,
+  kCmdSCard,
+  kCmdSDiff,
+  kCmdSDiffstore,
+  kCmdSInter,
+  kCmdSInterstore,
+  kCmdSIsmember,
+  kCmdSMembers,
+  kCmdSMove,
+  kCmdSPop,
+  kCmdSRandmember,
+  kCmdSRem,
+  kCmdSUnion,
+  kCmdSUnionstore,
+  kCmdSScan,
+  kCmdLPush,
+  kCmdRPush,
+  kCmdLRange,
+  kCmdLTrim,
+  kCmdLLen,
+  kCmdLPop,
+  kCmdRPop,
+  kCmdLIndex,
+  kCmdLInsert,
+  kCmdLPushx,
+  kCmdRPushx,
+  kCmdLRem,
+  kCmdLSet,
+  kCmdRPoplpush,
+  kCmdZPopMax,
+  kCmdZPopMin,
+  kCmdZAdd,
+  kCmdZCard,
+  kCmdZCount,
+  kCmdZIncrby,
+  kCmdZRange,
+  kCmdZRangebyscore,
+  kCmdZRank,
+  kCmdZRem,
+  kCmdZRemrangebyrank,
+  kCmdZRemrangebyscore,
+  kCmdZRevrangebyscore,
+  kCmdZRevrange,
+  kCmdZRevrank,
+  kCmdZScore,
+  kCmdZUnionstore,
+  kCmdZInterstore,
+  kCmdZRangebylex,
+  kCmdZLexcount,
+  kCmdZRemrangebylex,
+  kCmdZScan,
+  kCmdExpire,
+  kCmdDel,
+  kCmdDelByType,
+  kCmdExists,
+  kCmdScan,
+  kCmdPKExpireScan,
+  kCmdPKScanRange,
+  kCmdPKRScanRange,
+  kCmdPKPatternMatchDel,
+  kCmdScanx,
+  kCmdExpireat,
+  kCmdPersist,
+  kCmdTTL,
+  kCmdType,
+  kCmdKeys,
+  kCmdPfAdd,
+  kCmdPfCount,
+  kCmdPfMerge,
+  kCmdNum
+};
+
+extern const char* const CommandNames[kCmdNum];
+
+inline uint64_t CommandStatsNowNanos() {
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(
+      std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// Log-linear latency histogram in microseconds, values below
+// kLinearBuckets have a bucket each, above every power of two is split
+// in kSubBuckets, so a percentile is off by 1/kSubBuckets at most.
+//
+// Only the owner thread writes, the relaxed load + store pairs are
+// cheaper than atomic increments and readers see each counter whole.
+class LatencyHistogram {
+ public:
+  static const uint64_t kLinearBuckets = 16;
+  static const uint64_t kSubBuckets = 8;
+  static const uint64_t kMaxPower = 36;
+  static const size_t kNumBuckets =
+    kLinearBuckets + (kMaxPower - 4) * kSubBuckets;
+
+  LatencyHistogram() {
+    Clear();
+  }
+
+  static size_t BucketIndex(uint64_t micros);
+  // Largest value falling in the bucket
+  static uint64_t BucketLimit(size_t index);
+
+  void Add(uint64_t micros) {
+    size_t index = BucketIndex(micros);
+    Increase(&buckets_[index], 1);
+    Increase(&count_, 1);
+    Increase(&sum_, micros);
+    if (micros > max_.load(std::memory_order_relaxed)) {
+      max_.store(micros, std::memory_order_relaxed);
+    }
+  }
+
+  // Callers serialize the writes to this histogram
+  void Merge(const LatencyHistogram& other);
+  void Clear();
+
+  void Report(LatencyStats* stats) const;
+
+ private:
+  static void Increase(std::atomic<uint64_t>* counter, uint64_t value) {
+    counter->store(counter->load(std::memory_order_relaxed) + value,
+                   std::memory_order_relaxed);
+  }
+
+  std::atomic<uint64_t> count_;
+  std::atomic<uint64_t> sum_;
+  std::atomic<uint64_t> max_;
+  std::atomic<uint64_t> buckets_[kNumBuckets];
+};
+
+struct CommandCounters {
+  std::atomic<uint64_t> calls;
+  LatencyHistogram phases[kPhaseNum];
+
+  CommandCounters() : calls(0) {}
+};
+
+// Counters of the commands run by one thread, registered in a process
+// wide list so GetCommandStats can sum them up. When the thread exits
+// its counters are merged into the retired ones.
+class ThreadCommandStats {
+ public:
+  ThreadCommandStats();
+  ~ThreadCommandStats();
+
+  static ThreadCommandStats* Current();
+
+  CommandCounters* Counters(CommandType command);
+  CommandCounters* PeekCounters(CommandType command) const {
+    return counters_[command].load(std::memory_order_acquire);
+  }
+
+  // State of the outermost CommandStatsScope of this thread
+  CommandType active_command;
+  uint64_t phase_nanos[kPhaseNum];
+  bool phase_entered[kPhaseNum];
+
+ private:
+  std::atomic<CommandCounters*> counters_[kCmdNum];
+
+  // No copying allowed
+  ThreadCommandStats(const ThreadCommandStats&);
+  void operator=(const ThreadCommandStats&);
+};
+
+void EnableCommandStats(bool enable);
+bool CommandStatsEnabled();
+void GetCommandStats(std::vector<CommandStats>* stats);
+// Counters updated while resetting may survive it
+void ResetCommandStats();
+
+// True while a command of this thread is timed
+inline bool CommandStatsActive() {
+  return CommandStatsEnabled()
+    && ThreadCommandStats::Current()->active_command != kCmdNum;
+}
+
+// Times a BlackWidow command, the scopes of commands called by
+// another command are ignored
+class CommandStatsScope {
+ public:
+  explicit CommandStatsScope(CommandType command) : stats_(nullptr) {
+    if (!CommandStatsEnabled()) {
+      return;
+    }
+    ThreadCommandStats* stats = ThreadCommandStats::Current();
+    if (stats->active_command != kCmdNum) {
+      return;
+    }
+    stats_ = stats;
+    stats_->active_command = command;
+    for (int idx = 0; idx < kPhaseNum; ++idx) {
+      stats_->phase_nanos[idx] = 0;
+      stats_->phase_entered[idx] = false;
+    }
+    start_nanos_ = CommandStatsNowNanos();
+  }
+
+  ~CommandStatsScope() {
+    if (stats_ != nullptr) {
+      Finish();
+    }
+  }
+
+ private:
+  void Finish();
+
+  ThreadCommandStats* stats_;
+  uint64_t start_nanos_;
+
+  CommandStatsScope(const CommandStatsScope&);
+  void operator=(const CommandStatsScope&);
+};
+
+// Adds the time until destruction to a phase of the running command
+class CommandPhaseTimer {
+ public:
+  explicit CommandPhaseTimer(CommandPhase phase) : stats_(nullptr) {
+    if (!CommandStatsEnabled()) {
+      return;
+    }
+    ThreadCommandStats* stats = ThreadCommandStats::Current();
+    if (stats->active_command == kCmdNum) {
+      return;
+    }
+    stats_ = stats;
+    phase_ = phase;
+    start_nanos_ = CommandStatsNowNanos();
+  }
+
+  ~CommandPhaseTimer() {
+    if (stats_ != nullptr) {
+      stats_->phase_nanos[phase_] += CommandStatsNowNanos() - start_nanos_;
+      stats_->phase_entered[phase_] = true;
+    }
+  }
+
+ private:
+  ThreadCommandStats* stats_;
+  CommandPhase phase_;
+  uint64_t start_nanos_;
+
+  CommandPhaseTimer(const CommandPhaseTimer&);
+  void operator=(const CommandPhaseTimer&);
+};
+
+}  //  namespace blackwidow
+#endif  // SRC_COMMAND_STATS_H_
@@ -0,0 +1,77 @@
+//  Copyright (c) 2017-present, Qihoo, Inc.  All rights reserved.
+//  This source code is licensed under the BSD-style license found in the
+//  LICENSE file in the root directory of this source tree. An additional grant
+//  of patent rights can be found in the PATENTS file in the same directory.
+
+#include "src/encode_buffer.h"
+
+#include <atomic>
+#include <vector>
+
+namespace blackwidow {
+
+const size_t ScratchBuffers::kMaxCachedBuffers;
+const size_t ScratchBuffers::kMaxCachedSize;
+
+static std::atomic<uint64_t> scratch_allocations(0);
+
+namespace {
+
+struct Buffer {
+  char* buf;
+  size_t capacity;
+};
+
+struct BufferCache {
+  std::vector<Buffer> buffers;
+
+  ~BufferCache() {
+    for (const auto& buffer : buffers) {
+      delete[] buffer.buf;
+    }
+  }
+};
+
+}  // namespace
+
+static thread_local BufferCache buffer_cache;
+
+char* ScratchBuffers::Acquire(size_t size, size_t* capacity) {
+  std::vector<Buffer>& buffers = buffer_cache.buffers;
+  for (size_t idx = buffers.size(); idx > 0; --idx) {
+    if (buffers[idx - 1].capacity >= size) {
+      Buffer buffer = buffers[idx - 1];
+      buffers.erase(buffers.begin() + idx - 1);
+      *capacity = buffer.capacity;
+      return buffer.buf;
+    }
+  }
+
+  // Powers of two, so that a buffer fits the next encodings of about
+  // the same size
+  size_t rounded = 256;
+  while (rounded < size) {
+    rounded <<= 1;
+  }
+  if (rounded > kMaxCachedSize) {
+    rounded = size;
+  }
+  scratch_allocations.fetch_add(1, std::memory_order_relaxed);
+  *capacity = rounded;
+  return new char[rounded];
+}
+
+void ScratchBuffers::Release(char* buf, size_t capacity) {
+  std::vector<Buffer>& buffers = buffer_cache.buffers;
+  if (capacity > kMaxCachedSize || buffers.size() >= kMaxCachedBuffers) {
+    delete[] buf;
+    return;
+  }
+  buffers.push_back({buf, capacity});
+}
+
+uint64_t ScratchBuffers::Allocations() {
+  return scratch_allocations.load(std::memory_order_relaxed);
+}
+
+}  //  namespace blackwidow
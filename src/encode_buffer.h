@@ -0,0 +1,69 @@
+//  Copyright (c) 2017-present, Qihoo, Inc.  All rights reserved.
+//  This source code is licensed under the BSD-style license found in the
+//  LICENSE file in the root directory of this source tree. An additional grant
+//  of patent rights can be found in the PATENTS file in the same directory.
+
+#ifndef SRC_ENCODE_BUFFER_H_
+#define SRC_ENCODE_BUFFER_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+namespace blackwidow {
+
+// Heap buffers of the encodings too long for their inline space. Every
+// thread keeps up to kMaxCachedBuffers released buffers of at most
+// kMaxCachedSize bytes, so that long keys and values do not allocate on
+// every encode.
+class ScratchBuffers {
+ public:
+  static const size_t kMaxCachedBuffers = 16;
+  static const size_t kMaxCachedSize = 64 << 10;
+
+  // A buffer of at least size bytes, its actual size in capacity
+  static char* Acquire(size_t size, size_t* capacity);
+  static void Release(char* buf, size_t capacity);
+
+  // Buffers allocated by all the threads
+  static uint64_t Allocations();
+};
+
+// Space of the encoding of a key or value: the inline space for a short
+// one, otherwise a scratch buffer
+class EncodeBuffer {
+ public:
+  EncodeBuffer() : start_(space_), capacity_(sizeof(space_)) {}
+
+  ~EncodeBuffer() {
+    if (start_ != space_) {
+      ScratchBuffers::Release(start_, capacity_);
+    }
+  }
+
+  // Space of size bytes, overwriting the previous encoding
+  char* Reserve(size_t size) {
+    if (size > capacity_) {
+      if (start_ != space_) {
+        ScratchBuffers::Release(start_, capacity_);
+      }
+      start_ = ScratchBuffers::Acquire(size, &capacity_);
+    }
+    return start_;
+  }
+
+  char* data() const {
+    return start_;
+  }
+
+ private:
+  char space_[200];
+  char* start_;
+  size_t capacity_;
+
+  // No copying allowed
+  EncodeBuffer(const EncodeBuffer&);
+  void operator=(const EncodeBuffer&);
+};
+
+}  //  namespace blackwidow
+#endif  // SRC_ENCODE_BUFFER_H_
@@ -0,0 +1,121 @@
+//  Copyright (c) 2017-present, Qihoo, Inc.  All rights reserved.
+//  This source code is licensed under the BSD-style license found in the
+//  LICENSE file in the root directory of this source tree. An additional grant
+//  of patent rights can be found in the PATENTS file in the same directory.
+
+#include "src/glob_pattern.h"
+
+#include <string.h>
+
+#include "blackwidow/util.h"
+
+namespace blackwidow {
+
+GlobPattern::GlobPattern(const std::string& pattern)
+    : pattern_(pattern),
+      type_(kGeneric) {
+  // Split the pattern on '*', the escaped characters are literals
+  bool generic = false, prefix_done = false;
+  std::vector<std::string> segments(1);
+  for (size_t idx = 0; idx < pattern.size(); ++idx) {
+    char c = pattern[idx];
+    if (c == '*' || c == '?' || c == '[') {
+      prefix_done = true;
+      if (c == '*') {
+        segments.push_back(std::string());
+      } else {
+        generic = true;
+      }
+      continue;
+    }
+    if (c == '\\' && idx + 1 < pattern.size()) {
+      c = pattern[++idx];
+    }
+    segments.back().push_back(c);
+    if (!prefix_done) {
+      prefix_.push_back(c);
+    }
+  }
+
+  upper_bound_ = prefix_;
+  while (!upper_bound_.empty()
+    && static_cast<unsigned char>(upper_bound_.back()) == 0xff) {
+    upper_bound_.pop_back();
+  }
+  if (!upper_bound_.empty()) {
+    upper_bound_.back() = static_cast<char>(upper_bound_.back() + 1);
+  }
+
+  if (generic) {
+    return;
+  }
+  head_ = segments.front();
+  if (segments.size() == 1) {
+    type_ = kExact;
+    return;
+  }
+  tail_ = segments.back();
+  for (size_t idx = 1; idx + 1 < segments.size(); ++idx) {
+    if (!segments[idx].empty()) {
+      middle_.push_back(segments[idx]);
+    }
+  }
+  if (middle_.empty() && tail_.empty()) {
+    type_ = head_.empty() ? kMatchAll : kPrefix;
+  } else if (middle_.empty() && head_.empty()) {
+    type_ = kSuffix;
+  } else if (middle_.size() == 1 && head_.empty() && tail_.empty()) {
+    type_ = kContains;
+  } else {
+    type_ = kSegments;
+  }
+}
+
+bool GlobPattern::Match(const Slice& str) const {
+  switch (type_) {
+    case kMatchAll:
+      return true;
+    case kExact:
+      return str == Slice(head_);
+    case kPrefix:
+      return str.starts_with(head_);
+    case kSuffix:
+      return str.size() >= tail_.size()
+        && !memcmp(str.data() + str.size() - tail_.size(),
+                   tail_.data(), tail_.size());
+    case kContains:
+      return memmem(str.data(), str.size(),
+                    middle_[0].data(), middle_[0].size()) != NULL;
+    case kSegments:
+      {
+      if (str.size() < head_.size() + tail_.size()
+        || !str.starts_with(head_)
+        || memcmp(str.data() + str.size() - tail_.size(),
+                  tail_.data(), tail_.size())) {
+        return false;
+      }
+      // Taking the leftmost match of every middle literal leaves the
+      // most room to the next ones
+      const char* pos = str.data() + head_.size();
+      const char* end = str.data() + str.size() - tail_.size();
+      for (const auto& literal : middle_) {
+        const void* found = memmem(pos, end - pos,
+                                   literal.data(), literal.size());
+        if (found == NULL) {
+          return false;
+        }
+        pos = static_cast<const char*>(found) + literal.size();
+      }
+      return true;
+      }
+    default:
+      if (!str.starts_with(prefix_)) {
+        return false;
+      }
+      // StringMatch may look at the first character of an empty string
+      return StringMatch(pattern_.data(), pattern_.size(),
+                         str.empty() ? "" : str.data(), str.size(), 0);
+  }
+}
+
+}  //  namespace blackwidow
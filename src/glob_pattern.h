@@ -0,0 +1,69 @@
+//  Copyright (c) 2017-present, Qihoo, Inc.  All rights reserved.
+//  This source code is licensed under the BSD-style license found in the
+//  LICENSE file in the root directory of this source tree. An additional grant
+//  of patent rights can be found in the PATENTS file in the same directory.
+
+#ifndef SRC_GLOB_PATTERN_H_
+#define SRC_GLOB_PATTERN_H_
+
+#include <string>
+#include <vector>
+
+#include "rocksdb/slice.h"
+
+namespace blackwidow {
+
+using Slice = rocksdb::Slice;
+
+// Glob pattern compiled once for a whole scan, matches the same strings
+// as StringMatch. Patterns made of literals and '*' only are matched by
+// comparing and searching their literal segments, the others fall back
+// to StringMatch once the literal prefix is checked.
+class GlobPattern {
+ public:
+  explicit GlobPattern(const std::string& pattern);
+
+  bool Match(const Slice& str) const;
+
+  // Literal prefix of every matching string, the scans seek to it
+  const std::string& prefix() const {
+    return prefix_;
+  }
+
+  // Smallest string greater than all the strings starting with the
+  // prefix, empty if there is none
+  const std::string& upper_bound() const {
+    return upper_bound_;
+  }
+
+  // True if str and every string after it in bytewise order can not
+  // match, so a scan in key order can stop there
+  bool PastPrefix(const Slice& str) const {
+    return !str.starts_with(prefix_) && str.compare(prefix_) > 0;
+  }
+
+ private:
+  enum MatchType {
+    kMatchAll,
+    kExact,
+    kPrefix,
+    kSuffix,
+    kContains,
+    kSegments,
+    kGeneric
+  };
+
+  std::string pattern_;
+  std::string prefix_;
+  std::string upper_bound_;
+  MatchType type_;
+
+  // The literals between the '*' of the pattern, head is matched at the
+  // start of the string, tail at its end and the middle ones in order
+  std::string head_;
+  std::string tail_;
+  std::vector<std::string> middle_;
+};
+
+}  //  namespace blackwidow
+#endif  // SRC_GLOB_PATTERN_H_
@@ -0,0 +1,172 @@
+//  Copyright (c) 2017-present, Qihoo, Inc.  All rights reserved.
+//  This source code is licensed under the BSD-style license found in the
+//  LICENSE file in the root directory of this source tree. An additional grant
+//  of patent rights can be found in the PATENTS file in the same directory.
+
+#include "src/hot_keys.h"
+
+#include <algorithm>
+
+#include "src/murmurhash.h"
+
+namespace blackwidow {
+
+namespace {
+
+// Threads take consecutive numbers, so the recording threads spread over
+// the shards of every HotKeys they record into
+size_t ThreadIndex() {
+  static std::atomic<size_t> next_thread(0);
+  static thread_local size_t thread_idx = next_thread++;
+  return thread_idx;
+}
+
+}  // namespace
+
+const size_t HotKeys::kNumShards;
+const size_t HotKeys::kSketchDepth;
+const size_t HotKeys::kSketchWidth;
+const size_t HotKeys::kCandidates;
+const size_t HotKeys::kNumTypes;
+
+HotKeys::HotKeys()
+    : sample_rate_(0) {
+  shards_ = new Shard[kNumShards];
+  for (size_t idx = 0; idx < kNumShards; ++idx) {
+    shards_[idx].sketch.resize(kSketchDepth * kSketchWidth, 0);
+  }
+}
+
+HotKeys::~HotKeys() {
+  delete[] shards_;
+}
+
+void HotKeys::SetSampleRate(uint32_t sample_rate) {
+  sample_rate_.store(sample_rate, std::memory_order_relaxed);
+}
+
+void HotKeys::SketchSlots(size_t type_idx, Access access, const Slice& key,
+                          size_t slots[kSketchDepth]) {
+  // Every data type and access has its own hash seeds, so they share the
+  // sketch without sharing its counters
+  unsigned int seed = static_cast<unsigned int>(type_idx * kAccessNum + access);
+  uint64_t h1 = MurmurHash(key.data(), static_cast<int>(key.size()), seed * 2);
+  uint64_t h2 = MurmurHash(key.data(), static_cast<int>(key.size()),
+                           seed * 2 + 1) | 1;
+  for (size_t row = 0; row < kSketchDepth; ++row) {
+    slots[row] = row * kSketchWidth + (h1 + row * h2) % kSketchWidth;
+  }
+}
+
+uint64_t HotKeys::Estimate(const Shard& shard, size_t type_idx,
+                           Access access, const Slice& key) const {
+  size_t slots[kSketchDepth];
+  SketchSlots(type_idx, access, key, slots);
+  uint32_t count = shard.sketch[slots[0]];
+  for (size_t row = 1; row < kSketchDepth; ++row) {
+    count = std::min(count, shard.sketch[slots[row]]);
+  }
+  return count;
+}
+
+void HotKeys::Sample(const DataType& type, Access access, const Slice& key) {
+  if (type < kStrings || type > kSets) {
+    return;
+  }
+  size_t type_idx = type - kStrings;
+  Shard* shard = &shards_[ThreadIndex() % kNumShards];
+
+  size_t slots[kSketchDepth];
+  SketchSlots(type_idx, access, key, slots);
+  slash::MutexLock l(&shard->mutex);
+  // Conservative update, only the smallest counters grow
+  uint32_t count = shard->sketch[slots[0]];
+  for (size_t row = 1; row < kSketchDepth; ++row) {
+    count = std::min(count, shard->sketch[slots[row]]);
+  }
+  count++;
+  for (size_t row = 0; row < kSketchDepth; ++row) {
+    if (shard->sketch[slots[row]] < count) {
+      shard->sketch[slots[row]] = count;
+    }
+  }
+
+  auto& candidates = shard->candidates[type_idx][access];
+  std::string key_str = key.ToString();
+  auto iter = candidates.find(key_str);
+  if (iter != candidates.end()) {
+    iter->second = count;
+    return;
+  }
+  if (candidates.size() >= kCandidates) {
+    auto min_iter = candidates.begin();
+    for (auto it = candidates.begin(); it != candidates.end(); ++it) {
+      if (it->second < min_iter->second) {
+        min_iter = it;
+      }
+    }
+    if (min_iter->second >= count) {
+      return;
+    }
+    candidates.erase(min_iter);
+  }
+  candidates.insert({key_str, count});
+}
+
+Status HotKeys::GetHotKeys(const DataType& type, size_t k,
+                           std::vector<HotKey>* hot_keys) {
+  hot_keys->clear();
+  if (type < kStrings || type > kSets) {
+    return Status::InvalidArgument("invalid data type");
+  }
+  size_t type_idx = type - kStrings;
+  uint64_t sample_rate = std::max<uint32_t>(
+      sample_rate_.load(std::memory_order_relaxed), 1);
+
+  // A key may be a candidate of some shards only, its count is taken
+  // from the sketches of all of them
+  std::unordered_map<std::string, HotKey> keys;
+  for (size_t idx = 0; idx < kNumShards; ++idx) {
+    slash::MutexLock l(&shards_[idx].mutex);
+    for (int access = 0; access < kAccessNum; ++access) {
+      for (const auto& candidate : shards_[idx].candidates[type_idx][access]) {
+        keys.insert({candidate.first, {candidate.first, 0, 0}});
+      }
+    }
+  }
+  for (size_t idx = 0; idx < kNumShards; ++idx) {
+    slash::MutexLock l(&shards_[idx].mutex);
+    for (auto& item : keys) {
+      item.second.reads += Estimate(shards_[idx], type_idx, kRead, item.first);
+      item.second.writes += Estimate(shards_[idx], type_idx, kWrite, item.first);
+    }
+  }
+
+  for (auto& item : keys) {
+    item.second.reads *= sample_rate;
+    item.second.writes *= sample_rate;
+    hot_keys->push_back(item.second);
+  }
+  std::sort(hot_keys->begin(), hot_keys->end(),
+            [](const HotKey& a, const HotKey& b) {
+              return a.reads + a.writes > b.reads + b.writes;
+            });
+  if (hot_keys->size() > k) {
+    hot_keys->resize(k);
+  }
+  return Status::OK();
+}
+
+void HotKeys::Reset() {
+  for (size_t idx = 0; idx < kNumShards; ++idx) {
+    slash::MutexLock l(&shards_[idx].mutex);
+    std::fill(shards_[idx].sketch.begin(), shards_[idx].sketch.end(), 0);
+    for (size_t type_idx = 0; type_idx < kNumTypes; ++type_idx) {
+      for (int access = 0; access < kAccessNum; ++access) {
+        shards_[idx].candidates[type_idx][access].clear();
+      }
+    }
+  }
+}
+
+}  //  namespace blackwidow
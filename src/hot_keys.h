@@ -0,0 +1,116 @@
+//  Copyright (c) 2017-present, Qihoo, Inc.  All rights reserved.
+//  This source code is licensed under the BSD-style license found in the
+//  LICENSE file in the root directory of this source tree. An additional grant
+//  of patent rights can be found in the PATENTS file in the same directory.
+
+#ifndef SRC_HOT_KEYS_H_
+#define SRC_HOT_KEYS_H_
+
+#include <stdint.h>
+#include <atomic>
+#include <string>
+#include <vector>
+#include <unordered_map>
+
+#include "rocksdb/slice.h"
+#include "rocksdb/status.h"
+
+#include "slash/include/slash_mutex.h"
+#include "blackwidow/blackwidow.h"
+
+namespace blackwidow {
+
+using Slice = rocksdb::Slice;
+using Status = rocksdb::Status;
+
+// Sampled read and write counts of the keys of every data type.
+//
+// One access out of sample_rate, picked at random, is recorded into a
+// count-min sketch, which estimates the count of any key, and the keys
+// with the highest estimates are kept as candidates. Every thread
+// records into one of kNumShards shards, each with its own sketch and
+// lock, so recording threads rarely contend. The estimates of a key are
+// summed over the shards and scaled back by the sample rate.
+class HotKeys {
+ public:
+  static const size_t kNumShards = 8;
+  static const size_t kSketchDepth = 4;
+  static const size_t kSketchWidth = 2048;
+  // Candidates kept per shard, data type and access
+  static const size_t kCandidates = 64;
+
+  HotKeys();
+  ~HotKeys();
+
+  // 0 disables the recording
+  void SetSampleRate(uint32_t sample_rate);
+
+  void RecordRead(const DataType& type, const Slice& key) {
+    Record(type, kRead, key);
+  }
+
+  void RecordWrite(const DataType& type, const Slice& key) {
+    Record(type, kWrite, key);
+  }
+
+  // The k keys of type with the most reads and writes, most accessed first
+  Status GetHotKeys(const DataType& type, size_t k,
+                    std::vector<HotKey>* hot_keys);
+  void Reset();
+
+ private:
+  enum Access {
+    kRead = 0,
+    kWrite,
+    kAccessNum
+  };
+
+  static const size_t kNumTypes = 5;
+
+  struct Shard {
+    slash::Mutex mutex;
+    std::vector<uint32_t> sketch;
+    std::unordered_map<std::string, uint64_t> candidates[kNumTypes][kAccessNum];
+  };
+
+  void Record(const DataType& type, Access access, const Slice& key) {
+    uint32_t sample_rate = sample_rate_.load(std::memory_order_relaxed);
+    if (sample_rate == 0) {
+      return;
+    }
+    // Sampled at random, a fixed period could keep missing the keys of
+    // a periodic access pattern
+    static thread_local uint32_t random = 0;
+    if (sample_rate > 1) {
+      if (random == 0) {
+        random = static_cast<uint32_t>(
+            reinterpret_cast<uintptr_t>(&random) >> 4) | 1;
+      }
+      // xorshift32
+      random ^= random << 13;
+      random ^= random >> 17;
+      random ^= random << 5;
+      if (random % sample_rate != 0) {
+        return;
+      }
+    }
+    Sample(type, access, key);
+  }
+
+  void Sample(const DataType& type, Access access, const Slice& key);
+  // Count of key in the sketch of shard, its lock is held
+  uint64_t Estimate(const Shard& shard, size_t type_idx, Access access,
+                    const Slice& key) const;
+  static void SketchSlots(size_t type_idx, Access access, const Slice& key,
+                          size_t slots[kSketchDepth]);
+
+  std::atomic<uint32_t> sample_rate_;
+  Shard* shards_;
+
+  // No copying allowed
+  HotKeys(const HotKeys&);
+  void operator=(const HotKeys&);
+};
+
+}  //  namespace blackwidow
+#endif  // SRC_HOT_KEYS_H_
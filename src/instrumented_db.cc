@@ -0,0 +1,144 @@
+//  Copyright (c) 2017-present, Qihoo, Inc.  All rights reserved.
+//  This source code is licensed under the BSD-style license found in the
+//  LICENSE file in the root directory of this source tree. An additional grant
+//  of patent rights can be found in the PATENTS file in the same directory.
+
+#include "src/instrumented_db.h"
+
+namespace blackwidow {
+
+// Times the positioning of the wrapped iterator, the returned key and
+// value are already in memory
+class InstrumentedIterator : public rocksdb::Iterator {
+ public:
+  InstrumentedIterator(rocksdb::Iterator* iter, CommandPhase phase)
+      : iter_(iter), phase_(phase) {}
+
+  ~InstrumentedIterator() {
+    delete iter_;
+  }
+
+  bool Valid() const override { return iter_->Valid(); }
+
+  void SeekToFirst() override {
+    CommandPhaseTimer timer(phase_);
+    iter_->SeekToFirst();
+  }
+
+  void SeekToLast() override {
+    CommandPhaseTimer timer(phase_);
+    iter_->SeekToLast();
+  }
+
+  void Seek(const rocksdb::Slice& target) override {
+    CommandPhaseTimer timer(phase_);
+    iter_->Seek(target);
+  }
+
+  void SeekForPrev(const rocksdb::Slice& target) override {
+    CommandPhaseTimer timer(phase_);
+    iter_->SeekForPrev(target);
+  }
+
+  void Next() override {
+    CommandPhaseTimer timer(phase_);
+    iter_->Next();
+  }
+
+  void Prev() override {
+    CommandPhaseTimer timer(phase_);
+    iter_->Prev();
+  }
+
+  rocksdb::Slice key() const override { return iter_->key(); }
+  rocksdb::Slice value() const override { return iter_->value(); }
+  rocksdb::Status status() const override { return iter_->status(); }
+
+  rocksdb::Status GetProperty(std::string prop_name,
+                              std::string* prop) override {
+    return iter_->GetProperty(prop_name, prop);
+  }
+
+  // The pooled iterators are refreshed instead of built again
+  rocksdb::Status Refresh() override {
+    CommandPhaseTimer timer(phase_);
+    return iter_->Refresh();
+  }
+
+  bool IsKeyPinned() const override { return iter_->IsKeyPinned(); }
+
+ private:
+  rocksdb::Iterator* iter_;
+  CommandPhase phase_;
+
+  // No copying allowed
+  InstrumentedIterator(const InstrumentedIterator&);
+  void operator=(const InstrumentedIterator&);
+};
+
+rocksdb::Status InstrumentedDB::Get(const rocksdb::ReadOptions& options,
+                                    rocksdb::ColumnFamilyHandle* column_family,
+                                    const rocksdb::Slice& key,
+                                    rocksdb::PinnableSlice* value) {
+  CommandPhaseTimer timer(ReadPhase(column_family));
+  return db_->Get(options, column_family, key, value);
+}
+
+std::vector<rocksdb::Status> InstrumentedDB::MultiGet(
+    const rocksdb::ReadOptions& options,
+    const std::vector<rocksdb::ColumnFamilyHandle*>& column_family,
+    const std::vector<rocksdb::Slice>& keys,
+    std::vector<std::string>* values) {
+  CommandPhaseTimer timer(column_family.empty()
+    ? kPhaseDataIO : ReadPhase(column_family[0]));
+  return db_->MultiGet(options, column_family, keys, values);
+}
+
+#ifdef BLACKWIDOW_PINNED_MULTIGET
+void InstrumentedDB::MultiGet(const rocksdb::ReadOptions& options,
+                              rocksdb::ColumnFamilyHandle* column_family,
+                              const size_t num_keys,
+                              const rocksdb::Slice* keys,
+                              rocksdb::PinnableSlice* values,
+                              rocksdb::Status* statuses,
+                              const bool sorted_input) {
+  CommandPhaseTimer timer(ReadPhase(column_family));
+  db_->MultiGet(options, column_family, num_keys, keys, values, statuses,
+                sorted_input);
+}
+#endif
+
+rocksdb::Status InstrumentedDB::Put(const rocksdb::WriteOptions& options,
+                                    rocksdb::ColumnFamilyHandle* column_family,
+                                    const rocksdb::Slice& key,
+                                    const rocksdb::Slice& value) {
+  CommandPhaseTimer timer(kPhaseWrite);
+  return db_->Put(options, column_family, key, value);
+}
+
+rocksdb::Status InstrumentedDB::Delete(
+    const rocksdb::WriteOptions& options,
+    rocksdb::ColumnFamilyHandle* column_family,
+    const rocksdb::Slice& key) {
+  CommandPhaseTimer timer(kPhaseWrite);
+  return db_->Delete(options, column_family, key);
+}
+
+rocksdb::Status InstrumentedDB::Write(const rocksdb::WriteOptions& options,
+                                      rocksdb::WriteBatch* updates) {
+  CommandPhaseTimer timer(kPhaseWrite);
+  return db_->Write(options, updates);
+}
+
+rocksdb::Iterator* InstrumentedDB::NewIterator(
+    const rocksdb::ReadOptions& options,
+    rocksdb::ColumnFamilyHandle* column_family) {
+  rocksdb::Iterator* iter = db_->NewIterator(options, column_family);
+  if (!CommandStatsActive()) {
+    // Not worth the indirection for compactions and background scans
+    return iter;
+  }
+  return new InstrumentedIterator(iter, ReadPhase(column_family));
+}
+
+}  //  namespace blackwidow
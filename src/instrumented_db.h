@@ -0,0 +1,84 @@
+//  Copyright (c) 2017-present, Qihoo, Inc.  All rights reserved.
+//  This source code is licensed under the BSD-style license found in the
+//  LICENSE file in the root directory of this source tree. An additional grant
+//  of patent rights can be found in the PATENTS file in the same directory.
+
+#ifndef SRC_INSTRUMENTED_DB_H_
+#define SRC_INSTRUMENTED_DB_H_
+
+#include <string>
+#include <vector>
+
+#include "rocksdb/db.h"
+#include "rocksdb/version.h"
+#include "rocksdb/utilities/stackable_db.h"
+
+#include "src/command_stats.h"
+
+// rocksdb reads a batch of keys into PinnableSlices at one sequence
+// since 6.4, older releases take one Get per key
+#if (ROCKSDB_MAJOR > 6 || (ROCKSDB_MAJOR == 6 && ROCKSDB_MINOR >= 4))
+#define BLACKWIDOW_PINNED_MULTIGET
+#endif
+
+namespace blackwidow {
+
+// Charges the reads and writes of the running command to its phases,
+// reads of the default column family are meta reads when the db keeps
+// the meta values there, every other read is data io
+class InstrumentedDB : public rocksdb::StackableDB {
+ public:
+  InstrumentedDB(rocksdb::DB* db, bool has_meta_cf)
+      : rocksdb::StackableDB(db), has_meta_cf_(has_meta_cf) {}
+
+  using rocksdb::StackableDB::Get;
+  rocksdb::Status Get(const rocksdb::ReadOptions& options,
+                      rocksdb::ColumnFamilyHandle* column_family,
+                      const rocksdb::Slice& key,
+                      rocksdb::PinnableSlice* value) override;
+
+  using rocksdb::StackableDB::MultiGet;
+  std::vector<rocksdb::Status> MultiGet(
+      const rocksdb::ReadOptions& options,
+      const std::vector<rocksdb::ColumnFamilyHandle*>& column_family,
+      const std::vector<rocksdb::Slice>& keys,
+      std::vector<std::string>* values) override;
+
+#ifdef BLACKWIDOW_PINNED_MULTIGET
+  void MultiGet(const rocksdb::ReadOptions& options,
+                rocksdb::ColumnFamilyHandle* column_family,
+                const size_t num_keys, const rocksdb::Slice* keys,
+                rocksdb::PinnableSlice* values, rocksdb::Status* statuses,
+                const bool sorted_input = false) override;
+#endif
+
+  using rocksdb::StackableDB::Put;
+  rocksdb::Status Put(const rocksdb::WriteOptions& options,
+                      rocksdb::ColumnFamilyHandle* column_family,
+                      const rocksdb::Slice& key,
+                      const rocksdb::Slice& value) override;
+
+  using rocksdb::StackableDB::Delete;
+  rocksdb::Status Delete(const rocksdb::WriteOptions& options,
+                         rocksdb::ColumnFamilyHandle* column_family,
+                         const rocksdb::Slice& key) override;
+
+  rocksdb::Status Write(const rocksdb::WriteOptions& options,
+                        rocksdb::WriteBatch* updates) override;
+
+  using rocksdb::StackableDB::NewIterator;
+  rocksdb::Iterator* NewIterator(
+      const rocksdb::ReadOptions& options,
+      rocksdb::ColumnFamilyHandle* column_family) override;
+
+ private:
+  CommandPhase ReadPhase(rocksdb::ColumnFamilyHandle* column_family) const {
+    return has_meta_cf_ && column_family->GetID() == 0
+      ? kPhaseMetaRead : kPhaseDataIO;
+  }
+
+  const bool has_meta_cf_;
+};
+
+}  //  namespace blackwidow
+#endif  // SRC_INSTRUMENTED_DB_H_
@@ -0,0 +1,96 @@
+//  Copyright (c) 2017-present, Qihoo, Inc.  All rights reserved.
+//  This source code is licensed under the BSD-style license found in the
+//  LICENSE file in the root directory of this source tree. An additional grant
+//  of patent rights can be found in the PATENTS file in the same directory.
+
+#include "src/iterator_pool.h"
+
+namespace blackwidow {
+
+namespace {
+
+// Threads take consecutive numbers, so the threads using a pool at once
+// spread over its shards whichever pool they used first
+size_t ThreadIndex() {
+  static std::atomic<size_t> next_thread(0);
+  static thread_local size_t thread_idx = next_thread++;
+  return thread_idx;
+}
+
+}  // namespace
+
+const size_t IteratorPool::kNumShards;
+
+IteratorPool::IteratorPool(rocksdb::DB* db,
+                           rocksdb::ColumnFamilyHandle* handle,
+                           size_t capacity)
+    : db_(db),
+      handle_(handle),
+      shard_capacity_((capacity + kNumShards - 1) / kNumShards),
+      created_(0) {
+  shards_ = new Shard[kNumShards];
+}
+
+IteratorPool::~IteratorPool() {
+  for (size_t idx = 0; idx < kNumShards; ++idx) {
+    for (auto entry : shards_[idx].entries) {
+      DeleteEntry(entry);
+    }
+  }
+  delete[] shards_;
+}
+
+IteratorPool::Shard* IteratorPool::GetShard() {
+  return &shards_[ThreadIndex() % kNumShards];
+}
+
+IteratorPool::Entry* IteratorPool::NewEntry() {
+  Entry* entry = new Entry();
+  // The iterator keeps the address of the bound, not its value
+  rocksdb::ReadOptions read_options;
+  read_options.iterate_upper_bound = &entry->upper_bound_slice;
+  entry->iter = db_->NewIterator(read_options, handle_);
+  created_.fetch_add(1, std::memory_order_relaxed);
+  return entry;
+}
+
+void IteratorPool::DeleteEntry(Entry* entry) {
+  delete entry->iter;
+  delete entry;
+}
+
+IteratorPool::Entry* IteratorPool::Checkout(const Slice& upper_bound) {
+  Entry* entry = nullptr;
+  Shard* shard = GetShard();
+  {
+    slash::MutexLock l(&shard->mutex);
+    if (!shard->entries.empty()) {
+      entry = shard->entries.back();
+      shard->entries.pop_back();
+    }
+  }
+  if (entry != nullptr && !entry->iter->Refresh().ok()) {
+    DeleteEntry(entry);
+    entry = nullptr;
+  }
+  if (entry == nullptr) {
+    entry = NewEntry();
+  }
+  entry->upper_bound.assign(upper_bound.data(), upper_bound.size());
+  entry->upper_bound_slice = entry->upper_bound;
+  return entry;
+}
+
+void IteratorPool::Return(Entry* entry) {
+  Shard* shard = GetShard();
+  {
+    slash::MutexLock l(&shard->mutex);
+    if (shard->entries.size() < shard_capacity_) {
+      shard->entries.push_back(entry);
+      return;
+    }
+  }
+  DeleteEntry(entry);
+}
+
+}  //  namespace blackwidow
@@ -0,0 +1,125 @@
+//  Copyright (c) 2017-present, Qihoo, Inc.  All rights reserved.
+//  This source code is licensed under the BSD-style license found in the
+//  LICENSE file in the root directory of this source tree. An additional grant
+//  of patent rights can be found in the PATENTS file in the same directory.
+
+#ifndef SRC_ITERATOR_POOL_H_
+#define SRC_ITERATOR_POOL_H_
+
+#include <atomic>
+#include <string>
+#include <vector>
+
+#include "rocksdb/db.h"
+#include "rocksdb/slice.h"
+
+#include "slash/include/slash_mutex.h"
+
+namespace blackwidow {
+
+using Slice = rocksdb::Slice;
+
+// Idle iterators over a column family, kept for the short range reads
+// so they do not build a new iterator every time.
+//
+// A checked out iterator is refreshed to the latest data, rocksdb can
+// not refresh an iterator to a snapshot, so pooled reads see every write
+// done before the checkout. Its upper bound points into the pool entry,
+// which is set on every checkout. Every thread takes and returns its
+// iterators to one of kNumShards free lists.
+//
+// An idle iterator pins the memtables and SSTs it was last refreshed
+// to, so capacity also bounds the obsolete data kept alive.
+class IteratorPool {
+ public:
+  static const size_t kNumShards = 8;
+
+  struct Entry {
+    rocksdb::Iterator* iter;
+    std::string upper_bound;
+    Slice upper_bound_slice;
+  };
+
+  // At most capacity idle iterators over handle
+  IteratorPool(rocksdb::DB* db, rocksdb::ColumnFamilyHandle* handle,
+               size_t capacity);
+  // Must be destroyed before db is closed
+  ~IteratorPool();
+
+  // An iterator over the latest data stopping at upper_bound, given back
+  // by Return()
+  Entry* Checkout(const Slice& upper_bound);
+  void Return(Entry* entry);
+
+  uint64_t Created() const {
+    return created_.load(std::memory_order_relaxed);
+  }
+
+ private:
+  struct Shard {
+    slash::Mutex mutex;
+    std::vector<Entry*> entries;
+  };
+
+  Shard* GetShard();
+  Entry* NewEntry();
+  static void DeleteEntry(Entry* entry);
+
+  rocksdb::DB* const db_;
+  rocksdb::ColumnFamilyHandle* const handle_;
+  const size_t shard_capacity_;
+  std::atomic<uint64_t> created_;
+  Shard* shards_;
+
+  // No copying allowed
+  IteratorPool(const IteratorPool&);
+  void operator=(const IteratorPool&);
+};
+
+// Iterator of a range read stopping at upper_bound: a pooled one reading
+// the latest data when pool is not null, otherwise a new one reading
+// with read_options. A read at a snapshot never takes a pooled one.
+class ScopeIterator {
+ public:
+  ScopeIterator(IteratorPool* pool, rocksdb::DB* db,
+                rocksdb::ColumnFamilyHandle* handle,
+                const rocksdb::ReadOptions& read_options,
+                const Slice& upper_bound)
+      : pool_(read_options.snapshot == nullptr ? pool : nullptr),
+        entry_(nullptr) {
+    if (pool_ != nullptr) {
+      entry_ = pool_->Checkout(upper_bound);
+      iter_ = entry_->iter;
+    } else {
+      upper_bound_ = upper_bound;
+      rocksdb::ReadOptions options(read_options);
+      options.iterate_upper_bound = &upper_bound_;
+      iter_ = db->NewIterator(options, handle);
+    }
+  }
+
+  ~ScopeIterator() {
+    if (pool_ != nullptr) {
+      pool_->Return(entry_);
+    } else {
+      delete iter_;
+    }
+  }
+
+  rocksdb::Iterator* operator->() const {
+    return iter_;
+  }
+
+ private:
+  IteratorPool* const pool_;
+  IteratorPool::Entry* entry_;
+  Slice upper_bound_;
+  rocksdb::Iterator* iter_;
+
+  // No copying allowed
+  ScopeIterator(const ScopeIterator&);
+  void operator=(const ScopeIterator&);
+};
+
+}  //  namespace blackwidow
+#endif  // SRC_ITERATOR_POOL_H_
@@ -0,0 +1,95 @@
+//  Copyright (c) 2017-present, Qihoo, Inc.  All rights reserved.
+//  This source code is licensed under the BSD-style license found in the
+//  LICENSE file in the root directory of this source tree. An additional grant
+//  of patent rights can be found in the PATENTS file in the same directory.
+
+#include "src/key_range_workers.h"
+
+#include <algorithm>
+
+namespace blackwidow {
+
+KeyRangeWorkers::KeyRangeWorkers()
+    : work_cond_(&mutex_),
+      done_cond_(&mutex_),
+      should_exit_(false) {
+}
+
+KeyRangeWorkers::~KeyRangeWorkers() {
+  {
+    slash::MutexLock l(&mutex_);
+    should_exit_ = true;
+    work_cond_.SignalAll();
+  }
+  for (auto& worker : workers_) {
+    worker.join();
+  }
+}
+
+void KeyRangeWorkers::Start(size_t num_workers) {
+  slash::MutexLock l(&mutex_);
+  while (workers_.size() < num_workers) {
+    workers_.push_back(std::thread(&KeyRangeWorkers::WorkerLoop, this));
+  }
+}
+
+Status KeyRangeWorkers::Run(size_t num_tasks, const Task& task) {
+  if (num_tasks == 0) {
+    return Status::OK();
+  }
+  Job job = {&task, num_tasks, 0, 0, Status::OK()};
+  slash::MutexLock l(&mutex_);
+  jobs_.push_back(&job);
+  work_cond_.SignalAll();
+  while (job.next_task < job.num_tasks) {
+    RunTaskLocked(&job);
+  }
+  while (job.running > 0) {
+    done_cond_.Wait();
+  }
+  return job.first_error;
+}
+
+void KeyRangeWorkers::WorkerLoop() {
+  slash::MutexLock l(&mutex_);
+  while (true) {
+    while (!should_exit_ && jobs_.empty()) {
+      work_cond_.Wait();
+    }
+    if (should_exit_) {
+      return;
+    }
+    RunTaskLocked(jobs_.front());
+  }
+}
+
+void KeyRangeWorkers::RunTaskLocked(Job* job) {
+  size_t idx = job->next_task++;
+  if (job->next_task == job->num_tasks) {
+    SkipTasksLocked(job);
+  }
+  job->running++;
+  mutex_.Unlock();
+  Status s = (*job->task)(idx);
+  mutex_.Lock();
+  job->running--;
+  if (!s.ok()) {
+    if (job->first_error.ok()) {
+      job->first_error = s;
+    }
+    SkipTasksLocked(job);
+  }
+  if (job->running == 0 && job->next_task == job->num_tasks) {
+    done_cond_.SignalAll();
+  }
+}
+
+void KeyRangeWorkers::SkipTasksLocked(Job* job) {
+  job->next_task = job->num_tasks;
+  auto iter = std::find(jobs_.begin(), jobs_.end(), job);
+  if (iter != jobs_.end()) {
+    jobs_.erase(iter);
+  }
+}
+
+}  //  namespace blackwidow
@@ -0,0 +1,69 @@
+//  Copyright (c) 2017-present, Qihoo, Inc.  All rights reserved.
+//  This source code is licensed under the BSD-style license found in the
+//  LICENSE file in the root directory of this source tree. An additional grant
+//  of patent rights can be found in the PATENTS file in the same directory.
+
+#ifndef SRC_KEY_RANGE_WORKERS_H_
+#define SRC_KEY_RANGE_WORKERS_H_
+
+#include <deque>
+#include <functional>
+#include <thread>
+#include <vector>
+
+#include "rocksdb/status.h"
+
+#include "slash/include/slash_mutex.h"
+
+namespace blackwidow {
+
+using Status = rocksdb::Status;
+
+// A fixed pool of threads scanning the key ranges of Keys, GetKeyNum and
+// PKPatternMatchDel.
+//
+// Every Run() queues a job whose tasks are taken by the idle workers and
+// by the calling thread, so concurrent scans share the pool and a scan
+// still progresses when every worker is busy.
+class KeyRangeWorkers {
+ public:
+  typedef std::function<Status(size_t)> Task;
+
+  KeyRangeWorkers();
+  ~KeyRangeWorkers();
+
+  // Grow the pool to num_workers threads, the pool never shrinks
+  void Start(size_t num_workers);
+
+  // Runs task(idx) for every idx below num_tasks. Returns the first
+  // error, the tasks not started yet are skipped once a task fails
+  Status Run(size_t num_tasks, const Task& task);
+
+ private:
+  struct Job {
+    const Task* task;
+    size_t num_tasks;
+    size_t next_task;
+    size_t running;
+    Status first_error;
+  };
+
+  slash::Mutex mutex_;
+  slash::CondVar work_cond_;
+  slash::CondVar done_cond_;
+  bool should_exit_;
+  std::deque<Job*> jobs_;
+  std::vector<std::thread> workers_;
+
+  void WorkerLoop();
+  // Runs the next task of job, called and returns with mutex_ held
+  void RunTaskLocked(Job* job);
+  void SkipTasksLocked(Job* job);
+
+  // No copying allowed
+  KeyRangeWorkers(const KeyRangeWorkers&);
+  void operator=(const KeyRangeWorkers&);
+};
+
+}  //  namespace blackwidow
+#endif  // SRC_KEY_RANGE_WORKERS_H_
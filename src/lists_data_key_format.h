@@ -8,34 +8,23 @@
 
 #include <string>
 
+#include "src/encode_buffer.h"
+
 namespace blackwidow {
 class ListsDataKey {
  public:
   ListsDataKey(const Slice& key, int32_t version, uint64_t index) :
-    start_(nullptr), key_(key), version_(version), index_(index) {
-  }
-
-  ~ListsDataKey() {
-    if (start_ != space_) {
-      delete[] start_;
-    }
+    encoded_size_(0), key_(key), version_(version), index_(index) {
   }
 
+  // Encoded once, the next calls return the same slice
   const Slice Encode() {
+    if (encoded_size_ != 0) {
+      return Slice(buffer_.data(), encoded_size_);
+    }
     size_t usize = key_.size();
     size_t needed = usize + sizeof(int32_t) * 2 + sizeof(uint64_t);
-    char* dst;
-    if (needed <= sizeof(space_)) {
-      dst = space_;
-    } else {
-      dst = new char[needed];
-
-      // Need to allocate space, delete previous space
-      if (start_ != space_) {
-        delete[] start_;
-      }
-    }
-    start_ = dst;
+    char* dst = buffer_.Reserve(needed);
     EncodeFixed32(dst, key_.size());
     dst += sizeof(int32_t);
     memcpy(dst, key_.data(), key_.size());
@@ -43,12 +32,13 @@ class ListsDataKey {
     EncodeFixed32(dst, version_);
     dst += sizeof(int32_t);
     EncodeFixed64(dst, index_);
-    return Slice(start_, needed);
+    encoded_size_ = needed;
+    return Slice(buffer_.data(), needed);
   }
 
  private:
-  char space_[200];
-  char* start_;
+  EncodeBuffer buffer_;
+  size_t encoded_size_;
   Slice key_;
   int32_t version_;
   uint64_t index_;
@@ -49,20 +49,13 @@ class ListsMetaValue : public InternalValue {
   const Slice Encode() override {
     size_t usize = user_value_.size();
     size_t needed = usize + kDefaultValueSuffixLength;
-    char* dst;
-    if (needed <= sizeof(space_)) {
-      dst = space_;
-    } else {
-      dst = new char[needed];
-    }
-    start_  = dst;
+    start_ = buffer_.Reserve(needed);
     size_t len = AppendTimestampAndVersion() + AppendIndex();
     return Slice(start_, len);
   }
 
   int32_t UpdateVersion() {
-    int64_t unix_time;
-    rocksdb::Env::Default()->GetCurrentTime(&unix_time);
+    int64_t unix_time = CoarseClock::Now();
     if (version_ >= static_cast<int32_t>(unix_time)) {
       version_++;
     } else {
@@ -207,8 +200,7 @@ class ParsedListsMetaValue : public ParsedInternalValue {
   }
 
   int32_t UpdateVersion() {
-    int64_t unix_time;
-    rocksdb::Env::Default()->GetCurrentTime(&unix_time);
+    int64_t unix_time = CoarseClock::Now();
     if (version_ >= static_cast<int32_t>(unix_time)) {
       version_++;
     } else {
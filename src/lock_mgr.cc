@@ -3,188 +3,383 @@
 //  LICENSE file in the root directory of this source tree. An additional grant
 //  of patent rights can be found in the PATENTS file in the same directory.
 
-#ifndef __STDC_FORMAT_MACROS
-#define __STDC_FORMAT_MACROS
-#endif
-
 #include "src/lock_mgr.h"
 
+#include <assert.h>
+
 #include <vector>
-#include <unordered_set>
+#include <unordered_map>
 #include <atomic>
 #include <memory>
+#include <mutex>
+#include <condition_variable>
+#include <chrono>
+#include <algorithm>
 
-#include "src/mutex.h"
 #include "src/murmurhash.h"
 
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#endif
+
 namespace blackwidow {
 
-struct LockMapStripe {
-  explicit LockMapStripe(std::shared_ptr<MutexFactory> factory) {
-    stripe_mutex = factory->AllocateMutex();
-    stripe_cv = factory->AllocateCondVar();
-    assert(stripe_mutex);
-    assert(stripe_cv);
+// One of this many waits of a slot records the key waited for
+static const uint64_t kContendedKeySampleInterval = 8;
+// Keys tracked at most to find the top LOCK_STATS_TOP_K
+static const size_t kContendedKeysCapacity = 8 * LOCK_STATS_TOP_K;
+
+// Bounds of the spins before parking, a waiter spins for twice as long
+// as the recent waits which ended while spinning
+static const uint32_t kMinSpins = 16;
+static const uint32_t kMaxSpins = 4096;
+
+static const uint32_t kSlotFree = 0;
+static const uint32_t kSlotLocked = 1;
+
+// Deadline of the innermost LockDeadline scope
+static thread_local uint64_t thread_deadline_micros = LockMgr::kNoDeadline;
+
+static inline void CpuRelax() {
+#if defined(__x86_64__) || defined(__i386__)
+  _mm_pause();
+#else
+  std::atomic_signal_fence(std::memory_order_seq_cst);
+#endif
+}
+
+struct LockMgr::Slot {
+  Slot()
+      : state(kSlotFree), waiters(0), spins(kMinSpins),
+        acquisitions(0), waits(0), wait_micros(0), max_wait_micros(0) {}
+
+  bool TryAcquire() {
+    uint32_t expected = kSlotFree;
+    return state.compare_exchange_strong(expected, kSlotLocked,
+                                         std::memory_order_seq_cst,
+                                         std::memory_order_relaxed);
   }
 
-  // Mutex must be held before modifying keys map
-  std::shared_ptr<Mutex> stripe_mutex;
+  std::atomic<uint32_t> state;
 
-  // Condition Variable per stripe for waiting on a lock
-  std::shared_ptr<CondVar> stripe_cv;
+  // Threads parked on cv, or about to
+  std::atomic<uint32_t> waiters;
+  std::atomic<uint32_t> spins;
+  std::mutex mutex;
+  std::condition_variable cv;
 
-  // Locked keys
-  std::unordered_set<std::string> keys;
+  // Contention counters, only updated by the holder of the slot
+  std::atomic<uint64_t> acquisitions;
+  std::atomic<uint64_t> waits;
+  std::atomic<uint64_t> wait_micros;
+  std::atomic<uint64_t> max_wait_micros;
 };
 
-// Map of #num_stripes LockMapStripes
-struct LockMap {
-  explicit LockMap(size_t num_stripes,
-                   std::shared_ptr<MutexFactory> factory)
-      : num_stripes_(num_stripes) {
-    lock_map_stripes_.reserve(num_stripes);
-    for (size_t i = 0; i < num_stripes; i++) {
-      LockMapStripe* stripe = new LockMapStripe(factory);
-      lock_map_stripes_.push_back(stripe);
+static void Increase(std::atomic<uint64_t>* counter, uint64_t value) {
+  counter->store(counter->load(std::memory_order_relaxed) + value,
+                 std::memory_order_relaxed);
+}
+
+// Space saving counters of the sampled waits: when all the slots are
+// taken, the key with the least waits is replaced by the new one which
+// inherits its count, so a hot key can not be starved out by cold ones
+struct ContendedKeys {
+  struct Counter {
+    uint64_t waits;
+    uint64_t wait_micros;
+  };
+
+  void Add(const std::string& key, uint64_t waits, uint64_t wait_micros) {
+    std::lock_guard<std::mutex> lock(mutex);
+    auto iter = counters.find(key);
+    if (iter == counters.end()) {
+      Counter counter = {0, 0};
+      if (counters.size() >= kContendedKeysCapacity) {
+        auto min_iter = counters.begin();
+        for (auto it = counters.begin(); it != counters.end(); ++it) {
+          if (it->second.waits < min_iter->second.waits) {
+            min_iter = it;
+          }
+        }
+        counter = min_iter->second;
+        counters.erase(min_iter);
+      }
+      iter = counters.insert({key, counter}).first;
     }
+    iter->second.waits += waits;
+    iter->second.wait_micros += wait_micros;
   }
 
-  ~LockMap() {
-    for (auto stripe : lock_map_stripes_) {
-      delete stripe;
+  void Top(size_t num, std::vector<LockKeyStats>* keys) {
+    std::lock_guard<std::mutex> lock(mutex);
+    keys->clear();
+    for (const auto& item : counters) {
+      keys->push_back({item.first, item.second.waits, item.second.wait_micros});
+    }
+    std::sort(keys->begin(), keys->end(),
+              [](const LockKeyStats& a, const LockKeyStats& b) {
+                return a.waits > b.waits;
+              });
+    if (keys->size() > num) {
+      keys->resize(num);
     }
   }
 
-  // Number of sepearate LockMapStripes to create, each with their own Mutex
-  const size_t num_stripes_;
+  void Clear() {
+    std::lock_guard<std::mutex> lock(mutex);
+    counters.clear();
+  }
 
-  // Count of keys that are currently locked.
-  // (Only maintained if LockMgr::max_num_locks_ is positive.)
-  std::atomic<int64_t> lock_cnt{0};
+  std::mutex mutex;
+  std::unordered_map<std::string, Counter> counters;
+};
 
-  std::vector<LockMapStripe*> lock_map_stripes_;
+static size_t RoundUpPowerOfTwo(size_t num) {
+  size_t power = 1;
+  while (power < num) {
+    power <<= 1;
+  }
+  return power;
+}
 
-  size_t GetStripe(const std::string& key) const;
-};
+const uint64_t LockMgr::kNoDeadline;
 
-size_t LockMap::GetStripe(const std::string& key) const {
-  assert(num_stripes_ > 0);
-  static murmur_hash hash;
-  size_t stripe = hash(key) % num_stripes_;
-  return stripe;
+uint64_t LockMgr::NowMicros() {
+  return std::chrono::duration_cast<std::chrono::microseconds>(
+      std::chrono::steady_clock::now().time_since_epoch()).count();
 }
 
-LockMgr::LockMgr(size_t default_num_stripes,
-                 int64_t max_num_locks,
-                 std::shared_ptr<MutexFactory> mutex_factory)
-    : default_num_stripes_(default_num_stripes),
-      max_num_locks_(max_num_locks),
-      mutex_factory_(mutex_factory),
-      lock_map_(std::shared_ptr<LockMap>(
-            new LockMap(default_num_stripes, mutex_factory))) {}
+uint64_t LockMgr::ThreadDeadline() {
+  return thread_deadline_micros;
+}
 
-LockMgr::~LockMgr() {}
+// 0 stays 0, so the waits for a held slot fail right away
+static uint64_t DeadlineAfter(uint64_t timeout_micros) {
+  if (timeout_micros == 0) {
+    return 0;
+  }
+  uint64_t now = LockMgr::NowMicros();
+  return timeout_micros < LockMgr::kNoDeadline - now
+    ? now + timeout_micros : LockMgr::kNoDeadline - 1;
+}
 
-Status LockMgr::TryLock(const std::string& key) {
-#ifdef LOCKLESS
-  return Status::OK();
-#else
-  size_t stripe_num = lock_map_->GetStripe(key);
-  assert(lock_map_->lock_map_stripes_.size() > stripe_num);
-  LockMapStripe* stripe = lock_map_->lock_map_stripes_.at(stripe_num);
+LockDeadline::LockDeadline(uint64_t timeout_micros)
+    : prev_deadline_micros_(thread_deadline_micros) {
+  thread_deadline_micros = DeadlineAfter(timeout_micros);
+}
 
-  return Acquire(stripe, key);
-#endif
+LockDeadline::~LockDeadline() {
+  thread_deadline_micros = prev_deadline_micros_;
 }
 
-// Helper function for TryLock().
-Status LockMgr::Acquire(LockMapStripe* stripe,
-                        const std::string& key) {
-  Status result;
+LockMgr::LockMgr(size_t num_slots)
+    : LockMgr(num_slots, 0, nullptr) {}
+
+LockMgr::LockMgr(size_t default_num_stripes, int64_t max_num_locks,
+                 std::shared_ptr<MutexFactory> factory)
+    : slot_mask_(RoundUpPowerOfTwo(
+          std::max<size_t>(default_num_stripes, 1)) - 1),
+      slots_(new Slot[slot_mask_ + 1]),
+      max_num_locks_(std::max<int64_t>(max_num_locks, 0)),
+      lock_cnt_(0),
+      stats_enabled_(false),
+      contended_keys_(std::make_shared<ContendedKeys>()) {}
+
+LockMgr::~LockMgr() {
+  delete[] slots_;
+}
 
-  // we wait indefinitely to acquire the lock
-  result = stripe->stripe_mutex->Lock();
+size_t LockMgr::GetSlot(const Slice& key) const {
+  uint64_t hash = MurmurHash(key.data(), static_cast<int>(key.size()), 0);
+  return static_cast<size_t>(hash) & slot_mask_;
+}
 
-  if (!result.ok()) {
-    // failed to acquire mutex
-    return result;
-  }
+Status LockMgr::TryLockFor(const Slice& key, uint64_t timeout_micros) {
+  return LockSlot(GetSlot(key), key, DeadlineAfter(timeout_micros));
+}
 
-  // Acquire lock if we are able to
-  result = AcquireLocked(stripe, key);
+Status LockMgr::LockSlot(size_t slot_idx, const Slice& key,
+                         uint64_t deadline_micros) {
+#ifdef LOCKLESS
+  return Status::OK();
+#else
+  assert(slot_idx <= slot_mask_);
+  Slot* slot = &slots_[slot_idx];
+  if (!slot->TryAcquire()) {
+    if (deadline_micros == 0
+      || (deadline_micros != kNoDeadline && NowMicros() >= deadline_micros)) {
+      return Status::Busy(Status::SubCode::kLockTimeout);
+    }
+    Status s = Wait(slot, key, deadline_micros);
+    if (!s.ok()) {
+      return s;
+    }
+  }
+  // Only the held slots count, the waiters do not
+  if (max_num_locks_ > 0
+    && lock_cnt_.fetch_add(1, std::memory_order_relaxed) >= max_num_locks_) {
+    UnLockSlot(slot_idx);
+    return Status::Busy(Status::SubCode::kLockLimit);
+  }
+  if (stats_enabled_.load(std::memory_order_relaxed)) {
+    Increase(&slot->acquisitions, 1);
+  }
+  return Status::OK();
+#endif
+}
 
-  if (!result.ok()) {
-    // If we weren't able to acquire the lock, we will keep retrying
-    do {
-      result = stripe->stripe_cv->Wait(stripe->stripe_mutex);
-      if (result.ok()) {
-        result = AcquireLocked(stripe, key);
-      }
-    } while (!result.ok());
-  }
-
-  stripe->stripe_mutex->UnLock();
-
-  return result;
-}
-
-// Try to lock this key after we have acquired the mutex.
-// REQUIRED:  Stripe mutex must be held.
-Status LockMgr::AcquireLocked(LockMapStripe* stripe,
-                              const std::string& key) {
-  Status result;
-  // Check if this key is already locked
-  if (stripe->keys.find(key) != stripe->keys.end()) {
-    // Lock already held
-      result = Status::Busy(Status::SubCode::kLockTimeout);
-  } else {  // Lock not held.
-    // Check lock limit
-    if (max_num_locks_ > 0 &&
-        lock_map_->lock_cnt.load(std::memory_order_acquire) >= max_num_locks_) {
-      result = Status::Busy(Status::SubCode::kLockLimit);
-    } else {
-      // acquire lock
-      stripe->keys.insert(key);
-
-      // Maintain lock count if there is a limit on the number of locks
-      if (max_num_locks_) {
-        lock_map_->lock_cnt++;
+// Returns once the slot is acquired, or the deadline passed
+Status LockMgr::Wait(Slot* slot, const Slice& key, uint64_t deadline_micros) {
+  bool track = stats_enabled_.load(std::memory_order_relaxed);
+  uint64_t start_micros = track ? NowMicros() : 0;
+
+  // Spin while the holder is likely to be about to unlock
+  uint32_t max_spins = slot->spins.load(std::memory_order_relaxed);
+  uint32_t spin = 0;
+  bool acquired = false;
+  for (; spin < max_spins; ++spin) {
+    if (slot->state.load(std::memory_order_relaxed) == kSlotFree
+      && slot->TryAcquire()) {
+      acquired = true;
+      break;
+    }
+    CpuRelax();
+  }
+  if (acquired) {
+    slot->spins.store(std::max(kMinSpins, std::min(kMaxSpins, 2 * spin)),
+                      std::memory_order_relaxed);
+  } else {
+    slot->spins.store(std::max(kMinSpins, max_spins / 2),
+                      std::memory_order_relaxed);
+    // The waiter is counted before trying again, so an unlock either
+    // sees it and signals, or happens before the try which then succeeds
+    std::chrono::steady_clock::time_point deadline =
+      std::chrono::steady_clock::time_point(
+          std::chrono::microseconds(deadline_micros));
+    std::unique_lock<std::mutex> lock(slot->mutex);
+    slot->waiters.fetch_add(1, std::memory_order_seq_cst);
+    while (!(acquired = slot->TryAcquire())) {
+      if (deadline_micros == kNoDeadline) {
+        slot->cv.wait(lock);
+      } else if (slot->cv.wait_until(lock, deadline)
+        == std::cv_status::timeout) {
+        // The signal of an unlock may have come with the timeout
+        acquired = slot->TryAcquire();
+        break;
       }
     }
+    slot->waiters.fetch_sub(1, std::memory_order_relaxed);
   }
 
-  return result;
+  if (track) {
+    uint64_t wait_micros = NowMicros() - start_micros;
+    Increase(&slot->waits, 1);
+    Increase(&slot->wait_micros, wait_micros);
+    if (wait_micros > slot->max_wait_micros.load(std::memory_order_relaxed)) {
+      slot->max_wait_micros.store(wait_micros, std::memory_order_relaxed);
+    }
+    if (slot->waits.load(std::memory_order_relaxed)
+      % kContendedKeySampleInterval == 0) {
+      contended_keys_->Add(key.ToString(), kContendedKeySampleInterval,
+                           wait_micros * kContendedKeySampleInterval);
+    }
+  }
+  return acquired ? Status::OK()
+    : Status::TimedOut(Status::SubCode::kLockTimeout);
 }
 
-void LockMgr::UnLockKey(const std::string& key, LockMapStripe* stripe) {
+void LockMgr::UnLockSlot(size_t slot_idx) {
 #ifdef LOCKLESS
 #else
-  auto stripe_iter = stripe->keys.find(key);
-  if (stripe_iter != stripe->keys.end()) {
-    // Found the key locked.  unlock it.
-    stripe->keys.erase(stripe_iter);
-    if (max_num_locks_ > 0) {
-      // Maintain lock count if there is a limit on the number of locks.
-      assert(lock_map_->lock_cnt.load(std::memory_order_relaxed) > 0);
-      lock_map_->lock_cnt--;
-    }
-  } else {
-    // This key is either not locked or locked by someone else.
+  assert(slot_idx <= slot_mask_);
+  Slot* slot = &slots_[slot_idx];
+  slot->state.store(kSlotFree, std::memory_order_seq_cst);
+  if (max_num_locks_ > 0) {
+    lock_cnt_.fetch_sub(1, std::memory_order_relaxed);
+  }
+  if (slot->waiters.load(std::memory_order_seq_cst) > 0) {
+    // Taking the mutex makes sure the waiter is parked, or has not
+    // tried again yet
+    std::lock_guard<std::mutex> lock(slot->mutex);
+    slot->cv.notify_one();
   }
 #endif
 }
 
-void LockMgr::UnLock(const std::string& key) {
-  // Lock the mutex for the stripe that this key hashes to
-  size_t stripe_num = lock_map_->GetStripe(key);
-  assert(lock_map_->lock_map_stripes_.size() > stripe_num);
-  LockMapStripe* stripe = lock_map_->lock_map_stripes_.at(stripe_num);
+Status LockMgr::MultiLock(const std::vector<std::string>& keys,
+                          uint64_t deadline_micros,
+                          std::vector<size_t>* slots) {
+  std::vector<std::pair<size_t, size_t>> order;
+  order.reserve(keys.size());
+  for (size_t idx = 0; idx < keys.size(); ++idx) {
+    order.push_back({GetSlot(keys[idx]), idx});
+  }
+  std::sort(order.begin(), order.end());
+
+  slots->clear();
+  for (const auto& item : order) {
+    if (!slots->empty() && slots->back() == item.first) {
+      continue;
+    }
+    Status s = LockSlot(item.first, keys[item.second], deadline_micros);
+    if (!s.ok()) {
+      MultiUnLock(*slots);
+      slots->clear();
+      return s;
+    }
+    slots->push_back(item.first);
+  }
+  return Status::OK();
+}
+
+void LockMgr::MultiUnLock(const std::vector<size_t>& slots) {
+  for (auto iter = slots.rbegin(); iter != slots.rend(); ++iter) {
+    UnLockSlot(*iter);
+  }
+}
 
-  stripe->stripe_mutex->Lock();
-  UnLockKey(key, stripe);
-  stripe->stripe_mutex->UnLock();
+void LockMgr::EnableStats(bool enable) {
+  stats_enabled_.store(enable, std::memory_order_relaxed);
+}
 
-  // Signal waiting threads to retry locking
-  stripe->stripe_cv->NotifyAll();
+void LockMgr::GetStats(LockStats* stats) {
+  stats->acquisitions = 0;
+  stats->waits = 0;
+  stats->total_wait_micros = 0;
+  stats->max_wait_micros = 0;
+  stats->hot_stripes.clear();
+  for (size_t idx = 0; idx <= slot_mask_; ++idx) {
+    const Slot& slot = slots_[idx];
+    LockStripeStats slot_stats = {
+      idx, slot.waits.load(std::memory_order_relaxed),
+      slot.wait_micros.load(std::memory_order_relaxed),
+      slot.max_wait_micros.load(std::memory_order_relaxed)};
+    stats->acquisitions += slot.acquisitions.load(std::memory_order_relaxed);
+    stats->waits += slot_stats.waits;
+    stats->total_wait_micros += slot_stats.wait_micros;
+    stats->max_wait_micros = std::max(stats->max_wait_micros,
+                                      slot_stats.max_wait_micros);
+    if (slot_stats.waits > 0) {
+      stats->hot_stripes.push_back(slot_stats);
+    }
+  }
+  std::sort(stats->hot_stripes.begin(), stats->hot_stripes.end(),
+            [](const LockStripeStats& a, const LockStripeStats& b) {
+              return a.wait_micros > b.wait_micros;
+            });
+  if (stats->hot_stripes.size() > LOCK_STATS_TOP_K) {
+    stats->hot_stripes.resize(LOCK_STATS_TOP_K);
+  }
+  contended_keys_->Top(LOCK_STATS_TOP_K, &stats->hot_keys);
+}
+
+void LockMgr::ResetStats() {
+  for (size_t idx = 0; idx <= slot_mask_; ++idx) {
+    slots_[idx].acquisitions.store(0, std::memory_order_relaxed);
+    slots_[idx].waits.store(0, std::memory_order_relaxed);
+    slots_[idx].wait_micros.store(0, std::memory_order_relaxed);
+    slots_[idx].max_wait_micros.store(0, std::memory_order_relaxed);
+  }
+  contended_keys_->Clear();
 }
 }  //  namespace blackwidow
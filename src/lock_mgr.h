@@ -6,48 +6,133 @@
 #ifndef SRC_LOCK_MGR_H_
 #define SRC_LOCK_MGR_H_
 
+#include <stdint.h>
 #include <string>
+#include <vector>
 #include <memory>
+#include <atomic>
+
+#include "rocksdb/slice.h"
+#include "rocksdb/status.h"
 
 #include "src/mutex.h"
+#include "blackwidow/blackwidow.h"
 
 namespace blackwidow {
 
-struct LockMap;
-struct LockMapStripe;
-
+using Slice = rocksdb::Slice;
+using Status = rocksdb::Status;
+
+struct ContendedKeys;
+
+// Record locks on a fixed table of slots, a key locks the slot its hash
+// maps to, so locking allocates nothing and keys sharing a slot are
+// simply locked together. A waiter first spins for about as long as the
+// recent waits of the slot took, then parks on the wait queue of the
+// slot, which an unlock only signals when someone is parked there.
+//
+// Waits are unbounded unless a deadline is given, commands take theirs
+// from the LockDeadline scope of the calling thread.
+//
+// Slots are shared by unrelated keys: a key whose slot is held by a
+// command on any other key waits as if that key were its own. With n
+// keys locked at once, a lock waits needlessly with a probability of
+// about n / num_slots, so the hot stripes of the lock stats may report
+// waits for keys that are never written concurrently. A slot takes
+// about 140 bytes.
+//
+// The slot of a key is not reentrant: a thread holding a key must not
+// lock another one of the same LockMgr, except all at once by MultiLock().
 class LockMgr {
  public:
+  // num_slots is rounded up to a power of two
+  explicit LockMgr(size_t num_slots);
+
+  // default_num_stripes is the number of slots. When max_num_locks is
+  // positive, at most that many slots are held at once and locking one
+  // more returns Status::Busy with SubCode::kLockLimit. The factory is
+  // not used, the slots wait on their own mutex and condition variable.
   LockMgr(size_t default_num_stripes, int64_t max_num_locks,
           std::shared_ptr<MutexFactory> factory);
 
   ~LockMgr();
 
-  // Attempt to lock key.  If OK status is returned, the caller is responsible
-  // for calling UnLock() on this key.
-  Status TryLock(const std::string& key);
-
-  // Unlock a key locked by TryLock().
-  void UnLock(const std::string& key);
+  static const uint64_t kNoDeadline = UINT64_MAX;
+
+  static uint64_t NowMicros();
+
+  // Deadline of the innermost LockDeadline scope of this thread, or
+  // kNoDeadline
+  static uint64_t ThreadDeadline();
+
+  // Whether s is returned for a key that could not be locked, in which
+  // case the command changed nothing
+  static bool IsLockFailure(const Status& s) {
+    return s.subcode() == Status::SubCode::kLockTimeout
+      || s.subcode() == Status::SubCode::kLockLimit;
+  }
+
+  size_t GetSlot(const Slice& key) const;
+
+  // Attempt to lock key, waiting for as long as another thread holds its
+  // slot. If OK status is returned, the caller is responsible for
+  // calling UnLock() on this key.
+  Status TryLock(const Slice& key) {
+    return LockSlot(GetSlot(key), key, kNoDeadline);
+  }
+
+  // Lock key, waiting for it until deadline_micros on the NowMicros()
+  // clock, see LockSlot()
+  Status Lock(const Slice& key, uint64_t deadline_micros = kNoDeadline) {
+    return LockSlot(GetSlot(key), key, deadline_micros);
+  }
+
+  // Lock key, Status::TimedOut after waiting timeout_micros for it, or
+  // Status::Busy right away if timeout_micros is 0 and its slot is held
+  Status TryLockFor(const Slice& key, uint64_t timeout_micros);
+
+  // Unlock a key locked by TryLock(), Lock() or TryLockFor().
+  void UnLock(const Slice& key) {
+    UnLockSlot(GetSlot(key));
+  }
+
+  // Lock slot, waiting for it until deadline_micros on the NowMicros()
+  // clock: Status::Busy if the slot is held and the deadline already
+  // passed, Status::TimedOut if the deadline passed while waiting.
+  // key is only used by the lock stats.
+  Status LockSlot(size_t slot, const Slice& key, uint64_t deadline_micros);
+  void UnLockSlot(size_t slot);
+
+  // Lock the slots of all the keys in increasing order, each one once,
+  // the locked slots are returned for MultiUnLock(). Nothing is left
+  // locked when a slot can not be locked before deadline_micros.
+  Status MultiLock(const std::vector<std::string>& keys,
+                   uint64_t deadline_micros, std::vector<size_t>* slots);
+  void MultiUnLock(const std::vector<size_t>& slots);
+
+  // Track the waits for keys locked by another thread, off by default.
+  // Waits are counted per slot, the keys waited for are sampled.
+  void EnableStats(bool enable);
+  void GetStats(LockStats* stats);
+  void ResetStats();
 
  private:
-  // Default number of lock map stripes
-  const size_t default_num_stripes_;
+  struct Slot;
 
-  // Limit on number of keys locked per column family
-  const int64_t max_num_locks_;
-
-  // Used to allocate mutexes/condvars to use when locking keys
-  std::shared_ptr<MutexFactory> mutex_factory_;
+  Status Wait(Slot* slot, const Slice& key, uint64_t deadline_micros);
 
-  // Map to locked key info
-  std::shared_ptr<LockMap> lock_map_;
+  const size_t slot_mask_;
+  Slot* slots_;
 
-  Status Acquire(LockMapStripe* stripe, const std::string& key);
+  // Limit on the number of slots locked at once, 0 for no limit
+  const int64_t max_num_locks_;
+  // Count of the locked slots, only maintained with a limit
+  std::atomic<int64_t> lock_cnt_;
 
-  Status AcquireLocked(LockMapStripe* stripe, const std::string& key);
+  std::atomic<bool> stats_enabled_;
 
-  void UnLockKey(const std::string& key, LockMapStripe* stripe);
+  // Most waited keys among the sampled waits
+  std::shared_ptr<ContendedKeys> contended_keys_;
 
   // No copying allowed
   LockMgr(const LockMgr&);
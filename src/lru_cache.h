@@ -53,19 +53,17 @@ size_t HandleTable<T1, T2>::TableSize() {
 
 template <typename T1, typename T2>
 LRUHandle<T1, T2>* HandleTable<T1, T2>::Lookup(const T1& key) {
-  if (table_.find(key) != table_.end()) {
-    return table_[key];
-  } else {
-    return NULL;
-  }
+  auto iter = table_.find(key);
+  return iter != table_.end() ? iter->second : NULL;
 }
 
 template <typename T1, typename T2>
 LRUHandle<T1, T2>* HandleTable<T1, T2>::Remove(const T1& key) {
   LRUHandle<T1, T2>* old = NULL;
-  if (table_.find(key) != table_.end()) {
-    old = table_[key];
-    table_.erase(key);
+  auto iter = table_.find(key);
+  if (iter != table_.end()) {
+    old = iter->second;
+    table_.erase(iter);
   }
   return old;
 }
@@ -74,11 +72,11 @@ template <typename T1, typename T2>
 LRUHandle<T1, T2>* HandleTable<T1, T2>::Insert(const T1& key,
                                                LRUHandle<T1, T2>* const handle) {
   LRUHandle<T1, T2>* old = NULL;
-  if (table_.find(key) != table_.end()) {
-    old = table_[key];
-    table_.erase(key);
+  auto result = table_.insert({key, handle});
+  if (!result.second) {
+    old = result.first->second;
+    result.first->second = handle;
   }
-  table_.insert({key, handle});
   return old;
 }
 
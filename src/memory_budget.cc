@@ -0,0 +1,94 @@
+//  Copyright (c) 2017-present, Qihoo, Inc.  All rights reserved.
+//  This source code is licensed under the BSD-style license found in the
+//  LICENSE file in the root directory of this source tree. An additional grant
+//  of patent rights can be found in the PATENTS file in the same directory.
+
+#include "src/memory_budget.h"
+
+#include <algorithm>
+
+namespace blackwidow {
+
+static const DataType kBudgetTypes[] = {
+  kStrings, kHashes, kLists, kZSets, kSets
+};
+
+MemoryBudget::MemoryBudget(size_t budget, double write_buffer_ratio,
+                           const std::map<DataType, double>& weights)
+    : write_buffer_budget_(static_cast<size_t>(budget * write_buffer_ratio)) {
+  block_cache_ = rocksdb::NewLRUCache(budget);
+  for (auto type : kBudgetTypes) {
+    write_buffer_managers_[type] =
+      std::make_shared<rocksdb::WriteBufferManager>(1, block_cache_);
+  }
+  ResizeWriteBuffers(weights);
+}
+
+void MemoryBudget::Apply(const DataType& type,
+                         BlackwidowOptions* bw_options) const {
+  bw_options->table_options.block_cache = block_cache_;
+  bw_options->share_block_cache = true;
+  bw_options->options.write_buffer_manager = write_buffer_managers_.at(type);
+}
+
+Status MemoryBudget::CheckWeights(const std::map<DataType, double>& weights) {
+  for (const auto& weight : weights) {
+    if (weight.first == kAll) {
+      return Status::InvalidArgument("memory budget weight of all types");
+    }
+    // A WriteBufferManager of size 0 would not limit the memtables
+    if (!(weight.second > 0)) {
+      return Status::InvalidArgument("memory budget weight not positive");
+    }
+  }
+  return Status::OK();
+}
+
+Status MemoryBudget::CheckWriteBufferRatio(double write_buffer_ratio) {
+  // Memtables limited to 0 bytes would not be limited at all, and more
+  // than the budget would leave the block cache nothing
+  if (!(write_buffer_ratio > 0 && write_buffer_ratio <= 1)) {
+    return Status::InvalidArgument("memory budget write buffer ratio");
+  }
+  return Status::OK();
+}
+
+Status MemoryBudget::SetWeights(const std::map<DataType, double>& weights) {
+  Status s = CheckWeights(weights);
+  if (!s.ok()) {
+    return s;
+  }
+  slash::MutexLock l(&mutex_);
+  ResizeWriteBuffers(weights);
+  return Status::OK();
+}
+
+void MemoryBudget::ResizeWriteBuffers(
+    const std::map<DataType, double>& weights) {
+  std::map<DataType, double> type_weights;
+  double total_weight = 0;
+  for (auto type : kBudgetTypes) {
+    auto iter = weights.find(type);
+    type_weights[type] = iter != weights.end() ? iter->second : 1;
+    total_weight += type_weights[type];
+  }
+  for (auto type : kBudgetTypes) {
+    size_t size = static_cast<size_t>(
+        write_buffer_budget_ * type_weights[type] / total_weight);
+    write_buffer_managers_[type]->SetBufferSize(std::max<size_t>(size, 1));
+  }
+}
+
+uint64_t MemoryBudget::GetWriteBufferUsage(const DataType& type) const {
+  auto iter = write_buffer_managers_.find(type);
+  return iter != write_buffer_managers_.end()
+    ? iter->second->memory_usage() : 0;
+}
+
+uint64_t MemoryBudget::GetWriteBufferLimit(const DataType& type) const {
+  auto iter = write_buffer_managers_.find(type);
+  return iter != write_buffer_managers_.end()
+    ? iter->second->buffer_size() : 0;
+}
+
+}  //  namespace blackwidow
@@ -0,0 +1,69 @@
+//  Copyright (c) 2017-present, Qihoo, Inc.  All rights reserved.
+//  This source code is licensed under the BSD-style license found in the
+//  LICENSE file in the root directory of this source tree. An additional grant
+//  of patent rights can be found in the PATENTS file in the same directory.
+
+#ifndef SRC_MEMORY_BUDGET_H_
+#define SRC_MEMORY_BUDGET_H_
+
+#include <stdint.h>
+#include <map>
+#include <memory>
+#include <string>
+
+#include "rocksdb/cache.h"
+#include "rocksdb/status.h"
+#include "rocksdb/write_buffer_manager.h"
+
+#include "slash/include/slash_mutex.h"
+#include "blackwidow/blackwidow.h"
+
+namespace blackwidow {
+
+using Status = rocksdb::Status;
+
+// One memory budget for the memtables and the block cache of the five
+// databases.
+//
+// All the column families read through one block cache of the budget.
+// The memtables of every data type are limited by a WriteBufferManager
+// of its own, which flushes them once they reach the share of the type,
+// and which charges them to the block cache, so the memtables and the
+// cached blocks together stay within the budget. The memtable part of
+// the budget is split across the types by their weights.
+class MemoryBudget {
+ public:
+  MemoryBudget(size_t budget, double write_buffer_ratio,
+               const std::map<DataType, double>& weights);
+
+  // Points the options of the type at the block cache and at the
+  // WriteBufferManager of the type
+  void Apply(const DataType& type, BlackwidowOptions* bw_options) const;
+
+  // A missing type weighs 1, the shares of the types change at once
+  Status SetWeights(const std::map<DataType, double>& weights);
+  static Status CheckWeights(const std::map<DataType, double>& weights);
+  // The memtables may fill a part in (0, 1] of the budget
+  static Status CheckWriteBufferRatio(double write_buffer_ratio);
+
+  // Memtable bytes of the type and the share they are flushed at
+  uint64_t GetWriteBufferUsage(const DataType& type) const;
+  uint64_t GetWriteBufferLimit(const DataType& type) const;
+
+ private:
+  size_t write_buffer_budget_;
+  std::shared_ptr<rocksdb::Cache> block_cache_;
+  std::map<DataType, std::shared_ptr<rocksdb::WriteBufferManager>>
+    write_buffer_managers_;
+
+  slash::Mutex mutex_;
+
+  void ResizeWriteBuffers(const std::map<DataType, double>& weights);
+
+  // No copying allowed
+  MemoryBudget(const MemoryBudget&);
+  void operator=(const MemoryBudget&);
+};
+
+}  //  namespace blackwidow
+#endif  // SRC_MEMORY_BUDGET_H_
@@ -5,16 +5,29 @@
 
 #include "src/redis.h"
 
+#include <algorithm>
+#include <map>
+
+#include "blackwidow/util.h"
+#include "src/base_meta_value_format.h"
+#include "src/table_properties_collector.h"
+
 namespace blackwidow {
 
 Redis::Redis(BlackWidow* const bw, const DataType& type)
     : bw_(bw),
       type_(type),
-      lock_mgr_(new LockMgr(1000, 0, std::make_shared<MutexFactoryImpl>())),
+      lock_mgr_(nullptr),
       db_(nullptr),
-      small_compaction_threshold_(5000) {
-  statistics_store_ = new LRUCache<std::string, size_t>();
-  scan_cursors_store_ = new LRUCache<std::string, std::string>();
+      small_compaction_threshold_(5000),
+      combine_writes_(false),
+      garbage_compaction_ratio_(0),
+      expired_reclaimed_bytes_(0) {
+  // Statistics only need to keep the frequently updated keys, hits
+  // do not relink the list with the CLOCK policy
+  statistics_store_ = new ShardedLRUCache<std::string, size_t>(
+      4, CacheEvictionPolicy::kClock);
+  scan_cursors_store_ = new ShardedLRUCache<std::string, std::string>();
   scan_cursors_store_->SetCapacity(5000);
   default_compact_range_options_.exclusive_manual_compaction = false;
   default_compact_range_options_.change_level = true;
@@ -22,6 +35,9 @@ Redis::Redis(BlackWidow* const bw, const DataType& type)
 }
 
 Redis::~Redis() {
+  for (auto pool : iterator_pools_) {
+    delete pool;
+  }
   std::vector<rocksdb::ColumnFamilyHandle*> tmp_handles = handles_;
   handles_.clear();
   for (auto handle : tmp_handles) {
@@ -33,6 +49,97 @@ Redis::~Redis() {
   delete scan_cursors_store_;
 }
 
+Status Redis::GetMetaKeyRanges(size_t max_ranges,
+                               std::vector<KeyRange>* ranges) {
+  ranges->clear();
+  std::vector<rocksdb::LiveFileMetaData> metadata;
+  if (max_ranges > 1) {
+    db_->GetLiveFilesMetaData(&metadata);
+  }
+
+  uint64_t total_size = 0;
+  std::vector<std::pair<std::string, uint64_t>> files;
+  for (const auto& file : metadata) {
+    if (file.column_family_name == rocksdb::kDefaultColumnFamilyName) {
+      files.push_back({file.smallestkey, file.size});
+      total_size += file.size;
+    }
+  }
+  std::sort(files.begin(), files.end());
+
+  // The SSTs of different levels overlap, so the ranges are only about
+  // the same size
+  std::string start;
+  uint64_t scanned_size = 0;
+  size_t next_cut = 1;
+  for (const auto& file : files) {
+    if (next_cut < max_ranges
+      && scanned_size >= total_size / max_ranges * next_cut
+      && file.first > start) {
+      ranges->push_back(KeyRange(start, file.first));
+      start = file.first;
+      while (next_cut < max_ranges
+        && scanned_size >= total_size / max_ranges * next_cut) {
+        next_cut++;
+      }
+    }
+    scanned_size += file.second;
+  }
+  ranges->push_back(KeyRange(start, ""));
+  return Status::OK();
+}
+
+Status Redis::GetKeyNumApprox(KeyInfo* key_info) {
+  rocksdb::ColumnFamilyHandle* handle = handles_.empty()
+    ? db_->DefaultColumnFamily() : handles_[0];
+  rocksdb::TablePropertiesCollection props;
+  Status s = db_->GetPropertiesOfAllTables(handle, &props);
+  if (!s.ok()) {
+    return s;
+  }
+
+  int64_t unix_time = CoarseClock::Now();
+  int32_t cur_time = static_cast<int32_t>(unix_time);
+
+  uint64_t keys = 0, expires = 0, ttl_sum = 0;
+  uint64_t stale_keys = 0, deletions = 0;
+  for (const auto& file : props) {
+    KeyNumProperties key_num;
+    if (!ParseKeyNumProperties(file.second->user_collected_properties,
+                               &key_num)) {
+      continue;
+    }
+    uint64_t expired = key_num.ExpiredSince(cur_time);
+    keys += key_num.live_keys - expired;
+    expires += key_num.expire_count - expired;
+    ttl_sum += key_num.TTLSum(cur_time);
+    stale_keys += key_num.stale_keys + expired;
+    deletions += key_num.deletions;
+  }
+
+  // The records of the memtables are taken as live keys
+  const char* mem_properties[] = {"rocksdb.num-entries-active-mem-table",
+                                  "rocksdb.num-entries-imm-mem-tables",
+                                  "rocksdb.num-deletes-active-mem-table",
+                                  "rocksdb.num-deletes-imm-mem-tables"};
+  uint64_t mem_counts[4] = {0, 0, 0, 0};
+  for (size_t idx = 0; idx < 4; ++idx) {
+    db_->GetIntProperty(handle, mem_properties[idx], &mem_counts[idx]);
+  }
+  uint64_t mem_entries = mem_counts[0] + mem_counts[1];
+  uint64_t mem_deletes = mem_counts[2] + mem_counts[3];
+  keys += mem_entries > mem_deletes ? mem_entries - mem_deletes : 0;
+  deletions += mem_deletes;
+
+  // Every deletion hides a key of an older SST, an overwritten key is
+  // counted once per SST holding it
+  key_info->keys = keys > deletions ? keys - deletions : 0;
+  key_info->expires = std::min(expires, key_info->keys);
+  key_info->avg_ttl = expires != 0 ? ttl_sum / expires : 0;
+  key_info->invaild_keys = stale_keys;
+  return Status::OK();
+}
+
 Status Redis::GetScanStartPoint(const Slice& key,
                                 const Slice& pattern,
                                 int64_t cursor,
@@ -61,6 +168,103 @@ Status Redis::SetSmallCompactionThreshold(size_t small_compaction_threshold) {
   return Status::OK();
 }
 
+// Sweep when the data keys read are at least one out of
+// kSweepDensity elements, a MultiGet seeks every one of them
+static const size_t kSweepDensity = 4;
+static const size_t kMinSweepKeys = 8;
+// Entries stepped over at most before seeking to the next data key
+static const int kMaxSweepSteps = 8;
+
+void Redis::MultiGetData(const rocksdb::ReadOptions& read_options,
+                         int32_t count,
+                         const std::vector<std::string>& data_keys,
+                         std::vector<Status>* statuses,
+                         std::vector<std::string>* values) {
+  statuses->clear();
+  values->clear();
+  if (data_keys.empty()) {
+    return;
+  }
+  if (data_keys.size() < kMinSweepKeys
+    || static_cast<size_t>(count) > kSweepDensity * data_keys.size()) {
+    std::vector<Slice> keys(data_keys.begin(), data_keys.end());
+    std::vector<rocksdb::ColumnFamilyHandle*> column_families(keys.size(),
+                                                              handles_[1]);
+    *statuses = db_->MultiGet(read_options, column_families, keys, values);
+    return;
+  }
+
+  statuses->assign(data_keys.size(), Status::NotFound());
+  values->assign(data_keys.size(), std::string());
+  std::vector<size_t> order(data_keys.size());
+  for (size_t idx = 0; idx < order.size(); ++idx) {
+    order[idx] = idx;
+  }
+  std::sort(order.begin(), order.end(), [&data_keys](size_t a, size_t b) {
+    return data_keys[a] < data_keys[b];
+  });
+
+  rocksdb::Iterator* iter = db_->NewIterator(read_options, handles_[1]);
+  iter->Seek(data_keys[order[0]]);
+  for (auto idx : order) {
+    const std::string& data_key = data_keys[idx];
+    for (int step = 0;
+         iter->Valid() && iter->key().compare(data_key) < 0; ++step) {
+      if (step == kMaxSweepSteps) {
+        iter->Seek(data_key);
+        break;
+      }
+      iter->Next();
+    }
+    if (iter->Valid() && iter->key() == data_key) {
+      (*statuses)[idx] = Status::OK();
+      (*values)[idx] = iter->value().ToString();
+    }
+  }
+  Status s = iter->status();
+  delete iter;
+  if (!s.ok()) {
+    statuses->assign(data_keys.size(), s);
+  }
+}
+
+void Redis::SetWriteCombining(bool enable) {
+  combine_writes_.store(enable, std::memory_order_relaxed);
+}
+
+void Redis::CreateIteratorPools(size_t capacity) {
+  if (capacity == 0 || !iterator_pools_.empty()) {
+    return;
+  }
+  iterator_pools_.push_back(nullptr);
+  for (size_t idx = 1; idx < handles_.size(); ++idx) {
+    iterator_pools_.push_back(new IteratorPool(db_, handles_[idx], capacity));
+  }
+}
+
+Status Redis::GetMetaForWrite(const Slice& key, std::string* meta_value,
+                              bool* reset) {
+  *reset = false;
+  Status s = db_->Get(default_read_options_, handles_[0], key, meta_value);
+  if (s.IsNotFound()) {
+    char str[4];
+    EncodeFixed32(str, 0);
+    BaseMetaValue base_meta_value(Slice(str, sizeof(int32_t)));
+    base_meta_value.UpdateVersion();
+    *meta_value = base_meta_value.Encode().ToString();
+    *reset = true;
+    return Status::OK();
+  } else if (!s.ok()) {
+    return s;
+  }
+  ParsedBaseMetaValue parsed_meta_value(meta_value);
+  if (parsed_meta_value.IsStale() || parsed_meta_value.count() == 0) {
+    parsed_meta_value.InitialMetaValue();
+    *reset = true;
+  }
+  return Status::OK();
+}
+
 Status Redis::UpdateSpecificKeyStatistics(const std::string& key,
                                           size_t count) {
   if (statistics_store_->Capacity() && count) {
@@ -83,6 +287,193 @@ Status Redis::AddCompactKeyTaskIfNeeded(const std::string& key,
   return Status::OK();
 }
 
+struct PickedFile {
+  rocksdb::ColumnFamilyHandle* handle;
+  std::string smallest_key;
+  std::string largest_key;
+  double score;
+};
+
+// Data keys start with the length of their key, so the data of the meta
+// keys in [smallest, largest] lies in one range per key length
+static Status DataRangesOf(rocksdb::DB* db, rocksdb::ColumnFamilyHandle* meta,
+                           const std::string& smallest,
+                           const std::string& largest,
+                           std::vector<std::pair<std::string,
+                                                 std::string>>* ranges) {
+  std::map<size_t, std::pair<std::string, std::string>> keys_by_size;
+  rocksdb::ReadOptions read_options;
+  read_options.fill_cache = false;
+  std::unique_ptr<rocksdb::Iterator> iter(db->NewIterator(read_options, meta));
+  for (iter->Seek(smallest);
+       iter->Valid() && iter->key().compare(largest) <= 0; iter->Next()) {
+    std::string key = iter->key().ToString();
+    auto bounds = keys_by_size.find(key.size());
+    if (bounds == keys_by_size.end()) {
+      keys_by_size[key.size()] = {key, key};
+    } else {
+      bounds->second.second = key;
+    }
+  }
+  for (const auto& bounds : keys_by_size) {
+    std::string start_key, end_key, unused;
+    CalculateDataStartAndEndKey(bounds.second.first, &start_key, &unused);
+    CalculateDataStartAndEndKey(bounds.second.second, &unused, &end_key);
+    ranges->push_back({start_key, end_key});
+  }
+  return iter->status();
+}
+
+// Compacts [begin, end] of handle, the bytes reclaimed are estimated by
+// the approximate size of the range before and after, writes into it
+// meanwhile make the estimate lower
+Status Redis::CompactMeasuredRange(rocksdb::ColumnFamilyHandle* handle,
+                                   const Slice& begin, const Slice& end,
+                                   uint64_t* reclaimed_bytes) {
+  rocksdb::Range range(begin, end);
+  uint64_t before = 0, after = 0;
+  db_->GetApproximateSizes(handle, &range, 1, &before);
+  Status s = db_->CompactRange(default_compact_range_options_,
+                               handle, &begin, &end);
+  if (!s.ok()) {
+    return s;
+  }
+  db_->GetApproximateSizes(handle, &range, 1, &after);
+  if (before > after) {
+    *reclaimed_bytes += before - after;
+  }
+  return Status::OK();
+}
+
+Status Redis::CompactPickedFiles(const FilePicker& picker, size_t max_files,
+                                 size_t* compacted_files,
+                                 uint64_t* reclaimed_bytes) {
+  *compacted_files = 0;
+  *reclaimed_bytes = 0;
+  if (max_files == 0) {
+    return Status::OK();
+  }
+
+  std::vector<rocksdb::ColumnFamilyHandle*> handles = handles_;
+  if (handles.empty()) {
+    handles.push_back(db_->DefaultColumnFamily());
+  }
+
+  std::vector<PickedFile> candidates;
+  for (const auto& handle : handles) {
+    rocksdb::TablePropertiesCollection props;
+    Status s = db_->GetPropertiesOfAllTables(handle, &props);
+    if (!s.ok()) {
+      return s;
+    }
+
+    // Table properties are keyed by the full path of the file,
+    // meta data by its name
+    rocksdb::ColumnFamilyMetaData cf_meta;
+    db_->GetColumnFamilyMetaData(handle, &cf_meta);
+    for (const auto& level : cf_meta.levels) {
+      for (const auto& file : level.files) {
+        if (file.being_compacted) {
+          continue;
+        }
+        auto iter = props.find(file.db_path + file.name);
+        if (iter == props.end()) {
+          continue;
+        }
+        double score = picker(iter->second->user_collected_properties);
+        if (score <= 0) {
+          continue;
+        }
+        candidates.push_back({handle, file.smallestkey,
+                              file.largestkey, score});
+      }
+    }
+  }
+
+  std::sort(candidates.begin(), candidates.end(),
+            [](const PickedFile& a, const PickedFile& b) {
+              return a.score > b.score;
+            });
+  if (candidates.size() > max_files) {
+    candidates.resize(max_files);
+  }
+  for (const auto& candidate : candidates) {
+    // The data of the keys of a meta file is garbage once their meta
+    // values are dropped, and compacted right after them
+    std::vector<std::pair<std::string, std::string>> data_ranges;
+    if (handles_.size() > 1 && candidate.handle == handles_[0]) {
+      Status s = DataRangesOf(db_, handles_[0], candidate.smallest_key,
+                              candidate.largest_key, &data_ranges);
+      if (!s.ok()) {
+        return s;
+      }
+    }
+    Status s = CompactMeasuredRange(candidate.handle, candidate.smallest_key,
+                                    candidate.largest_key, reclaimed_bytes);
+    if (!s.ok()) {
+      return s;
+    }
+    for (size_t idx = 1; idx < handles_.size(); ++idx) {
+      for (const auto& range : data_ranges) {
+        s = CompactMeasuredRange(handles_[idx], range.first, range.second,
+                                 reclaimed_bytes);
+        if (!s.ok()) {
+          return s;
+        }
+      }
+    }
+    (*compacted_files)++;
+  }
+  return Status::OK();
+}
+
+Status Redis::CompactGarbageFiles(size_t max_files, size_t* compacted_files) {
+  double garbage_ratio = garbage_compaction_ratio_;
+  if (garbage_ratio <= 0) {
+    *compacted_files = 0;
+    return Status::OK();
+  }
+  uint64_t reclaimed_bytes = 0;
+  return CompactPickedFiles(
+      [garbage_ratio](const rocksdb::UserCollectedProperties& props) {
+        GarbageProperties garbage;
+        if (!ParseGarbageProperties(props, &garbage)
+          || garbage.entries < kGarbageMinEntries
+          || garbage.ratio() < garbage_ratio) {
+          return 0.0;
+        }
+        return garbage.ratio();
+      }, max_files, compacted_files, &reclaimed_bytes);
+}
+
+Status Redis::CompactExpiredFiles(size_t max_files, size_t* compacted_files) {
+  double garbage_ratio = garbage_compaction_ratio_;
+  if (garbage_ratio <= 0) {
+    *compacted_files = 0;
+    return Status::OK();
+  }
+  int64_t unix_time = CoarseClock::Now();
+  int32_t cur_time = static_cast<int32_t>(unix_time);
+
+  uint64_t reclaimed_bytes = 0;
+  Status s = CompactPickedFiles(
+      [garbage_ratio, cur_time](const rocksdb::UserCollectedProperties& props) {
+        ExpireProperties expire;
+        if (!ParseExpireProperties(props, &expire)
+          || expire.entries < kGarbageMinEntries
+          || expire.ExpiredRatio(cur_time) < garbage_ratio) {
+          return 0.0;
+        }
+        return expire.ExpiredRatio(cur_time);
+      }, max_files, compacted_files, &reclaimed_bytes);
+  expired_reclaimed_bytes_ += reclaimed_bytes;
+  return s;
+}
+
+uint64_t Redis::GetExpiredReclaimedBytes() {
+  return expired_reclaimed_bytes_;
+}
+
 Status Redis::SetOptions(const OptionType& option_type,
     const std::unordered_map<std::string, std::string>& options) {
   if (option_type == OptionType::kDB) {
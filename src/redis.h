@@ -7,15 +7,23 @@
 #define SRC_REDIS_H_
 
 #include <string>
+#include <atomic>
 #include <memory>
+#include <algorithm>
 #include <vector>
+#include <functional>
 
 #include "rocksdb/db.h"
 #include "rocksdb/status.h"
 #include "rocksdb/slice.h"
+#include "rocksdb/table_properties.h"
 
 #include "src/lock_mgr.h"
+#include "src/iterator_pool.h"
+#include "src/scan_policy.h"
+#include "src/glob_pattern.h"
 #include "src/lru_cache.h"
+#include "src/sharded_lru_cache.h"
 #include "src/mutex_impl.h"
 #include "blackwidow/blackwidow.h"
 
@@ -23,6 +31,30 @@ namespace blackwidow {
 using Status = rocksdb::Status;
 using Slice = rocksdb::Slice;
 
+// Meta keys in [start, end) scanned by one task of a parallel scan, an
+// empty start or end leaves that side unbounded
+struct KeyRange {
+  std::string start;
+  std::string end;
+
+  KeyRange() {}
+  KeyRange(const std::string& range_start, const std::string& range_end)
+      : start(range_start), end(range_end) {}
+
+  KeyRange Intersect(const std::string& other_start,
+                     const std::string& other_end) const {
+    KeyRange range(std::max(start, other_start), end);
+    if (range.end.empty() || (!other_end.empty() && other_end < range.end)) {
+      range.end = other_end;
+    }
+    return range;
+  }
+};
+
+// Called with every live key and its size, the value bytes for strings
+// and the number of elements for the other types
+typedef std::function<void(const Slice& key, uint64_t size)> KeySizeVisitor;
+
 class Redis {
  public:
   Redis(BlackWidow* const bw, const DataType& type);
@@ -32,6 +64,14 @@ class Redis {
     return db_;
   }
 
+  LockMgr* GetLockMgr() {
+    return lock_mgr_;
+  }
+
+  ScanPolicy* GetScanPolicy() {
+    return &scan_policy_;
+  }
+
   Status SetOptions(const OptionType& option_type, const std::unordered_map<std::string, std::string>& options);
 
   // Common Commands
@@ -41,10 +81,28 @@ class Redis {
                               const rocksdb::Slice* end,
                               const ColumnFamilyType& type = kMetaAndData) = 0;
   virtual Status GetProperty(const std::string& property, uint64_t* out) = 0;
-  virtual Status ScanKeyNum(KeyInfo* key_info) = 0;
+  virtual Status ScanKeyNum(const KeyRange& range,
+                            const std::atomic<bool>& stop,
+                            KeyInfo* key_info) = 0;
+  virtual Status ScanKeySizes(const std::atomic<bool>& stop,
+                              const KeySizeVisitor& visitor) = 0;
+  // Visits the live keys of range matching pattern in order, until
+  // visitor returns false
   virtual Status ScanKeys(const std::string& pattern,
-                          std::vector<std::string>* keys) = 0;
-  virtual Status PKPatternMatchDel(const std::string& pattern, int32_t* ret) = 0;
+                          const KeyRange& range,
+                          const ElementVisitor& visitor) = 0;
+  virtual Status PKPatternMatchDel(const std::string& pattern,
+                                   const KeyRange& range,
+                                   int32_t* ret) = 0;
+
+  // Estimate the key counts from the properties recorded for the SSTs
+  // of the meta column family by GarbagePropertiesCollector and the
+  // entries of the memtables, without reading any record
+  Status GetKeyNumApprox(KeyInfo* key_info);
+
+  // Splits the meta keys in at most max_ranges ranges holding about the
+  // same amount of SST data, cut at the smallest keys of the SSTs
+  Status GetMetaKeyRanges(size_t max_ranges, std::vector<KeyRange>* ranges);
 
   // Keys Commands
   virtual Status Expire(const Slice& key, int32_t ttl) = 0;
@@ -67,6 +125,24 @@ class Redis {
   Status SetMaxCacheStatisticKeys(size_t max_cache_statistic_keys);
   Status SetSmallCompactionThreshold(size_t small_compaction_threshold);
 
+  // Apply the concurrent writes to a key together, for the commands
+  // going through a WriteCombiner
+  void SetWriteCombining(bool enable);
+
+  // Keep up to capacity idle iterators over every data column family
+  // for the short range reads, only called before the db is used
+  void CreateIteratorPools(size_t capacity);
+
+  // Compact the key ranges of at most max_files SSTs whose garbage
+  // ratio recorded by GarbagePropertiesCollector is the highest, and
+  // the data of the keys of the meta SSTs among them
+  Status CompactGarbageFiles(size_t max_files, size_t* compacted_files);
+
+  // Same as CompactGarbageFiles, but pick the SSTs by the ratio of
+  // records expired by now according to their expire time range
+  Status CompactExpiredFiles(size_t max_files, size_t* compacted_files);
+  uint64_t GetExpiredReclaimedBytes();
+
  protected:
   BlackWidow* const bw_;
   DataType type_;
@@ -74,11 +150,17 @@ class Redis {
   rocksdb::DB* db_;
   std::vector<rocksdb::ColumnFamilyHandle*> handles_;
   rocksdb::WriteOptions default_write_options_;
+  // The single key reads take no snapshot. A data key is never written
+  // again under the version of an older meta value, so reading the meta
+  // value and then the data keys at a later sequence gives the elements
+  // of a state the key had since the meta read. Lists and the zset
+  // ranges by rank, whose indexes shift, and the commands reading several
+  // keys read at one sequence.
   rocksdb::ReadOptions default_read_options_;
   rocksdb::CompactRangeOptions default_compact_range_options_;
 
   // For Scan
-  LRUCache<std::string, std::string>* scan_cursors_store_;
+  ShardedLRUCache<std::string, std::string>* scan_cursors_store_;
 
   Status GetScanStartPoint(const Slice& key, const Slice& pattern,
                            int64_t cursor, std::string* start_point);
@@ -87,10 +169,50 @@ class Redis {
 
   // For Statistics
   std::atomic<size_t> small_compaction_threshold_;
-  LRUCache<std::string, size_t>* statistics_store_;
+  ShardedLRUCache<std::string, size_t>* statistics_store_;
 
   Status UpdateSpecificKeyStatistics(const std::string& key, size_t count);
+
+  // Reads at once the data keys of handles_[1] of a key holding count
+  // elements: a sweep stepping through the sorted data keys when they are
+  // a good part of the elements, one MultiGet otherwise. statuses and
+  // values are in the order of data_keys.
+  void MultiGetData(const rocksdb::ReadOptions& read_options, int32_t count,
+                    const std::vector<std::string>& data_keys,
+                    std::vector<Status>* statuses,
+                    std::vector<std::string>* values);
+
+  // Read options of the collection reads and keyspace scans
+  ScanPolicy scan_policy_;
+
+  // For iterator pooling, the pool of handles_[idx] or nullptr
+  std::vector<IteratorPool*> iterator_pools_;
+
+  IteratorPool* GetIteratorPool(size_t idx) {
+    return idx < iterator_pools_.size() ? iterator_pools_[idx] : nullptr;
+  }
+
+  // For write combining
+  std::atomic<bool> combine_writes_;
+
+  // Meta value of key to apply combined writes to, a missing, stale or
+  // empty one is replaced by a new version with no element and *reset
+  // is set. The record lock of key must be held.
+  Status GetMetaForWrite(const Slice& key, std::string* meta_value,
+                         bool* reset);
   Status AddCompactKeyTaskIfNeeded(const std::string& key, size_t total);
+
+  // For garbage compaction, a picker scores the table properties of a
+  // SST, files scoring 0 are skipped
+  typedef std::function<double(const rocksdb::UserCollectedProperties&)> FilePicker;
+  std::atomic<double> garbage_compaction_ratio_;
+  std::atomic<uint64_t> expired_reclaimed_bytes_;
+
+  Status CompactPickedFiles(const FilePicker& picker, size_t max_files,
+                            size_t* compacted_files, uint64_t* reclaimed_bytes);
+  Status CompactMeasuredRange(rocksdb::ColumnFamilyHandle* handle,
+                              const Slice& begin, const Slice& end,
+                              uint64_t* reclaimed_bytes);
 };
 
 }  //  namespace blackwidow
@@ -6,11 +6,15 @@
 #include "src/redis_hashes.h"
 
 #include <memory>
+#include <unordered_map>
 
 #include "blackwidow/util.h"
 #include "src/base_filter.h"
 #include "src/scope_record_lock.h"
+#include "src/instrumented_db.h"
 #include "src/scope_snapshot.h"
+#include "src/iterator_pool.h"
+#include "src/table_properties_collector.h"
 
 namespace blackwidow {
 
@@ -20,8 +24,10 @@ RedisHashes::RedisHashes(BlackWidow* const bw, const DataType& type)
 
 Status RedisHashes::Open(const BlackwidowOptions& bw_options,
                          const std::string& db_path) {
+  lock_mgr_ = new LockMgr(bw_options.lock_slots);
   statistics_store_->SetCapacity(bw_options.statistics_max_size);
   small_compaction_threshold_ = bw_options.small_compaction_threshold;
+  garbage_compaction_ratio_ = bw_options.garbage_compaction_ratio;
 
   rocksdb::Options ops(bw_options.options);
   Status s = rocksdb::DB::Open(ops, db_path, &db_);
@@ -46,6 +52,12 @@ Status RedisHashes::Open(const BlackwidowOptions& bw_options,
     std::make_shared<HashesMetaFilterFactory>();
   data_cf_ops.compaction_filter_factory =
     std::make_shared<HashesDataFilterFactory>(&db_, &handles_);
+  meta_cf_ops.table_properties_collector_factories.push_back(
+    std::make_shared<GarbagePropertiesCollectorFactory>(
+        RecordFormat::kBaseMetaValue, bw_options.garbage_compaction_ratio));
+  data_cf_ops.table_properties_collector_factories.push_back(
+    std::make_shared<GarbagePropertiesCollectorFactory>(
+        RecordFormat::kBaseDataKey, bw_options.garbage_compaction_ratio));
 
   // use the bloom filter policy to reduce disk reads
   rocksdb::BlockBasedTableOptions table_ops(bw_options.table_options);
@@ -70,7 +82,11 @@ Status RedisHashes::Open(const BlackwidowOptions& bw_options,
   // Data CF
   column_families.push_back(rocksdb::ColumnFamilyDescriptor(
       "data_cf", data_cf_ops));
-  return rocksdb::DB::Open(db_ops, db_path, column_families, &handles_, &db_);
+  s = rocksdb::DB::Open(db_ops, db_path, column_families, &handles_, &db_);
+  if (s.ok()) {
+    db_ = new InstrumentedDB(db_, true);
+  }
+  return s;
 }
 
 Status RedisHashes::CompactRange(const rocksdb::Slice* begin,
@@ -94,7 +110,9 @@ Status RedisHashes::GetProperty(const std::string& property, uint64_t* out) {
   return Status::OK();
 }
 
-Status RedisHashes::ScanKeyNum(KeyInfo* key_info) {
+Status RedisHashes::ScanKeyNum(const KeyRange& range,
+                               const std::atomic<bool>& stop,
+                               KeyInfo* key_info) {
   uint64_t keys = 0;
   uint64_t expires = 0;
   uint64_t ttl_sum = 0;
@@ -104,15 +122,21 @@ Status RedisHashes::ScanKeyNum(KeyInfo* key_info) {
   const rocksdb::Snapshot* snapshot;
   ScopeSnapshot ss(db_, &snapshot);
   iterator_options.snapshot = snapshot;
-  iterator_options.fill_cache = false;
+  scan_policy_.ForKeyspaceScan(&iterator_options);
+  rocksdb::Slice upper_bound(range.end);
+  if (!range.end.empty()) {
+    iterator_options.iterate_upper_bound = &upper_bound;
+  }
 
-  int64_t curtime;
-  rocksdb::Env::Default()->GetCurrentTime(&curtime);
+  int64_t curtime = CoarseClock::Now();
 
   rocksdb::Iterator* iter = db_->NewIterator(iterator_options, handles_[0]);
-  for (iter->SeekToFirst();
+  for (iter->Seek(range.start);
        iter->Valid();
        iter->Next()) {
+    if (stop.load(std::memory_order_relaxed)) {
+      break;
+    }
     ParsedHashesMetaValue parsed_hashes_meta_value(iter->value());
     if (parsed_hashes_meta_value.IsStale()
       || parsed_hashes_meta_value.count() == 0) {
@@ -134,26 +158,57 @@ Status RedisHashes::ScanKeyNum(KeyInfo* key_info) {
   return Status::OK();
 }
 
+Status RedisHashes::ScanKeySizes(const std::atomic<bool>& stop,
+                                 const KeySizeVisitor& visitor) {
+  rocksdb::ReadOptions iterator_options;
+  const rocksdb::Snapshot* snapshot;
+  ScopeSnapshot ss(db_, &snapshot);
+  iterator_options.snapshot = snapshot;
+  scan_policy_.ForKeyspaceScan(&iterator_options);
+
+  rocksdb::Iterator* iter = db_->NewIterator(iterator_options, handles_[0]);
+  for (iter->SeekToFirst();
+       iter->Valid() && !stop.load(std::memory_order_relaxed);
+       iter->Next()) {
+    ParsedHashesMetaValue parsed_hashes_meta_value(iter->value());
+    if (!parsed_hashes_meta_value.IsStale()
+      && parsed_hashes_meta_value.count() != 0) {
+      visitor(iter->key(), parsed_hashes_meta_value.count());
+    }
+  }
+  delete iter;
+  return Status::OK();
+}
+
 Status RedisHashes::ScanKeys(const std::string& pattern,
-                             std::vector<std::string>* keys) {
+                             const KeyRange& range,
+                             const ElementVisitor& visitor) {
   std::string key;
   rocksdb::ReadOptions iterator_options;
   const rocksdb::Snapshot* snapshot;
   ScopeSnapshot ss(db_, &snapshot);
   iterator_options.snapshot = snapshot;
-  iterator_options.fill_cache = false;
+  scan_policy_.ForKeyspaceScan(&iterator_options);
+
+  // Only the keys of range starting with the literal prefix of pattern
+  // can match
+  GlobPattern glob(pattern);
+  KeyRange scan_range = range.Intersect(glob.prefix(), glob.upper_bound());
+  rocksdb::Slice upper_bound(scan_range.end);
+  if (!scan_range.end.empty()) {
+    iterator_options.iterate_upper_bound = &upper_bound;
+  }
 
   rocksdb::Iterator* iter = db_->NewIterator(iterator_options, handles_[0]);
-  for (iter->SeekToFirst();
+  for (iter->Seek(scan_range.start);
        iter->Valid();
        iter->Next()) {
     ParsedHashesMetaValue parsed_hashes_meta_value(iter->value());
     if (!parsed_hashes_meta_value.IsStale()
       && parsed_hashes_meta_value.count() != 0) {
       key = iter->key().ToString();
-      if (StringMatch(pattern.data(),
-            pattern.size(), key.data(), key.size(), 0)) {
-        keys->push_back(key);
+      if (glob.Match(key) && !visitor(key)) {
+        break;
       }
     }
   }
@@ -162,12 +217,22 @@ Status RedisHashes::ScanKeys(const std::string& pattern,
 }
 
 Status RedisHashes::PKPatternMatchDel(const std::string& pattern,
+                                      const KeyRange& range,
                                       int32_t* ret) {
   rocksdb::ReadOptions iterator_options;
   const rocksdb::Snapshot* snapshot;
   ScopeSnapshot ss(db_, &snapshot);
   iterator_options.snapshot = snapshot;
-  iterator_options.fill_cache = false;
+  scan_policy_.ForKeyspaceScan(&iterator_options);
+
+  // Only the keys of range starting with the literal prefix of pattern
+  // can match
+  GlobPattern glob(pattern);
+  KeyRange scan_range = range.Intersect(glob.prefix(), glob.upper_bound());
+  rocksdb::Slice upper_bound(scan_range.end);
+  if (!scan_range.end.empty()) {
+    iterator_options.iterate_upper_bound = &upper_bound;
+  }
 
   std::string key;
   std::string meta_value;
@@ -175,14 +240,14 @@ Status RedisHashes::PKPatternMatchDel(const std::string& pattern,
   Status s;
   rocksdb::WriteBatch batch;
   rocksdb::Iterator* iter = db_->NewIterator(iterator_options, handles_[0]);
-  iter->SeekToFirst();
+  iter->Seek(scan_range.start);
   while (iter->Valid()) {
     key = iter->key().ToString();
     meta_value = iter->value().ToString();
     ParsedHashesMetaValue parsed_hashes_meta_value(&meta_value);
     if (!parsed_hashes_meta_value.IsStale()
       && parsed_hashes_meta_value.count()
-      && StringMatch(pattern.data(), pattern.size(), key.data(), key.size(), 0)) {
+      && glob.Match(key)) {
       parsed_hashes_meta_value.InitialMetaValue();
       batch.Put(handles_[0], key, meta_value);
     }
@@ -232,6 +297,9 @@ Status RedisHashes::HDel(const Slice& key,
   int32_t del_cnt = 0;
   int32_t version = 0;
   ScopeRecordLock l(lock_mgr_, key);
+  if (!l.status().ok()) {
+    return l.status();
+  }
   ScopeSnapshot ss(db_, &snapshot);
   read_options.snapshot = snapshot;
   Status s = db_->Get(read_options, handles_[0], key, &meta_value);
@@ -242,20 +310,23 @@ Status RedisHashes::HDel(const Slice& key,
       *ret = 0;
       return Status::OK();
     } else {
-      std::string data_value;
       version = parsed_hashes_meta_value.version();
+      std::vector<std::string> data_keys;
       for (const auto& field : filtered_fields) {
         HashesDataKey hashes_data_key(key, version, field);
-        s = db_->Get(read_options, handles_[1],
-                hashes_data_key.Encode(), &data_value);
-        if (s.ok()) {
+        data_keys.push_back(hashes_data_key.Encode().ToString());
+      }
+      std::vector<Status> statuses;
+      std::vector<std::string> data_values;
+      MultiGetData(read_options, parsed_hashes_meta_value.count(),
+                   data_keys, &statuses, &data_values);
+      for (size_t idx = 0; idx < data_keys.size(); ++idx) {
+        if (statuses[idx].ok()) {
           del_cnt++;
           statistic++;
-          batch.Delete(handles_[1], hashes_data_key.Encode());
-        } else if (s.IsNotFound()) {
-          continue;
-        } else {
-          return s;
+          batch.Delete(handles_[1], data_keys[idx]);
+        } else if (!statuses[idx].IsNotFound()) {
+          return statuses[idx];
         }
       }
       *ret = del_cnt;
@@ -283,9 +354,28 @@ Status RedisHashes::HGet(const Slice& key, const Slice& field,
   std::string meta_value;
   int32_t version = 0;
   rocksdb::ReadOptions read_options;
-  const rocksdb::Snapshot* snapshot;
-  ScopeSnapshot ss(db_, &snapshot);
-  read_options.snapshot = snapshot;
+  Status s = db_->Get(read_options, handles_[0], key, &meta_value);
+  if (s.ok()) {
+    ParsedHashesMetaValue parsed_hashes_meta_value(&meta_value);
+    if (parsed_hashes_meta_value.IsStale()) {
+      return Status::NotFound("Stale");
+    } else if (parsed_hashes_meta_value.count() == 0) {
+      return Status::NotFound();
+    } else {
+      version = parsed_hashes_meta_value.version();
+      HashesDataKey data_key(key, version, field);
+      s = db_->Get(read_options, handles_[1], data_key.Encode(), value);
+    }
+  }
+  return s;
+}
+
+Status RedisHashes::HGet(const Slice& key, const Slice& field,
+                         PinnableSlice* value) {
+  value->Reset();
+  std::string meta_value;
+  int32_t version = 0;
+  rocksdb::ReadOptions read_options;
   Status s = db_->Get(read_options, handles_[0], key, &meta_value);
   if (s.ok()) {
     ParsedHashesMetaValue parsed_hashes_meta_value(&meta_value);
@@ -304,13 +394,18 @@ Status RedisHashes::HGet(const Slice& key, const Slice& field,
 
 Status RedisHashes::HGetall(const Slice& key,
                             std::vector<FieldValue>* fvs) {
+  return HGetall(key, [fvs](const Slice& field, const Slice& value) {
+    fvs->push_back({field.ToString(), value.ToString()});
+    return true;
+  });
+}
+
+Status RedisHashes::HGetall(const Slice& key,
+                            const FieldValueVisitor& visitor) {
   rocksdb::ReadOptions read_options;
-  const rocksdb::Snapshot* snapshot;
 
   std::string meta_value;
   int32_t version = 0;
-  ScopeSnapshot ss(db_, &snapshot);
-  read_options.snapshot = snapshot;
   Status s = db_->Get(read_options, handles_[0], key, &meta_value);
   if (s.ok()) {
     ParsedHashesMetaValue parsed_hashes_meta_value(&meta_value);
@@ -324,19 +419,19 @@ Status RedisHashes::HGetall(const Slice& key,
       HashesDataKey hashes_data_next_key(key, version + 1, "");
       Slice prefix = hashes_data_key.Encode();
       Slice next_version_prefix_key = hashes_data_next_key.Encode();
-      rocksdb::Slice upper_bound(next_version_prefix_key);
-      read_options.iterate_upper_bound = &upper_bound;
-      read_options.fill_cache = false;
+      bool small = scan_policy_.ForCollection(
+          parsed_hashes_meta_value.count(), &read_options);
 
-      auto iter = db_->NewIterator(read_options, handles_[1]);
+      ScopeIterator iter(small ? GetIteratorPool(1) : nullptr, db_,
+                         handles_[1], read_options, next_version_prefix_key);
       for (iter->Seek(prefix);
            iter->Valid() && iter->key().starts_with(prefix);
            iter->Next()) {
         ParsedHashesDataKey parsed_hashes_data_key(iter->key());
-        fvs->push_back({parsed_hashes_data_key.field().ToString(),
-                iter->value().ToString()});
+        if (!visitor(parsed_hashes_data_key.field(), iter->value())) {
+          break;
+        }
       }
-      delete iter;
     }
   }
   return s;
@@ -345,8 +440,21 @@ Status RedisHashes::HGetall(const Slice& key,
 Status RedisHashes::HIncrby(const Slice& key, const Slice& field, int64_t value,
                             int64_t* ret) {
   *ret = 0;
+  if (combine_writes_.load(std::memory_order_relaxed)) {
+    HIncrbyCombiner::Request request(key, {field, value, 0});
+    Status s = hincrby_combiner_.Run(lock_mgr_, &request,
+        [this](const Slice& key, const HIncrbyCombiner::Requests& requests) {
+          ApplyHIncrbys(key, requests);
+        });
+    *ret = request.op.ret;
+    return s;
+  }
+
   rocksdb::WriteBatch batch;
   ScopeRecordLock l(lock_mgr_, key);
+  if (!l.status().ok()) {
+    return l.status();
+  }
 
   int32_t version = 0;
   uint32_t statistic = 0;
@@ -417,11 +525,92 @@ Status RedisHashes::HIncrby(const Slice& key, const Slice& field, int64_t value,
   return s;
 }
 
+// Same as the HIncrby of every request in turn, with one read of the
+// meta value and one write, a failed request does not fail the others
+void RedisHashes::ApplyHIncrbys(const Slice& key,
+                                const HIncrbyCombiner::Requests& requests) {
+  std::string meta_value;
+  bool reset = false;
+  Status s = GetMetaForWrite(key, &meta_value, &reset);
+  if (!s.ok()) {
+    for (auto request : requests) {
+      request->status = s;
+    }
+    return;
+  }
+  ParsedHashesMetaValue parsed_hashes_meta_value(&meta_value);
+  int32_t version = parsed_hashes_meta_value.version();
+
+  rocksdb::WriteBatch batch;
+  int32_t added = 0;
+  uint32_t statistic = 0;
+  std::string old_value;
+  // Fields incremented by the previous requests
+  std::unordered_map<std::string, int64_t> values;
+  for (auto request : requests) {
+    HIncrbyOp& op = request->op;
+    HashesDataKey hashes_data_key(key, version, op.field);
+    std::string field = op.field.ToString();
+    int64_t ival = 0;
+    bool exists = false;
+    auto iter = values.find(field);
+    if (iter != values.end()) {
+      ival = iter->second;
+      exists = true;
+    } else if (!reset) {
+      s = db_->Get(default_read_options_, handles_[1],
+                   hashes_data_key.Encode(), &old_value);
+      if (s.ok()) {
+        if (!StrToInt64(old_value.data(), old_value.size(), &ival)) {
+          request->status = Status::Corruption("hash value is not an integer");
+          continue;
+        }
+        exists = true;
+      } else if (!s.IsNotFound()) {
+        request->status = s;
+        continue;
+      }
+    }
+    if ((op.value >= 0 && LLONG_MAX - op.value < ival) ||
+      (op.value < 0 && LLONG_MIN - op.value > ival)) {
+      request->status = Status::InvalidArgument("Overflow");
+      continue;
+    }
+    op.ret = ival + op.value;
+    char buf[32];
+    Int64ToStr(buf, 32, op.ret);
+    batch.Put(handles_[1], hashes_data_key.Encode(), buf);
+    if (exists) {
+      statistic++;
+    } else {
+      added++;
+    }
+    values[field] = op.ret;
+    request->status = Status::OK();
+  }
+
+  if (added > 0) {
+    parsed_hashes_meta_value.ModifyCount(added);
+    batch.Put(handles_[0], key, meta_value);
+  }
+  s = batch.Count() > 0 ? db_->Write(default_write_options_, &batch)
+    : Status::OK();
+  for (auto request : requests) {
+    if (request->status.ok()) {
+      request->status = s;
+    }
+  }
+  UpdateSpecificKeyStatistics(key.ToString(), statistic);
+}
+
 Status RedisHashes::HIncrbyfloat(const Slice& key, const Slice& field,
                                  const Slice& by, std::string* new_value) {
   new_value->clear();
   rocksdb::WriteBatch batch;
   ScopeRecordLock l(lock_mgr_, key);
+  if (!l.status().ok()) {
+    return l.status();
+  }
 
   int32_t version = 0;
   uint32_t statistic = 0;
@@ -494,13 +683,18 @@ Status RedisHashes::HIncrbyfloat(const Slice& key, const Slice& field,
 
 Status RedisHashes::HKeys(const Slice& key,
                           std::vector<std::string>* fields) {
+  return HKeys(key, [fields](const Slice& field) {
+    fields->push_back(field.ToString());
+    return true;
+  });
+}
+
+Status RedisHashes::HKeys(const Slice& key,
+                          const ElementVisitor& visitor) {
   rocksdb::ReadOptions read_options;
-  const rocksdb::Snapshot* snapshot;
 
   std::string meta_value;
   int32_t version = 0;
-  ScopeSnapshot ss(db_, &snapshot);
-  read_options.snapshot = snapshot;
   Status s = db_->Get(read_options, handles_[0], key, &meta_value);
   if (s.ok()) {
     ParsedHashesMetaValue parsed_hashes_meta_value(&meta_value);
@@ -512,12 +706,16 @@ Status RedisHashes::HKeys(const Slice& key,
       version = parsed_hashes_meta_value.version();
       HashesDataKey hashes_data_key(key, version, "");
       Slice prefix = hashes_data_key.Encode();
+      scan_policy_.ForCollection(parsed_hashes_meta_value.count(),
+                                 &read_options);
       auto iter = db_->NewIterator(read_options, handles_[1]);
       for (iter->Seek(prefix);
            iter->Valid() && iter->key().starts_with(prefix);
            iter->Next()) {
         ParsedHashesDataKey parsed_hashes_data_key(iter->key());
-        fields->push_back(parsed_hashes_data_key.field().ToString());
+        if (!visitor(parsed_hashes_data_key.field())) {
+          break;
+        }
       }
       delete iter;
     }
@@ -552,12 +750,8 @@ Status RedisHashes::HMGet(const Slice& key,
 
   int32_t version = 0;
   bool is_stale = false;
-  std::string value;
   std::string meta_value;
   rocksdb::ReadOptions read_options;
-  const rocksdb::Snapshot* snapshot;
-  ScopeSnapshot ss(db_, &snapshot);
-  read_options.snapshot = snapshot;
   Status s = db_->Get(read_options, handles_[0], key, &meta_value);
   if (s.ok()) {
     ParsedHashesMetaValue parsed_hashes_meta_value(&meta_value);
@@ -569,17 +763,24 @@ Status RedisHashes::HMGet(const Slice& key,
       return Status::NotFound(is_stale ? "Stale" : "");
     } else {
       version = parsed_hashes_meta_value.version();
+      std::vector<std::string> data_keys;
       for (const auto& field : fields) {
         HashesDataKey hashes_data_key(key, version, field);
-        s = db_->Get(read_options, handles_[1],
-                hashes_data_key.Encode(), &value);
-        if (s.ok()) {
-          vss->push_back({value, Status::OK()});
-        } else if (s.IsNotFound()) {
+        data_keys.push_back(hashes_data_key.Encode().ToString());
+      }
+      // The fields are read at once, at one sequence
+      std::vector<Status> statuses;
+      std::vector<std::string> values;
+      MultiGetData(read_options, parsed_hashes_meta_value.count(),
+                   data_keys, &statuses, &values);
+      for (size_t idx = 0; idx < fields.size(); ++idx) {
+        if (statuses[idx].ok()) {
+          vss->push_back({std::move(values[idx]), Status::OK()});
+        } else if (statuses[idx].IsNotFound()) {
           vss->push_back({std::string(), Status::NotFound()});
         } else {
           vss->clear();
-          return s;
+          return statuses[idx];
         }
       }
     }
@@ -607,6 +808,9 @@ Status RedisHashes::HMSet(const Slice& key,
 
   rocksdb::WriteBatch batch;
   ScopeRecordLock l(lock_mgr_, key);
+  if (!l.status().ok()) {
+    return l.status();
+  }
 
   int32_t version = 0;
   std::string meta_value;
@@ -624,21 +828,25 @@ Status RedisHashes::HMSet(const Slice& key,
       }
     } else {
       int32_t count = 0;
-      std::string data_value;
       version = parsed_hashes_meta_value.version();
+      std::vector<std::string> data_keys;
       for (const auto& fv : filtered_fvs) {
         HashesDataKey hashes_data_key(key, version, fv.field);
-        s = db_->Get(default_read_options_, handles_[1],
-                hashes_data_key.Encode(), &data_value);
-        if (s.ok()) {
+        data_keys.push_back(hashes_data_key.Encode().ToString());
+      }
+      std::vector<Status> statuses;
+      std::vector<std::string> data_values;
+      MultiGetData(default_read_options_, parsed_hashes_meta_value.count(),
+                   data_keys, &statuses, &data_values);
+      for (size_t idx = 0; idx < filtered_fvs.size(); ++idx) {
+        if (statuses[idx].ok()) {
           statistic++;
-          batch.Put(handles_[1], hashes_data_key.Encode(), fv.value);
-        } else if (s.IsNotFound()) {
+        } else if (statuses[idx].IsNotFound()) {
           count++;
-          batch.Put(handles_[1], hashes_data_key.Encode(), fv.value);
         } else {
-          return s;
+          return statuses[idx];
         }
+        batch.Put(handles_[1], data_keys[idx], filtered_fvs[idx].value);
       }
       parsed_hashes_meta_value.ModifyCount(count);
       batch.Put(handles_[0], key, meta_value);
@@ -663,6 +871,9 @@ Status RedisHashes::HSet(const Slice& key, const Slice& field,
                          const Slice& value, int32_t* res) {
   rocksdb::WriteBatch batch;
   ScopeRecordLock l(lock_mgr_, key);
+  if (!l.status().ok()) {
+    return l.status();
+  }
 
   int32_t version = 0;
   uint32_t statistic = 0;
@@ -722,6 +933,9 @@ Status RedisHashes::HSetnx(const Slice& key, const Slice& field,
                            const Slice& value, int32_t* ret) {
   rocksdb::WriteBatch batch;
   ScopeRecordLock l(lock_mgr_, key);
+  if (!l.status().ok()) {
+    return l.status();
+  }
 
   int32_t version = 0;
   std::string meta_value;
@@ -770,13 +984,18 @@ Status RedisHashes::HSetnx(const Slice& key, const Slice& field,
 
 Status RedisHashes::HVals(const Slice& key,
                           std::vector<std::string>* values) {
+  return HVals(key, [values](const Slice& value) {
+    values->push_back(value.ToString());
+    return true;
+  });
+}
+
+Status RedisHashes::HVals(const Slice& key,
+                          const ElementVisitor& visitor) {
   rocksdb::ReadOptions read_options;
-  const rocksdb::Snapshot* snapshot;
 
   std::string meta_value;
   int32_t version = 0;
-  ScopeSnapshot ss(db_, &snapshot);
-  read_options.snapshot = snapshot;
   Status s = db_->Get(read_options, handles_[0], key, &meta_value);
   if (s.ok()) {
     ParsedHashesMetaValue parsed_hashes_meta_value(&meta_value);
@@ -788,11 +1007,15 @@ Status RedisHashes::HVals(const Slice& key,
       version = parsed_hashes_meta_value.version();
       HashesDataKey hashes_data_key(key, version, "");
       Slice prefix = hashes_data_key.Encode();
+      scan_policy_.ForCollection(parsed_hashes_meta_value.count(),
+                                 &read_options);
       auto iter = db_->NewIterator(read_options, handles_[1]);
       for (iter->Seek(prefix);
            iter->Valid() && iter->key().starts_with(prefix);
            iter->Next()) {
-        values->push_back(iter->value().ToString());
+        if (!visitor(iter->value())) {
+          break;
+        }
       }
       delete iter;
     }
@@ -825,47 +1048,85 @@ Status RedisHashes::HScan(const Slice& key,
     return Status::OK();
   }
 
+  std::string start_point, next_field;
+  Status s = GetScanStartPoint(key, pattern, cursor, &start_point);
+  GlobPattern glob(pattern);
+  if (s.IsNotFound()) {
+    cursor = 0;
+    start_point = glob.prefix();
+  }
+
+  bool has_next = false;
+  s = HScanFrom(key, start_point, glob, count,
+                field_values, &next_field, &has_next);
+  if (s.ok() && has_next) {
+    *next_cursor = cursor + count;
+    StoreScanNextPoint(key, pattern, *next_cursor, next_field);
+  }
+  return s;
+}
+
+Status RedisHashes::HScan(const Slice& key,
+                          const std::string& cursor,
+                          const std::string& pattern,
+                          int64_t count,
+                          std::vector<FieldValue>* field_values,
+                          std::string* next_cursor) {
+  next_cursor->clear();
+  field_values->clear();
+  char type_tag = DataTypeTag[kHashes];
+  std::string start_point, next_field;
+  if (!cursor.empty()
+    && (!DecodeScanCursor(cursor, &type_tag, &start_point)
+      || type_tag != DataTypeTag[kHashes])) {
+    return Status::InvalidArgument("invalid cursor");
+  }
+  GlobPattern glob(pattern);
+  if (start_point < glob.prefix()) {
+    start_point = glob.prefix();
+  }
+
+  bool has_next = false;
+  Status s = HScanFrom(key, start_point, glob, count,
+                       field_values, &next_field, &has_next);
+  if (s.ok() && has_next) {
+    *next_cursor = EncodeScanCursor(DataTypeTag[kHashes], next_field);
+  }
+  return s;
+}
+
+Status RedisHashes::HScanFrom(const Slice& key,
+                              const std::string& start_point,
+                              const GlobPattern& glob,
+                              int64_t count,
+                              std::vector<FieldValue>* field_values,
+                              std::string* next_field,
+                              bool* has_next) {
   int64_t rest = count;
-  int64_t step_length = count;
   rocksdb::ReadOptions read_options;
-  const rocksdb::Snapshot* snapshot;
 
   std::string meta_value;
-  ScopeSnapshot ss(db_, &snapshot);
-  read_options.snapshot = snapshot;
   Status s = db_->Get(read_options, handles_[0], key, &meta_value);
   if (s.ok()) {
     ParsedHashesMetaValue parsed_hashes_meta_value(&meta_value);
     if (parsed_hashes_meta_value.IsStale()
       || parsed_hashes_meta_value.count() == 0) {
-      *next_cursor = 0;
       return Status::NotFound();
     } else {
-      std::string sub_field;
-      std::string start_point;
       int32_t version = parsed_hashes_meta_value.version();
-      s = GetScanStartPoint(key, pattern, cursor, &start_point);
-      if (s.IsNotFound()) {
-        cursor = 0;
-        if (isTailWildcard(pattern)) {
-          start_point = pattern.substr(0, pattern.size() - 1);
-        }
-      }
-      if (isTailWildcard(pattern)) {
-        sub_field = pattern.substr(0, pattern.size() - 1);
-      }
 
-      HashesDataKey hashes_data_prefix(key, version, sub_field);
+      HashesDataKey hashes_data_prefix(key, version, glob.prefix());
       HashesDataKey hashes_start_data_key(key, version, start_point);
+      HashesDataKey hashes_data_next_key(key, version + 1, "");
       std::string prefix = hashes_data_prefix.Encode().ToString();
-      rocksdb::Iterator* iter = db_->NewIterator(read_options, handles_[1]);
+      ScopeIterator iter(GetIteratorPool(1), db_, handles_[1], read_options,
+                         hashes_data_next_key.Encode());
       for (iter->Seek(hashes_start_data_key.Encode());
            iter->Valid() && rest > 0 && iter->key().starts_with(prefix);
            iter->Next()) {
         ParsedHashesDataKey parsed_hashes_data_key(iter->key());
         std::string field = parsed_hashes_data_key.field().ToString();
-        if (StringMatch(pattern.data(),
-              pattern.size(), field.data(), field.size(), 0)) {
+        if (glob.Match(field)) {
           field_values->push_back({field, iter->value().ToString()});
         }
         rest--;
@@ -874,17 +1135,12 @@ Status RedisHashes::HScan(const Slice& key,
       if (iter->Valid()
         && (iter->key().compare(prefix) <= 0
           || iter->key().starts_with(prefix))) {
-        *next_cursor = cursor + step_length;
+        *has_next = true;
         ParsedHashesDataKey parsed_hashes_data_key(iter->key());
-        std::string next_field = parsed_hashes_data_key.field().ToString();
-        StoreScanNextPoint(key, pattern, *next_cursor, next_field);
-      } else {
-        *next_cursor = 0;
+        *next_field = parsed_hashes_data_key.field().ToString();
       }
-      delete iter;
     }
   } else {
-    *next_cursor = 0;
     return s;
   }
   return Status::OK();
@@ -901,9 +1157,6 @@ Status RedisHashes::HScanx(const Slice& key,
   int64_t rest = count;
   std::string meta_value;
   rocksdb::ReadOptions read_options;
-  const rocksdb::Snapshot* snapshot;
-  ScopeSnapshot ss(db_, &snapshot);
-  read_options.snapshot = snapshot;
   Status s = db_->Get(read_options, handles_[0], key, &meta_value);
   if (s.ok()) {
     ParsedHashesMetaValue parsed_hashes_meta_value(&meta_value);
@@ -916,14 +1169,14 @@ Status RedisHashes::HScanx(const Slice& key,
       HashesDataKey hashes_data_prefix(key, version, Slice());
       HashesDataKey hashes_start_data_key(key, version, start_field);
       std::string prefix = hashes_data_prefix.Encode().ToString();
+      GlobPattern glob(pattern);
       rocksdb::Iterator* iter = db_->NewIterator(read_options, handles_[1]);
       for (iter->Seek(hashes_start_data_key.Encode());
            iter->Valid() && rest > 0 && iter->key().starts_with(prefix);
            iter->Next()) {
         ParsedHashesDataKey parsed_hashes_data_key(iter->key());
         std::string field = parsed_hashes_data_key.field().ToString();
-        if (StringMatch(pattern.data(),
-              pattern.size(), field.data(), field.size(), 0)) {
+        if (glob.Match(field)) {
           field_values->push_back({field, iter->value().ToString()});
         }
         rest--;
@@ -981,6 +1234,7 @@ Status RedisHashes::PKHScanRange(const Slice& key,
       HashesDataKey hashes_data_prefix(key, version, Slice());
       HashesDataKey hashes_start_data_key(key, version, field_start);
       std::string prefix = hashes_data_prefix.Encode().ToString();
+      GlobPattern glob(pattern.ToString());
       rocksdb::Iterator* iter = db_->NewIterator(read_options, handles_[1]);
       for (iter->Seek(start_no_limit ? prefix : hashes_start_data_key.Encode());
            iter->Valid() && remain > 0 && iter->key().starts_with(prefix);
@@ -990,8 +1244,7 @@ Status RedisHashes::PKHScanRange(const Slice& key,
         if (!end_no_limit && field.compare(field_end) > 0) {
           break;
         }
-        if (StringMatch(pattern.data(),
-              pattern.size(), field.data(), field.size(), 0)) {
+        if (glob.Match(field)) {
           field_values->push_back({field, iter->value().ToString()});
         }
         remain--;
@@ -1053,6 +1306,7 @@ Status RedisHashes::PKHRScanRange(const Slice& key,
       HashesDataKey hashes_start_data_key(
           key, start_key_version, start_key_field);
       std::string prefix = hashes_data_prefix.Encode().ToString();
+      GlobPattern glob(pattern.ToString());
       rocksdb::Iterator* iter = db_->NewIterator(read_options, handles_[1]);
       for (iter->SeekForPrev(hashes_start_data_key.Encode().ToString());
            iter->Valid() && remain > 0 && iter->key().starts_with(prefix);
@@ -1062,8 +1316,7 @@ Status RedisHashes::PKHRScanRange(const Slice& key,
         if (!end_no_limit && field.compare(field_end) < 0) {
           break;
         }
-        if (StringMatch(pattern.data(),
-              pattern.size(), field.data(), field.size(), 0)) {
+        if (glob.Match(field)) {
           field_values->push_back({field, iter->value().ToString()});
         }
         remain--;
@@ -1099,6 +1352,7 @@ Status RedisHashes::PKScanRange(const Slice& key_start,
   ScopeSnapshot ss(db_, &snapshot);
   iterator_options.snapshot = snapshot;
   iterator_options.fill_cache = false;
+  GlobPattern glob(pattern.ToString());
 
   bool start_no_limit = !key_start.compare("");
   bool end_no_limit = !key_end.compare("");
@@ -1110,22 +1364,23 @@ Status RedisHashes::PKScanRange(const Slice& key_start,
   }
 
   rocksdb::Iterator* it = db_->NewIterator(iterator_options, handles_[0]);
-  if (start_no_limit) {
-    it->SeekToFirst();
+  // Keys before the literal prefix of pattern can not match
+  if (start_no_limit || key_start.compare(glob.prefix()) < 0) {
+    it->Seek(glob.prefix());
   } else {
     it->Seek(key_start);
   }
 
   while (it->Valid() && remain > 0
-    && (end_no_limit || it->key().compare(key_end) <= 0)) {
+    && (end_no_limit || it->key().compare(key_end) <= 0)
+    && !glob.PastPrefix(it->key())) {
     ParsedHashesMetaValue parsed_hashes_meta_value(it->value());
     if (parsed_hashes_meta_value.IsStale()
       || parsed_hashes_meta_value.count() == 0) {
       it->Next();
     } else {
       key = it->key().ToString();
-      if (StringMatch(pattern.data(), pattern.size(),
-                         key.data(), key.size(), 0)) {
+      if (glob.Match(key)) {
         keys->push_back(key);
       }
       remain--;
@@ -1134,7 +1389,8 @@ Status RedisHashes::PKScanRange(const Slice& key_start,
   }
 
   while (it->Valid()
-    && (end_no_limit || it->key().compare(key_end) <= 0)) {
+    && (end_no_limit || it->key().compare(key_end) <= 0)
+    && !glob.PastPrefix(it->key())) {
     ParsedHashesMetaValue parsed_hashes_meta_value(it->value());
     if (parsed_hashes_meta_value.IsStale()
       || parsed_hashes_meta_value.count() == 0) {
@@ -1163,6 +1419,7 @@ Status RedisHashes::PKRScanRange(const Slice& key_start,
   ScopeSnapshot ss(db_, &snapshot);
   iterator_options.snapshot = snapshot;
   iterator_options.fill_cache = false;
+  GlobPattern glob(pattern.ToString());
 
   bool start_no_limit = !key_start.compare("");
   bool end_no_limit = !key_end.compare("");
@@ -1188,8 +1445,7 @@ Status RedisHashes::PKRScanRange(const Slice& key_start,
       it->Prev();
     } else {
       key = it->key().ToString();
-      if (StringMatch(pattern.data(), pattern.size(),
-                         key.data(), key.size(), 0)) {
+      if (glob.Match(key)) {
         keys->push_back(key);
       }
       remain--;
@@ -1216,6 +1472,9 @@ Status RedisHashes::PKRScanRange(const Slice& key_start,
 Status RedisHashes::Expire(const Slice& key, int32_t ttl) {
   std::string meta_value;
   ScopeRecordLock l(lock_mgr_, key);
+  if (!l.status().ok()) {
+    return l.status();
+  }
   Status s = db_->Get(default_read_options_, handles_[0], key, &meta_value);
   if (s.ok()) {
     ParsedHashesMetaValue parsed_hashes_meta_value(&meta_value);
@@ -1239,6 +1498,9 @@ Status RedisHashes::Expire(const Slice& key, int32_t ttl) {
 Status RedisHashes::Del(const Slice& key) {
   std::string meta_value;
   ScopeRecordLock l(lock_mgr_, key);
+  if (!l.status().ok()) {
+    return l.status();
+  }
   Status s = db_->Get(default_read_options_, handles_[0], key, &meta_value);
   if (s.ok()) {
     ParsedHashesMetaValue parsed_hashes_meta_value(&meta_value);
@@ -1268,11 +1530,13 @@ bool RedisHashes::Scan(const std::string& start_key,
   ScopeSnapshot ss(db_, &snapshot);
   iterator_options.snapshot = snapshot;
   iterator_options.fill_cache = false;
+  GlobPattern glob(pattern);
 
   rocksdb::Iterator* it = db_->NewIterator(iterator_options, handles_[0]);
 
-  it->Seek(start_key);
-  while (it->Valid() && (*count) > 0) {
+  it->Seek(start_key < glob.prefix() ? glob.prefix() : start_key);
+  while (it->Valid() && (*count) > 0
+    && !glob.PastPrefix(it->key())) {
     ParsedHashesMetaValue parsed_meta_value(it->value());
     if (parsed_meta_value.IsStale()
       || parsed_meta_value.count() == 0) {
@@ -1280,8 +1544,7 @@ bool RedisHashes::Scan(const std::string& start_key,
       continue;
     } else {
       meta_key = it->key().ToString();
-      if (StringMatch(pattern.data(), pattern.size(),
-                         meta_key.data(), meta_key.size(), 0)) {
+      if (glob.Match(meta_key)) {
         keys->push_back(meta_key);
       }
       (*count)--;
@@ -1289,10 +1552,7 @@ bool RedisHashes::Scan(const std::string& start_key,
     }
   }
 
-  std::string prefix = isTailWildcard(pattern) ?
-    pattern.substr(0, pattern.size() - 1) : "";
-  if (it->Valid()
-    && (it->key().compare(prefix) <= 0 || it->key().starts_with(prefix))) {
+  if (it->Valid() && !glob.PastPrefix(it->key())) {
     *next_key = it->key().ToString();
     is_finish = false;
   } else {
@@ -1345,6 +1605,9 @@ bool RedisHashes::PKExpireScan(const std::string& start_key,
 Status RedisHashes::Expireat(const Slice& key, int32_t timestamp) {
   std::string meta_value;
   ScopeRecordLock l(lock_mgr_, key);
+  if (!l.status().ok()) {
+    return l.status();
+  }
   Status s = db_->Get(default_read_options_, handles_[0], key, &meta_value);
   if (s.ok()) {
     ParsedHashesMetaValue parsed_hashes_meta_value(&meta_value);
@@ -1367,6 +1630,9 @@ Status RedisHashes::Expireat(const Slice& key, int32_t timestamp) {
 Status RedisHashes::Persist(const Slice& key) {
   std::string meta_value;
   ScopeRecordLock l(lock_mgr_, key);
+  if (!l.status().ok()) {
+    return l.status();
+  }
   Status s = db_->Get(default_read_options_, handles_[0], key, &meta_value);
   if (s.ok()) {
     ParsedHashesMetaValue parsed_hashes_meta_value(&meta_value);
@@ -1403,8 +1669,7 @@ Status RedisHashes::TTL(const Slice& key, int64_t* timestamp) {
       if (*timestamp == 0) {
         *timestamp = -1;
       } else {
-        int64_t curtime;
-        rocksdb::Env::Default()->GetCurrentTime(&curtime);
+        int64_t curtime = CoarseClock::Now();
         *timestamp = *timestamp - curtime >= 0 ? *timestamp - curtime : -2;
       }
     }
@@ -11,6 +11,7 @@
 #include <unordered_set>
 
 #include "src/redis.h"
+#include "src/write_combiner.h"
 
 namespace blackwidow {
 
@@ -26,24 +27,33 @@ class RedisHashes : public Redis {
                       const rocksdb::Slice* end,
                       const ColumnFamilyType& type = kMetaAndData) override;
   Status GetProperty(const std::string& property, uint64_t* out) override;
-  Status ScanKeyNum(KeyInfo* key_info) override;
-  Status ScanKeys(const std::string& pattern,
-                  std::vector<std::string>* keys) override;
-  Status PKPatternMatchDel(const std::string& pattern, int32_t* ret) override;
+  Status ScanKeyNum(const KeyRange& range, const std::atomic<bool>& stop,
+                    KeyInfo* key_info) override;
+  Status ScanKeySizes(const std::atomic<bool>& stop,
+                      const KeySizeVisitor& visitor) override;
+  Status ScanKeys(const std::string& pattern, const KeyRange& range,
+                  const ElementVisitor& visitor) override;
+  Status PKPatternMatchDel(const std::string& pattern, const KeyRange& range,
+                           int32_t* ret) override;
 
   // Hashes Commands
   Status HDel(const Slice& key, const std::vector<std::string>& fields,
               int32_t* ret);
   Status HExists(const Slice& key, const Slice& field);
   Status HGet(const Slice& key, const Slice& field, std::string* value);
+  Status HGet(const Slice& key, const Slice& field, PinnableSlice* value);
   Status HGetall(const Slice& key,
                  std::vector<FieldValue>* fvs);
+  Status HGetall(const Slice& key,
+                 const FieldValueVisitor& visitor);
   Status HIncrby(const Slice& key, const Slice& field, int64_t value,
                  int64_t* ret);
   Status HIncrbyfloat(const Slice& key, const Slice& field,
                       const Slice& by, std::string* new_value);
   Status HKeys(const Slice& key,
                std::vector<std::string>* fields);
+  Status HKeys(const Slice& key,
+               const ElementVisitor& visitor);
   Status HLen(const Slice& key, int32_t* ret);
   Status HMGet(const Slice& key, const std::vector<std::string>& fields,
                std::vector<ValueStatus>* vss);
@@ -55,10 +65,15 @@ class RedisHashes : public Redis {
                 int32_t* ret);
   Status HVals(const Slice& key,
                std::vector<std::string>* values);
+  Status HVals(const Slice& key,
+               const ElementVisitor& visitor);
   Status HStrlen(const Slice& key, const Slice& field, int32_t* len);
   Status HScan(const Slice& key, int64_t cursor,
                const std::string& pattern, int64_t count,
                std::vector<FieldValue>* field_values, int64_t* next_cursor);
+  Status HScan(const Slice& key, const std::string& cursor,
+               const std::string& pattern, int64_t count,
+               std::vector<FieldValue>* field_values, std::string* next_cursor);
   Status HScanx(const Slice& key, const std::string start_field,
                 const std::string& pattern, int64_t count,
                 std::vector<FieldValue>* field_values,
@@ -99,6 +114,24 @@ class RedisHashes : public Redis {
 
   // Iterate all data
   void ScanDatabase();
+
+ private:
+  // Shared by the HScan with a cursors store and the stateless one
+  Status HScanFrom(const Slice& key, const std::string& start_point,
+                   const GlobPattern& glob, int64_t count,
+                   std::vector<FieldValue>* field_values,
+                   std::string* next_field, bool* has_next);
+
+  // For write combining
+  struct HIncrbyOp {
+    Slice field;
+    int64_t value;
+    int64_t ret;
+  };
+  typedef WriteCombiner<HIncrbyOp> HIncrbyCombiner;
+  HIncrbyCombiner hincrby_combiner_;
+  void ApplyHIncrbys(const Slice& key,
+                     const HIncrbyCombiner::Requests& requests);
 };
 
 }  //  namespace blackwidow
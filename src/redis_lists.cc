@@ -10,7 +10,9 @@
 #include "src/redis_lists.h"
 #include "src/lists_filter.h"
 #include "src/scope_record_lock.h"
+#include "src/instrumented_db.h"
 #include "src/scope_snapshot.h"
+#include "src/table_properties_collector.h"
 
 namespace blackwidow {
 
@@ -25,8 +27,10 @@ RedisLists::RedisLists(BlackWidow* const bw, const DataType& type)
 
 Status RedisLists::Open(const BlackwidowOptions& bw_options,
                         const std::string& db_path) {
+  lock_mgr_ = new LockMgr(bw_options.lock_slots);
   statistics_store_->SetCapacity(bw_options.statistics_max_size);
   small_compaction_threshold_ = bw_options.small_compaction_threshold;
+  garbage_compaction_ratio_ = bw_options.garbage_compaction_ratio;
 
   rocksdb::Options ops(bw_options.options);
   Status s = rocksdb::DB::Open(ops, db_path, &db_);
@@ -52,6 +56,12 @@ Status RedisLists::Open(const BlackwidowOptions& bw_options,
     std::make_shared<ListsMetaFilterFactory>();
   data_cf_ops.compaction_filter_factory =
     std::make_shared<ListsDataFilterFactory>(&db_, &handles_);
+  meta_cf_ops.table_properties_collector_factories.push_back(
+    std::make_shared<GarbagePropertiesCollectorFactory>(
+        RecordFormat::kListsMetaValue, bw_options.garbage_compaction_ratio));
+  data_cf_ops.table_properties_collector_factories.push_back(
+    std::make_shared<GarbagePropertiesCollectorFactory>(
+        RecordFormat::kBaseDataKey, bw_options.garbage_compaction_ratio));
   data_cf_ops.comparator = ListsDataKeyComparator();
 
   // use the bloom filter policy to reduce disk reads
@@ -77,7 +87,11 @@ Status RedisLists::Open(const BlackwidowOptions& bw_options,
   // Data CF
   column_families.push_back(rocksdb::ColumnFamilyDescriptor(
       "data_cf", data_cf_ops));
-  return rocksdb::DB::Open(db_ops, db_path, column_families, &handles_, &db_);
+  s = rocksdb::DB::Open(db_ops, db_path, column_families, &handles_, &db_);
+  if (s.ok()) {
+    db_ = new InstrumentedDB(db_, true);
+  }
+  return s;
 }
 
 Status RedisLists::CompactRange(const rocksdb::Slice* begin,
@@ -101,7 +115,9 @@ Status RedisLists::GetProperty(const std::string& property, uint64_t* out) {
   return Status::OK();
 }
 
-Status RedisLists::ScanKeyNum(KeyInfo* key_info) {
+Status RedisLists::ScanKeyNum(const KeyRange& range,
+                              const std::atomic<bool>& stop,
+                              KeyInfo* key_info) {
   uint64_t keys = 0;
   uint64_t expires = 0;
   uint64_t ttl_sum = 0;
@@ -111,15 +127,21 @@ Status RedisLists::ScanKeyNum(KeyInfo* key_info) {
   const rocksdb::Snapshot* snapshot;
   ScopeSnapshot ss(db_, &snapshot);
   iterator_options.snapshot = snapshot;
-  iterator_options.fill_cache = false;
+  scan_policy_.ForKeyspaceScan(&iterator_options);
+  rocksdb::Slice upper_bound(range.end);
+  if (!range.end.empty()) {
+    iterator_options.iterate_upper_bound = &upper_bound;
+  }
 
-  int64_t curtime;
-  rocksdb::Env::Default()->GetCurrentTime(&curtime);
+  int64_t curtime = CoarseClock::Now();
 
   rocksdb::Iterator* iter = db_->NewIterator(iterator_options, handles_[0]);
-  for (iter->SeekToFirst();
+  for (iter->Seek(range.start);
        iter->Valid();
        iter->Next()) {
+    if (stop.load(std::memory_order_relaxed)) {
+      break;
+    }
     ParsedListsMetaValue parsed_lists_meta_value(iter->value());
     if (parsed_lists_meta_value.IsStale()
       || parsed_lists_meta_value.count() == 0) {
@@ -141,26 +163,57 @@ Status RedisLists::ScanKeyNum(KeyInfo* key_info) {
   return Status::OK();
 }
 
+Status RedisLists::ScanKeySizes(const std::atomic<bool>& stop,
+                                const KeySizeVisitor& visitor) {
+  rocksdb::ReadOptions iterator_options;
+  const rocksdb::Snapshot* snapshot;
+  ScopeSnapshot ss(db_, &snapshot);
+  iterator_options.snapshot = snapshot;
+  scan_policy_.ForKeyspaceScan(&iterator_options);
+
+  rocksdb::Iterator* iter = db_->NewIterator(iterator_options, handles_[0]);
+  for (iter->SeekToFirst();
+       iter->Valid() && !stop.load(std::memory_order_relaxed);
+       iter->Next()) {
+    ParsedListsMetaValue parsed_lists_meta_value(iter->value());
+    if (!parsed_lists_meta_value.IsStale()
+      && parsed_lists_meta_value.count() != 0) {
+      visitor(iter->key(), parsed_lists_meta_value.count());
+    }
+  }
+  delete iter;
+  return Status::OK();
+}
+
 Status RedisLists::ScanKeys(const std::string& pattern,
-                              std::vector<std::string>* keys) {
+                            const KeyRange& range,
+                            const ElementVisitor& visitor) {
   std::string key;
   rocksdb::ReadOptions iterator_options;
   const rocksdb::Snapshot* snapshot;
   ScopeSnapshot ss(db_, &snapshot);
   iterator_options.snapshot = snapshot;
-  iterator_options.fill_cache = false;
+  scan_policy_.ForKeyspaceScan(&iterator_options);
+
+  // Only the keys of range starting with the literal prefix of pattern
+  // can match
+  GlobPattern glob(pattern);
+  KeyRange scan_range = range.Intersect(glob.prefix(), glob.upper_bound());
+  rocksdb::Slice upper_bound(scan_range.end);
+  if (!scan_range.end.empty()) {
+    iterator_options.iterate_upper_bound = &upper_bound;
+  }
 
   rocksdb::Iterator* iter = db_->NewIterator(iterator_options, handles_[0]);
-  for (iter->SeekToFirst();
+  for (iter->Seek(scan_range.start);
        iter->Valid();
        iter->Next()) {
     ParsedListsMetaValue parsed_lists_meta_value(iter->value());
     if (!parsed_lists_meta_value.IsStale()
       && parsed_lists_meta_value.count() != 0) {
       key = iter->key().ToString();
-      if (StringMatch(pattern.data(),
-            pattern.size(), key.data(), key.size(), 0)) {
-        keys->push_back(key);
+      if (glob.Match(key) && !visitor(key)) {
+        break;
       }
     }
   }
@@ -169,12 +222,22 @@ Status RedisLists::ScanKeys(const std::string& pattern,
 }
 
 Status RedisLists::PKPatternMatchDel(const std::string& pattern,
+                                     const KeyRange& range,
                                      int32_t* ret) {
   rocksdb::ReadOptions iterator_options;
   const rocksdb::Snapshot* snapshot;
   ScopeSnapshot ss(db_, &snapshot);
   iterator_options.snapshot = snapshot;
-  iterator_options.fill_cache = false;
+  scan_policy_.ForKeyspaceScan(&iterator_options);
+
+  // Only the keys of range starting with the literal prefix of pattern
+  // can match
+  GlobPattern glob(pattern);
+  KeyRange scan_range = range.Intersect(glob.prefix(), glob.upper_bound());
+  rocksdb::Slice upper_bound(scan_range.end);
+  if (!scan_range.end.empty()) {
+    iterator_options.iterate_upper_bound = &upper_bound;
+  }
 
   std::string key;
   std::string meta_value;
@@ -182,14 +245,14 @@ Status RedisLists::PKPatternMatchDel(const std::string& pattern,
   Status s;
   rocksdb::WriteBatch batch;
   rocksdb::Iterator* iter = db_->NewIterator(iterator_options, handles_[0]);
-  iter->SeekToFirst();
+  iter->Seek(scan_range.start);
   while (iter->Valid()) {
     key = iter->key().ToString();
     meta_value = iter->value().ToString();
     ParsedListsMetaValue parsed_lists_meta_value(&meta_value);
     if (!parsed_lists_meta_value.IsStale()
       && parsed_lists_meta_value.count()
-      && StringMatch(pattern.data(), pattern.size(), key.data(), key.size(), 0)) {
+      && glob.Match(key)) {
       parsed_lists_meta_value.InitialMetaValue();
       batch.Put(handles_[0], key, meta_value);
     }
@@ -264,6 +327,9 @@ Status RedisLists::LInsert(const Slice& key,
   rocksdb::ReadOptions read_options;
   rocksdb::WriteBatch batch;
   ScopeRecordLock l(lock_mgr_, key);
+  if (!l.status().ok()) {
+    return l.status();
+  }
   std::string meta_value;
   Status s = db_->Get(default_read_options_, handles_[0], key, &meta_value);
   if (s.ok()) {
@@ -407,6 +473,9 @@ Status RedisLists::LPop(const Slice& key, std::string* element) {
   uint32_t statistic = 0;
   rocksdb::WriteBatch batch;
   ScopeRecordLock l(lock_mgr_, key);
+  if (!l.status().ok()) {
+    return l.status();
+  }
   std::string meta_value;
   Status s = db_->Get(default_read_options_, handles_[0], key, &meta_value);
   if (s.ok()) {
@@ -444,6 +513,9 @@ Status RedisLists::LPush(const Slice& key,
   *ret = 0;
   rocksdb::WriteBatch batch;
   ScopeRecordLock l(lock_mgr_, key);
+  if (!l.status().ok()) {
+    return l.status();
+  }
 
   uint64_t index = 0;
   int32_t version = 0;
@@ -489,6 +561,9 @@ Status RedisLists::LPushx(const Slice& key, const Slice& value, uint64_t* len) {
   *len = 0;
   rocksdb::WriteBatch batch;
   ScopeRecordLock l(lock_mgr_, key);
+  if (!l.status().ok()) {
+    return l.status();
+  }
 
   std::string meta_value;
   Status s = db_->Get(default_read_options_, handles_[0], key, &meta_value);
@@ -515,62 +590,82 @@ Status RedisLists::LPushx(const Slice& key, const Slice& value, uint64_t* len) {
 
 Status RedisLists::LRange(const Slice& key, int64_t start, int64_t stop,
                           std::vector<std::string>* ret) {
-  rocksdb::ReadOptions read_options;
-  const rocksdb::Snapshot* snapshot;
-
-  ScopeSnapshot ss(db_, &snapshot);
-  read_options.snapshot = snapshot;
+  return LRange(key, start, stop, [ret](const Slice& element) {
+    ret->push_back(element.ToString());
+    return true;
+  });
+}
 
+Status RedisLists::LRange(const Slice& key, int64_t start, int64_t stop,
+                          const ElementVisitor& visitor) {
+  // The indexes of a list shift on every push and pop, so its meta value
+  // and its nodes are read at one sequence, by two iterators of the same
+  // NewIterators() call. The Get only sizes the read for the scan policy
   std::string meta_value;
-  Status s = db_->Get(read_options, handles_[0], key, &meta_value);
-  if (s.ok()) {
+  Status s = db_->Get(default_read_options_, handles_[0], key, &meta_value);
+  if (!s.ok()) {
+    return s;
+  }
+  rocksdb::ReadOptions read_options;
+  {
     ParsedListsMetaValue parsed_lists_meta_value(&meta_value);
-    if (parsed_lists_meta_value.IsStale()) {
-      return Status::NotFound("Stale");
-    } else if (parsed_lists_meta_value.count() == 0) {
-      return Status::NotFound();
-    } else {
-      int32_t version = parsed_lists_meta_value.version();
-      uint64_t origin_left_index = parsed_lists_meta_value.left_index() + 1;
-      uint64_t origin_right_index = parsed_lists_meta_value.right_index() - 1;
-      uint64_t sublist_left_index  = start >= 0 ?
-                                     origin_left_index + start :
-                                     origin_right_index + start + 1;
-      uint64_t sublist_right_index = stop >= 0 ?
-                                     origin_left_index + stop :
-                                     origin_right_index + stop + 1;
+    scan_policy_.ForCollection(parsed_lists_meta_value.count(),
+                               &read_options);
+  }
+  std::vector<rocksdb::Iterator*> iters;
+  s = db_->NewIterators(read_options, {handles_[0], handles_[1]}, &iters);
+  if (!s.ok()) {
+    return s;
+  }
+  std::unique_ptr<rocksdb::Iterator> meta_iter(iters[0]);
+  std::unique_ptr<rocksdb::Iterator> iter(iters[1]);
+  meta_iter->Seek(key);
+  if (!meta_iter->Valid() || meta_iter->key() != key) {
+    return meta_iter->status().ok() ? Status::NotFound() : meta_iter->status();
+  }
+  meta_value = meta_iter->value().ToString();
 
-      if (sublist_left_index > sublist_right_index
-        || sublist_left_index > origin_right_index
-        || sublist_right_index < origin_left_index) {
-        return Status::OK();
-      } else {
-        if (sublist_left_index < origin_left_index) {
-          sublist_left_index = origin_left_index;
-        }
-        if (sublist_right_index > origin_right_index) {
-          sublist_right_index = origin_right_index;
-        }
-        rocksdb::Iterator* iter = db_->NewIterator(read_options,
-                handles_[1]);
-        uint64_t current_index = sublist_left_index;
-        ListsDataKey start_data_key(key, version, current_index);
-        ListsDataKey start_data_next_key(key, version + 1, current_index);
-        Slice start_next_prefix_key = start_data_next_key.Encode();
-        rocksdb::Slice upper_bound(start_next_prefix_key);
-        read_options.iterate_upper_bound = &upper_bound;
-        read_options.fill_cache = false;
-          for (iter->Seek(start_data_key.Encode());
-             iter->Valid() && current_index <= sublist_right_index;
-             iter->Next(), current_index++) {
-          ret->push_back(iter->value().ToString());
+  ParsedListsMetaValue parsed_lists_meta_value(&meta_value);
+  if (parsed_lists_meta_value.IsStale()) {
+    return Status::NotFound("Stale");
+  } else if (parsed_lists_meta_value.count() == 0) {
+    return Status::NotFound();
+  } else {
+    int32_t version = parsed_lists_meta_value.version();
+    uint64_t origin_left_index = parsed_lists_meta_value.left_index() + 1;
+    uint64_t origin_right_index = parsed_lists_meta_value.right_index() - 1;
+    uint64_t sublist_left_index  = start >= 0 ?
+                                   origin_left_index + start :
+                                   origin_right_index + start + 1;
+    uint64_t sublist_right_index = stop >= 0 ?
+                                   origin_left_index + stop :
+                                   origin_right_index + stop + 1;
+
+    if (sublist_left_index > sublist_right_index
+      || sublist_left_index > origin_right_index
+      || sublist_right_index < origin_left_index) {
+      return Status::OK();
+    } else {
+      if (sublist_left_index < origin_left_index) {
+        sublist_left_index = origin_left_index;
+      }
+      if (sublist_right_index > origin_right_index) {
+        sublist_right_index = origin_right_index;
+      }
+      uint64_t current_index = sublist_left_index;
+      ListsDataKey start_data_key(key, version, current_index);
+      ListsDataKey start_data_next_key(key, version + 1, current_index);
+      Slice start_next_prefix_key = start_data_next_key.Encode();
+      for (iter->Seek(start_data_key.Encode());
+           iter->Valid() && current_index <= sublist_right_index
+           && iter->key().compare(start_next_prefix_key) < 0;
+           iter->Next(), current_index++) {
+        if (!visitor(iter->value())) {
+          break;
         }
-        delete iter;
-        return Status::OK();
       }
+      return Status::OK();
     }
-  } else {
-    return s;
   }
 }
 
@@ -580,6 +675,9 @@ Status RedisLists::LRem(const Slice& key, int64_t count,
   rocksdb::WriteBatch batch;
   rocksdb::ReadOptions read_options;
   ScopeRecordLock l(lock_mgr_, key);
+  if (!l.status().ok()) {
+    return l.status();
+  }
   std::string meta_value;
   Status s = db_->Get(default_read_options_, handles_[0], key, &meta_value);
   if (s.ok()) {
@@ -716,6 +814,9 @@ Status RedisLists::LRem(const Slice& key, int64_t count,
 Status RedisLists::LSet(const Slice& key, int64_t index, const Slice& value) {
   uint32_t statistic = 0;
   ScopeRecordLock l(lock_mgr_, key);
+  if (!l.status().ok()) {
+    return l.status();
+  }
   std::string meta_value;
   Status s = db_->Get(default_read_options_, handles_[0], key, &meta_value);
   if (s.ok()) {
@@ -747,6 +848,9 @@ Status RedisLists::LSet(const Slice& key, int64_t index, const Slice& value) {
 Status RedisLists::LTrim(const Slice& key, int64_t start, int64_t stop) {
   rocksdb::WriteBatch batch;
   ScopeRecordLock l(lock_mgr_, key);
+  if (!l.status().ok()) {
+    return l.status();
+  }
 
   uint32_t statistic = 0;
   std::string meta_value;
@@ -818,6 +922,9 @@ Status RedisLists::RPop(const Slice& key, std::string* element) {
   uint32_t statistic = 0;
   rocksdb::WriteBatch batch;
   ScopeRecordLock l(lock_mgr_, key);
+  if (!l.status().ok()) {
+    return l.status();
+  }
 
   std::string meta_value;
   Status s = db_->Get(default_read_options_, handles_[0], key, &meta_value);
@@ -859,6 +966,9 @@ Status RedisLists::RPoplpush(const Slice& source,
   rocksdb::WriteBatch batch;
   MultiScopeRecordLock l(lock_mgr_,
       {source.ToString(), destination.ToString()});
+  if (!l.status().ok()) {
+    return l.status();
+  }
   if (!source.compare(destination)) {
     std::string meta_value;
     s = db_->Get(default_read_options_, handles_[0], source, &meta_value);
@@ -1021,6 +1131,9 @@ Status RedisLists::RPushx(const Slice& key, const Slice& value, uint64_t* len) {
   rocksdb::WriteBatch batch;
 
   ScopeRecordLock l(lock_mgr_, key);
+  if (!l.status().ok()) {
+    return l.status();
+  }
   std::string meta_value;
   Status s = db_->Get(default_read_options_, handles_[0], key, &meta_value);
   if (s.ok()) {
@@ -1059,6 +1172,7 @@ Status RedisLists::PKScanRange(const Slice& key_start,
   ScopeSnapshot ss(db_, &snapshot);
   iterator_options.snapshot = snapshot;
   iterator_options.fill_cache = false;
+  GlobPattern glob(pattern.ToString());
 
   bool start_no_limit = !key_start.compare("");
   bool end_no_limit = !key_end.compare("");
@@ -1070,22 +1184,23 @@ Status RedisLists::PKScanRange(const Slice& key_start,
   }
 
   rocksdb::Iterator* it = db_->NewIterator(iterator_options, handles_[0]);
-  if (start_no_limit) {
-    it->SeekToFirst();
+  // Keys before the literal prefix of pattern can not match
+  if (start_no_limit || key_start.compare(glob.prefix()) < 0) {
+    it->Seek(glob.prefix());
   } else {
     it->Seek(key_start);
   }
 
   while (it->Valid() && remain > 0
-    && (end_no_limit || it->key().compare(key_end) <= 0)) {
+    && (end_no_limit || it->key().compare(key_end) <= 0)
+    && !glob.PastPrefix(it->key())) {
     ParsedListsMetaValue parsed_lists_meta_value(it->value());
     if (parsed_lists_meta_value.IsStale()
       || parsed_lists_meta_value.count() == 0) {
       it->Next();
     } else {
       key = it->key().ToString();
-      if (StringMatch(pattern.data(), pattern.size(),
-                         key.data(), key.size(), 0)) {
+      if (glob.Match(key)) {
         keys->push_back(key);
       }
       remain--;
@@ -1094,7 +1209,8 @@ Status RedisLists::PKScanRange(const Slice& key_start,
   }
 
   while (it->Valid()
-    && (end_no_limit || it->key().compare(key_end) <= 0)) {
+    && (end_no_limit || it->key().compare(key_end) <= 0)
+    && !glob.PastPrefix(it->key())) {
     ParsedListsMetaValue parsed_lists_meta_value(it->value());
     if (parsed_lists_meta_value.IsStale()
       || parsed_lists_meta_value.count() == 0) {
@@ -1123,6 +1239,7 @@ Status RedisLists::PKRScanRange(const Slice& key_start,
   ScopeSnapshot ss(db_, &snapshot);
   iterator_options.snapshot = snapshot;
   iterator_options.fill_cache = false;
+  GlobPattern glob(pattern.ToString());
 
   bool start_no_limit = !key_start.compare("");
   bool end_no_limit = !key_end.compare("");
@@ -1148,8 +1265,7 @@ Status RedisLists::PKRScanRange(const Slice& key_start,
       it->Prev();
     } else {
       key = it->key().ToString();
-      if (StringMatch(pattern.data(), pattern.size(),
-                         key.data(), key.size(), 0)) {
+      if (glob.Match(key)) {
         keys->push_back(key);
       }
       remain--;
@@ -1175,6 +1291,9 @@ Status RedisLists::PKRScanRange(const Slice& key_start,
 Status RedisLists::Expire(const Slice& key, int32_t ttl) {
   std::string meta_value;
   ScopeRecordLock l(lock_mgr_, key);
+  if (!l.status().ok()) {
+    return l.status();
+  }
   Status s = db_->Get(default_read_options_, handles_[0], key, &meta_value);
   if (s.ok()) {
     ParsedListsMetaValue parsed_lists_meta_value(&meta_value);
@@ -1198,6 +1317,9 @@ Status RedisLists::Expire(const Slice& key, int32_t ttl) {
 Status RedisLists::Del(const Slice& key) {
   std::string meta_value;
   ScopeRecordLock l(lock_mgr_, key);
+  if (!l.status().ok()) {
+    return l.status();
+  }
   Status s = db_->Get(default_read_options_, handles_[0], key, &meta_value);
   if (s.ok()) {
     ParsedListsMetaValue parsed_lists_meta_value(&meta_value);
@@ -1227,11 +1349,13 @@ bool RedisLists::Scan(const std::string& start_key,
   ScopeSnapshot ss(db_, &snapshot);
   iterator_options.snapshot = snapshot;
   iterator_options.fill_cache = false;
+  GlobPattern glob(pattern);
 
   rocksdb::Iterator* it = db_->NewIterator(iterator_options, handles_[0]);
 
-  it->Seek(start_key);
-  while (it->Valid() && (*count) > 0) {
+  it->Seek(start_key < glob.prefix() ? glob.prefix() : start_key);
+  while (it->Valid() && (*count) > 0
+    && !glob.PastPrefix(it->key())) {
     ParsedListsMetaValue parsed_lists_meta_value(it->value());
     if (parsed_lists_meta_value.IsStale()
       || parsed_lists_meta_value.count() == 0) {
@@ -1239,8 +1363,7 @@ bool RedisLists::Scan(const std::string& start_key,
       continue;
     } else {
       meta_key = it->key().ToString();
-      if (StringMatch(pattern.data(), pattern.size(),
-                         meta_key.data(), meta_key.size(), 0)) {
+      if (glob.Match(meta_key)) {
         keys->push_back(meta_key);
       }
       (*count)--;
@@ -1248,10 +1371,7 @@ bool RedisLists::Scan(const std::string& start_key,
     }
   }
 
-  std::string prefix = isTailWildcard(pattern) ?
-    pattern.substr(0, pattern.size() - 1) : "";
-  if (it->Valid()
-    && (it->key().compare(prefix) <= 0 || it->key().starts_with(prefix))) {
+  if (it->Valid() && !glob.PastPrefix(it->key())) {
     *next_key = it->key().ToString();
     is_finish = false;
   } else {
@@ -1304,6 +1424,9 @@ bool RedisLists::PKExpireScan(const std::string& start_key,
 Status RedisLists::Expireat(const Slice& key, int32_t timestamp) {
   std::string meta_value;
   ScopeRecordLock l(lock_mgr_, key);
+  if (!l.status().ok()) {
+    return l.status();
+  }
   Status s = db_->Get(default_read_options_, handles_[0], key, &meta_value);
   if (s.ok()) {
     ParsedListsMetaValue parsed_lists_meta_value(&meta_value);
@@ -1326,6 +1449,9 @@ Status RedisLists::Expireat(const Slice& key, int32_t timestamp) {
 Status RedisLists::Persist(const Slice& key) {
   std::string meta_value;
   ScopeRecordLock l(lock_mgr_, key);
+  if (!l.status().ok()) {
+    return l.status();
+  }
   Status s = db_->Get(default_read_options_, handles_[0], key, &meta_value);
   if (s.ok()) {
     ParsedListsMetaValue parsed_lists_meta_value(&meta_value);
@@ -1362,8 +1488,7 @@ Status RedisLists::TTL(const Slice& key, int64_t* timestamp) {
       if (*timestamp == 0) {
         *timestamp = -1;
       } else {
-        int64_t curtime;
-        rocksdb::Env::Default()->GetCurrentTime(&curtime);
+        int64_t curtime = CoarseClock::Now();
         *timestamp = *timestamp - curtime >= 0 ? *timestamp - curtime : -2;
       }
     }
@@ -27,10 +27,14 @@ class RedisLists : public Redis {
                       const rocksdb::Slice* end,
                       const ColumnFamilyType& type = kMetaAndData) override;
   Status GetProperty(const std::string& property, uint64_t* out) override;
-  Status ScanKeyNum(KeyInfo* key_info) override;
-  Status ScanKeys(const std::string& pattern,
-                  std::vector<std::string>* keys) override;
-  Status PKPatternMatchDel(const std::string& pattern, int32_t* ret) override;
+  Status ScanKeyNum(const KeyRange& range, const std::atomic<bool>& stop,
+                    KeyInfo* key_info) override;
+  Status ScanKeySizes(const std::atomic<bool>& stop,
+                      const KeySizeVisitor& visitor) override;
+  Status ScanKeys(const std::string& pattern, const KeyRange& range,
+                  const ElementVisitor& visitor) override;
+  Status PKPatternMatchDel(const std::string& pattern, const KeyRange& range,
+                           int32_t* ret) override;
 
 
   // Lists commands;
@@ -45,6 +49,8 @@ class RedisLists : public Redis {
   Status LPushx(const Slice& key, const Slice& value, uint64_t* len);
   Status LRange(const Slice& key, int64_t start, int64_t stop,
                 std::vector<std::string>* ret);
+  Status LRange(const Slice& key, int64_t start, int64_t stop,
+                const ElementVisitor& visitor);
   Status LRem(const Slice& key, int64_t count,
               const Slice& value, uint64_t* ret);
   Status LSet(const Slice& key, int64_t index, const Slice& value);
@@ -13,7 +13,10 @@
 #include "blackwidow/util.h"
 #include "src/base_filter.h"
 #include "src/scope_snapshot.h"
+#include "src/iterator_pool.h"
+#include "src/table_properties_collector.h"
 #include "src/scope_record_lock.h"
+#include "src/instrumented_db.h"
 
 namespace blackwidow {
 
@@ -25,8 +28,10 @@ RedisSets::RedisSets(BlackWidow* const bw, const DataType& type)
 
 Status RedisSets::Open(const BlackwidowOptions& bw_options,
                        const std::string& db_path) {
+  lock_mgr_ = new LockMgr(bw_options.lock_slots);
   statistics_store_->SetCapacity(bw_options.statistics_max_size);
   small_compaction_threshold_ = bw_options.small_compaction_threshold;
+  garbage_compaction_ratio_ = bw_options.garbage_compaction_ratio;
 
   rocksdb::Options ops(bw_options.options);
   Status s = rocksdb::DB::Open(ops, db_path, &db_);
@@ -51,6 +56,12 @@ Status RedisSets::Open(const BlackwidowOptions& bw_options,
       std::make_shared<SetsMetaFilterFactory>();
   member_cf_ops.compaction_filter_factory =
       std::make_shared<SetsMemberFilterFactory>(&db_, &handles_);
+  meta_cf_ops.table_properties_collector_factories.push_back(
+      std::make_shared<GarbagePropertiesCollectorFactory>(
+          RecordFormat::kBaseMetaValue, bw_options.garbage_compaction_ratio));
+  member_cf_ops.table_properties_collector_factories.push_back(
+      std::make_shared<GarbagePropertiesCollectorFactory>(
+          RecordFormat::kBaseDataKey, bw_options.garbage_compaction_ratio));
 
   // use the bloom filter policy to reduce disk reads
   rocksdb::BlockBasedTableOptions table_ops(bw_options.table_options);
@@ -75,7 +86,11 @@ Status RedisSets::Open(const BlackwidowOptions& bw_options,
   // Member CF
   column_families.push_back(rocksdb::ColumnFamilyDescriptor(
       "member_cf", member_cf_ops));
-  return rocksdb::DB::Open(db_ops, db_path, column_families, &handles_, &db_);
+  s = rocksdb::DB::Open(db_ops, db_path, column_families, &handles_, &db_);
+  if (s.ok()) {
+    db_ = new InstrumentedDB(db_, true);
+  }
+  return s;
 }
 
 Status RedisSets::CompactRange(const rocksdb::Slice* begin,
@@ -99,7 +114,9 @@ Status RedisSets::GetProperty(const std::string& property, uint64_t* out) {
   return Status::OK();
 }
 
-Status RedisSets::ScanKeyNum(KeyInfo* key_info) {
+Status RedisSets::ScanKeyNum(const KeyRange& range,
+                             const std::atomic<bool>& stop,
+                             KeyInfo* key_info) {
   uint64_t keys = 0;
   uint64_t expires = 0;
   uint64_t ttl_sum = 0;
@@ -109,15 +126,21 @@ Status RedisSets::ScanKeyNum(KeyInfo* key_info) {
   const rocksdb::Snapshot* snapshot;
   ScopeSnapshot ss(db_, &snapshot);
   iterator_options.snapshot = snapshot;
-  iterator_options.fill_cache = false;
+  scan_policy_.ForKeyspaceScan(&iterator_options);
+  rocksdb::Slice upper_bound(range.end);
+  if (!range.end.empty()) {
+    iterator_options.iterate_upper_bound = &upper_bound;
+  }
 
-  int64_t curtime;
-  rocksdb::Env::Default()->GetCurrentTime(&curtime);
+  int64_t curtime = CoarseClock::Now();
 
   rocksdb::Iterator* iter = db_->NewIterator(iterator_options, handles_[0]);
-  for (iter->SeekToFirst();
+  for (iter->Seek(range.start);
        iter->Valid();
        iter->Next()) {
+    if (stop.load(std::memory_order_relaxed)) {
+      break;
+    }
     ParsedSetsMetaValue parsed_sets_meta_value(iter->value());
     if (parsed_sets_meta_value.IsStale()
       || parsed_sets_meta_value.count() == 0) {
@@ -139,26 +162,57 @@ Status RedisSets::ScanKeyNum(KeyInfo* key_info) {
   return Status::OK();
 }
 
+Status RedisSets::ScanKeySizes(const std::atomic<bool>& stop,
+                               const KeySizeVisitor& visitor) {
+  rocksdb::ReadOptions iterator_options;
+  const rocksdb::Snapshot* snapshot;
+  ScopeSnapshot ss(db_, &snapshot);
+  iterator_options.snapshot = snapshot;
+  scan_policy_.ForKeyspaceScan(&iterator_options);
+
+  rocksdb::Iterator* iter = db_->NewIterator(iterator_options, handles_[0]);
+  for (iter->SeekToFirst();
+       iter->Valid() && !stop.load(std::memory_order_relaxed);
+       iter->Next()) {
+    ParsedSetsMetaValue parsed_sets_meta_value(iter->value());
+    if (!parsed_sets_meta_value.IsStale()
+      && parsed_sets_meta_value.count() != 0) {
+      visitor(iter->key(), parsed_sets_meta_value.count());
+    }
+  }
+  delete iter;
+  return Status::OK();
+}
+
 Status RedisSets::ScanKeys(const std::string& pattern,
-                             std::vector<std::string>* keys) {
+                           const KeyRange& range,
+                           const ElementVisitor& visitor) {
   std::string key;
   rocksdb::ReadOptions iterator_options;
   const rocksdb::Snapshot* snapshot;
   ScopeSnapshot ss(db_, &snapshot);
   iterator_options.snapshot = snapshot;
-  iterator_options.fill_cache = false;
+  scan_policy_.ForKeyspaceScan(&iterator_options);
+
+  // Only the keys of range starting with the literal prefix of pattern
+  // can match
+  GlobPattern glob(pattern);
+  KeyRange scan_range = range.Intersect(glob.prefix(), glob.upper_bound());
+  rocksdb::Slice upper_bound(scan_range.end);
+  if (!scan_range.end.empty()) {
+    iterator_options.iterate_upper_bound = &upper_bound;
+  }
 
   rocksdb::Iterator* iter = db_->NewIterator(iterator_options, handles_[0]);
-  for (iter->SeekToFirst();
+  for (iter->Seek(scan_range.start);
        iter->Valid();
        iter->Next()) {
     ParsedSetsMetaValue parsed_sets_meta_value(iter->value());
     if (!parsed_sets_meta_value.IsStale()
       && parsed_sets_meta_value.count() != 0) {
       key = iter->key().ToString();
-      if (StringMatch(pattern.data(),
-            pattern.size(), key.data(), key.size(), 0)) {
-        keys->push_back(key);
+      if (glob.Match(key) && !visitor(key)) {
+        break;
       }
     }
   }
@@ -167,12 +221,22 @@ Status RedisSets::ScanKeys(const std::string& pattern,
 }
 
 Status RedisSets::PKPatternMatchDel(const std::string& pattern,
+                                    const KeyRange& range,
                                     int32_t* ret) {
   rocksdb::ReadOptions iterator_options;
   const rocksdb::Snapshot* snapshot;
   ScopeSnapshot ss(db_, &snapshot);
   iterator_options.snapshot = snapshot;
-  iterator_options.fill_cache = false;
+  scan_policy_.ForKeyspaceScan(&iterator_options);
+
+  // Only the keys of range starting with the literal prefix of pattern
+  // can match
+  GlobPattern glob(pattern);
+  KeyRange scan_range = range.Intersect(glob.prefix(), glob.upper_bound());
+  rocksdb::Slice upper_bound(scan_range.end);
+  if (!scan_range.end.empty()) {
+    iterator_options.iterate_upper_bound = &upper_bound;
+  }
 
   std::string key;
   std::string meta_value;
@@ -180,14 +244,14 @@ Status RedisSets::PKPatternMatchDel(const std::string& pattern,
   Status s;
   rocksdb::WriteBatch batch;
   rocksdb::Iterator* iter = db_->NewIterator(iterator_options, handles_[0]);
-  iter->SeekToFirst();
+  iter->Seek(scan_range.start);
   while (iter->Valid()) {
     key = iter->key().ToString();
     meta_value = iter->value().ToString();
     ParsedSetsMetaValue parsed_sets_meta_value(&meta_value);
     if (!parsed_sets_meta_value.IsStale()
       && parsed_sets_meta_value.count()
-      && StringMatch(pattern.data(), pattern.size(), key.data(), key.size(), 0)) {
+      && glob.Match(key)) {
       parsed_sets_meta_value.InitialMetaValue();
       batch.Put(handles_[0], key, meta_value);
     }
@@ -217,6 +281,16 @@ Status RedisSets::PKPatternMatchDel(const std::string& pattern,
 
 Status RedisSets::SAdd(const Slice& key,
                        const std::vector<std::string>& members, int32_t* ret) {
+  if (combine_writes_.load(std::memory_order_relaxed)) {
+    SAddCombiner::Request request(key, {&members, 0});
+    Status s = sadd_combiner_.Run(lock_mgr_, &request,
+        [this](const Slice& key, const SAddCombiner::Requests& requests) {
+          ApplySAdds(key, requests);
+        });
+    *ret = request.op.ret;
+    return s;
+  }
+
   std::unordered_set<std::string> unique;
   std::vector<std::string> filtered_members;
   for (const auto& member : members) {
@@ -228,6 +302,9 @@ Status RedisSets::SAdd(const Slice& key,
 
   rocksdb::WriteBatch batch;
   ScopeRecordLock l(lock_mgr_, key);
+  if (!l.status().ok()) {
+    return l.status();
+  }
   int32_t version = 0;
   std::string meta_value;
   Status s = db_->Get(default_read_options_, handles_[0], key, &meta_value);
@@ -245,18 +322,22 @@ Status RedisSets::SAdd(const Slice& key,
       *ret = filtered_members.size();
     } else {
       int32_t cnt = 0;
-      std::string member_value;
       version = parsed_sets_meta_value.version();
+      std::vector<std::string> member_keys;
       for (const auto& member : filtered_members) {
         SetsMemberKey sets_member_key(key, version, member);
-        s = db_->Get(default_read_options_, handles_[1],
-                     sets_member_key.Encode(), &member_value);
-        if (s.ok()) {
-        } else if (s.IsNotFound()) {
+        member_keys.push_back(sets_member_key.Encode().ToString());
+      }
+      std::vector<Status> statuses;
+      std::vector<std::string> member_values;
+      MultiGetData(default_read_options_, parsed_sets_meta_value.count(),
+                   member_keys, &statuses, &member_values);
+      for (size_t idx = 0; idx < member_keys.size(); ++idx) {
+        if (statuses[idx].IsNotFound()) {
           cnt++;
-          batch.Put(handles_[1], sets_member_key.Encode(), Slice());
-        } else {
-          return s;
+          batch.Put(handles_[1], member_keys[idx], Slice());
+        } else if (!statuses[idx].ok()) {
+          return statuses[idx];
         }
       }
       *ret = cnt;
@@ -284,6 +365,75 @@ Status RedisSets::SAdd(const Slice& key,
   return db_->Write(default_write_options_, &batch);
 }
 
+// Same as the SAdd of every request in turn, with one read of the meta
+// value and one write, a failed request does not fail the others
+void RedisSets::ApplySAdds(const Slice& key,
+                           const SAddCombiner::Requests& requests) {
+  std::string meta_value;
+  bool reset = false;
+  Status s = GetMetaForWrite(key, &meta_value, &reset);
+  if (!s.ok()) {
+    for (auto request : requests) {
+      request->status = s;
+    }
+    return;
+  }
+  ParsedSetsMetaValue parsed_sets_meta_value(&meta_value);
+  int32_t version = parsed_sets_meta_value.version();
+
+  rocksdb::WriteBatch batch;
+  int32_t added = 0;
+  std::string member_value;
+  // Members known to be in the set, stored or added by the previous requests
+  std::unordered_set<std::string> present;
+  for (auto request : requests) {
+    std::vector<std::string> new_members;
+    request->status = Status::OK();
+    for (const auto& member : *request->op.members) {
+      if (present.find(member) != present.end()) {
+        continue;
+      }
+      if (!reset) {
+        SetsMemberKey sets_member_key(key, version, member);
+        s = db_->Get(default_read_options_, handles_[1],
+                     sets_member_key.Encode(), &member_value);
+        if (!s.ok() && !s.IsNotFound()) {
+          request->status = s;
+          break;
+        }
+      }
+      present.insert(member);
+      if (reset || s.IsNotFound()) {
+        new_members.push_back(member);
+      }
+    }
+    if (!request->status.ok()) {
+      for (const auto& member : new_members) {
+        present.erase(member);
+      }
+      continue;
+    }
+    for (const auto& member : new_members) {
+      SetsMemberKey sets_member_key(key, version, member);
+      batch.Put(handles_[1], sets_member_key.Encode(), Slice());
+    }
+    request->op.ret = new_members.size();
+    added += new_members.size();
+  }
+
+  if (added > 0) {
+    parsed_sets_meta_value.ModifyCount(added);
+    batch.Put(handles_[0], key, meta_value);
+  }
+  s = batch.Count() > 0 ? db_->Write(default_write_options_, &batch)
+    : Status::OK();
+  for (auto request : requests) {
+    if (request->status.ok()) {
+      request->status = s;
+    }
+  }
+}
+
 Status RedisSets::SCard(const Slice& key, int32_t* ret) {
   *ret = 0;
   std::string meta_value;
@@ -342,7 +492,10 @@ Status RedisSets::SDiff(const std::vector<std::string>& keys,
       version = parsed_sets_meta_value.version();
       SetsMemberKey sets_member_key(keys[0], version, Slice());
       prefix = sets_member_key.Encode();
-      auto iter = db_->NewIterator(read_options, handles_[1]);
+      rocksdb::ReadOptions scan_options(read_options);
+      scan_policy_.ForCollection(parsed_sets_meta_value.count(),
+                                 &scan_options);
+      auto iter = db_->NewIterator(scan_options, handles_[1]);
       for (iter->Seek(prefix);
            iter->Valid() && iter->key().starts_with(prefix);
            iter->Next()) {
@@ -389,6 +542,9 @@ Status RedisSets::SDiffstore(const Slice& destination,
   std::string meta_value;
   int32_t version = 0;
   ScopeRecordLock l(lock_mgr_, destination);
+  if (!l.status().ok()) {
+    return l.status();
+  }
   ScopeSnapshot ss(db_, &snapshot);
   read_options.snapshot = snapshot;
   std::vector<KeyVersion> vaild_sets;
@@ -418,7 +574,10 @@ Status RedisSets::SDiffstore(const Slice& destination,
       version = parsed_sets_meta_value.version();
       SetsMemberKey sets_member_key(keys[0], version, Slice());
       Slice prefix = sets_member_key.Encode();
-      auto iter = db_->NewIterator(read_options, handles_[1]);
+      rocksdb::ReadOptions scan_options(read_options);
+      scan_policy_.ForCollection(parsed_sets_meta_value.count(),
+                                 &scan_options);
+      auto iter = db_->NewIterator(scan_options, handles_[1]);
       for (iter->Seek(prefix);
            iter->Valid() && iter->key().starts_with(prefix);
            iter->Next()) {
@@ -520,8 +679,15 @@ Status RedisSets::SInter(const std::vector<std::string>& keys,
       std::string member_value;
       version = parsed_sets_meta_value.version();
       SetsMemberKey sets_member_key(keys[0], version, Slice());
+      SetsMemberKey sets_member_next_key(keys[0], version + 1, Slice());
       Slice prefix = sets_member_key.Encode();
-      auto iter = db_->NewIterator(read_options, handles_[1]);
+      rocksdb::ReadOptions scan_options(read_options);
+      scan_policy_.ForCollection(parsed_sets_meta_value.count(),
+                                 &scan_options);
+      // The members of the other sets are read at the snapshot too, so
+      // this scan does not take a pooled iterator
+      ScopeIterator iter(nullptr, db_, handles_[1], scan_options,
+                         sets_member_next_key.Encode());
       for (iter->Seek(prefix);
            iter->Valid() && iter->key().starts_with(prefix);
            iter->Next()) {
@@ -540,7 +706,6 @@ Status RedisSets::SInter(const std::vector<std::string>& keys,
             reliable = false;
             break;
           } else {
-            delete iter;
             return s;
           }
         }
@@ -548,7 +713,6 @@ Status RedisSets::SInter(const std::vector<std::string>& keys,
           members->push_back(member.ToString());
         }
       }
-      delete iter;
     }
   } else if (s.IsNotFound()) {
     return Status::OK();
@@ -573,6 +737,9 @@ Status RedisSets::SInterstore(const Slice& destination,
   int32_t version = 0;
   bool have_invalid_sets = false;
   ScopeRecordLock l(lock_mgr_, destination);
+  if (!l.status().ok()) {
+    return l.status();
+  }
   ScopeSnapshot ss(db_, &snapshot);
   read_options.snapshot = snapshot;
   std::vector<KeyVersion> vaild_sets;
@@ -611,7 +778,10 @@ Status RedisSets::SInterstore(const Slice& destination,
         version = parsed_sets_meta_value.version();
         SetsMemberKey sets_member_key(keys[0], version, Slice());
         Slice prefix = sets_member_key.Encode();
-        auto iter = db_->NewIterator(read_options, handles_[1]);
+        rocksdb::ReadOptions scan_options(read_options);
+        scan_policy_.ForCollection(parsed_sets_meta_value.count(),
+                                   &scan_options);
+        auto iter = db_->NewIterator(scan_options, handles_[1]);
         for (iter->Seek(prefix);
              iter->Valid() && iter->key().starts_with(prefix);
              iter->Next()) {
@@ -677,12 +847,9 @@ Status RedisSets::SIsmember(const Slice& key, const Slice& member,
                             int32_t* ret) {
   *ret = 0;
   rocksdb::ReadOptions read_options;
-  const rocksdb::Snapshot* snapshot;
 
   std::string meta_value;
   int32_t version = 0;
-  ScopeSnapshot ss(db_, &snapshot);
-  read_options.snapshot = snapshot;
   Status s = db_->Get(read_options, handles_[0], key, &meta_value);
   if (s.ok()) {
     ParsedSetsMetaValue parsed_sets_meta_value(&meta_value);
@@ -706,13 +873,18 @@ Status RedisSets::SIsmember(const Slice& key, const Slice& member,
 
 Status RedisSets::SMembers(const Slice& key,
                            std::vector<std::string>* members) {
+  return SMembers(key, [members](const Slice& member) {
+    members->push_back(member.ToString());
+    return true;
+  });
+}
+
+Status RedisSets::SMembers(const Slice& key,
+                           const ElementVisitor& visitor) {
   rocksdb::ReadOptions read_options;
-  const rocksdb::Snapshot* snapshot;
 
   std::string meta_value;
   int32_t version = 0;
-  ScopeSnapshot ss(db_, &snapshot);
-  read_options.snapshot = snapshot;
   Status s = db_->Get(read_options, handles_[0], key, &meta_value);
   if (s.ok()) {
     ParsedSetsMetaValue parsed_sets_meta_value(&meta_value);
@@ -726,18 +898,19 @@ Status RedisSets::SMembers(const Slice& key,
       SetsMemberKey sets_member_next_key(key, version + 1, Slice());
       Slice prefix = sets_member_key.Encode();
       Slice next_version_prefix = sets_member_next_key.Encode();
-      rocksdb::Slice upper_bound(next_version_prefix);
-      read_options.iterate_upper_bound = &upper_bound;
-      read_options.fill_cache = false;
+      bool small = scan_policy_.ForCollection(
+          parsed_sets_meta_value.count(), &read_options);
 
-      auto iter = db_->NewIterator(read_options, handles_[1]);
+      ScopeIterator iter(small ? GetIteratorPool(1) : nullptr, db_,
+                         handles_[1], read_options, next_version_prefix);
       for (iter->Seek(prefix);
            iter->Valid() && iter->key().starts_with(prefix);
            iter->Next()) {
         ParsedSetsMemberKey parsed_sets_member_key(iter->key());
-        members->push_back(parsed_sets_member_key.member().ToString());
+        if (!visitor(parsed_sets_member_key.member())) {
+          break;
+        }
       }
-      delete iter;
     }
   }
   return s;
@@ -754,6 +927,9 @@ Status RedisSets::SMove(const Slice& source, const Slice& destination,
   std::string meta_value;
   std::vector<std::string> keys {source.ToString(), destination.ToString()};
   MultiScopeRecordLock ml(lock_mgr_, keys);
+  if (!ml.status().ok()) {
+    return ml.status();
+  }
 
   if (source == destination) {
     *ret = 1;
@@ -841,6 +1017,9 @@ Status RedisSets::SPop(const Slice& key,
   std::string meta_value;
   rocksdb::WriteBatch batch;
   ScopeRecordLock l(lock_mgr_, key);
+  if (!l.status().ok()) {
+    return l.status();
+  }
 
   uint64_t start_us = slash::NowMicros();
   Status s = db_->Get(default_read_options_, handles_[0], key, &meta_value);
@@ -913,6 +1092,9 @@ Status RedisSets::SRandmember(const Slice& key, int32_t count,
   std::string meta_value;
   rocksdb::WriteBatch batch;
   ScopeRecordLock l(lock_mgr_, key);
+  if (!l.status().ok()) {
+    return l.status();
+  }
   std::vector<int32_t> targets;
   std::unordered_set<int32_t> unique;
 
@@ -976,6 +1158,9 @@ Status RedisSets::SRem(const Slice& key,
   *ret = 0;
   rocksdb::WriteBatch batch;
   ScopeRecordLock l(lock_mgr_, key);
+  if (!l.status().ok()) {
+    return l.status();
+  }
 
   int32_t version = 0;
   uint32_t statistic = 0;
@@ -989,19 +1174,23 @@ Status RedisSets::SRem(const Slice& key,
       return Status::NotFound();
     } else {
       int32_t cnt = 0;
-      std::string member_value;
       version = parsed_sets_meta_value.version();
+      std::vector<std::string> member_keys;
       for (const auto& member : members) {
         SetsMemberKey sets_member_key(key, version, member);
-        s = db_->Get(default_read_options_, handles_[1],
-                sets_member_key.Encode(), &member_value);
-        if (s.ok()) {
+        member_keys.push_back(sets_member_key.Encode().ToString());
+      }
+      std::vector<Status> statuses;
+      std::vector<std::string> member_values;
+      MultiGetData(default_read_options_, parsed_sets_meta_value.count(),
+                   member_keys, &statuses, &member_values);
+      for (size_t idx = 0; idx < member_keys.size(); ++idx) {
+        if (statuses[idx].ok()) {
           cnt++;
           statistic++;
-          batch.Delete(handles_[1], sets_member_key.Encode());
-        } else if (s.IsNotFound()) {
-        } else {
-          return s;
+          batch.Delete(handles_[1], member_keys[idx]);
+        } else if (!statuses[idx].IsNotFound()) {
+          return statuses[idx];
         }
       }
       *ret = cnt;
@@ -1069,6 +1258,70 @@ Status RedisSets::SUnion(const std::vector<std::string>& keys,
   return Status::OK();
 }
 
+// Without the members already seen at hand, a member is only visited
+// from the first set holding it: the sets before are probed for it
+Status RedisSets::SUnion(const std::vector<std::string>& keys,
+                         const ElementVisitor& visitor) {
+  if (keys.size() <= 0) {
+    return Status::Corruption("SUnion invalid parameter, no keys");
+  }
+
+  rocksdb::ReadOptions read_options;
+  const rocksdb::Snapshot* snapshot;
+
+  std::string meta_value;
+  ScopeSnapshot ss(db_, &snapshot);
+  read_options.snapshot = snapshot;
+  std::vector<KeyVersion> vaild_sets;
+  Status s;
+
+  for (uint32_t idx = 0; idx < keys.size(); ++idx) {
+    s = db_->Get(read_options, handles_[0], keys[idx], &meta_value);
+    if (s.ok()) {
+      ParsedSetsMetaValue parsed_sets_meta_value(&meta_value);
+      if (!parsed_sets_meta_value.IsStale() &&
+        parsed_sets_meta_value.count() != 0) {
+        vaild_sets.push_back({keys[idx], parsed_sets_meta_value.version()});
+      }
+    } else if (!s.IsNotFound()) {
+      return s;
+    }
+  }
+
+  std::string member_value;
+  for (uint32_t idx = 0; idx < vaild_sets.size(); ++idx) {
+    SetsMemberKey sets_member_key(vaild_sets[idx].key,
+        vaild_sets[idx].version, Slice());
+    SetsMemberKey sets_member_next_key(vaild_sets[idx].key,
+        vaild_sets[idx].version + 1, Slice());
+    Slice prefix = sets_member_key.Encode();
+    ScopeIterator iter(nullptr, db_, handles_[1], read_options,
+                       sets_member_next_key.Encode());
+    for (iter->Seek(prefix);
+         iter->Valid() && iter->key().starts_with(prefix);
+         iter->Next()) {
+      ParsedSetsMemberKey parsed_sets_member_key(iter->key());
+      Slice member = parsed_sets_member_key.member();
+      bool seen = false;
+      for (uint32_t prev = 0; prev < idx && !seen; ++prev) {
+        SetsMemberKey prev_member_key(vaild_sets[prev].key,
+            vaild_sets[prev].version, member);
+        s = db_->Get(read_options, handles_[1],
+                prev_member_key.Encode(), &member_value);
+        if (s.ok()) {
+          seen = true;
+        } else if (!s.IsNotFound()) {
+          return s;
+        }
+      }
+      if (!seen && !visitor(member)) {
+        return Status::OK();
+      }
+    }
+  }
+  return Status::OK();
+}
+
 Status RedisSets::SUnionstore(const Slice& destination,
                               const std::vector<std::string>& keys,
                               int32_t* ret) {
@@ -1083,6 +1336,9 @@ Status RedisSets::SUnionstore(const Slice& destination,
   std::string meta_value;
   int32_t version = 0;
   ScopeRecordLock l(lock_mgr_, destination);
+  if (!l.status().ok()) {
+    return l.status();
+  }
   ScopeSnapshot ss(db_, &snapshot);
   read_options.snapshot = snapshot;
   std::vector<KeyVersion> vaild_sets;
@@ -1162,37 +1418,74 @@ Status RedisSets::SScan(const Slice& key,
     return Status::OK();
   }
 
+  std::string start_point, next_member;
+  Status s = GetScanStartPoint(key, pattern, cursor, &start_point);
+  GlobPattern glob(pattern);
+  if (s.IsNotFound()) {
+    cursor = 0;
+    start_point = glob.prefix();
+  }
+
+  bool has_next = false;
+  s = SScanFrom(key, start_point, glob, count,
+                members, &next_member, &has_next);
+  if (s.ok() && has_next) {
+    *next_cursor = cursor + count;
+    StoreScanNextPoint(key, pattern, *next_cursor, next_member);
+  }
+  return s;
+}
+
+Status RedisSets::SScan(const Slice& key,
+                        const std::string& cursor,
+                        const std::string& pattern,
+                        int64_t count,
+                        std::vector<std::string>* members,
+                        std::string* next_cursor) {
+  next_cursor->clear();
+  members->clear();
+  char type_tag = DataTypeTag[kSets];
+  std::string start_point, next_member;
+  if (!cursor.empty()
+    && (!DecodeScanCursor(cursor, &type_tag, &start_point)
+      || type_tag != DataTypeTag[kSets])) {
+    return Status::InvalidArgument("invalid cursor");
+  }
+  GlobPattern glob(pattern);
+  if (start_point < glob.prefix()) {
+    start_point = glob.prefix();
+  }
+
+  bool has_next = false;
+  Status s = SScanFrom(key, start_point, glob, count,
+                       members, &next_member, &has_next);
+  if (s.ok() && has_next) {
+    *next_cursor = EncodeScanCursor(DataTypeTag[kSets], next_member);
+  }
+  return s;
+}
+
+Status RedisSets::SScanFrom(const Slice& key,
+                            const std::string& start_point,
+                            const GlobPattern& glob,
+                            int64_t count,
+                            std::vector<std::string>* members,
+                            std::string* next_member,
+                            bool* has_next) {
   int64_t rest = count;
-  int64_t step_length = count;
   rocksdb::ReadOptions read_options;
-  const rocksdb::Snapshot* snapshot;
 
   std::string meta_value;
-  ScopeSnapshot ss(db_, &snapshot);
-  read_options.snapshot = snapshot;
   Status s = db_->Get(read_options, handles_[0], key, &meta_value);
   if (s.ok()) {
     ParsedSetsMetaValue parsed_sets_meta_value(&meta_value);
     if (parsed_sets_meta_value.IsStale()
       || parsed_sets_meta_value.count() == 0) {
-      *next_cursor = 0;
       return Status::NotFound();
     } else {
-      std::string sub_member;
-      std::string start_point;
       int32_t version = parsed_sets_meta_value.version();
-      s = GetScanStartPoint(key, pattern, cursor, &start_point);
-      if (s.IsNotFound()) {
-        cursor = 0;
-        if (isTailWildcard(pattern)) {
-          start_point = pattern.substr(0, pattern.size() - 1);
-        }
-      }
-      if (isTailWildcard(pattern)) {
-        sub_member = pattern.substr(0, pattern.size() - 1);
-      }
 
-      SetsMemberKey sets_member_prefix(key, version, sub_member);
+      SetsMemberKey sets_member_prefix(key, version, glob.prefix());
       SetsMemberKey sets_member_key(key, version, start_point);
       std::string prefix = sets_member_prefix.Encode().ToString();
       rocksdb::Iterator* iter = db_->NewIterator(read_options, handles_[1]);
@@ -1201,8 +1494,7 @@ Status RedisSets::SScan(const Slice& key,
            iter->Next()) {
         ParsedSetsMemberKey parsed_sets_member_key(iter->key());
         std::string member = parsed_sets_member_key.member().ToString();
-        if (StringMatch(pattern.data(),
-              pattern.size(), member.data(), member.size(), 0)) {
+        if (glob.Match(member)) {
           members->push_back(member);
         }
         rest--;
@@ -1211,17 +1503,13 @@ Status RedisSets::SScan(const Slice& key,
       if (iter->Valid()
         && (iter->key().compare(prefix) <= 0
           || iter->key().starts_with(prefix))) {
-        *next_cursor = cursor + step_length;
+        *has_next = true;
         ParsedSetsMemberKey parsed_sets_member_key(iter->key());
-        std::string next_member = parsed_sets_member_key.member().ToString();
-        StoreScanNextPoint(key, pattern, *next_cursor, next_member);
-      } else {
-        *next_cursor = 0;
+        *next_member = parsed_sets_member_key.member().ToString();
       }
       delete iter;
     }
   } else {
-    *next_cursor = 0;
     return s;
   }
   return Status::OK();
@@ -1242,6 +1530,7 @@ Status RedisSets::PKScanRange(const Slice& key_start,
   ScopeSnapshot ss(db_, &snapshot);
   iterator_options.snapshot = snapshot;
   iterator_options.fill_cache = false;
+  GlobPattern glob(pattern.ToString());
 
   bool start_no_limit = !key_start.compare("");
   bool end_no_limit = !key_end.compare("");
@@ -1253,22 +1542,23 @@ Status RedisSets::PKScanRange(const Slice& key_start,
   }
 
   rocksdb::Iterator* it = db_->NewIterator(iterator_options, handles_[0]);
-  if (start_no_limit) {
-    it->SeekToFirst();
+  // Keys before the literal prefix of pattern can not match
+  if (start_no_limit || key_start.compare(glob.prefix()) < 0) {
+    it->Seek(glob.prefix());
   } else {
     it->Seek(key_start);
   }
 
   while (it->Valid() && remain > 0
-    && (end_no_limit || it->key().compare(key_end) <= 0)) {
+    && (end_no_limit || it->key().compare(key_end) <= 0)
+    && !glob.PastPrefix(it->key())) {
     ParsedSetsMetaValue parsed_meta_value(it->value());
     if (parsed_meta_value.IsStale()
       || parsed_meta_value.count() == 0) {
       it->Next();
     } else {
       key = it->key().ToString();
-      if (StringMatch(pattern.data(), pattern.size(),
-                         key.data(), key.size(), 0)) {
+      if (glob.Match(key)) {
         keys->push_back(key);
       }
       remain--;
@@ -1277,7 +1567,8 @@ Status RedisSets::PKScanRange(const Slice& key_start,
   }
 
   while (it->Valid()
-    && (end_no_limit || it->key().compare(key_end) <= 0)) {
+    && (end_no_limit || it->key().compare(key_end) <= 0)
+    && !glob.PastPrefix(it->key())) {
     ParsedSetsMetaValue parsed_sets_meta_value(it->value());
     if (parsed_sets_meta_value.IsStale()
       || parsed_sets_meta_value.count() == 0) {
@@ -1306,6 +1597,7 @@ Status RedisSets::PKRScanRange(const Slice& key_start,
   ScopeSnapshot ss(db_, &snapshot);
   iterator_options.snapshot = snapshot;
   iterator_options.fill_cache = false;
+  GlobPattern glob(pattern.ToString());
 
   bool start_no_limit = !key_start.compare("");
   bool end_no_limit = !key_end.compare("");
@@ -1331,8 +1623,7 @@ Status RedisSets::PKRScanRange(const Slice& key_start,
       it->Prev();
     } else {
       key = it->key().ToString();
-      if (StringMatch(pattern.data(), pattern.size(),
-                         key.data(), key.size(), 0)) {
+      if (glob.Match(key)) {
         keys->push_back(key);
       }
       remain--;
@@ -1358,6 +1649,9 @@ Status RedisSets::PKRScanRange(const Slice& key_start,
 Status RedisSets::Expire(const Slice& key, int32_t ttl) {
   std::string meta_value;
   ScopeRecordLock l(lock_mgr_, key);
+  if (!l.status().ok()) {
+    return l.status();
+  }
   Status s = db_->Get(default_read_options_, handles_[0], key, &meta_value);
   if (s.ok()) {
     ParsedSetsMetaValue parsed_sets_meta_value(&meta_value);
@@ -1381,6 +1675,9 @@ Status RedisSets::Expire(const Slice& key, int32_t ttl) {
 Status RedisSets::Del(const Slice& key) {
   std::string meta_value;
   ScopeRecordLock l(lock_mgr_, key);
+  if (!l.status().ok()) {
+    return l.status();
+  }
   Status s = db_->Get(default_read_options_, handles_[0], key, &meta_value);
   if (s.ok()) {
     ParsedSetsMetaValue parsed_sets_meta_value(&meta_value);
@@ -1410,11 +1707,13 @@ bool RedisSets::Scan(const std::string& start_key,
   ScopeSnapshot ss(db_, &snapshot);
   iterator_options.snapshot = snapshot;
   iterator_options.fill_cache = false;
+  GlobPattern glob(pattern);
 
   rocksdb::Iterator* it = db_->NewIterator(iterator_options, handles_[0]);
 
-  it->Seek(start_key);
-  while (it->Valid() && (*count) > 0) {
+  it->Seek(start_key < glob.prefix() ? glob.prefix() : start_key);
+  while (it->Valid() && (*count) > 0
+    && !glob.PastPrefix(it->key())) {
     ParsedSetsMetaValue parsed_meta_value(it->value());
     if (parsed_meta_value.IsStale()
       || parsed_meta_value.count() == 0) {
@@ -1422,8 +1721,7 @@ bool RedisSets::Scan(const std::string& start_key,
       continue;
     } else {
       meta_key = it->key().ToString();
-      if (StringMatch(pattern.data(), pattern.size(),
-                         meta_key.data(), meta_key.size(), 0)) {
+      if (glob.Match(meta_key)) {
         keys->push_back(meta_key);
       }
       (*count)--;
@@ -1431,10 +1729,7 @@ bool RedisSets::Scan(const std::string& start_key,
     }
   }
 
-  std::string prefix = isTailWildcard(pattern) ?
-    pattern.substr(0, pattern.size() - 1) : "";
-  if (it->Valid()
-    && (it->key().compare(prefix) <= 0 || it->key().starts_with(prefix))) {
+  if (it->Valid() && !glob.PastPrefix(it->key())) {
     *next_key = it->key().ToString();
     is_finish = false;
   } else {
@@ -1487,6 +1782,9 @@ bool RedisSets::PKExpireScan(const std::string& start_key,
 Status RedisSets::Expireat(const Slice& key, int32_t timestamp) {
   std::string meta_value;
   ScopeRecordLock l(lock_mgr_, key);
+  if (!l.status().ok()) {
+    return l.status();
+  }
   Status s = db_->Get(default_read_options_, handles_[0], key, &meta_value);
   if (s.ok()) {
     ParsedSetsMetaValue parsed_sets_meta_value(&meta_value);
@@ -1509,6 +1807,9 @@ Status RedisSets::Expireat(const Slice& key, int32_t timestamp) {
 Status RedisSets::Persist(const Slice& key) {
   std::string meta_value;
   ScopeRecordLock l(lock_mgr_, key);
+  if (!l.status().ok()) {
+    return l.status();
+  }
   Status s = db_->Get(default_read_options_, handles_[0], key, &meta_value);
   if (s.ok()) {
     ParsedSetsMetaValue parsed_sets_meta_value(&meta_value);
@@ -1545,8 +1846,7 @@ Status RedisSets::TTL(const Slice& key, int64_t* timestamp) {
       if (*timestamp == 0) {
         *timestamp = -1;
       } else {
-        int64_t curtime;
-        rocksdb::Env::Default()->GetCurrentTime(&curtime);
+        int64_t curtime = CoarseClock::Now();
         *timestamp = *timestamp - curtime >= 0 ? *timestamp - curtime : -2;
       }
     }
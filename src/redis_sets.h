@@ -14,6 +14,7 @@
 
 #include "src/redis.h"
 #include "src/lru_cache.h"
+#include "src/write_combiner.h"
 #include "src/custom_comparator.h"
 
 #define SPOP_COMPACT_THRESHOLD_COUNT     500
@@ -33,10 +34,14 @@ class RedisSets : public Redis {
                       const rocksdb::Slice* end,
                       const ColumnFamilyType& type = kMetaAndData) override;
   Status GetProperty(const std::string& property, uint64_t* out) override;
-  Status ScanKeyNum(KeyInfo* key_info) override;
-  Status ScanKeys(const std::string& pattern,
-                  std::vector<std::string>* keys) override;
-  Status PKPatternMatchDel(const std::string& pattern, int32_t* ret) override;
+  Status ScanKeyNum(const KeyRange& range, const std::atomic<bool>& stop,
+                    KeyInfo* key_info) override;
+  Status ScanKeySizes(const std::atomic<bool>& stop,
+                      const KeySizeVisitor& visitor) override;
+  Status ScanKeys(const std::string& pattern, const KeyRange& range,
+                  const ElementVisitor& visitor) override;
+  Status PKPatternMatchDel(const std::string& pattern, const KeyRange& range,
+                           int32_t* ret) override;
 
   // Setes Commands
   Status SAdd(const Slice& key,
@@ -56,6 +61,8 @@ class RedisSets : public Redis {
                    int32_t* ret);
   Status SMembers(const Slice& key,
                   std::vector<std::string>* members);
+  Status SMembers(const Slice& key,
+                  const ElementVisitor& visitor);
   Status SMove(const Slice& source, const Slice& destination,
                const Slice& member, int32_t* ret);
   Status SPop(const Slice& key, std::string* member, bool* need_compact);
@@ -65,12 +72,17 @@ class RedisSets : public Redis {
               int32_t* ret);
   Status SUnion(const std::vector<std::string>& keys,
                 std::vector<std::string>* members);
+  Status SUnion(const std::vector<std::string>& keys,
+                const ElementVisitor& visitor);
   Status SUnionstore(const Slice& destination,
                      const std::vector<std::string>& keys,
                      int32_t* ret);
   Status SScan(const Slice& key, int64_t cursor,
                const std::string& pattern, int64_t count,
                std::vector<std::string>* members, int64_t* next_cursor);
+  Status SScan(const Slice& key, const std::string& cursor,
+               const std::string& pattern, int64_t count,
+               std::vector<std::string>* members, std::string* next_cursor);
   Status PKScanRange(const Slice& key_start, const Slice& key_end,
                      const Slice& pattern, int32_t limit,
                      std::vector<std::string>* keys, std::string* next_key);
@@ -97,10 +109,25 @@ class RedisSets : public Redis {
   void ScanDatabase();
 
  private:
+  // Shared by the SScan with a cursors store and the stateless one
+  Status SScanFrom(const Slice& key, const std::string& start_point,
+                   const GlobPattern& glob, int64_t count,
+                   std::vector<std::string>* members,
+                   std::string* next_member, bool* has_next);
+
   // For compact in time after multiple spop
   LRUCache<std::string, size_t>* spop_counts_store_;
   Status ResetSpopCount(const std::string& key);
   Status AddAndGetSpopCount(const std::string& key, uint64_t* count);
+
+  // For write combining
+  struct SAddOp {
+    const std::vector<std::string>* members;
+    int32_t ret;
+  };
+  typedef WriteCombiner<SAddOp> SAddCombiner;
+  SAddCombiner sadd_combiner_;
+  void ApplySAdds(const Slice& key, const SAddCombiner::Requests& requests);
 };
 
 }  //  namespace blackwidow
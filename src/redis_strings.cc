@@ -13,7 +13,9 @@
 #include "blackwidow/util.h"
 #include "src/strings_filter.h"
 #include "src/scope_record_lock.h"
+#include "src/instrumented_db.h"
 #include "src/scope_snapshot.h"
+#include "src/table_properties_collector.h"
 
 namespace blackwidow {
 
@@ -23,8 +25,14 @@ RedisStrings::RedisStrings(BlackWidow* const bw, const DataType& type)
 
 Status RedisStrings::Open(const BlackwidowOptions& bw_options,
     const std::string& db_path) {
+  lock_mgr_ = new LockMgr(bw_options.lock_slots);
+  garbage_compaction_ratio_ = bw_options.garbage_compaction_ratio;
+
   rocksdb::Options ops(bw_options.options);
   ops.compaction_filter_factory = std::make_shared<StringsFilterFactory>();
+  ops.table_properties_collector_factories.push_back(
+    std::make_shared<GarbagePropertiesCollectorFactory>(
+        RecordFormat::kStringsValue, bw_options.garbage_compaction_ratio));
 
   // use the bloom filter policy to reduce disk reads
   rocksdb::BlockBasedTableOptions table_ops(bw_options.table_options);
@@ -34,7 +42,11 @@ Status RedisStrings::Open(const BlackwidowOptions& bw_options,
   table_ops.filter_policy.reset(rocksdb::NewBloomFilterPolicy(10, true));
   ops.table_factory.reset(rocksdb::NewBlockBasedTableFactory(table_ops));
 
-  return rocksdb::DB::Open(ops, db_path, &db_);
+  Status s = rocksdb::DB::Open(ops, db_path, &db_);
+  if (s.ok()) {
+    db_ = new InstrumentedDB(db_, false);
+  }
+  return s;
 }
 
 Status RedisStrings::CompactRange(const rocksdb::Slice* begin,
@@ -50,7 +62,9 @@ Status RedisStrings::GetProperty(const std::string& property, uint64_t* out) {
   return Status::OK();
 }
 
-Status RedisStrings::ScanKeyNum(KeyInfo* key_info) {
+Status RedisStrings::ScanKeyNum(const KeyRange& range,
+                                const std::atomic<bool>& stop,
+                                KeyInfo* key_info) {
   uint64_t keys = 0;
   uint64_t expires = 0;
   uint64_t ttl_sum = 0;
@@ -60,17 +74,23 @@ Status RedisStrings::ScanKeyNum(KeyInfo* key_info) {
   const rocksdb::Snapshot* snapshot;
   ScopeSnapshot ss(db_, &snapshot);
   iterator_options.snapshot = snapshot;
-  iterator_options.fill_cache = false;
+  scan_policy_.ForKeyspaceScan(&iterator_options);
+  rocksdb::Slice upper_bound(range.end);
+  if (!range.end.empty()) {
+    iterator_options.iterate_upper_bound = &upper_bound;
+  }
 
-  int64_t curtime;
-  rocksdb::Env::Default()->GetCurrentTime(&curtime);
+  int64_t curtime = CoarseClock::Now();
 
   // Note: This is a string type and does not need to pass the column family as
   // a parameter, use the default column family
   rocksdb::Iterator* iter = db_->NewIterator(iterator_options);
-  for (iter->SeekToFirst();
+  for (iter->Seek(range.start);
        iter->Valid();
        iter->Next()) {
+    if (stop.load(std::memory_order_relaxed)) {
+      break;
+    }
     ParsedStringsValue parsed_strings_value(iter->value());
     if (parsed_strings_value.IsStale()) {
       invaild_keys++;
@@ -91,27 +111,59 @@ Status RedisStrings::ScanKeyNum(KeyInfo* key_info) {
   return Status::OK();
 }
 
+Status RedisStrings::ScanKeySizes(const std::atomic<bool>& stop,
+                                  const KeySizeVisitor& visitor) {
+  rocksdb::ReadOptions iterator_options;
+  const rocksdb::Snapshot* snapshot;
+  ScopeSnapshot ss(db_, &snapshot);
+  iterator_options.snapshot = snapshot;
+  scan_policy_.ForKeyspaceScan(&iterator_options);
+
+  // Note: This is a string type and does not need to pass the column family as
+  // a parameter, use the default column family
+  rocksdb::Iterator* iter = db_->NewIterator(iterator_options);
+  for (iter->SeekToFirst();
+       iter->Valid() && !stop.load(std::memory_order_relaxed);
+       iter->Next()) {
+    ParsedStringsValue parsed_strings_value(iter->value());
+    if (!parsed_strings_value.IsStale()) {
+      visitor(iter->key(), parsed_strings_value.user_value().size());
+    }
+  }
+  delete iter;
+  return Status::OK();
+}
+
 Status RedisStrings::ScanKeys(const std::string& pattern,
-                              std::vector<std::string>* keys) {
+                              const KeyRange& range,
+                              const ElementVisitor& visitor) {
   std::string key;
   rocksdb::ReadOptions iterator_options;
   const rocksdb::Snapshot* snapshot;
   ScopeSnapshot ss(db_, &snapshot);
   iterator_options.snapshot = snapshot;
-  iterator_options.fill_cache = false;
+  scan_policy_.ForKeyspaceScan(&iterator_options);
+
+  // Only the keys of range starting with the literal prefix of pattern
+  // can match
+  GlobPattern glob(pattern);
+  KeyRange scan_range = range.Intersect(glob.prefix(), glob.upper_bound());
+  rocksdb::Slice upper_bound(scan_range.end);
+  if (!scan_range.end.empty()) {
+    iterator_options.iterate_upper_bound = &upper_bound;
+  }
 
   // Note: This is a string type and does not need to pass the column family as
   // a parameter, use the default column family
   rocksdb::Iterator* iter = db_->NewIterator(iterator_options);
-  for (iter->SeekToFirst();
+  for (iter->Seek(scan_range.start);
        iter->Valid();
        iter->Next()) {
     ParsedStringsValue parsed_strings_value(iter->value());
     if (!parsed_strings_value.IsStale()) {
       key = iter->key().ToString();
-      if (StringMatch(pattern.data(),
-            pattern.size(), key.data(), key.size(), 0)) {
-        keys->push_back(key);
+      if (glob.Match(key) && !visitor(key)) {
+        break;
       }
     }
   }
@@ -120,12 +172,22 @@ Status RedisStrings::ScanKeys(const std::string& pattern,
 }
 
 Status RedisStrings::PKPatternMatchDel(const std::string& pattern,
+                                       const KeyRange& range,
                                        int32_t* ret) {
   rocksdb::ReadOptions iterator_options;
   const rocksdb::Snapshot* snapshot;
   ScopeSnapshot ss(db_, &snapshot);
   iterator_options.snapshot = snapshot;
-  iterator_options.fill_cache = false;
+  scan_policy_.ForKeyspaceScan(&iterator_options);
+
+  // Only the keys of range starting with the literal prefix of pattern
+  // can match
+  GlobPattern glob(pattern);
+  KeyRange scan_range = range.Intersect(glob.prefix(), glob.upper_bound());
+  rocksdb::Slice upper_bound(scan_range.end);
+  if (!scan_range.end.empty()) {
+    iterator_options.iterate_upper_bound = &upper_bound;
+  }
 
   std::string key;
   std::string value;
@@ -133,13 +195,13 @@ Status RedisStrings::PKPatternMatchDel(const std::string& pattern,
   Status s;
   rocksdb::WriteBatch batch;
   rocksdb::Iterator* iter = db_->NewIterator(iterator_options);
-  iter->SeekToFirst();
+  iter->Seek(scan_range.start);
   while (iter->Valid()) {
     key = iter->key().ToString();
     value = iter->value().ToString();
     ParsedStringsValue parsed_strings_value(&value);
     if (!parsed_strings_value.IsStale()
-      && StringMatch(pattern.data(), pattern.size(), key.data(), key.size(), 0)) {
+      && glob.Match(key)) {
       batch.Delete(key);
     }
     // In order to be more efficient, we use batch deletion here
@@ -172,6 +234,9 @@ Status RedisStrings::Append(const Slice& key, const Slice& value,
   std::string old_value;
   *ret = 0;
   ScopeRecordLock l(lock_mgr_, key);
+  if (!l.status().ok()) {
+    return l.status();
+  }
   Status s = db_->Get(default_read_options_, key, &old_value);
   if (s.ok()) {
     ParsedStringsValue parsed_strings_value(&old_value);
@@ -354,6 +419,9 @@ Status RedisStrings::BitOp(BitOpType op,
   StringsValue strings_value(Slice(dest_value.c_str(),
                                    static_cast<size_t>(max_len)));
   ScopeRecordLock l(lock_mgr_, dest_key);
+  if (!l.status().ok()) {
+    return l.status();
+  }
   return db_->Put(default_write_options_, dest_key, strings_value.Encode());
 }
 
@@ -361,6 +429,9 @@ Status RedisStrings::Decrby(const Slice& key, int64_t value, int64_t* ret) {
   std::string old_value;
   std::string new_value;
   ScopeRecordLock l(lock_mgr_, key);
+  if (!l.status().ok()) {
+    return l.status();
+  }
   Status s = db_->Get(default_read_options_, key, &old_value);
   if (s.ok()) {
     ParsedStringsValue parsed_strings_value(&old_value);
@@ -412,6 +483,22 @@ Status RedisStrings::Get(const Slice& key, std::string* value) {
   return s;
 }
 
+Status RedisStrings::Get(const Slice& key, PinnableSlice* value) {
+  value->Reset();
+  Status s = db_->Get(default_read_options_, db_->DefaultColumnFamily(),
+                      key, value);
+  if (s.ok()) {
+    ParsedStringsValue parsed_strings_value(*value);
+    if (parsed_strings_value.IsStale()) {
+      value->Reset();
+      return Status::NotFound("Stale");
+    } else {
+      value->remove_suffix(ParsedStringsValue::kStringsValueSuffixLength);
+    }
+  }
+  return s;
+}
+
 Status RedisStrings::GetBit(const Slice& key, int64_t offset, int32_t* ret) {
   std::string meta_value;
   Status s = db_->Get(default_read_options_, key, &meta_value);
@@ -480,6 +567,9 @@ Status RedisStrings::Getrange(const Slice& key,
 Status RedisStrings::GetSet(const Slice& key, const Slice& value,
                             std::string* old_value) {
   ScopeRecordLock l(lock_mgr_, key);
+  if (!l.status().ok()) {
+    return l.status();
+  }
   Status s = db_->Get(default_read_options_, key, old_value);
   if (s.ok()) {
     ParsedStringsValue parsed_strings_value(old_value);
@@ -499,6 +589,9 @@ Status RedisStrings::Incrby(const Slice& key, int64_t value, int64_t* ret) {
   std::string old_value;
   std::string new_value;
   ScopeRecordLock l(lock_mgr_, key);
+  if (!l.status().ok()) {
+    return l.status();
+  }
   Status s = db_->Get(default_read_options_, key, &old_value);
   if (s.ok()) {
     ParsedStringsValue parsed_strings_value(&old_value);
@@ -545,6 +638,9 @@ Status RedisStrings::Incrbyfloat(const Slice& key, const Slice& value,
     return Status::Corruption("Value is not a vaild float");
   }
   ScopeRecordLock l(lock_mgr_, key);
+  if (!l.status().ok()) {
+    return l.status();
+  }
   Status s = db_->Get(default_read_options_, key, &old_value);
   if (s.ok()) {
     ParsedStringsValue parsed_strings_value(&old_value);
@@ -584,16 +680,15 @@ Status RedisStrings::MGet(const std::vector<std::string>& keys,
                           std::vector<ValueStatus>* vss) {
   vss->clear();
 
-  Status s;
-  std::string value;
-  rocksdb::ReadOptions read_options;
-  const rocksdb::Snapshot* snapshot;
-  ScopeSnapshot ss(db_, &snapshot);
-  read_options.snapshot = snapshot;
-  for (const auto& key : keys) {
-    s = db_->Get(read_options, key, &value);
+  // One MultiGet reads all the keys at one sequence
+  std::vector<Slice> keys_slices(keys.begin(), keys.end());
+  std::vector<std::string> values;
+  std::vector<Status> statuses =
+    db_->MultiGet(default_read_options_, keys_slices, &values);
+  for (size_t idx = 0; idx < keys.size(); ++idx) {
+    const Status& s = statuses[idx];
     if (s.ok()) {
-      ParsedStringsValue parsed_strings_value(&value);
+      ParsedStringsValue parsed_strings_value(&values[idx]);
       if (parsed_strings_value.IsStale()) {
         vss->push_back({std::string(), Status::NotFound("Stale")});
       } else {
@@ -610,6 +705,45 @@ Status RedisStrings::MGet(const std::vector<std::string>& keys,
   return Status::OK();
 }
 
+Status RedisStrings::MGet(const std::vector<std::string>& keys,
+                          PinnableSlice* values, Status* statuses) {
+#ifdef BLACKWIDOW_PINNED_MULTIGET
+  // One batched MultiGet reads all the keys at one sequence
+  std::vector<Slice> keys_slices(keys.begin(), keys.end());
+  for (size_t idx = 0; idx < keys.size(); ++idx) {
+    values[idx].Reset();
+  }
+  db_->MultiGet(default_read_options_, db_->DefaultColumnFamily(),
+                keys_slices.size(), keys_slices.data(), values, statuses);
+#else
+  rocksdb::ReadOptions read_options;
+  const rocksdb::Snapshot* snapshot;
+  ScopeSnapshot ss(db_, &snapshot);
+  read_options.snapshot = snapshot;
+  for (size_t idx = 0; idx < keys.size(); ++idx) {
+    values[idx].Reset();
+    statuses[idx] = db_->Get(read_options, db_->DefaultColumnFamily(),
+                             keys[idx], &values[idx]);
+  }
+#endif
+  for (size_t idx = 0; idx < keys.size(); ++idx) {
+    PinnableSlice* value = &values[idx];
+    const Status& s = statuses[idx];
+    if (s.ok()) {
+      ParsedStringsValue parsed_strings_value(*value);
+      if (parsed_strings_value.IsStale()) {
+        value->Reset();
+        statuses[idx] = Status::NotFound("Stale");
+      } else {
+        value->remove_suffix(ParsedStringsValue::kStringsValueSuffixLength);
+      }
+    } else if (!s.IsNotFound()) {
+      return s;
+    }
+  }
+  return Status::OK();
+}
+
 Status RedisStrings::MSet(const std::vector<KeyValue>& kvs) {
   std::vector<std::string> keys;
   for (const auto& kv :  kvs) {
@@ -617,6 +751,9 @@ Status RedisStrings::MSet(const std::vector<KeyValue>& kvs) {
   }
 
   MultiScopeRecordLock ml(lock_mgr_, keys);
+  if (!ml.status().ok()) {
+    return ml.status();
+  }
   rocksdb::WriteBatch batch;
   for (const auto& kv : kvs) {
     StringsValue strings_value(kv.value);
@@ -654,6 +791,9 @@ Status RedisStrings::Set(const Slice& key,
                          const Slice& value) {
   StringsValue strings_value(value);
   ScopeRecordLock l(lock_mgr_, key);
+  if (!l.status().ok()) {
+    return l.status();
+  }
   return db_->Put(default_write_options_, key, strings_value.Encode());
 }
 
@@ -665,6 +805,9 @@ Status RedisStrings::Setxx(const Slice& key,
   std::string old_value;
   StringsValue strings_value(value);
   ScopeRecordLock l(lock_mgr_, key);
+  if (!l.status().ok()) {
+    return l.status();
+  }
   Status s = db_->Get(default_read_options_, key, &old_value);
   if (s.ok()) {
     ParsedStringsValue parsed_strings_value(old_value);
@@ -695,6 +838,9 @@ Status RedisStrings::SetBit(const Slice& key, int64_t offset,
   }
 
   ScopeRecordLock l(lock_mgr_, key);
+  if (!l.status().ok()) {
+    return l.status();
+  }
   Status s = db_->Get(default_read_options_, key, &meta_value);
   if (s.ok() || s.IsNotFound()) {
     std::string data_value;
@@ -740,6 +886,9 @@ Status RedisStrings::Setex(const Slice& key, const Slice& value, int32_t ttl) {
   StringsValue strings_value(value);
   strings_value.SetRelativeTimestamp(ttl);
   ScopeRecordLock l(lock_mgr_, key);
+  if (!l.status().ok()) {
+    return l.status();
+  }
   return db_->Put(default_write_options_, key, strings_value.Encode());
 }
 
@@ -750,6 +899,9 @@ Status RedisStrings::Setnx(const Slice& key,
   *ret = 0;
   std::string old_value;
   ScopeRecordLock l(lock_mgr_, key);
+  if (!l.status().ok()) {
+    return l.status();
+  }
   Status s = db_->Get(default_read_options_, key, &old_value);
   if (s.ok()) {
     ParsedStringsValue parsed_strings_value(&old_value);
@@ -784,6 +936,9 @@ Status RedisStrings::Setvx(const Slice& key,
   *ret = 0;
   std::string old_value;
   ScopeRecordLock l(lock_mgr_, key);
+  if (!l.status().ok()) {
+    return l.status();
+  }
   Status s = db_->Get(default_read_options_, key, &old_value);
   if (s.ok()) {
     ParsedStringsValue parsed_strings_value(&old_value);
@@ -816,6 +971,9 @@ Status RedisStrings::Delvx(const Slice& key, const Slice& value, int32_t* ret) {
   *ret = 0;
   std::string old_value;
   ScopeRecordLock l(lock_mgr_, key);
+  if (!l.status().ok()) {
+    return l.status();
+  }
   Status s = db_->Get(default_read_options_, key, &old_value);
   if (s.ok()) {
     ParsedStringsValue parsed_strings_value(&old_value);
@@ -845,6 +1003,9 @@ Status RedisStrings::Setrange(const Slice& key, int64_t start_offset,
   }
 
   ScopeRecordLock l(lock_mgr_, key);
+  if (!l.status().ok()) {
+    return l.status();
+  }
   Status s = db_->Get(default_read_options_, key, &old_value);
   if (s.ok()) {
     ParsedStringsValue parsed_strings_value(&old_value);
@@ -1086,6 +1247,9 @@ Status RedisStrings::BitPos(const Slice& key, int32_t bit,
 Status RedisStrings::PKSetexAt(const Slice& key, const Slice& value, int32_t timestamp) {
   StringsValue strings_value(value);
   ScopeRecordLock l(lock_mgr_, key);
+  if (!l.status().ok()) {
+    return l.status();
+  }
   strings_value.set_timestamp(timestamp);
   return db_->Put(default_write_options_, key, strings_value.Encode());
 }
@@ -1105,6 +1269,7 @@ Status RedisStrings::PKScanRange(const Slice& key_start,
   ScopeSnapshot ss(db_, &snapshot);
   iterator_options.snapshot = snapshot;
   iterator_options.fill_cache = false;
+  GlobPattern glob(pattern.ToString());
 
   bool start_no_limit = !key_start.compare("");
   bool end_no_limit = !key_end.compare("");
@@ -1118,22 +1283,23 @@ Status RedisStrings::PKScanRange(const Slice& key_start,
   // Note: This is a string type and does not need to pass the column family as
   // a parameter, use the default column family
   rocksdb::Iterator* it = db_->NewIterator(iterator_options);
-  if (start_no_limit) {
-    it->SeekToFirst();
+  // Keys before the literal prefix of pattern can not match
+  if (start_no_limit || key_start.compare(glob.prefix()) < 0) {
+    it->Seek(glob.prefix());
   } else {
     it->Seek(key_start);
   }
 
   while (it->Valid() && remain > 0
-    && (end_no_limit || it->key().compare(key_end) <= 0)) {
+    && (end_no_limit || it->key().compare(key_end) <= 0)
+    && !glob.PastPrefix(it->key())) {
     ParsedStringsValue parsed_strings_value(it->value());
     if (parsed_strings_value.IsStale()) {
       it->Next();
     } else {
       key = it->key().ToString();
       value = parsed_strings_value.value().ToString();
-      if (StringMatch(pattern.data(), pattern.size(),
-                         key.data(), key.size(), 0)) {
+      if (glob.Match(key)) {
         kvs->push_back({key, value});
       }
       remain--;
@@ -1142,7 +1308,8 @@ Status RedisStrings::PKScanRange(const Slice& key_start,
   }
 
   while (it->Valid()
-    && (end_no_limit || it->key().compare(key_end) <= 0)) {
+    && (end_no_limit || it->key().compare(key_end) <= 0)
+    && !glob.PastPrefix(it->key())) {
     ParsedStringsValue parsed_strings_value(it->value());
     if (parsed_strings_value.IsStale()) {
       it->Next();
@@ -1168,6 +1335,7 @@ Status RedisStrings::PKRScanRange(const Slice& key_start,
   ScopeSnapshot ss(db_, &snapshot);
   iterator_options.snapshot = snapshot;
   iterator_options.fill_cache = false;
+  GlobPattern glob(pattern.ToString());
 
   bool start_no_limit = !key_start.compare("");
   bool end_no_limit = !key_end.compare("");
@@ -1195,8 +1363,7 @@ Status RedisStrings::PKRScanRange(const Slice& key_start,
     } else {
       key = it->key().ToString();
       value = parsed_strings_value.value().ToString();
-      if (StringMatch(pattern.data(), pattern.size(),
-                         key.data(), key.size(), 0)) {
+      if (glob.Match(key)) {
         kvs->push_back({key, value});
       }
       remain--;
@@ -1222,6 +1389,9 @@ Status RedisStrings::PKRScanRange(const Slice& key_start,
 Status RedisStrings::Expire(const Slice& key, int32_t ttl) {
   std::string value;
   ScopeRecordLock l(lock_mgr_, key);
+  if (!l.status().ok()) {
+    return l.status();
+  }
   Status s = db_->Get(default_read_options_, key, &value);
   if (s.ok()) {
     ParsedStringsValue parsed_strings_value(&value);
@@ -1241,6 +1411,9 @@ Status RedisStrings::Expire(const Slice& key, int32_t ttl) {
 Status RedisStrings::Del(const Slice& key) {
   std::string value;
   ScopeRecordLock l(lock_mgr_, key);
+  if (!l.status().ok()) {
+    return l.status();
+  }
   Status s = db_->Get(default_read_options_, key, &value);
   if (s.ok()) {
     ParsedStringsValue parsed_strings_value(&value);
@@ -1264,21 +1437,22 @@ bool RedisStrings::Scan(const std::string& start_key,
   ScopeSnapshot ss(db_, &snapshot);
   iterator_options.snapshot = snapshot;
   iterator_options.fill_cache = false;
+  GlobPattern glob(pattern);
 
   // Note: This is a string type and does not need to pass the column family as
   // a parameter, use the default column family
   rocksdb::Iterator* it = db_->NewIterator(iterator_options);
 
-  it->Seek(start_key);
-  while (it->Valid() && (*count) > 0) {
+  it->Seek(start_key < glob.prefix() ? glob.prefix() : start_key);
+  while (it->Valid() && (*count) > 0
+    && !glob.PastPrefix(it->key())) {
     ParsedStringsValue parsed_strings_value(it->value());
     if (parsed_strings_value.IsStale()) {
       it->Next();
       continue;
     } else {
       key = it->key().ToString();
-      if (StringMatch(pattern.data(), pattern.size(),
-                         key.data(), key.size(), 0)) {
+      if (glob.Match(key)) {
         keys->push_back(key);
       }
       (*count)--;
@@ -1286,10 +1460,7 @@ bool RedisStrings::Scan(const std::string& start_key,
     }
   }
 
-  std::string prefix = isTailWildcard(pattern) ?
-    pattern.substr(0, pattern.size() - 1) : "";
-  if (it->Valid()
-    && (it->key().compare(prefix) <= 0 || it->key().starts_with(prefix))) {
+  if (it->Valid() && !glob.PastPrefix(it->key())) {
     is_finish = false;
     *next_key = it->key().ToString();
   } else {
@@ -1342,6 +1513,9 @@ bool RedisStrings::PKExpireScan(const std::string& start_key,
 Status RedisStrings::Expireat(const Slice& key, int32_t timestamp) {
   std::string value;
   ScopeRecordLock l(lock_mgr_, key);
+  if (!l.status().ok()) {
+    return l.status();
+  }
   Status s = db_->Get(default_read_options_, key, &value);
   if (s.ok()) {
     ParsedStringsValue parsed_strings_value(&value);
@@ -1362,6 +1536,9 @@ Status RedisStrings::Expireat(const Slice& key, int32_t timestamp) {
 Status RedisStrings::Persist(const Slice& key) {
   std::string value;
   ScopeRecordLock l(lock_mgr_, key);
+  if (!l.status().ok()) {
+    return l.status();
+  }
   Status s = db_->Get(default_read_options_, key, &value);
   if (s.ok()) {
     ParsedStringsValue parsed_strings_value(&value);
@@ -1383,6 +1560,9 @@ Status RedisStrings::Persist(const Slice& key) {
 Status RedisStrings::TTL(const Slice& key, int64_t* timestamp) {
   std::string value;
   ScopeRecordLock l(lock_mgr_, key);
+  if (!l.status().ok()) {
+    return l.status();
+  }
   Status s = db_->Get(default_read_options_, key, &value);
   if (s.ok()) {
     ParsedStringsValue parsed_strings_value(&value);
@@ -1394,8 +1574,7 @@ Status RedisStrings::TTL(const Slice& key, int64_t* timestamp) {
       if (*timestamp == 0) {
         *timestamp = -1;
       } else {
-        int64_t curtime;
-        rocksdb::Env::Default()->GetCurrentTime(&curtime);
+        int64_t curtime = CoarseClock::Now();
         *timestamp = *timestamp - curtime >= 0 ? *timestamp - curtime : -2;
       }
     }
@@ -26,10 +26,14 @@ class RedisStrings : public Redis {
                       const rocksdb::Slice* end,
                       const ColumnFamilyType& type = kMetaAndData) override;
   Status GetProperty(const std::string& property, uint64_t* out) override;
-  Status ScanKeyNum(KeyInfo* key_info) override;
-  Status ScanKeys(const std::string& pattern,
-                  std::vector<std::string>* keys) override;
-  Status PKPatternMatchDel(const std::string& pattern, int32_t* ret) override;
+  Status ScanKeyNum(const KeyRange& range, const std::atomic<bool>& stop,
+                    KeyInfo* key_info) override;
+  Status ScanKeySizes(const std::atomic<bool>& stop,
+                      const KeySizeVisitor& visitor) override;
+  Status ScanKeys(const std::string& pattern, const KeyRange& range,
+                  const ElementVisitor& visitor) override;
+  Status PKPatternMatchDel(const std::string& pattern, const KeyRange& range,
+                           int32_t* ret) override;
 
   // Strings Commands
   Status Append(const Slice& key, const Slice& value, int32_t* ret);
@@ -39,6 +43,7 @@ class RedisStrings : public Redis {
                const std::vector<std::string>& src_keys, int64_t* ret);
   Status Decrby(const Slice& key, int64_t value, int64_t* ret);
   Status Get(const Slice& key, std::string* value);
+  Status Get(const Slice& key, PinnableSlice* value);
   Status GetBit(const Slice& key, int64_t offset, int32_t* ret);
   Status Getrange(const Slice& key, int64_t start_offset, int64_t end_offset,
                   std::string* ret);
@@ -47,6 +52,8 @@ class RedisStrings : public Redis {
   Status Incrbyfloat(const Slice& key, const Slice& value, std::string* ret);
   Status MGet(const std::vector<std::string>& keys,
               std::vector<ValueStatus>* vss);
+  Status MGet(const std::vector<std::string>& keys,
+              PinnableSlice* values, Status* statuses);
   Status MSet(const std::vector<KeyValue>& kvs);
   Status MSetnx(const std::vector<KeyValue>& kvs, int32_t* ret);
   Status Set(const Slice& key, const Slice& value);
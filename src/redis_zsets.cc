@@ -7,13 +7,16 @@
 
 #include <map>
 #include <memory>
+#include <unordered_map>
 #include <limits>
 #include <algorithm>
 
 #include "blackwidow/util.h"
 #include "src/zsets_filter.h"
 #include "src/scope_record_lock.h"
+#include "src/instrumented_db.h"
 #include "src/scope_snapshot.h"
+#include "src/table_properties_collector.h"
 
 namespace blackwidow {
 
@@ -28,8 +31,10 @@ RedisZSets::RedisZSets(BlackWidow* const bw, const DataType& type)
 
 Status RedisZSets::Open(const BlackwidowOptions& bw_options,
                         const std::string& db_path) {
+  lock_mgr_ = new LockMgr(bw_options.lock_slots);
   statistics_store_->SetCapacity(bw_options.statistics_max_size);
   small_compaction_threshold_ = bw_options.small_compaction_threshold;
+  garbage_compaction_ratio_ = bw_options.garbage_compaction_ratio;
 
   rocksdb::Options ops(bw_options.options);
   Status s = rocksdb::DB::Open(ops, db_path, &db_);
@@ -61,6 +66,15 @@ Status RedisZSets::Open(const BlackwidowOptions& bw_options,
     std::make_shared<ZSetsDataFilterFactory>(&db_, &handles_);
   score_cf_ops.compaction_filter_factory =
     std::make_shared<ZSetsScoreFilterFactory>(&db_, &handles_);
+  meta_cf_ops.table_properties_collector_factories.push_back(
+    std::make_shared<GarbagePropertiesCollectorFactory>(
+        RecordFormat::kBaseMetaValue, bw_options.garbage_compaction_ratio));
+  data_cf_ops.table_properties_collector_factories.push_back(
+    std::make_shared<GarbagePropertiesCollectorFactory>(
+        RecordFormat::kBaseDataKey, bw_options.garbage_compaction_ratio));
+  score_cf_ops.table_properties_collector_factories.push_back(
+    std::make_shared<GarbagePropertiesCollectorFactory>(
+        RecordFormat::kBaseDataKey, bw_options.garbage_compaction_ratio));
   score_cf_ops.comparator = ZSetsScoreKeyComparator();
 
   // use the bloom filter policy to reduce disk reads
@@ -91,7 +105,11 @@ Status RedisZSets::Open(const BlackwidowOptions& bw_options,
         "data_cf", data_cf_ops));
   column_families.push_back(rocksdb::ColumnFamilyDescriptor(
         "score_cf", score_cf_ops));
-  return rocksdb::DB::Open(db_ops, db_path, column_families, &handles_, &db_);
+  s = rocksdb::DB::Open(db_ops, db_path, column_families, &handles_, &db_);
+  if (s.ok()) {
+    db_ = new InstrumentedDB(db_, true);
+  }
+  return s;
 }
 
 Status RedisZSets::CompactRange(const rocksdb::Slice* begin,
@@ -118,7 +136,9 @@ Status RedisZSets::GetProperty(const std::string& property, uint64_t* out) {
   return Status::OK();
 }
 
-Status RedisZSets::ScanKeyNum(KeyInfo* key_info) {
+Status RedisZSets::ScanKeyNum(const KeyRange& range,
+                              const std::atomic<bool>& stop,
+                              KeyInfo* key_info) {
   uint64_t keys = 0;
   uint64_t expires = 0;
   uint64_t ttl_sum = 0;
@@ -128,15 +148,21 @@ Status RedisZSets::ScanKeyNum(KeyInfo* key_info) {
   const rocksdb::Snapshot* snapshot;
   ScopeSnapshot ss(db_, &snapshot);
   iterator_options.snapshot = snapshot;
-  iterator_options.fill_cache = false;
+  scan_policy_.ForKeyspaceScan(&iterator_options);
+  rocksdb::Slice upper_bound(range.end);
+  if (!range.end.empty()) {
+    iterator_options.iterate_upper_bound = &upper_bound;
+  }
 
-  int64_t curtime;
-  rocksdb::Env::Default()->GetCurrentTime(&curtime);
+  int64_t curtime = CoarseClock::Now();
 
   rocksdb::Iterator* iter = db_->NewIterator(iterator_options, handles_[0]);
-  for (iter->SeekToFirst();
+  for (iter->Seek(range.start);
        iter->Valid();
        iter->Next()) {
+    if (stop.load(std::memory_order_relaxed)) {
+      break;
+    }
     ParsedZSetsMetaValue parsed_zsets_meta_value(iter->value());
     if (parsed_zsets_meta_value.IsStale()
       || parsed_zsets_meta_value.count() == 0) {
@@ -158,26 +184,57 @@ Status RedisZSets::ScanKeyNum(KeyInfo* key_info) {
   return Status::OK();
 }
 
+Status RedisZSets::ScanKeySizes(const std::atomic<bool>& stop,
+                                const KeySizeVisitor& visitor) {
+  rocksdb::ReadOptions iterator_options;
+  const rocksdb::Snapshot* snapshot;
+  ScopeSnapshot ss(db_, &snapshot);
+  iterator_options.snapshot = snapshot;
+  scan_policy_.ForKeyspaceScan(&iterator_options);
+
+  rocksdb::Iterator* iter = db_->NewIterator(iterator_options, handles_[0]);
+  for (iter->SeekToFirst();
+       iter->Valid() && !stop.load(std::memory_order_relaxed);
+       iter->Next()) {
+    ParsedZSetsMetaValue parsed_zsets_meta_value(iter->value());
+    if (!parsed_zsets_meta_value.IsStale()
+      && parsed_zsets_meta_value.count() != 0) {
+      visitor(iter->key(), parsed_zsets_meta_value.count());
+    }
+  }
+  delete iter;
+  return Status::OK();
+}
+
 Status RedisZSets::ScanKeys(const std::string& pattern,
-                            std::vector<std::string>* keys) {
+                            const KeyRange& range,
+                            const ElementVisitor& visitor) {
   std::string key;
   rocksdb::ReadOptions iterator_options;
   const rocksdb::Snapshot* snapshot;
   ScopeSnapshot ss(db_, &snapshot);
   iterator_options.snapshot = snapshot;
-  iterator_options.fill_cache = false;
+  scan_policy_.ForKeyspaceScan(&iterator_options);
+
+  // Only the keys of range starting with the literal prefix of pattern
+  // can match
+  GlobPattern glob(pattern);
+  KeyRange scan_range = range.Intersect(glob.prefix(), glob.upper_bound());
+  rocksdb::Slice upper_bound(scan_range.end);
+  if (!scan_range.end.empty()) {
+    iterator_options.iterate_upper_bound = &upper_bound;
+  }
 
   rocksdb::Iterator* iter = db_->NewIterator(iterator_options, handles_[0]);
-  for (iter->SeekToFirst();
+  for (iter->Seek(scan_range.start);
        iter->Valid();
        iter->Next()) {
     ParsedZSetsMetaValue parsed_zsets_meta_value(iter->value());
     if (!parsed_zsets_meta_value.IsStale()
       && parsed_zsets_meta_value.count() != 0) {
       key = iter->key().ToString();
-      if (StringMatch(pattern.data(),
-            pattern.size(), key.data(), key.size(), 0)) {
-        keys->push_back(key);
+      if (glob.Match(key) && !visitor(key)) {
+        break;
       }
     }
   }
@@ -186,12 +243,22 @@ Status RedisZSets::ScanKeys(const std::string& pattern,
 }
 
 Status RedisZSets::PKPatternMatchDel(const std::string& pattern,
+                                     const KeyRange& range,
                                      int32_t* ret) {
   rocksdb::ReadOptions iterator_options;
   const rocksdb::Snapshot* snapshot;
   ScopeSnapshot ss(db_, &snapshot);
   iterator_options.snapshot = snapshot;
-  iterator_options.fill_cache = false;
+  scan_policy_.ForKeyspaceScan(&iterator_options);
+
+  // Only the keys of range starting with the literal prefix of pattern
+  // can match
+  GlobPattern glob(pattern);
+  KeyRange scan_range = range.Intersect(glob.prefix(), glob.upper_bound());
+  rocksdb::Slice upper_bound(scan_range.end);
+  if (!scan_range.end.empty()) {
+    iterator_options.iterate_upper_bound = &upper_bound;
+  }
 
   std::string key;
   std::string meta_value;
@@ -199,14 +266,14 @@ Status RedisZSets::PKPatternMatchDel(const std::string& pattern,
   Status s;
   rocksdb::WriteBatch batch;
   rocksdb::Iterator* iter = db_->NewIterator(iterator_options, handles_[0]);
-  iter->SeekToFirst();
+  iter->Seek(scan_range.start);
   while (iter->Valid()) {
     key = iter->key().ToString();
     meta_value = iter->value().ToString();
     ParsedZSetsMetaValue parsed_zsets_meta_value(&meta_value);
     if (!parsed_zsets_meta_value.IsStale()
       && parsed_zsets_meta_value.count()
-      && StringMatch(pattern.data(), pattern.size(), key.data(), key.size(), 0)) {
+      && glob.Match(key)) {
       parsed_zsets_meta_value.InitialMetaValue();
       batch.Put(handles_[0], key, meta_value);
     }
@@ -242,6 +309,9 @@ Status RedisZSets::ZPopMax(const Slice& key,
   rocksdb::WriteBatch batch;
   rocksdb::ReadOptions read_options;
   ScopeRecordLock l(lock_mgr_, key);
+  if (!l.status().ok()) {
+    return l.status();
+  }
   std::string meta_value;
   Status s = db_->Get(default_read_options_, handles_[0], key, &meta_value);
   if (s.ok()) {
@@ -301,6 +371,9 @@ Status RedisZSets::ZPopMin(const Slice& key,
   rocksdb::WriteBatch batch;
   rocksdb::ReadOptions read_options;
   ScopeRecordLock l(lock_mgr_, key);
+  if (!l.status().ok()) {
+    return l.status();
+  }
   std::string meta_value;
   Status s = db_->Get(default_read_options_, handles_[0], key, &meta_value);
   if (s.ok()) {
@@ -371,6 +444,9 @@ Status RedisZSets::ZAdd(const Slice& key,
   std::string meta_value;
   rocksdb::WriteBatch batch;
   ScopeRecordLock l(lock_mgr_, key);
+  if (!l.status().ok()) {
+    return l.status();
+  }
   Status s = db_->Get(default_read_options_, handles_[0], key, &meta_value);
   if (s.ok()) {
     bool vaild = true;
@@ -385,16 +461,26 @@ Status RedisZSets::ZAdd(const Slice& key,
     }
 
     int32_t cnt = 0;
-    std::string data_value;
-    for (const auto& sm : filtered_score_members) {
+    std::vector<Status> statuses;
+    std::vector<std::string> data_values;
+    if (vaild) {
+      std::vector<std::string> member_keys;
+      for (const auto& sm : filtered_score_members) {
+        ZSetsMemberKey zsets_member_key(key, version, sm.member);
+        member_keys.push_back(zsets_member_key.Encode().ToString());
+      }
+      MultiGetData(default_read_options_, parsed_zsets_meta_value.count(),
+                   member_keys, &statuses, &data_values);
+    }
+    for (size_t idx = 0; idx < filtered_score_members.size(); ++idx) {
+      const ScoreMember& sm = filtered_score_members[idx];
       bool not_found = true;
       ZSetsMemberKey zsets_member_key(key, version, sm.member);
       if (vaild) {
-        s = db_->Get(default_read_options_,
-            handles_[1], zsets_member_key.Encode(), &data_value);
+        s = statuses[idx];
         if (s.ok()) {
           not_found = false;
-          uint64_t tmp = DecodeFixed64(data_value.data());
+          uint64_t tmp = DecodeFixed64(data_values[idx].data());
           const void* ptr_tmp = reinterpret_cast<const void*>(&tmp);
           double old_score = *reinterpret_cast<const double*>(ptr_tmp);
           if (old_score == sm.score) {
@@ -479,11 +565,8 @@ Status RedisZSets::ZCount(const Slice& key,
                           int32_t* ret) {
   *ret = 0;
   rocksdb::ReadOptions read_options;
-  const rocksdb::Snapshot* snapshot = nullptr;
 
   std::string meta_value;
-  ScopeSnapshot ss(db_, &snapshot);
-  read_options.snapshot = snapshot;
 
   Status s = db_->Get(read_options, key, &meta_value);
   if (s.ok()) {
@@ -538,6 +621,16 @@ Status RedisZSets::ZIncrby(const Slice& key,
                            double increment,
                            double* ret) {
   *ret = 0;
+  if (combine_writes_.load(std::memory_order_relaxed)) {
+    ZIncrbyCombiner::Request request(key, {member, increment, 0});
+    Status s = zincrby_combiner_.Run(lock_mgr_, &request,
+        [this](const Slice& key, const ZIncrbyCombiner::Requests& requests) {
+          ApplyZIncrbys(key, requests);
+        });
+    *ret = request.op.ret;
+    return s;
+  }
+
   uint32_t statistic = 0;
   double score = 0;
   char score_buf[8];
@@ -545,6 +638,9 @@ Status RedisZSets::ZIncrby(const Slice& key,
   std::string meta_value;
   rocksdb::WriteBatch batch;
   ScopeRecordLock l(lock_mgr_, key);
+  if (!l.status().ok()) {
+    return l.status();
+  }
   Status s = db_->Get(default_read_options_, handles_[0], key, &meta_value);
   if (s.ok()) {
     ParsedZSetsMetaValue parsed_zsets_meta_value(&meta_value);
@@ -599,19 +695,136 @@ Status RedisZSets::ZIncrby(const Slice& key,
   return s;
 }
 
+// Same as the ZIncrby of every request in turn, with one read of the
+// meta value and one write, a failed request does not fail the others
+void RedisZSets::ApplyZIncrbys(const Slice& key,
+                               const ZIncrbyCombiner::Requests& requests) {
+  std::string meta_value;
+  bool reset = false;
+  Status s = GetMetaForWrite(key, &meta_value, &reset);
+  if (!s.ok()) {
+    for (auto request : requests) {
+      request->status = s;
+    }
+    return;
+  }
+  ParsedZSetsMetaValue parsed_zsets_meta_value(&meta_value);
+  int32_t version = parsed_zsets_meta_value.version();
+
+  rocksdb::WriteBatch batch;
+  int32_t added = 0;
+  uint32_t statistic = 0;
+  std::string data_value;
+  // Members incremented by the previous requests
+  std::unordered_map<std::string, double> scores;
+  for (auto request : requests) {
+    ZIncrbyOp& op = request->op;
+    std::string member = op.member.ToString();
+    ZSetsMemberKey zsets_member_key(key, version, op.member);
+    double score = 0;
+    bool exists = false;
+    auto iter = scores.find(member);
+    if (iter != scores.end()) {
+      score = iter->second;
+      exists = true;
+    } else if (!reset) {
+      s = db_->Get(default_read_options_, handles_[1],
+                   zsets_member_key.Encode(), &data_value);
+      if (s.ok()) {
+        uint64_t tmp = DecodeFixed64(data_value.data());
+        const void* ptr_tmp = reinterpret_cast<const void*>(&tmp);
+        score = *reinterpret_cast<const double*>(ptr_tmp);
+        exists = true;
+      } else if (!s.IsNotFound()) {
+        request->status = s;
+        continue;
+      }
+    }
+    if (exists) {
+      ZSetsScoreKey zsets_score_key(key, version, score, op.member);
+      batch.Delete(handles_[2], zsets_score_key.Encode());
+      statistic++;
+    } else {
+      added++;
+    }
+    score += op.increment;
+
+    char score_buf[8];
+    const void* ptr_score = reinterpret_cast<const void*>(&score);
+    EncodeFixed64(score_buf, *reinterpret_cast<const uint64_t*>(ptr_score));
+    batch.Put(handles_[1],
+        zsets_member_key.Encode(), Slice(score_buf, sizeof(uint64_t)));
+    ZSetsScoreKey zsets_score_key(key, version, score, op.member);
+    batch.Put(handles_[2], zsets_score_key.Encode(), Slice());
+    scores[member] = score;
+    op.ret = score;
+    request->status = Status::OK();
+  }
+
+  if (added > 0) {
+    parsed_zsets_meta_value.ModifyCount(added);
+    batch.Put(handles_[0], key, meta_value);
+  }
+  s = batch.Count() > 0 ? db_->Write(default_write_options_, &batch)
+    : Status::OK();
+  for (auto request : requests) {
+    if (request->status.ok()) {
+      request->status = s;
+    }
+  }
+  UpdateSpecificKeyStatistics(key.ToString(), statistic);
+}
+
 Status RedisZSets::ZRange(const Slice& key,
                           int32_t start,
                           int32_t stop,
                           std::vector<ScoreMember>* score_members) {
   score_members->clear();
+  return ZRange(key, start, stop,
+      [score_members](double score, const Slice& member) {
+    score_members->push_back({score, member.ToString()});
+    return true;
+  });
+}
+
+Status RedisZSets::NewRankIterator(
+    const Slice& key, std::string* meta_value,
+    std::unique_ptr<rocksdb::Iterator>* score_iter) {
+  // The ranks shift on every add and remove, so the meta value and the
+  // scores are read by two iterators of the same NewIterators() call.
+  // The Get only sizes the read for the scan policy
+  Status s = db_->Get(default_read_options_, handles_[0], key, meta_value);
+  if (!s.ok()) {
+    return s;
+  }
   rocksdb::ReadOptions read_options;
-  const rocksdb::Snapshot* snapshot = nullptr;
+  {
+    ParsedZSetsMetaValue parsed_zsets_meta_value(meta_value);
+    scan_policy_.ForCollection(parsed_zsets_meta_value.count(),
+                               &read_options);
+  }
+  std::vector<rocksdb::Iterator*> iters;
+  s = db_->NewIterators(read_options, {handles_[0], handles_[2]}, &iters);
+  if (!s.ok()) {
+    return s;
+  }
+  std::unique_ptr<rocksdb::Iterator> meta_iter(iters[0]);
+  score_iter->reset(iters[1]);
+  meta_iter->Seek(key);
+  if (!meta_iter->Valid() || meta_iter->key() != key) {
+    return meta_iter->status().ok() ? Status::NotFound() : meta_iter->status();
+  }
+  *meta_value = meta_iter->value().ToString();
+  return Status::OK();
+}
 
+Status RedisZSets::ZRange(const Slice& key,
+                          int32_t start,
+                          int32_t stop,
+                          const ScoreMemberVisitor& visitor) {
   std::string meta_value;
-  ScopeSnapshot ss(db_, &snapshot);
-  read_options.snapshot = snapshot;
-
-  Status s = db_->Get(read_options, key, &meta_value);
+  std::unique_ptr<rocksdb::Iterator> iter;
+  Status s = NewRankIterator(key, &meta_value, &iter);
   if (s.ok()) {
     ParsedZSetsMetaValue parsed_zsets_meta_value(&meta_value);
     if (parsed_zsets_meta_value.IsStale()) {
@@ -631,31 +844,23 @@ Status RedisZSets::ZRange(const Slice& key,
         return s;
       }
       int32_t cur_index = 0;
-      ScoreMember score_member;
       ZSetsScoreKey zsets_score_key(key, version,
           std::numeric_limits<double>::lowest(), Slice());
       ZSetsScoreKey zsets_score_next_key(key, version + 1,
                  std::numeric_limits<double>::lowest(), Slice());
       Slice zsets_next_version_key = zsets_score_next_key.Encode();
-      Slice zsets_prefix_key = zsets_score_key.Encode();
-      rocksdb::Slice upper_bound(zsets_next_version_key);
-      rocksdb::Slice lower_bound(zsets_prefix_key);
-      read_options.iterate_upper_bound = &upper_bound;
-      read_options.iterate_lower_bound = &lower_bound;
-      read_options.fill_cache = false;
-
-      rocksdb::Iterator* iter = db_->NewIterator(read_options, handles_[2]);
       for (iter->Seek(zsets_score_key.Encode());
-           iter->Valid() && cur_index <= stop_index;
+           iter->Valid() && cur_index <= stop_index
+           && iter->key().compare(zsets_next_version_key) < 0;
            iter->Next(), ++cur_index) {
         if (cur_index >= start_index) {
           ParsedZSetsScoreKey parsed_zsets_score_key(iter->key());
-          score_member.score = parsed_zsets_score_key.score();
-          score_member.member = parsed_zsets_score_key.member().ToString();
-          score_members->push_back(score_member);
+          if (!visitor(parsed_zsets_score_key.score(),
+                       parsed_zsets_score_key.member())) {
+            break;
+          }
         }
       }
-      delete iter;
     }
   }
   return s;
@@ -670,12 +875,24 @@ Status RedisZSets::ZRangebyscore(const Slice& key,
                                  int64_t offset,
                                  std::vector<ScoreMember>* score_members) {
   score_members->clear();
+  return ZRangebyscore(key, min, max, left_close, right_close,
+      count, offset, [score_members](double score, const Slice& member) {
+    score_members->push_back({score, member.ToString()});
+    return true;
+  });
+}
+
+Status RedisZSets::ZRangebyscore(const Slice& key,
+                                 double min,
+                                 double max,
+                                 bool left_close,
+                                 bool right_close,
+                                 int64_t count,
+                                 int64_t offset,
+                                 const ScoreMemberVisitor& visitor) {
   rocksdb::ReadOptions read_options;
-  const rocksdb::Snapshot* snapshot = nullptr;
 
   std::string meta_value;
-  ScopeSnapshot ss(db_, &snapshot);
-  read_options.snapshot = snapshot;
   Status s = db_->Get(read_options, handles_[0], key, &meta_value);
   if (s.ok()) {
     ParsedZSetsMetaValue parsed_zsets_meta_value(&meta_value);
@@ -688,7 +905,7 @@ Status RedisZSets::ZRangebyscore(const Slice& key,
       int32_t index = 0;
       int32_t stop_index = parsed_zsets_meta_value.count() - 1;
       int64_t skipped = 0;
-      ScoreMember score_member;
+      int64_t visited = 0;
       ZSetsScoreKey zsets_score_key(key, version, min, Slice());
       ZSetsScoreKey zsets_score_next_key(key, version + 1,min, Slice());
       Slice zsets_next_version_key = zsets_score_next_key.Encode();
@@ -697,7 +914,8 @@ Status RedisZSets::ZRangebyscore(const Slice& key,
       rocksdb::Slice lower_bound(zsets_prefix_key);
       read_options.iterate_upper_bound = &upper_bound;
       read_options.iterate_lower_bound = &lower_bound;
-      read_options.fill_cache = false;
+      scan_policy_.ForCollection(parsed_zsets_meta_value.count(),
+                                 &read_options);
 
       rocksdb::Iterator* iter = db_->NewIterator(read_options, handles_[2]);
       for (iter->Seek(zsets_score_key.Encode());
@@ -726,10 +944,9 @@ Status RedisZSets::ZRangebyscore(const Slice& key,
             ++skipped;
             continue;
           }
-          score_member.score = parsed_zsets_score_key.score();
-          score_member.member = parsed_zsets_score_key.member().ToString();
-          score_members->push_back(score_member);
-          if (count > 0 && score_members->size() == static_cast<size_t>(count)) {
+          if (!visitor(parsed_zsets_score_key.score(),
+                       parsed_zsets_score_key.member())
+            || (count > 0 && ++visited == count)) {
             break;
           }
         }
@@ -748,11 +965,8 @@ Status RedisZSets::ZRank(const Slice& key,
                          int32_t* rank) {
   *rank = -1;
   rocksdb::ReadOptions read_options;
-  const rocksdb::Snapshot* snapshot = nullptr;
 
   std::string meta_value;
-  ScopeSnapshot ss(db_, &snapshot);
-  read_options.snapshot = snapshot;
   Status s = db_->Get(read_options, handles_[0], key, &meta_value);
   if (s.ok()) {
     ParsedZSetsMetaValue  parsed_zsets_meta_value(&meta_value);
@@ -817,6 +1031,9 @@ Status RedisZSets::ZRem(const Slice& key,
   std::string meta_value;
   rocksdb::WriteBatch batch;
   ScopeRecordLock l(lock_mgr_, key);
+  if (!l.status().ok()) {
+    return l.status();
+  }
   Status s = db_->Get(default_read_options_, handles_[0], key, &meta_value);
   if (s.ok()) {
     ParsedZSetsMetaValue parsed_zsets_meta_value(&meta_value);
@@ -826,21 +1043,28 @@ Status RedisZSets::ZRem(const Slice& key,
       return Status::NotFound();
     } else {
       int32_t del_cnt = 0;
-      std::string data_value;
       int32_t version = parsed_zsets_meta_value.version();
+      std::vector<std::string> member_keys;
       for (const auto& member : filtered_members) {
         ZSetsMemberKey zsets_member_key(key, version, member);
-        s = db_->Get(default_read_options_,
-            handles_[1], zsets_member_key.Encode(), &data_value);
+        member_keys.push_back(zsets_member_key.Encode().ToString());
+      }
+      std::vector<Status> statuses;
+      std::vector<std::string> data_values;
+      MultiGetData(default_read_options_, parsed_zsets_meta_value.count(),
+                   member_keys, &statuses, &data_values);
+      for (size_t idx = 0; idx < filtered_members.size(); ++idx) {
+        s = statuses[idx];
         if (s.ok()) {
           del_cnt++;
           statistic++;
-          uint64_t tmp = DecodeFixed64(data_value.data());
+          uint64_t tmp = DecodeFixed64(data_values[idx].data());
           const void* ptr_tmp = reinterpret_cast<const void*>(&tmp);
           double score = *reinterpret_cast<const double*>(ptr_tmp);
-          batch.Delete(handles_[1], zsets_member_key.Encode());
+          batch.Delete(handles_[1], member_keys[idx]);
 
-          ZSetsScoreKey zsets_score_key(key, version, score, member);
+          ZSetsScoreKey zsets_score_key(key, version, score,
+                                        filtered_members[idx]);
           batch.Delete(handles_[2], zsets_score_key.Encode());
         } else if (!s.IsNotFound()) {
           return s;
@@ -868,6 +1092,9 @@ Status RedisZSets::ZRemrangebyrank(const Slice& key,
   rocksdb::WriteBatch batch;
   rocksdb::ReadOptions read_options;
   ScopeRecordLock l(lock_mgr_, key);
+  if (!l.status().ok()) {
+    return l.status();
+  }
   Status s = db_->Get(default_read_options_, handles_[0], key, &meta_value);
   if (s.ok()) {
     ParsedZSetsMetaValue parsed_zsets_meta_value(&meta_value);
@@ -940,6 +1167,9 @@ Status RedisZSets::ZRemrangebyscore(const Slice& key,
   rocksdb::WriteBatch batch;
   rocksdb::ReadOptions read_options;
   ScopeRecordLock l(lock_mgr_, key);
+  if (!l.status().ok()) {
+    return l.status();
+  }
   Status s = db_->Get(default_read_options_, handles_[0], key, &meta_value);
   if (s.ok()) {
     ParsedZSetsMetaValue parsed_zsets_meta_value(&meta_value);
@@ -1015,14 +1245,20 @@ Status RedisZSets::ZRevrange(const Slice& key,
                              int32_t stop,
                              std::vector<ScoreMember>* score_members) {
   score_members->clear();
-  rocksdb::ReadOptions read_options;
-  const rocksdb::Snapshot* snapshot = nullptr;
+  return ZRevrange(key, start, stop,
+      [score_members](double score, const Slice& member) {
+    score_members->push_back({score, member.ToString()});
+    return true;
+  });
+}
 
+Status RedisZSets::ZRevrange(const Slice& key,
+                             int32_t start,
+                             int32_t stop,
+                             const ScoreMemberVisitor& visitor) {
   std::string meta_value;
-  ScopeSnapshot ss(db_, &snapshot);
-  read_options.snapshot = snapshot;
-
-  Status s = db_->Get(read_options, key, &meta_value);
+  std::unique_ptr<rocksdb::Iterator> iter;
+  Status s = NewRankIterator(key, &meta_value, &iter);
   if (s.ok()) {
     ParsedZSetsMetaValue parsed_zsets_meta_value(&meta_value);
     if (parsed_zsets_meta_value.IsStale()) {
@@ -1042,22 +1278,23 @@ Status RedisZSets::ZRevrange(const Slice& key,
         return s;
       }
       int32_t cur_index = count - 1;
-      ScoreMember score_member;
       ZSetsScoreKey zsets_score_key(key, version,
           std::numeric_limits<double>::max(), Slice());
-
-      rocksdb::Iterator* iter = db_->NewIterator(read_options, handles_[2]);
+      ZSetsScoreKey zsets_score_prefix_key(key, version,
+          std::numeric_limits<double>::lowest(), Slice());
+      Slice zsets_prefix_key = zsets_score_prefix_key.Encode();
       for (iter->SeekForPrev(zsets_score_key.Encode());
-           iter->Valid() && cur_index >= start_index;
+           iter->Valid() && cur_index >= start_index
+           && iter->key().compare(zsets_prefix_key) >= 0;
            iter->Prev(), --cur_index) {
         if (cur_index <= stop_index) {
           ParsedZSetsScoreKey parsed_zsets_score_key(iter->key());
-          score_member.score = parsed_zsets_score_key.score();
-          score_member.member = parsed_zsets_score_key.member().ToString();
-          score_members->push_back(score_member);
+          if (!visitor(parsed_zsets_score_key.score(),
+                       parsed_zsets_score_key.member())) {
+            break;
+          }
         }
       }
-      delete iter;
     }
   }
   return s;
@@ -1072,12 +1309,24 @@ Status RedisZSets::ZRevrangebyscore(const Slice& key,
                                     int64_t offset,
                                     std::vector<ScoreMember>* score_members) {
   score_members->clear();
+  return ZRevrangebyscore(key, min, max, left_close, right_close,
+      count, offset, [score_members](double score, const Slice& member) {
+    score_members->push_back({score, member.ToString()});
+    return true;
+  });
+}
+
+Status RedisZSets::ZRevrangebyscore(const Slice& key,
+                                    double min,
+                                    double max,
+                                    bool left_close,
+                                    bool right_close,
+                                    int64_t count,
+                                    int64_t offset,
+                                    const ScoreMemberVisitor& visitor) {
   rocksdb::ReadOptions read_options;
-  const rocksdb::Snapshot* snapshot = nullptr;
 
   std::string meta_value;
-  ScopeSnapshot ss(db_, &snapshot);
-  read_options.snapshot = snapshot;
   Status s = db_->Get(read_options, handles_[0], key, &meta_value);
   if (s.ok()) {
     ParsedZSetsMetaValue parsed_zsets_meta_value(&meta_value);
@@ -1089,10 +1338,11 @@ Status RedisZSets::ZRevrangebyscore(const Slice& key,
       int32_t version = parsed_zsets_meta_value.version();
       int32_t left = parsed_zsets_meta_value.count();
       int64_t skipped = 0;
-      ScoreMember score_member;
+      int64_t visited = 0;
       ZSetsScoreKey zsets_score_key(key, version,
           std::nextafter(max, std::numeric_limits<double>::max()), Slice());
-      
+      scan_policy_.ForCollection(left, &read_options);
+
       rocksdb::Iterator* iter = db_->NewIterator(read_options, handles_[2]);
       for (iter->SeekForPrev(zsets_score_key.Encode());
            iter->Valid() && left > 0;
@@ -1120,10 +1370,9 @@ Status RedisZSets::ZRevrangebyscore(const Slice& key,
             ++skipped;
             continue;
           }
-          score_member.score = parsed_zsets_score_key.score();
-          score_member.member = parsed_zsets_score_key.member().ToString();
-          score_members->push_back(score_member);
-          if (count > 0 and score_members->size() == static_cast<size_t>(count)) {
+          if (!visitor(parsed_zsets_score_key.score(),
+                       parsed_zsets_score_key.member())
+            || (count > 0 && ++visited == count)) {
             break;
           }
         }
@@ -1142,11 +1391,8 @@ Status RedisZSets::ZRevrank(const Slice& key,
                             int32_t* rank) {
   *rank = -1;
   rocksdb::ReadOptions read_options;
-  const rocksdb::Snapshot* snapshot = nullptr;
 
   std::string meta_value;
-  ScopeSnapshot ss(db_, &snapshot);
-  read_options.snapshot = snapshot;
 
   Status s = db_->Get(read_options, key, &meta_value);
   if (s.ok()) {
@@ -1188,11 +1434,8 @@ Status RedisZSets::ZScore(const Slice& key,
                           double* score) {
   *score = 0;
   rocksdb::ReadOptions read_options;
-  const rocksdb::Snapshot* snapshot = nullptr;
 
   std::string meta_value;
-  ScopeSnapshot ss(db_, &snapshot);
-  read_options.snapshot = snapshot;
 
   Status s = db_->Get(read_options, key, &meta_value);
   if (s.ok()) {
@@ -1238,6 +1481,9 @@ Status RedisZSets::ZUnionstore(const Slice& destination,
   ScopeSnapshot ss(db_, &snapshot);
   read_options.snapshot = snapshot;
   ScopeRecordLock l(lock_mgr_, destination);
+  if (!l.status().ok()) {
+    return l.status();
+  }
   std::map<std::string, double> member_score_map;
 
   Status s;
@@ -1262,7 +1508,8 @@ Status RedisZSets::ZUnionstore(const Slice& destination,
         rocksdb::Slice lower_bound(zsets_prefix_key);
         read_options.iterate_upper_bound = &upper_bound;
         read_options.iterate_lower_bound = &lower_bound;
-        read_options.fill_cache = false;
+        scan_policy_.ForCollection(parsed_zsets_meta_value.count(),
+                                   &read_options);
 
         rocksdb::Iterator* iter = db_->NewIterator(read_options, handles_[2]);
         for (iter->Seek(zsets_score_key.Encode());
@@ -1341,6 +1588,9 @@ Status RedisZSets::ZInterstore(const Slice& destination,
   ScopeSnapshot ss(db_, &snapshot);
   read_options.snapshot = snapshot;
   ScopeRecordLock l(lock_mgr_, destination);
+  if (!l.status().ok()) {
+    return l.status();
+  }
 
   std::string meta_value;
   int32_t version = 0;
@@ -1384,7 +1634,7 @@ Status RedisZSets::ZInterstore(const Slice& destination,
     rocksdb::Slice lower_bound(zsets_prefix_key);
     read_options.iterate_upper_bound = &upper_bound;
     read_options.iterate_lower_bound = &lower_bound;
-    read_options.fill_cache = false;
+    scan_policy_.ForCollection(stop_index + 1, &read_options);
 
     rocksdb::Iterator* iter = db_->NewIterator(read_options, handles_[2]);
     for (iter->Seek(zsets_score_key.Encode());
@@ -1470,11 +1720,8 @@ Status RedisZSets::ZRangebylex(const Slice& key,
                                std::vector<std::string>* members) {
   members->clear();
   rocksdb::ReadOptions read_options;
-  const rocksdb::Snapshot* snapshot = nullptr;
 
   std::string meta_value;
-  ScopeSnapshot ss(db_, &snapshot);
-  read_options.snapshot = snapshot;
 
   bool left_no_limit = !min.compare("-");
   bool right_not_limit = !max.compare("+");
@@ -1557,6 +1804,9 @@ Status RedisZSets::ZRemrangebylex(const Slice& key,
   ScopeSnapshot ss(db_, &snapshot);
   read_options.snapshot = snapshot;
   ScopeRecordLock l(lock_mgr_, key);
+  if (!l.status().ok()) {
+    return l.status();
+  }
 
   bool left_no_limit = !min.compare("-");
   bool right_not_limit = !max.compare("+");
@@ -1634,6 +1884,9 @@ Status RedisZSets::ZRemrangebylex(const Slice& key,
 Status RedisZSets::Expire(const Slice& key, int32_t ttl) {
   std::string meta_value;
   ScopeRecordLock l(lock_mgr_, key);
+  if (!l.status().ok()) {
+    return l.status();
+  }
   Status s = db_->Get(default_read_options_, key, &meta_value);
   if (s.ok()) {
     ParsedZSetsMetaValue parsed_zsets_meta_value(&meta_value);
@@ -1656,6 +1909,9 @@ Status RedisZSets::Expire(const Slice& key, int32_t ttl) {
 Status RedisZSets::Del(const Slice& key) {
   std::string meta_value;
   ScopeRecordLock l(lock_mgr_, key);
+  if (!l.status().ok()) {
+    return l.status();
+  }
   Status s = db_->Get(default_read_options_, key, &meta_value);
   if (s.ok()) {
     ParsedZSetsMetaValue parsed_zsets_meta_value(&meta_value);
@@ -1685,11 +1941,13 @@ bool RedisZSets::Scan(const std::string& start_key,
   ScopeSnapshot ss(db_, &snapshot);
   iterator_options.snapshot = snapshot;
   iterator_options.fill_cache = false;
+  GlobPattern glob(pattern);
 
   rocksdb::Iterator* it = db_->NewIterator(iterator_options, handles_[0]);
 
-  it->Seek(start_key);
-  while (it->Valid() && (*count) > 0) {
+  it->Seek(start_key < glob.prefix() ? glob.prefix() : start_key);
+  while (it->Valid() && (*count) > 0
+    && !glob.PastPrefix(it->key())) {
     ParsedZSetsMetaValue parsed_zsets_meta_value(it->value());
     if (parsed_zsets_meta_value.IsStale()
       || parsed_zsets_meta_value.count() == 0) {
@@ -1697,8 +1955,7 @@ bool RedisZSets::Scan(const std::string& start_key,
       continue;
     } else {
       meta_key = it->key().ToString();
-      if (StringMatch(pattern.data(), pattern.size(),
-                         meta_key.data(), meta_key.size(), 0)) {
+      if (glob.Match(meta_key)) {
         keys->push_back(meta_key);
       }
       (*count)--;
@@ -1706,10 +1963,7 @@ bool RedisZSets::Scan(const std::string& start_key,
     }
   }
 
-  std::string prefix = isTailWildcard(pattern) ?
-    pattern.substr(0, pattern.size() - 1) : "";
-  if (it->Valid()
-    && (it->key().compare(prefix) <= 0 || it->key().starts_with(prefix))) {
+  if (it->Valid() && !glob.PastPrefix(it->key())) {
     *next_key = it->key().ToString();
     is_finish = false;
   } else {
@@ -1763,6 +2017,9 @@ bool RedisZSets::PKExpireScan(const std::string& start_key,
 Status RedisZSets::Expireat(const Slice& key, int32_t timestamp) {
   std::string meta_value;
   ScopeRecordLock l(lock_mgr_, key);
+  if (!l.status().ok()) {
+    return l.status();
+  }
   Status s = db_->Get(default_read_options_, handles_[0], key, &meta_value);
   if (s.ok()) {
     ParsedZSetsMetaValue parsed_zsets_meta_value(&meta_value);
@@ -1795,37 +2052,74 @@ Status RedisZSets::ZScan(const Slice& key,
     return Status::OK();
   }
 
+  std::string start_point, next_member;
+  Status s = GetScanStartPoint(key, pattern, cursor, &start_point);
+  GlobPattern glob(pattern);
+  if (s.IsNotFound()) {
+    cursor = 0;
+    start_point = glob.prefix();
+  }
+
+  bool has_next = false;
+  s = ZScanFrom(key, start_point, glob, count,
+                score_members, &next_member, &has_next);
+  if (s.ok() && has_next) {
+    *next_cursor = cursor + count;
+    StoreScanNextPoint(key, pattern, *next_cursor, next_member);
+  }
+  return s;
+}
+
+Status RedisZSets::ZScan(const Slice& key,
+                         const std::string& cursor,
+                         const std::string& pattern,
+                         int64_t count,
+                         std::vector<ScoreMember>* score_members,
+                         std::string* next_cursor) {
+  next_cursor->clear();
+  score_members->clear();
+  char type_tag = DataTypeTag[kZSets];
+  std::string start_point, next_member;
+  if (!cursor.empty()
+    && (!DecodeScanCursor(cursor, &type_tag, &start_point)
+      || type_tag != DataTypeTag[kZSets])) {
+    return Status::InvalidArgument("invalid cursor");
+  }
+  GlobPattern glob(pattern);
+  if (start_point < glob.prefix()) {
+    start_point = glob.prefix();
+  }
+
+  bool has_next = false;
+  Status s = ZScanFrom(key, start_point, glob, count,
+                       score_members, &next_member, &has_next);
+  if (s.ok() && has_next) {
+    *next_cursor = EncodeScanCursor(DataTypeTag[kZSets], next_member);
+  }
+  return s;
+}
+
+Status RedisZSets::ZScanFrom(const Slice& key,
+                             const std::string& start_point,
+                             const GlobPattern& glob,
+                             int64_t count,
+                             std::vector<ScoreMember>* score_members,
+                             std::string* next_member,
+                             bool* has_next) {
   int64_t rest = count;
-  int64_t step_length = count;
   rocksdb::ReadOptions read_options;
-  const rocksdb::Snapshot* snapshot;
 
   std::string meta_value;
-  ScopeSnapshot ss(db_, &snapshot);
-  read_options.snapshot = snapshot;
   Status s = db_->Get(read_options, handles_[0], key, &meta_value);
   if (s.ok()) {
     ParsedZSetsMetaValue parsed_zsets_meta_value(&meta_value);
     if (parsed_zsets_meta_value.IsStale()
       || parsed_zsets_meta_value.count() == 0) {
-      *next_cursor = 0;
       return Status::NotFound();
     } else {
-      std::string sub_member;
-      std::string start_point;
       int32_t version = parsed_zsets_meta_value.version();
-      s = GetScanStartPoint(key, pattern, cursor, &start_point);
-      if (s.IsNotFound()) {
-        cursor = 0;
-        if (isTailWildcard(pattern)) {
-          start_point = pattern.substr(0, pattern.size() - 1);
-        }
-      }
-      if (isTailWildcard(pattern)) {
-        sub_member = pattern.substr(0, pattern.size() - 1);
-      }
 
-      ZSetsMemberKey zsets_member_prefix(key, version, sub_member);
+      ZSetsMemberKey zsets_member_prefix(key, version, glob.prefix());
       ZSetsMemberKey zsets_member_key(key, version, start_point);
       std::string prefix = zsets_member_prefix.Encode().ToString();
       ZSetsMemberKey zsets_member_next_key(key, version + 1, Slice());
@@ -1842,8 +2136,7 @@ Status RedisZSets::ZScan(const Slice& key,
            iter->Next()) {
         ParsedZSetsMemberKey parsed_zsets_member_key(iter->key());
         std::string member = parsed_zsets_member_key.member().ToString();
-        if (StringMatch(pattern.data(),
-              pattern.size(), member.data(), member.size(), 0)) {
+        if (glob.Match(member)) {
           uint64_t tmp = DecodeFixed64(iter->value().data());
           const void* ptr_tmp = reinterpret_cast<const void*>(&tmp);
           double score = *reinterpret_cast<const double*>(ptr_tmp);
@@ -1855,17 +2148,13 @@ Status RedisZSets::ZScan(const Slice& key,
       if (iter->Valid()
         && (iter->key().compare(prefix) <= 0
           || iter->key().starts_with(prefix))) {
-        *next_cursor = cursor + step_length;
+        *has_next = true;
         ParsedZSetsMemberKey parsed_zsets_member_key(iter->key());
-        std::string next_member = parsed_zsets_member_key.member().ToString();
-        StoreScanNextPoint(key, pattern, *next_cursor, next_member);
-      } else {
-        *next_cursor = 0;
+        *next_member = parsed_zsets_member_key.member().ToString();
       }
       delete iter;
     }
   } else {
-    *next_cursor = 0;
     return s;
   }
   return Status::OK();
@@ -1886,6 +2175,7 @@ Status RedisZSets::PKScanRange(const Slice& key_start,
   ScopeSnapshot ss(db_, &snapshot);
   iterator_options.snapshot = snapshot;
   iterator_options.fill_cache = false;
+  GlobPattern glob(pattern.ToString());
 
   bool start_no_limit = !key_start.compare("");
   bool end_no_limit = !key_end.compare("");
@@ -1897,22 +2187,23 @@ Status RedisZSets::PKScanRange(const Slice& key_start,
   }
 
   rocksdb::Iterator* it = db_->NewIterator(iterator_options, handles_[0]);
-  if (start_no_limit) {
-    it->SeekToFirst();
+  // Keys before the literal prefix of pattern can not match
+  if (start_no_limit || key_start.compare(glob.prefix()) < 0) {
+    it->Seek(glob.prefix());
   } else {
     it->Seek(key_start);
   }
 
   while (it->Valid() && remain > 0
-    && (end_no_limit || it->key().compare(key_end) <= 0)) {
+    && (end_no_limit || it->key().compare(key_end) <= 0)
+    && !glob.PastPrefix(it->key())) {
     ParsedZSetsMetaValue parsed_zsets_meta_value(it->value());
     if (parsed_zsets_meta_value.IsStale()
       || parsed_zsets_meta_value.count() == 0) {
       it->Next();
     } else {
       key = it->key().ToString();
-      if (StringMatch(pattern.data(), pattern.size(),
-                         key.data(), key.size(), 0)) {
+      if (glob.Match(key)) {
         keys->push_back(key);
       }
       remain--;
@@ -1921,7 +2212,8 @@ Status RedisZSets::PKScanRange(const Slice& key_start,
   }
 
   while (it->Valid()
-    && (end_no_limit || it->key().compare(key_end) <= 0)) {
+    && (end_no_limit || it->key().compare(key_end) <= 0)
+    && !glob.PastPrefix(it->key())) {
     ParsedZSetsMetaValue parsed_zsets_meta_value(it->value());
     if (parsed_zsets_meta_value.IsStale()
       || parsed_zsets_meta_value.count() == 0) {
@@ -1950,6 +2242,7 @@ Status RedisZSets::PKRScanRange(const Slice& key_start,
   ScopeSnapshot ss(db_, &snapshot);
   iterator_options.snapshot = snapshot;
   iterator_options.fill_cache = false;
+  GlobPattern glob(pattern.ToString());
 
   bool start_no_limit = !key_start.compare("");
   bool end_no_limit = !key_end.compare("");
@@ -1975,8 +2268,7 @@ Status RedisZSets::PKRScanRange(const Slice& key_start,
       it->Prev();
     } else {
       key = it->key().ToString();
-      if (StringMatch(pattern.data(), pattern.size(),
-                         key.data(), key.size(), 0)) {
+      if (glob.Match(key)) {
         keys->push_back(key);
       }
       remain--;
@@ -2002,6 +2294,9 @@ Status RedisZSets::PKRScanRange(const Slice& key_start,
 Status RedisZSets::Persist(const Slice& key) {
   std::string meta_value;
   ScopeRecordLock l(lock_mgr_, key);
+  if (!l.status().ok()) {
+    return l.status();
+  }
   Status s = db_->Get(default_read_options_, handles_[0], key, &meta_value);
   if (s.ok()) {
     ParsedZSetsMetaValue parsed_zsets_meta_value(&meta_value);
@@ -2038,8 +2333,7 @@ Status RedisZSets::TTL(const Slice& key, int64_t* timestamp) {
       if (*timestamp == 0) {
         *timestamp = -1;
       } else {
-        int64_t curtime;
-        rocksdb::Env::Default()->GetCurrentTime(&curtime);
+        int64_t curtime = CoarseClock::Now();
         *timestamp = *timestamp - curtime >= 0 ? *timestamp - curtime : -2;
       }
     }
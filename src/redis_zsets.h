@@ -6,12 +6,14 @@
 #ifndef SRC_REDIS_ZSETS_h
 #define SRC_REDIS_ZSETS_h
 
+#include <memory>
 #include <string>
 #include <vector>
 #include <unordered_set>
 
 #include "src/redis.h"
 #include "src/custom_comparator.h"
+#include "src/write_combiner.h"
 
 namespace blackwidow {
 
@@ -27,10 +29,14 @@ class RedisZSets : public Redis {
                       const rocksdb::Slice* end,
                       const ColumnFamilyType& type = kMetaAndData) override;
   Status GetProperty(const std::string& property, uint64_t* out) override;
-  Status ScanKeyNum(KeyInfo* key_info) override;
-  Status ScanKeys(const std::string& pattern,
-                  std::vector<std::string>* keys) override;
-  Status PKPatternMatchDel(const std::string& pattern, int32_t* ret) override;
+  Status ScanKeyNum(const KeyRange& range, const std::atomic<bool>& stop,
+                    KeyInfo* key_info) override;
+  Status ScanKeySizes(const std::atomic<bool>& stop,
+                      const KeySizeVisitor& visitor) override;
+  Status ScanKeys(const std::string& pattern, const KeyRange& range,
+                  const ElementVisitor& visitor) override;
+  Status PKPatternMatchDel(const std::string& pattern, const KeyRange& range,
+                           int32_t* ret) override;
 
   // ZSets Commands
   Status ZAdd(const Slice& key,
@@ -51,6 +57,10 @@ class RedisZSets : public Redis {
                 int32_t start,
                 int32_t stop,
                 std::vector<ScoreMember>* score_members);
+  Status ZRange(const Slice& key,
+                int32_t start,
+                int32_t stop,
+                const ScoreMemberVisitor& visitor);
   Status ZRangebyscore(const Slice& key,
                        double min,
                        double max,
@@ -59,6 +69,14 @@ class RedisZSets : public Redis {
                        int64_t count,
                        int64_t offset,
                        std::vector<ScoreMember>* score_members);
+  Status ZRangebyscore(const Slice& key,
+                       double min,
+                       double max,
+                       bool left_close,
+                       bool right_close,
+                       int64_t count,
+                       int64_t offset,
+                       const ScoreMemberVisitor& visitor);
   Status ZRank(const Slice& key,
                const Slice& member,
                int32_t* rank);
@@ -79,6 +97,10 @@ class RedisZSets : public Redis {
                    int32_t start,
                    int32_t stop,
                    std::vector<ScoreMember>* score_members);
+  Status ZRevrange(const Slice& key,
+                   int32_t start,
+                   int32_t stop,
+                   const ScoreMemberVisitor& visitor);
   Status ZRevrangebyscore(const Slice& key,
                           double min,
                           double max,
@@ -87,6 +109,14 @@ class RedisZSets : public Redis {
                           int64_t count,
                           int64_t offset,
                           std::vector<ScoreMember>* score_members);
+  Status ZRevrangebyscore(const Slice& key,
+                          double min,
+                          double max,
+                          bool left_close,
+                          bool right_close,
+                          int64_t count,
+                          int64_t offset,
+                          const ScoreMemberVisitor& visitor);
   Status ZRevrank(const Slice& key,
                   const Slice& member,
                   int32_t* rank);
@@ -125,6 +155,12 @@ class RedisZSets : public Redis {
                int64_t count,
                std::vector<ScoreMember>* score_members,
                int64_t* next_cursor);
+  Status ZScan(const Slice& key,
+               const std::string& cursor,
+               const std::string& pattern,
+               int64_t count,
+               std::vector<ScoreMember>* score_members,
+               std::string* next_cursor);
   Status PKScanRange(const Slice& key_start,
                      const Slice& key_end,
                      const Slice& pattern,
@@ -161,6 +197,30 @@ class RedisZSets : public Redis {
 
   // Iterate all data
   void ScanDatabase();
+
+ private:
+  // Reads the meta value of key and opens an iterator over the scores,
+  // both at one sequence, for the ranges by rank whose indexes come from
+  // the count of the meta value
+  Status NewRankIterator(const Slice& key, std::string* meta_value,
+                         std::unique_ptr<rocksdb::Iterator>* score_iter);
+
+  // Shared by the ZScan with a cursors store and the stateless one
+  Status ZScanFrom(const Slice& key, const std::string& start_point,
+                   const GlobPattern& glob, int64_t count,
+                   std::vector<ScoreMember>* score_members,
+                   std::string* next_member, bool* has_next);
+
+  // For write combining
+  struct ZIncrbyOp {
+    Slice member;
+    double increment;
+    double ret;
+  };
+  typedef WriteCombiner<ZIncrbyOp> ZIncrbyCombiner;
+  ZIncrbyCombiner zincrby_combiner_;
+  void ApplyZIncrbys(const Slice& key,
+                     const ZIncrbyCombiner::Requests& requests);
 };
 
 }  // namespace blackwidow
@@ -0,0 +1,111 @@
+//  Copyright (c) 2017-present The blackwidow Authors.  All rights reserved.
+//  This source code is licensed under the BSD-style license found in the
+//  LICENSE file in the root directory of this source tree. An additional grant
+//  of patent rights can be found in the PATENTS file in the same directory.
+
+#include "blackwidow/reply_sink.h"
+
+#include <stdio.h>
+
+#include "blackwidow/util.h"
+
+namespace blackwidow {
+
+RespReplySink::RespReplySink(std::string* buf, RespVersion version)
+    : buf_(buf), version_(version) {
+}
+
+void RespReplySink::StartArray(int64_t expected_len) {
+  StartAggregate('*', expected_len, false);
+}
+
+void RespReplySink::EndArray(int64_t len) {
+  EndAggregate(len);
+}
+
+void RespReplySink::StartMap(int64_t expected_len) {
+  if (version_ == kResp3) {
+    StartAggregate('%', expected_len, false);
+  } else {
+    StartAggregate('*', expected_len * 2, false);
+  }
+}
+
+void RespReplySink::EndMap(int64_t len) {
+  EndAggregate(version_ == kResp3 ? len : len * 2);
+}
+
+void RespReplySink::StartPairs(int64_t expected_len) {
+  if (version_ == kResp3) {
+    StartAggregate('*', expected_len, true);
+  } else {
+    StartAggregate('*', expected_len * 2, false);
+  }
+}
+
+void RespReplySink::EndPairs(int64_t len) {
+  EndAggregate(version_ == kResp3 ? len : len * 2);
+}
+
+void RespReplySink::AppendBulkString(const Slice& value) {
+  char len[32];
+  BeforeElement();
+  buf_->push_back('$');
+  buf_->append(len, Int64ToStr(len, sizeof(len), value.size()));
+  buf_->append("\r\n", 2);
+  buf_->append(value.data(), value.size());
+  buf_->append("\r\n", 2);
+}
+
+void RespReplySink::AppendDouble(double value) {
+  char dbuf[128];
+  int dlen = snprintf(dbuf, sizeof(dbuf), "%.17g", value);
+  if (version_ == kResp3) {
+    BeforeElement();
+    buf_->push_back(',');
+    buf_->append(dbuf, dlen);
+    buf_->append("\r\n", 2);
+  } else {
+    AppendBulkString(Slice(dbuf, dlen));
+  }
+}
+
+void RespReplySink::StartAggregate(char type, int64_t expected_len,
+                                   bool pairs) {
+  char len[32];
+  BeforeElement();
+  buf_->push_back(type);
+  Aggregate aggregate;
+  aggregate.header_pos = buf_->size();
+  aggregate.digits_len = Int64ToStr(len, sizeof(len),
+                                    expected_len > 0 ? expected_len : 0);
+  aggregate.elements = 0;
+  aggregate.pairs = pairs;
+  buf_->append(len, aggregate.digits_len);
+  buf_->append("\r\n", 2);
+  open_.push_back(aggregate);
+}
+
+void RespReplySink::EndAggregate(int64_t len) {
+  char digits[32];
+  const Aggregate& aggregate = open_.back();
+  size_t digits_len = Int64ToStr(digits, sizeof(digits), len);
+  // In place unless the hint had another number of digits, then the
+  // elements have to move
+  buf_->replace(aggregate.header_pos, aggregate.digits_len,
+                digits, digits_len);
+  open_.pop_back();
+}
+
+void RespReplySink::BeforeElement() {
+  if (open_.empty()) {
+    return;
+  }
+  Aggregate* aggregate = &open_.back();
+  if (aggregate->pairs && aggregate->elements % 2 == 0) {
+    buf_->append("*2\r\n", 4);
+  }
+  aggregate->elements++;
+}
+
+}  //  namespace blackwidow
@@ -0,0 +1,39 @@
+//  Copyright (c) 2017-present, Qihoo, Inc.  All rights reserved.
+//  This source code is licensed under the BSD-style license found in the
+//  LICENSE file in the root directory of this source tree. An additional grant
+//  of patent rights can be found in the PATENTS file in the same directory.
+
+#include "src/scan_policy.h"
+
+namespace blackwidow {
+
+ScanPolicy::ScanPolicy()
+    : large_read_threshold_(UINT64_MAX),
+      readahead_size_(0),
+      small_reads_(0),
+      large_reads_(0),
+      keyspace_scans_(0) {
+}
+
+void ScanPolicy::SetOptions(uint64_t large_read_threshold,
+                            size_t readahead_size) {
+  large_read_threshold_.store(large_read_threshold, std::memory_order_relaxed);
+  readahead_size_.store(readahead_size, std::memory_order_relaxed);
+}
+
+void ScanPolicy::GetStats(ScanPolicyStats* stats) const {
+  stats->large_read_threshold =
+    large_read_threshold_.load(std::memory_order_relaxed);
+  stats->readahead_size = readahead_size_.load(std::memory_order_relaxed);
+  stats->small_reads = small_reads_.load(std::memory_order_relaxed);
+  stats->large_reads = large_reads_.load(std::memory_order_relaxed);
+  stats->keyspace_scans = keyspace_scans_.load(std::memory_order_relaxed);
+}
+
+void ScanPolicy::ResetStats() {
+  small_reads_.store(0, std::memory_order_relaxed);
+  large_reads_.store(0, std::memory_order_relaxed);
+  keyspace_scans_.store(0, std::memory_order_relaxed);
+}
+
+}  //  namespace blackwidow
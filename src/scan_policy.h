@@ -0,0 +1,69 @@
+//  Copyright (c) 2017-present, Qihoo, Inc.  All rights reserved.
+//  This source code is licensed under the BSD-style license found in the
+//  LICENSE file in the root directory of this source tree. An additional grant
+//  of patent rights can be found in the PATENTS file in the same directory.
+
+#ifndef SRC_SCAN_POLICY_H_
+#define SRC_SCAN_POLICY_H_
+
+#include <stdint.h>
+#include <atomic>
+
+#include "rocksdb/options.h"
+
+#include "blackwidow/blackwidow.h"
+
+namespace blackwidow {
+
+// Picks the read options of the range reads by their expected size.
+//
+// A small collection read fills the block cache, it is likely read
+// again, and may use a pooled iterator. A read of more elements than
+// the large read threshold, and every keyspace scan, reads ahead with
+// large sequential I/Os and leaves the block cache to the small reads.
+class ScanPolicy {
+ public:
+  ScanPolicy();
+
+  void SetOptions(uint64_t large_read_threshold, size_t readahead_size);
+
+  // Set the read options of a read of count elements, false when it is
+  // a large read, which should not use a pooled iterator
+  bool ForCollection(uint64_t count, rocksdb::ReadOptions* read_options) {
+    if (count <= large_read_threshold_.load(std::memory_order_relaxed)) {
+      small_reads_.fetch_add(1, std::memory_order_relaxed);
+      read_options->fill_cache = true;
+      return true;
+    }
+    large_reads_.fetch_add(1, std::memory_order_relaxed);
+    read_options->fill_cache = false;
+    read_options->readahead_size =
+      readahead_size_.load(std::memory_order_relaxed);
+    return false;
+  }
+
+  void ForKeyspaceScan(rocksdb::ReadOptions* read_options) {
+    keyspace_scans_.fetch_add(1, std::memory_order_relaxed);
+    read_options->fill_cache = false;
+    read_options->readahead_size =
+      readahead_size_.load(std::memory_order_relaxed);
+  }
+
+  void GetStats(ScanPolicyStats* stats) const;
+  void ResetStats();
+
+ private:
+  std::atomic<uint64_t> large_read_threshold_;
+  std::atomic<size_t> readahead_size_;
+
+  std::atomic<uint64_t> small_reads_;
+  std::atomic<uint64_t> large_reads_;
+  std::atomic<uint64_t> keyspace_scans_;
+
+  // No copying allowed
+  ScanPolicy(const ScanPolicy&);
+  void operator=(const ScanPolicy&);
+};
+
+}  //  namespace blackwidow
+#endif  // SRC_SCAN_POLICY_H_
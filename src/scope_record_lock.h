@@ -8,24 +8,33 @@
 
 #include <vector>
 #include <string>
-#include <algorithm>
 
 #include "src/lock_mgr.h"
+#include "src/command_stats.h"
 
 namespace blackwidow {
 class ScopeRecordLock {
  public:
   ScopeRecordLock(LockMgr* lock_mgr, const Slice& key) :
-    lock_mgr_(lock_mgr), key_(key) {
-    lock_mgr_->TryLock(key_.ToString());
+    lock_mgr_(lock_mgr), slot_(lock_mgr->GetSlot(key)) {
+    CommandPhaseTimer timer(kPhaseLockWait);
+    status_ = lock_mgr_->LockSlot(slot_, key, LockMgr::ThreadDeadline());
   }
   ~ScopeRecordLock() {
-    lock_mgr_->UnLock(key_.ToString());
+    if (status_.ok()) {
+      lock_mgr_->UnLockSlot(slot_);
+    }
+  }
+
+  // Not ok when the key could not be locked before the LockDeadline
+  const Status& status() const {
+    return status_;
   }
 
  private:
   LockMgr* const lock_mgr_;
-  Slice key_;
+  const size_t slot_;
+  Status status_;
   ScopeRecordLock(const ScopeRecordLock&);
   void operator=(const ScopeRecordLock&);
 };
@@ -34,40 +43,23 @@ class MultiScopeRecordLock {
  public:
   MultiScopeRecordLock(LockMgr* lock_mgr,
                        const std::vector<std::string>& keys) :
-      lock_mgr_(lock_mgr),
-      keys_(keys) {
-    std::string pre_key;
-    std::sort(keys_.begin(), keys_.end());
-    if (!keys_.empty() &&
-      keys_[0].empty()) {
-      lock_mgr_->TryLock(pre_key);
-    }
-
-    for (const auto& key : keys_) {
-      if (pre_key != key) {
-        lock_mgr_->TryLock(key);
-        pre_key = key;
-      }
-    }
+      lock_mgr_(lock_mgr) {
+    CommandPhaseTimer timer(kPhaseLockWait);
+    status_ = lock_mgr_->MultiLock(keys, LockMgr::ThreadDeadline(), &slots_);
   }
   ~MultiScopeRecordLock() {
-    std::string pre_key;
-    if (!keys_.empty() &&
-      keys_[0].empty()) {
-      lock_mgr_->UnLock(pre_key);
-    }
+    lock_mgr_->MultiUnLock(slots_);
+  }
 
-    for (const auto& key : keys_) {
-      if (pre_key != key) {
-        lock_mgr_->UnLock(key);
-        pre_key = key;
-      }
-    }
+  // Not ok when the keys could not be locked before the LockDeadline
+  const Status& status() const {
+    return status_;
   }
 
  private:
   LockMgr* const lock_mgr_;
-  std::vector<std::string> keys_;
+  std::vector<size_t> slots_;
+  Status status_;
   MultiScopeRecordLock(const MultiScopeRecordLock&);
   void operator=(const MultiScopeRecordLock&);
 };
@@ -0,0 +1,395 @@
+//  Copyright (c) 2017-present, Qihoo, Inc.  All rights reserved.
+//  This source code is licensed under the BSD-style license found in the
+//  LICENSE file in the root directory of this source tree. An additional grant
+//  of patent rights can be found in the PATENTS file in the same directory.
+
+#ifndef SRC_SHARDED_LRU_CACHE_H_
+#define SRC_SHARDED_LRU_CACHE_H_
+
+#include <stdio.h>
+#include <assert.h>
+#include <atomic>
+#include <memory>
+#include <vector>
+#include <functional>
+#include <unordered_map>
+
+#include "rocksdb/status.h"
+
+#include "slash/include/slash_mutex.h"
+
+namespace blackwidow {
+
+using Status = rocksdb::Status;
+
+enum class CacheEvictionPolicy {
+  // A hit moves the entry to the head of the list
+  kLRU,
+  // A hit only marks the entry, the eviction gives marked entries a
+  // second chance, so hits never relink the list
+  kClock
+};
+
+// Handles are kept in the free list of their shard once evicted, the
+// key is the one stored in the hash table
+template <typename T1, typename T2>
+struct ShardHandle {
+  const T1* key;
+  T2 value;
+  size_t charge;
+  bool referenced;
+  ShardHandle* next;
+  ShardHandle* prev;
+};
+
+template <typename T1, typename T2>
+class LRUCacheShard {
+ public:
+  LRUCacheShard();
+  ~LRUCacheShard();
+
+  void SetPolicy(CacheEvictionPolicy policy) { policy_ = policy; }
+
+  size_t Size();
+  size_t TotalCharge();
+  void SetCapacity(size_t capacity);
+
+  Status Lookup(const T1& key, T2* value);
+  Status Insert(const T1& key, const T2& value, size_t charge);
+  Status Remove(const T1& key);
+  Status Clear();
+
+  bool LRUAndHandleTableConsistent();
+
+ private:
+  typedef ShardHandle<T1, T2> Handle;
+  static const size_t kHandleBlockSize = 64;
+
+  void Trim();
+  void Erase(Handle* const e);
+  void ListRemove(Handle* const e);
+  void ListAppend(Handle* const e);
+  Handle* AllocHandle();
+  void FreeHandle(Handle* const e);
+
+  CacheEvictionPolicy policy_;
+  size_t capacity_;
+  size_t usage_;
+
+  slash::Mutex mutex_;
+
+  // Dummy head of the list, lru_.prev is newest entry, lru_.next is
+  // oldest entry
+  Handle lru_;
+
+  std::unordered_map<T1, Handle*> table_;
+
+  Handle* free_handles_;
+  std::vector<std::unique_ptr<Handle[]>> handle_blocks_;
+
+  // No copying allowed
+  LRUCacheShard(const LRUCacheShard&);
+  void operator=(const LRUCacheShard&);
+};
+
+template <typename T1, typename T2>
+LRUCacheShard<T1, T2>::LRUCacheShard()
+    : policy_(CacheEvictionPolicy::kLRU),
+      capacity_(0),
+      usage_(0),
+      free_handles_(NULL) {
+  // Make empty circular linked lists.
+  lru_.next = &lru_;
+  lru_.prev = &lru_;
+}
+
+template <typename T1, typename T2>
+LRUCacheShard<T1, T2>::~LRUCacheShard() {
+  Clear();
+}
+
+template <typename T1, typename T2>
+size_t LRUCacheShard<T1, T2>::Size() {
+  slash::MutexLock l(&mutex_);
+  return table_.size();
+}
+
+template <typename T1, typename T2>
+size_t LRUCacheShard<T1, T2>::TotalCharge() {
+  slash::MutexLock l(&mutex_);
+  return usage_;
+}
+
+template <typename T1, typename T2>
+void LRUCacheShard<T1, T2>::SetCapacity(size_t capacity) {
+  slash::MutexLock l(&mutex_);
+  capacity_ = capacity;
+  Trim();
+}
+
+template <typename T1, typename T2>
+Status LRUCacheShard<T1, T2>::Lookup(const T1& key, T2* const value) {
+  slash::MutexLock l(&mutex_);
+  auto iter = table_.find(key);
+  if (iter == table_.end()) {
+    return Status::NotFound();
+  }
+  Handle* handle = iter->second;
+  if (policy_ == CacheEvictionPolicy::kClock) {
+    handle->referenced = true;
+  } else {
+    ListRemove(handle);
+    ListAppend(handle);
+  }
+  *value = handle->value;
+  return Status::OK();
+}
+
+template <typename T1, typename T2>
+Status LRUCacheShard<T1, T2>::Insert(const T1& key, const T2& value,
+                                     size_t charge) {
+  slash::MutexLock l(&mutex_);
+  if (capacity_ == 0) {
+    return Status::Corruption("capacity is empty");
+  }
+  auto result = table_.insert({key, nullptr});
+  Handle* handle = result.first->second;
+  if (result.second) {
+    handle = AllocHandle();
+    handle->key = &result.first->first;
+    handle->referenced = false;
+    result.first->second = handle;
+    ListAppend(handle);
+  } else {
+    usage_ -= handle->charge;
+    if (policy_ == CacheEvictionPolicy::kClock) {
+      handle->referenced = true;
+    } else {
+      ListRemove(handle);
+      ListAppend(handle);
+    }
+  }
+  handle->value = value;
+  handle->charge = charge;
+  usage_ += charge;
+  Trim();
+  return Status::OK();
+}
+
+template <typename T1, typename T2>
+Status LRUCacheShard<T1, T2>::Remove(const T1& key) {
+  slash::MutexLock l(&mutex_);
+  auto iter = table_.find(key);
+  if (iter == table_.end()) {
+    return Status::NotFound();
+  }
+  Handle* handle = iter->second;
+  table_.erase(iter);
+  ListRemove(handle);
+  usage_ -= handle->charge;
+  FreeHandle(handle);
+  return Status::OK();
+}
+
+template <typename T1, typename T2>
+Status LRUCacheShard<T1, T2>::Clear() {
+  slash::MutexLock l(&mutex_);
+  while (lru_.next != &lru_) {
+    Erase(lru_.next);
+  }
+  return Status::OK();
+}
+
+template <typename T1, typename T2>
+bool LRUCacheShard<T1, T2>::LRUAndHandleTableConsistent() {
+  size_t count = 0;
+  slash::MutexLock l(&mutex_);
+  Handle* current = lru_.prev;
+  while (current != &lru_) {
+    auto iter = table_.find(*current->key);
+    if (iter == table_.end() || iter->second != current) {
+      return false;
+    }
+    count++;
+    current = current->prev;
+  }
+  return count == table_.size();
+}
+
+template <typename T1, typename T2>
+void LRUCacheShard<T1, T2>::Trim() {
+  while (usage_ > capacity_ && lru_.next != &lru_) {
+    Handle* old = lru_.next;
+    if (old->referenced) {
+      // Second chance, every entry is passed at most once
+      old->referenced = false;
+      ListRemove(old);
+      ListAppend(old);
+      continue;
+    }
+    Erase(old);
+  }
+}
+
+template <typename T1, typename T2>
+void LRUCacheShard<T1, T2>::Erase(Handle* const e) {
+  ListRemove(e);
+  usage_ -= e->charge;
+  table_.erase(table_.find(*e->key));
+  FreeHandle(e);
+}
+
+template <typename T1, typename T2>
+void LRUCacheShard<T1, T2>::ListRemove(Handle* const e) {
+  e->next->prev = e->prev;
+  e->prev->next = e->next;
+}
+
+template <typename T1, typename T2>
+void LRUCacheShard<T1, T2>::ListAppend(Handle* const e) {
+  // Make "e" newest entry by inserting just before lru_
+  e->next = &lru_;
+  e->prev = lru_.prev;
+  e->prev->next = e;
+  e->next->prev = e;
+}
+
+template <typename T1, typename T2>
+ShardHandle<T1, T2>* LRUCacheShard<T1, T2>::AllocHandle() {
+  if (free_handles_ == NULL) {
+    Handle* block = new Handle[kHandleBlockSize];
+    handle_blocks_.push_back(std::unique_ptr<Handle[]>(block));
+    for (size_t idx = 0; idx < kHandleBlockSize; ++idx) {
+      FreeHandle(&block[idx]);
+    }
+  }
+  Handle* handle = free_handles_;
+  free_handles_ = handle->next;
+  return handle;
+}
+
+template <typename T1, typename T2>
+void LRUCacheShard<T1, T2>::FreeHandle(Handle* const e) {
+  // Release what the value holds, the handle itself is reused
+  e->value = T2();
+  e->key = NULL;
+  e->next = free_handles_;
+  free_handles_ = e;
+}
+
+// LRUCache split in 2^num_shard_bits shards by the hash of the key,
+// each with its own mutex, the capacity is spread evenly across them.
+// Same interface as LRUCache, but an entry may be evicted before older
+// entries of the other shards.
+template <typename T1, typename T2>
+class ShardedLRUCache {
+ public:
+  explicit ShardedLRUCache(
+      int num_shard_bits = 4,
+      CacheEvictionPolicy policy = CacheEvictionPolicy::kLRU);
+  ~ShardedLRUCache();
+
+  size_t Size();
+  size_t TotalCharge();
+  size_t Capacity();
+  void SetCapacity(size_t capacity);
+
+  Status Lookup(const T1& key, T2* value) {
+    return GetShard(key)->Lookup(key, value);
+  }
+
+  Status Insert(const T1& key, const T2& value, size_t charge = 1) {
+    return GetShard(key)->Insert(key, value, charge);
+  }
+
+  Status Remove(const T1& key) {
+    return GetShard(key)->Remove(key);
+  }
+
+  Status Clear();
+
+  // Just for test
+  bool LRUAndHandleTableConsistent();
+
+ private:
+  LRUCacheShard<T1, T2>* GetShard(const T1& key) {
+    return &shards_[std::hash<T1>()(key) & (num_shards_ - 1)];
+  }
+
+  const size_t num_shards_;
+  std::atomic<size_t> capacity_;
+  LRUCacheShard<T1, T2>* shards_;
+
+  // No copying allowed
+  ShardedLRUCache(const ShardedLRUCache&);
+  void operator=(const ShardedLRUCache&);
+};
+
+template <typename T1, typename T2>
+ShardedLRUCache<T1, T2>::ShardedLRUCache(int num_shard_bits,
+                                               CacheEvictionPolicy policy)
+    : num_shards_(static_cast<size_t>(1) << num_shard_bits),
+      capacity_(0) {
+  shards_ = new LRUCacheShard<T1, T2>[num_shards_];
+  for (size_t idx = 0; idx < num_shards_; ++idx) {
+    shards_[idx].SetPolicy(policy);
+  }
+}
+
+template <typename T1, typename T2>
+ShardedLRUCache<T1, T2>::~ShardedLRUCache() {
+  delete[] shards_;
+}
+
+template <typename T1, typename T2>
+size_t ShardedLRUCache<T1, T2>::Size() {
+  size_t size = 0;
+  for (size_t idx = 0; idx < num_shards_; ++idx) {
+    size += shards_[idx].Size();
+  }
+  return size;
+}
+
+template <typename T1, typename T2>
+size_t ShardedLRUCache<T1, T2>::TotalCharge() {
+  size_t usage = 0;
+  for (size_t idx = 0; idx < num_shards_; ++idx) {
+    usage += shards_[idx].TotalCharge();
+  }
+  return usage;
+}
+
+template <typename T1, typename T2>
+size_t ShardedLRUCache<T1, T2>::Capacity() {
+  return capacity_.load();
+}
+
+template <typename T1, typename T2>
+void ShardedLRUCache<T1, T2>::SetCapacity(size_t capacity) {
+  capacity_.store(capacity);
+  size_t shard_capacity = (capacity + num_shards_ - 1) / num_shards_;
+  for (size_t idx = 0; idx < num_shards_; ++idx) {
+    shards_[idx].SetCapacity(shard_capacity);
+  }
+}
+
+template <typename T1, typename T2>
+Status ShardedLRUCache<T1, T2>::Clear() {
+  for (size_t idx = 0; idx < num_shards_; ++idx) {
+    shards_[idx].Clear();
+  }
+  return Status::OK();
+}
+
+template <typename T1, typename T2>
+bool ShardedLRUCache<T1, T2>::LRUAndHandleTableConsistent() {
+  for (size_t idx = 0; idx < num_shards_; ++idx) {
+    if (!shards_[idx].LRUAndHandleTableConsistent()) {
+      return false;
+    }
+  }
+  return true;
+}
+
+}  //  namespace blackwidow
+#endif  // SRC_SHARDED_LRU_CACHE_H_
@@ -0,0 +1,426 @@
+//  Copyright (c) 2017-present, Qihoo, Inc.  All rights reserved.
+//  This source code is licensed under the BSD-style license found in the
+//  LICENSE file in the root directory of this source tree. An additional grant
+//  of patent rights can be found in the PATENTS file in the same directory.
+
+#ifndef SRC_TABLE_PROPERTIES_COLLECTOR_H_
+#define SRC_TABLE_PROPERTIES_COLLECTOR_H_
+
+#include <map>
+#include <string>
+#include <memory>
+#include <cstdlib>
+
+#include "rocksdb/env.h"
+#include "rocksdb/table_properties.h"
+
+#include "src/base_meta_value_format.h"
+#include "src/base_data_key_format.h"
+#include "src/lists_meta_value_format.h"
+#include "src/strings_value_format.h"
+
+namespace blackwidow {
+
+const std::string PROPERTY_GARBAGE_ENTRIES = "blackwidow.entries";
+const std::string PROPERTY_GARBAGE_DELETIONS = "blackwidow.deletions";
+const std::string PROPERTY_GARBAGE_STALE_VERSIONS = "blackwidow.stale-versions";
+const std::string PROPERTY_GARBAGE_EXPIRED = "blackwidow.expired";
+const std::string PROPERTY_EXPIRE_COUNT = "blackwidow.expire-count";
+const std::string PROPERTY_EXPIRE_MIN = "blackwidow.min-expire";
+const std::string PROPERTY_EXPIRE_MAX = "blackwidow.max-expire";
+const std::string PROPERTY_LIVE_KEYS = "blackwidow.live-keys";
+const std::string PROPERTY_LIVE_EXPIRE_COUNT = "blackwidow.live-expire-count";
+const std::string PROPERTY_LIVE_EXPIRE_SUM = "blackwidow.live-expire-sum";
+const std::string PROPERTY_LIVE_EXPIRE_MIN = "blackwidow.live-min-expire";
+
+// Files with less entries are never worth a dedicated compaction
+const uint64_t kGarbageMinEntries = 128;
+
+// Layout of the records a column family holds
+enum class RecordFormat {
+  kStringsValue,
+  kBaseMetaValue,
+  kListsMetaValue,
+  kBaseDataKey
+};
+
+struct GarbageProperties {
+  uint64_t entries;
+  uint64_t deletions;
+  uint64_t stale_versions;
+  uint64_t expired;
+
+  GarbageProperties()
+      : entries(0), deletions(0), stale_versions(0), expired(0) {}
+
+  uint64_t garbage() const {
+    return deletions + stale_versions + expired;
+  }
+
+  double ratio() const {
+    return entries == 0 ? 0 : static_cast<double>(garbage()) / entries;
+  }
+};
+
+inline bool ParseGarbageProperties(
+    const rocksdb::UserCollectedProperties& props,
+    GarbageProperties* garbage) {
+  const std::string* fields[] = {&PROPERTY_GARBAGE_ENTRIES,
+                                 &PROPERTY_GARBAGE_DELETIONS,
+                                 &PROPERTY_GARBAGE_STALE_VERSIONS,
+                                 &PROPERTY_GARBAGE_EXPIRED};
+  uint64_t* values[] = {&garbage->entries,
+                        &garbage->deletions,
+                        &garbage->stale_versions,
+                        &garbage->expired};
+  for (size_t idx = 0; idx < sizeof(fields) / sizeof(fields[0]); ++idx) {
+    auto iter = props.find(*fields[idx]);
+    if (iter == props.end()) {
+      // Written before the collector was installed
+      return false;
+    }
+    *values[idx] = std::strtoull(iter->second.c_str(), NULL, 10);
+  }
+  return true;
+}
+
+// Records of a SST carrying a timeout, only known for the column
+// families whose values hold the timestamp
+struct ExpireProperties {
+  uint64_t entries;
+  uint64_t expire_count;
+  int32_t min_expire;
+  int32_t max_expire;
+
+  ExpireProperties()
+      : entries(0), expire_count(0), min_expire(0), max_expire(0) {}
+
+  // Estimate the ratio of entries expired at cur_time, assuming the
+  // timeouts are evenly spread between min_expire and max_expire
+  double ExpiredRatio(int32_t cur_time) const {
+    if (entries == 0 || expire_count == 0 || cur_time <= min_expire) {
+      return 0;
+    }
+    double expired = expire_count;
+    if (cur_time <= max_expire) {
+      expired = expired * (cur_time - min_expire) / (max_expire - min_expire);
+    }
+    return expired / entries;
+  }
+};
+
+inline bool ParseExpireProperties(
+    const rocksdb::UserCollectedProperties& props,
+    ExpireProperties* expire) {
+  auto entries_iter = props.find(PROPERTY_GARBAGE_ENTRIES);
+  auto count_iter = props.find(PROPERTY_EXPIRE_COUNT);
+  auto min_iter = props.find(PROPERTY_EXPIRE_MIN);
+  auto max_iter = props.find(PROPERTY_EXPIRE_MAX);
+  if (entries_iter == props.end() || count_iter == props.end()
+    || min_iter == props.end() || max_iter == props.end()) {
+    return false;
+  }
+  expire->entries = std::strtoull(entries_iter->second.c_str(), NULL, 10);
+  expire->expire_count = std::strtoull(count_iter->second.c_str(), NULL, 10);
+  expire->min_expire = std::atoi(min_iter->second.c_str());
+  expire->max_expire = std::atoi(max_iter->second.c_str());
+  return true;
+}
+
+// Keys of a meta column family SST, live and expiring are as of the
+// time the file was written
+struct KeyNumProperties {
+  uint64_t live_keys;
+  uint64_t stale_keys;
+  uint64_t deletions;
+  uint64_t expire_count;
+  uint64_t expire_sum;
+  int32_t min_expire;
+  int32_t max_expire;
+
+  KeyNumProperties()
+      : live_keys(0), stale_keys(0), deletions(0), expire_count(0),
+        expire_sum(0), min_expire(0), max_expire(0) {}
+
+  // Estimate the live expiring keys expired at cur_time, assuming their
+  // timeouts are evenly spread between min_expire and max_expire
+  uint64_t ExpiredSince(int32_t cur_time) const {
+    if (expire_count == 0 || cur_time <= min_expire) {
+      return 0;
+    }
+    if (cur_time >= max_expire) {
+      return expire_count;
+    }
+    return expire_count * (static_cast<uint64_t>(cur_time) - min_expire)
+      / (static_cast<uint64_t>(max_expire) - min_expire);
+  }
+
+  // Sum of the ttl left at cur_time to the keys not expired yet
+  uint64_t TTLSum(int32_t cur_time) const {
+    uint64_t expired = ExpiredSince(cur_time);
+    uint64_t remaining = expire_count - expired;
+    if (remaining == 0) {
+      return 0;
+    }
+    if (expired == 0) {
+      return expire_sum - static_cast<uint64_t>(cur_time) * expire_count;
+    }
+    // The remaining timeouts are spread between cur_time and max_expire
+    return remaining * (static_cast<uint64_t>(max_expire) - cur_time) / 2;
+  }
+};
+
+inline bool ParseKeyNumProperties(
+    const rocksdb::UserCollectedProperties& props,
+    KeyNumProperties* key_num) {
+  GarbageProperties garbage;
+  if (!ParseGarbageProperties(props, &garbage)) {
+    return false;
+  }
+  const std::string* fields[] = {&PROPERTY_LIVE_KEYS,
+                                 &PROPERTY_LIVE_EXPIRE_COUNT,
+                                 &PROPERTY_LIVE_EXPIRE_SUM,
+                                 &PROPERTY_LIVE_EXPIRE_MIN,
+                                 &PROPERTY_EXPIRE_MAX};
+  std::string values[sizeof(fields) / sizeof(fields[0])];
+  for (size_t idx = 0; idx < sizeof(fields) / sizeof(fields[0]); ++idx) {
+    auto iter = props.find(*fields[idx]);
+    if (iter == props.end()) {
+      // Data column family, or written before the key counts were added
+      return false;
+    }
+    values[idx] = iter->second;
+  }
+  key_num->live_keys = std::strtoull(values[0].c_str(), NULL, 10);
+  key_num->expire_count = std::strtoull(values[1].c_str(), NULL, 10);
+  key_num->expire_sum = std::strtoull(values[2].c_str(), NULL, 10);
+  key_num->min_expire = std::atoi(values[3].c_str());
+  key_num->max_expire = std::atoi(values[4].c_str());
+  key_num->stale_keys = garbage.expired + garbage.stale_versions;
+  key_num->deletions = garbage.deletions;
+  return true;
+}
+
+// Counts per SST the records that a compaction would drop:
+// deletions, meta values of emptied keys, data of superseded versions
+// and records already expired when the file was written. For values
+// carrying a timestamp the range of timeouts is kept as well, so files
+// that expire after they were written can be found later. The meta
+// column families also record their live keys, so the keys can be
+// counted without a scan.
+class GarbagePropertiesCollector : public rocksdb::TablePropertiesCollector {
+ public:
+  GarbagePropertiesCollector(RecordFormat format, double garbage_ratio)
+      : format_(format),
+        garbage_ratio_(garbage_ratio),
+        cur_time_(0),
+        expire_count_(0),
+        min_expire_(0),
+        max_expire_(0),
+        live_keys_(0),
+        live_expire_count_(0),
+        live_expire_sum_(0),
+        live_min_expire_(0),
+        cur_key_("") {
+    int64_t unix_time = CoarseClock::Now();
+    cur_time_ = static_cast<int32_t>(unix_time);
+  }
+
+  rocksdb::Status AddUserKey(const rocksdb::Slice& key,
+                             const rocksdb::Slice& value,
+                             rocksdb::EntryType type,
+                             rocksdb::SequenceNumber seq,
+                             uint64_t file_size) override {
+    garbage_.entries++;
+    if (type == rocksdb::kEntryDelete
+      || type == rocksdb::kEntrySingleDelete) {
+      garbage_.deletions++;
+      return rocksdb::Status::OK();
+    }
+    if (type != rocksdb::kEntryPut) {
+      return rocksdb::Status::OK();
+    }
+
+    switch (format_) {
+      case RecordFormat::kStringsValue:
+        AddStringsValue(value);
+        break;
+      case RecordFormat::kBaseMetaValue:
+        AddBaseMetaValue(value);
+        break;
+      case RecordFormat::kListsMetaValue:
+        AddListsMetaValue(value);
+        break;
+      case RecordFormat::kBaseDataKey:
+        AddBaseDataKey(key);
+        break;
+    }
+    return rocksdb::Status::OK();
+  }
+
+  rocksdb::Status Finish(
+      rocksdb::UserCollectedProperties* properties) override {
+    FinishCurrentKey();
+    AppendProperties(properties);
+    return rocksdb::Status::OK();
+  }
+
+  rocksdb::UserCollectedProperties GetReadableProperties() const override {
+    rocksdb::UserCollectedProperties properties;
+    AppendProperties(&properties);
+    return properties;
+  }
+
+  // Let rocksdb pick the file for compaction by itself
+  bool NeedCompact() const override {
+    return garbage_ratio_ > 0
+      && garbage_.entries >= kGarbageMinEntries
+      && garbage_.ratio() >= garbage_ratio_;
+  }
+
+  const char* Name() const override { return "GarbagePropertiesCollector"; }
+
+ private:
+  void AppendProperties(rocksdb::UserCollectedProperties* properties) const {
+    properties->insert({PROPERTY_GARBAGE_ENTRIES,
+                        std::to_string(garbage_.entries)});
+    properties->insert({PROPERTY_GARBAGE_DELETIONS,
+                        std::to_string(garbage_.deletions)});
+    properties->insert({PROPERTY_GARBAGE_STALE_VERSIONS,
+                        std::to_string(garbage_.stale_versions)});
+    properties->insert({PROPERTY_GARBAGE_EXPIRED,
+                        std::to_string(garbage_.expired)});
+    if (format_ != RecordFormat::kBaseDataKey) {
+      properties->insert({PROPERTY_EXPIRE_COUNT,
+                          std::to_string(expire_count_)});
+      properties->insert({PROPERTY_EXPIRE_MIN, std::to_string(min_expire_)});
+      properties->insert({PROPERTY_EXPIRE_MAX, std::to_string(max_expire_)});
+      properties->insert({PROPERTY_LIVE_KEYS, std::to_string(live_keys_)});
+      properties->insert({PROPERTY_LIVE_EXPIRE_COUNT,
+                          std::to_string(live_expire_count_)});
+      properties->insert({PROPERTY_LIVE_EXPIRE_SUM,
+                          std::to_string(live_expire_sum_)});
+      properties->insert({PROPERTY_LIVE_EXPIRE_MIN,
+                          std::to_string(live_min_expire_)});
+    }
+  }
+
+  // Return true if the record was already expired
+  bool AddTimestamp(int32_t timestamp) {
+    if (timestamp == 0) {
+      return false;
+    }
+    if (expire_count_ == 0 || timestamp < min_expire_) {
+      min_expire_ = timestamp;
+    }
+    if (expire_count_ == 0 || timestamp > max_expire_) {
+      max_expire_ = timestamp;
+    }
+    expire_count_++;
+    return timestamp < cur_time_;
+  }
+
+  void AddLiveKey(int32_t timestamp) {
+    live_keys_++;
+    if (timestamp == 0) {
+      return;
+    }
+    if (live_expire_count_ == 0 || timestamp < live_min_expire_) {
+      live_min_expire_ = timestamp;
+    }
+    live_expire_count_++;
+    live_expire_sum_ += timestamp;
+  }
+
+  void AddStringsValue(const rocksdb::Slice& value) {
+    ParsedStringsValue parsed_strings_value(value);
+    if (AddTimestamp(parsed_strings_value.timestamp())) {
+      garbage_.expired++;
+    } else {
+      AddLiveKey(parsed_strings_value.timestamp());
+    }
+  }
+
+  void AddBaseMetaValue(const rocksdb::Slice& value) {
+    ParsedBaseMetaValue parsed_base_meta_value(value);
+    if (AddTimestamp(parsed_base_meta_value.timestamp())) {
+      garbage_.expired++;
+    } else if (parsed_base_meta_value.count() == 0) {
+      garbage_.stale_versions++;
+    } else {
+      AddLiveKey(parsed_base_meta_value.timestamp());
+    }
+  }
+
+  void AddListsMetaValue(const rocksdb::Slice& value) {
+    ParsedListsMetaValue parsed_lists_meta_value(value);
+    if (AddTimestamp(parsed_lists_meta_value.timestamp())) {
+      garbage_.expired++;
+    } else if (parsed_lists_meta_value.count() == 0) {
+      garbage_.stale_versions++;
+    } else {
+      AddLiveKey(parsed_lists_meta_value.timestamp());
+    }
+  }
+
+  // The data keys of one user key are adjacent, every version but the
+  // newest one seen in this file is garbage
+  void AddBaseDataKey(const rocksdb::Slice& key) {
+    if (key.size() < sizeof(int32_t) * 2) {
+      return;
+    }
+    ParsedBaseDataKey parsed_base_data_key(key);
+    if (parsed_base_data_key.key() != cur_key_) {
+      FinishCurrentKey();
+      cur_key_ = parsed_base_data_key.key().ToString();
+    }
+    cur_versions_[parsed_base_data_key.version()]++;
+  }
+
+  void FinishCurrentKey() {
+    if (cur_versions_.size() > 1) {
+      auto newest = cur_versions_.rbegin();
+      for (auto iter = ++newest; iter != cur_versions_.rend(); ++iter) {
+        garbage_.stale_versions += iter->second;
+      }
+    }
+    cur_versions_.clear();
+  }
+
+  RecordFormat format_;
+  double garbage_ratio_;
+  int32_t cur_time_;
+  GarbageProperties garbage_;
+  uint64_t expire_count_;
+  int32_t min_expire_;
+  int32_t max_expire_;
+  uint64_t live_keys_;
+  uint64_t live_expire_count_;
+  uint64_t live_expire_sum_;
+  int32_t live_min_expire_;
+  std::string cur_key_;
+  std::map<int32_t, uint64_t> cur_versions_;
+};
+
+class GarbagePropertiesCollectorFactory
+    : public rocksdb::TablePropertiesCollectorFactory {
+ public:
+  GarbagePropertiesCollectorFactory(RecordFormat format, double garbage_ratio)
+      : format_(format), garbage_ratio_(garbage_ratio) {}
+
+  rocksdb::TablePropertiesCollector* CreateTablePropertiesCollector(
+      rocksdb::TablePropertiesCollectorFactory::Context context) override {
+    return new GarbagePropertiesCollector(format_, garbage_ratio_);
+  }
+
+  const char* Name() const override {
+    return "GarbagePropertiesCollectorFactory";
+  }
+
+ private:
+  RecordFormat format_;
+  double garbage_ratio_;
+};
+
+}  //  namespace blackwidow
+#endif  // SRC_TABLE_PROPERTIES_COLLECTOR_H_
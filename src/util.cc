@@ -502,4 +502,22 @@ bool isTailWildcard(const std::string& pattern) {
   return true;
 }
 
+std::string EncodeScanCursor(char type_tag, const std::string& position) {
+  std::string cursor;
+  cursor.reserve(position.size() + 1);
+  cursor.push_back(type_tag);
+  cursor.append(position);
+  return cursor;
+}
+
+bool DecodeScanCursor(const std::string& cursor, char* type_tag,
+                      std::string* position) {
+  if (cursor.empty()) {
+    return false;
+  }
+  *type_tag = cursor[0];
+  position->assign(cursor, 1, std::string::npos);
+  return true;
+}
+
 }  //  namespace blackwidow
@@ -0,0 +1,133 @@
+//  Copyright (c) 2017-present, Qihoo, Inc.  All rights reserved.
+//  This source code is licensed under the BSD-style license found in the
+//  LICENSE file in the root directory of this source tree. An additional grant
+//  of patent rights can be found in the PATENTS file in the same directory.
+
+#ifndef SRC_WRITE_COMBINER_H_
+#define SRC_WRITE_COMBINER_H_
+
+#include <mutex>
+#include <vector>
+#include <algorithm>
+
+#include "rocksdb/slice.h"
+#include "rocksdb/status.h"
+
+#include "src/murmurhash.h"
+#include "src/lock_mgr.h"
+#include "src/scope_record_lock.h"
+
+namespace blackwidow {
+
+// Flat combining of the writes to a hot key: a thread queues its request
+// before waiting for the record lock of the key, and the thread getting
+// the lock applies every request queued for the key at once, with one
+// meta read and one WriteBatch. The threads whose request was applied
+// meanwhile only take the lock to pick up their result.
+//
+// Op holds the arguments and the result of a request, Run() calls the
+// apply function with the record lock of the key held, which sets the
+// status and result of every request it is given.
+template <typename Op>
+class WriteCombiner {
+ public:
+  struct Request {
+    Request(const Slice& request_key, const Op& request_op)
+        : key(request_key), op(request_op), done(false) {}
+
+    Slice key;
+    Op op;
+    Status status;
+    // Only read and written with the record lock of key held
+    bool done;
+  };
+
+  typedef std::vector<Request*> Requests;
+
+  WriteCombiner() {}
+
+  template <typename Apply>
+  Status Run(LockMgr* lock_mgr, Request* request, const Apply& apply) {
+    Add(request);
+    {
+      ScopeRecordLock l(lock_mgr, request->key);
+      if (l.status().ok()) {
+        if (!request->done) {
+          Requests requests;
+          Take(request->key, &requests);
+          apply(request->key, requests);
+          for (auto queued : requests) {
+            queued->done = true;
+          }
+        }
+        return request->status;
+      }
+      if (Remove(request)) {
+        return l.status();
+      }
+    }
+    // Taken by the holder of the lock, which is applying it right now,
+    // the deadline can not be honored anymore
+    lock_mgr->Lock(request->key);
+    Status s = request->status;
+    lock_mgr->UnLock(request->key);
+    return s;
+  }
+
+ private:
+  static const size_t kNumShards = 64;
+
+  struct Shard {
+    std::mutex mutex;
+    std::vector<Request*> requests;
+  };
+
+  Shard* GetShard(const Slice& key) {
+    return &shards_[MurmurHash(key.data(), static_cast<int>(key.size()), 0)
+                    % kNumShards];
+  }
+
+  void Add(Request* request) {
+    Shard* shard = GetShard(request->key);
+    std::lock_guard<std::mutex> lock(shard->mutex);
+    shard->requests.push_back(request);
+  }
+
+  // False when the request was already taken to be applied
+  bool Remove(Request* request) {
+    Shard* shard = GetShard(request->key);
+    std::lock_guard<std::mutex> lock(shard->mutex);
+    auto iter = std::find(shard->requests.begin(), shard->requests.end(),
+                          request);
+    if (iter == shard->requests.end()) {
+      return false;
+    }
+    shard->requests.erase(iter);
+    return true;
+  }
+
+  // The queued requests of key, in their queuing order
+  void Take(const Slice& key, Requests* requests) {
+    Shard* shard = GetShard(key);
+    std::lock_guard<std::mutex> lock(shard->mutex);
+    auto keep = shard->requests.begin();
+    for (auto iter = shard->requests.begin();
+         iter != shard->requests.end(); ++iter) {
+      if ((*iter)->key == key) {
+        requests->push_back(*iter);
+      } else {
+        *keep++ = *iter;
+      }
+    }
+    shard->requests.erase(keep, shard->requests.end());
+  }
+
+  Shard shards_[kNumShards];
+
+  // No copying allowed
+  WriteCombiner(const WriteCombiner&);
+  void operator=(const WriteCombiner&);
+};
+
+}  //  namespace blackwidow
+#endif  // SRC_WRITE_COMBINER_H_
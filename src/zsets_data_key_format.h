@@ -6,6 +6,8 @@
 #ifndef SRC_ZSETS_DATA_KEY_FORMAT_H_
 #define SRC_ZSETS_DATA_KEY_FORMAT_H_
 
+#include "src/encode_buffer.h"
+
 namespace blackwidow {
 
 /*
@@ -16,31 +18,18 @@ class ZSetsScoreKey {
  public:
   ZSetsScoreKey(const Slice& key, int32_t version,
                 double score, const Slice& member) :
-    start_(nullptr), key_(key),
+    encoded_size_(0), key_(key),
     version_(version), score_(score),
     member_(member) {}
 
-  ~ZSetsScoreKey() {
-    if (start_ != space_) {
-      delete[] start_;
-    }
-  }
-
+  // Encoded once, the next calls return the same slice
   const Slice Encode() {
+    if (encoded_size_ != 0) {
+      return Slice(buffer_.data(), encoded_size_);
+    }
     size_t needed = key_.size() + member_.size()
                         + sizeof(int32_t) * 2 + sizeof(uint64_t);
-    char* dst = nullptr;
-    if (needed <= sizeof(space_)) {
-      dst = space_;
-    } else {
-      dst = new char[needed];
-
-      // Need to allocate space, delete previous space
-      if (start_ != space_) {
-        delete[] start_;
-      }
-    }
-    start_ = dst;
+    char* dst = buffer_.Reserve(needed);
     EncodeFixed32(dst, key_.size());
     dst += sizeof(int32_t);
     memcpy(dst, key_.data(), key_.size());
@@ -51,12 +40,13 @@ class ZSetsScoreKey {
     EncodeFixed64(dst, *reinterpret_cast<const uint64_t*>(addr_score));
     dst += sizeof(uint64_t);
     memcpy(dst, member_.data(), member_.size());
-    return Slice(start_, needed);
+    encoded_size_ = needed;
+    return Slice(buffer_.data(), needed);
   }
 
  private:
-  char space_[200];
-  char* start_;
+  EncodeBuffer buffer_;
+  size_t encoded_size_;
   Slice key_;
   int32_t version_;
   double score_;
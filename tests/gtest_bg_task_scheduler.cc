@@ -0,0 +1,227 @@
+//  Copyright (c) 2017-present, Qihoo, Inc.  All rights reserved.
+//  This source code is licensed under the BSD-style license found in the
+//  LICENSE file in the root directory of this source tree. An additional grant
+//  of patent rights can be found in the PATENTS file in the same directory.
+
+#include <gtest/gtest.h>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include <condition_variable>
+
+#include "src/bg_task_scheduler.h"
+
+using namespace blackwidow;
+
+class BGTaskRecorder {
+ public:
+  BGTaskRecorder() : gate_open_(false), started_(0) {}
+
+  void Run(const BGTask& task) {
+    std::unique_lock<std::mutex> lock(mutex_);
+    started_++;
+    cv_.notify_all();
+    if (task.argv == "block") {
+      cv_.wait(lock, [this] { return gate_open_; });
+    }
+    tasks_.push_back(task);
+    cv_.notify_all();
+  }
+
+  void WaitStarted(size_t num) {
+    std::unique_lock<std::mutex> lock(mutex_);
+    cv_.wait(lock, [this, num] { return started_ >= num; });
+  }
+
+  void WaitFinished(size_t num) {
+    std::unique_lock<std::mutex> lock(mutex_);
+    cv_.wait(lock, [this, num] { return tasks_.size() >= num; });
+  }
+
+  void OpenGate() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    gate_open_ = true;
+    cv_.notify_all();
+  }
+
+  std::vector<BGTask> Tasks() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return tasks_;
+  }
+
+ private:
+  std::mutex mutex_;
+  std::condition_variable cv_;
+  bool gate_open_;
+  size_t started_;
+  std::vector<BGTask> tasks_;
+};
+
+// Priority
+TEST(BGTaskSchedulerTest, PriorityTest) {
+  BGTaskRecorder recorder;
+  BGTaskScheduler scheduler(std::bind(&BGTaskRecorder::Run,
+                                      &recorder, std::placeholders::_1));
+  ASSERT_TRUE(scheduler.Start(1).ok());
+
+  ASSERT_TRUE(scheduler.Schedule({kHashes, kCompactKey, "block"}).ok());
+  recorder.WaitStarted(1);
+
+  ASSERT_TRUE(scheduler.Schedule({kSets, kCleanAll}).ok());
+  ASSERT_TRUE(scheduler.Schedule({kZSets, kCompactKey, "KEY1"}).ok());
+  ASSERT_TRUE(scheduler.Schedule({kLists, kCompactKey, "KEY2"}).ok());
+  ASSERT_EQ(scheduler.QueueDepth(), 3);
+
+  recorder.OpenGate();
+  recorder.WaitFinished(4);
+  std::vector<BGTask> tasks = recorder.Tasks();
+  ASSERT_EQ(tasks[0].argv, "block");
+  ASSERT_EQ(tasks[1].argv, "KEY1");
+  ASSERT_EQ(tasks[2].argv, "KEY2");
+  ASSERT_EQ(tasks[3].type, kSets);
+  ASSERT_EQ(tasks[3].operation, kCleanAll);
+  scheduler.Stop();
+}
+
+// Coalesce
+TEST(BGTaskSchedulerTest, CoalesceTest) {
+  BGTaskRecorder recorder;
+  BGTaskScheduler scheduler(std::bind(&BGTaskRecorder::Run,
+                                      &recorder, std::placeholders::_1));
+  ASSERT_TRUE(scheduler.Start(1).ok());
+
+  ASSERT_TRUE(scheduler.Schedule({kHashes, kCompactKey, "block"}).ok());
+  recorder.WaitStarted(1);
+
+  for (int idx = 0; idx < 100; ++idx) {
+    ASSERT_TRUE(scheduler.Schedule({kSets, kCompactKey, "KEY"}).ok());
+  }
+  ASSERT_TRUE(scheduler.Schedule({kZSets, kCompactKey, "KEY"}).ok());
+  ASSERT_TRUE(scheduler.Schedule({kAll, kAnalyzeKeyspace}).ok());
+  ASSERT_EQ(scheduler.QueueDepth(), 3);
+
+  // Compact all data base supersedes every pending compaction
+  ASSERT_TRUE(scheduler.Schedule({kAll, kCleanAll}).ok());
+  ASSERT_EQ(scheduler.QueueDepth(), 2);
+
+  BGTaskStats stats;
+  scheduler.GetStats(&stats);
+  ASSERT_EQ(stats.scheduled, 5);
+  ASSERT_EQ(stats.coalesced, 101);
+  ASSERT_EQ(stats.pending_by_priority[kFullPriority], 1);
+  ASSERT_EQ(stats.running, 1);
+
+  recorder.OpenGate();
+  recorder.WaitFinished(3);
+  std::vector<BGTask> tasks = recorder.Tasks();
+  ASSERT_EQ(tasks[1].operation, kAnalyzeKeyspace);
+  ASSERT_EQ(tasks[2].type, kAll);
+  ASSERT_EQ(tasks[2].operation, kCleanAll);
+  scheduler.Stop();
+}
+
+// Cancel
+TEST(BGTaskSchedulerTest, CancelTest) {
+  BGTaskRecorder recorder;
+  BGTaskScheduler scheduler(std::bind(&BGTaskRecorder::Run,
+                                      &recorder, std::placeholders::_1));
+  ASSERT_TRUE(scheduler.Start(1).ok());
+
+  ASSERT_TRUE(scheduler.Schedule({kHashes, kCompactKey, "block"}).ok());
+  recorder.WaitStarted(1);
+
+  ASSERT_TRUE(scheduler.Schedule({kSets, kCompactKey, "KEY1"}).ok());
+  ASSERT_TRUE(scheduler.Schedule({kSets, kCompactKey, "KEY2"}).ok());
+  ASSERT_TRUE(scheduler.Schedule({kHashes, kCleanAll}).ok());
+
+  ASSERT_TRUE(scheduler.Cancel({kSets, kCompactKey, "KEY1"}).ok());
+  ASSERT_TRUE(scheduler.Cancel({kSets, kCompactKey, "KEY1"}).IsNotFound());
+  // Running task can not be cancelled
+  ASSERT_TRUE(scheduler.Cancel({kHashes, kCompactKey, "block"}).IsNotFound());
+  ASSERT_EQ(scheduler.QueueDepth(), 2);
+
+  ASSERT_EQ(scheduler.CancelAll(), 2);
+  ASSERT_EQ(scheduler.QueueDepth(), 0);
+
+  BGTaskStats stats;
+  scheduler.GetStats(&stats);
+  ASSERT_EQ(stats.cancelled, 3);
+
+  recorder.OpenGate();
+  recorder.WaitFinished(1);
+  scheduler.Stop();
+  ASSERT_EQ(recorder.Tasks().size(), 1);
+
+  // Stopped scheduler refuse new task
+  ASSERT_TRUE(scheduler.Schedule({kSets, kCompactKey, "KEY3"}).IsIncomplete());
+}
+
+// Worker pool
+TEST(BGTaskSchedulerTest, WorkerPoolTest) {
+  BGTaskRecorder recorder;
+  BGTaskScheduler scheduler(std::bind(&BGTaskRecorder::Run,
+                                      &recorder, std::placeholders::_1));
+  ASSERT_TRUE(scheduler.Start(2).ok());
+
+  // A long full compaction occupies one worker, per key compaction
+  // still runs on the reserved one
+  ASSERT_TRUE(scheduler.Schedule({kAll, kCleanAll, "block"}).ok());
+  recorder.WaitStarted(1);
+  ASSERT_TRUE(scheduler.Schedule({kStrings, kCleanAll}).ok());
+  ASSERT_TRUE(scheduler.Schedule({kSets, kCompactKey, "KEY"}).ok());
+  recorder.WaitFinished(1);
+
+  std::vector<BGTask> tasks = recorder.Tasks();
+  ASSERT_EQ(tasks[0].argv, "KEY");
+  ASSERT_EQ(scheduler.QueueDepth(), 1);
+
+  BGTaskStats stats;
+  scheduler.GetStats(&stats);
+  ASSERT_EQ(stats.workers, 2);
+
+  recorder.OpenGate();
+  recorder.WaitFinished(3);
+
+  // Stop join the workers after they have recorded the timing
+  scheduler.Stop();
+  scheduler.GetStats(&stats);
+  ASSERT_EQ(stats.pending, 0);
+  ASSERT_EQ(stats.running, 0);
+  ASSERT_EQ(stats.timing_by_priority[kKeyPriority].count, 1);
+  ASSERT_EQ(stats.timing_by_priority[kTypePriority].count, 1);
+  ASSERT_EQ(stats.timing_by_priority[kFullPriority].count, 1);
+  ASSERT_GE(stats.timing_by_priority[kFullPriority].max_micros,
+            stats.timing_by_priority[kFullPriority].last_micros);
+}
+
+// Only the full compaction of all dbs supersedes the pending tasks
+TEST(BGTaskSchedulerTest, FullPriorityTest) {
+  ASSERT_EQ(BGTaskScheduler::PriorityOf({kAll, kCleanAll}), kFullPriority);
+  ASSERT_EQ(BGTaskScheduler::PriorityOf({kAll, kCompactGarbage}),
+            kTypePriority);
+  ASSERT_EQ(BGTaskScheduler::PriorityOf({kHashes, kCleanAll}),
+            kTypePriority);
+}
+
+// Periodic
+TEST(BGTaskSchedulerTest, PeriodicTest) {
+  BGTaskRecorder recorder;
+  BGTaskScheduler scheduler(std::bind(&BGTaskRecorder::Run,
+                                      &recorder, std::placeholders::_1));
+  ASSERT_TRUE(scheduler.Start(1).ok());
+  scheduler.AddPeriodicTask({kAll, kCompactExpired}, 10000);
+
+  recorder.WaitFinished(3);
+  scheduler.Stop();
+  std::vector<BGTask> tasks = recorder.Tasks();
+  for (const auto& task : tasks) {
+    ASSERT_EQ(task.type, kAll);
+    ASSERT_EQ(task.operation, kCompactExpired);
+  }
+  ASSERT_EQ(BGTaskScheduler::PriorityOf(tasks[0]), kTypePriority);
+}
+
+int main(int argc, char** argv) {
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
@@ -0,0 +1,65 @@
+//  Copyright (c) 2017-present, Qihoo, Inc.  All rights reserved.
+//  This source code is licensed under the BSD-style license found in the
+//  LICENSE file in the root directory of this source tree. An additional grant
+//  of patent rights can be found in the PATENTS file in the same directory.
+
+#include <gtest/gtest.h>
+#include <cstdlib>
+#include <string>
+
+#include "blackwidow/blackwidow.h"
+#include "src/coarse_clock.h"
+#include "src/strings_value_format.h"
+
+using namespace blackwidow;
+
+static int64_t EnvNow() {
+  int64_t unix_time;
+  rocksdb::Env::Default()->GetCurrentTime(&unix_time);
+  return unix_time;
+}
+
+// The clock follows the real time with and without a ticker
+TEST(CoarseClockTest, NowTest) {
+  ASSERT_LE(std::abs(CoarseClock::Now() - EnvNow()), 1);
+
+  CoarseClock::Start();
+  CoarseClock::Start();
+  ASSERT_LE(std::abs(CoarseClock::Now() - EnvNow()), 1);
+  CoarseClock::Stop();
+  ASSERT_LE(std::abs(CoarseClock::Now() - EnvNow()), 1);
+  CoarseClock::Stop();
+  ASSERT_LE(std::abs(CoarseClock::Now() - EnvNow()), 1);
+}
+
+// A fixed time is kept by the ticker until it is cleared
+TEST(CoarseClockTest, SetNowTest) {
+  CoarseClock::Start();
+  CoarseClock::SetNow(1000);
+  usleep(20 * 1000);
+  ASSERT_EQ(CoarseClock::Now(), 1000);
+
+  // Values expire against the fixed time
+  StringsValue strings_value("VALUE");
+  strings_value.SetRelativeTimestamp(10);
+  std::string encoded = strings_value.Encode().ToString();
+  ParsedStringsValue parsed_strings_value(&encoded);
+  ASSERT_EQ(parsed_strings_value.timestamp(), 1010);
+  ASSERT_FALSE(parsed_strings_value.IsStale());
+  CoarseClock::SetNow(1011);
+  ASSERT_TRUE(parsed_strings_value.IsStale());
+
+  CoarseClock::SetNow(0);
+  ASSERT_LE(std::abs(CoarseClock::Now() - EnvNow()), 1);
+  CoarseClock::Stop();
+
+  CoarseClock::SetNow(1000);
+  ASSERT_EQ(CoarseClock::Now(), 1000);
+  CoarseClock::SetNow(0);
+  ASSERT_LE(std::abs(CoarseClock::Now() - EnvNow()), 1);
+}
+
+int main(int argc, char** argv) {
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
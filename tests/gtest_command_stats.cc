@@ -0,0 +1,150 @@
+//  Copyright (c) 2017-present, Qihoo, Inc.  All rights reserved.
+//  This source code is licensed under the BSD-style license found in the
+//  LICENSE file in the root directory of this source tree. An additional grant
+//  of patent rights can be found in the PATENTS file in the same directory.
+
+#include <gtest/gtest.h>
+#include <thread>
+#include <vector>
+
+#include "src/command_stats.h"
+
+using namespace blackwidow;
+
+static bool FindCommandStats(const std::string& command,
+                             CommandStats* command_stats) {
+  std::vector<CommandStats> stats;
+  GetCommandStats(&stats);
+  for (const auto& item : stats) {
+    if (item.command == command) {
+      *command_stats = item;
+      return true;
+    }
+  }
+  return false;
+}
+
+// Buckets
+TEST(CommandStatsTest, BucketTest) {
+  for (uint64_t micros = 0; micros < 16; ++micros) {
+    ASSERT_EQ(LatencyHistogram::BucketIndex(micros), micros);
+    ASSERT_EQ(LatencyHistogram::BucketLimit(micros), micros);
+  }
+  size_t prev_index = LatencyHistogram::BucketIndex(15);
+  for (uint64_t micros = 16; micros < (1ULL << 20); micros += 7) {
+    size_t index = LatencyHistogram::BucketIndex(micros);
+    ASSERT_GE(index, prev_index);
+    ASSERT_LT(index, LatencyHistogram::kNumBuckets);
+    ASSERT_GE(LatencyHistogram::BucketLimit(index), micros);
+    // Relative error of a bucket is bounded by 1/8
+    ASSERT_LE(LatencyHistogram::BucketLimit(index) - micros, micros / 8);
+    prev_index = index;
+  }
+  ASSERT_EQ(LatencyHistogram::BucketIndex(UINT64_MAX),
+            LatencyHistogram::kNumBuckets - 1);
+}
+
+// Percentiles
+TEST(CommandStatsTest, PercentileTest) {
+  LatencyHistogram histogram;
+  for (uint64_t idx = 1; idx <= 1000; ++idx) {
+    histogram.Add(idx);
+  }
+  LatencyStats stats;
+  histogram.Report(&stats);
+  ASSERT_EQ(stats.count, 1000);
+  ASSERT_EQ(stats.total_micros, 500500);
+  ASSERT_EQ(stats.max_micros, 1000);
+  ASSERT_GE(stats.p50_micros, 500);
+  ASSERT_LE(stats.p50_micros, 500 + 500 / 8);
+  ASSERT_GE(stats.p99_micros, 990);
+  ASSERT_LE(stats.p999_micros, 1000);
+
+  LatencyHistogram merged;
+  merged.Add(5000);
+  merged.Merge(histogram);
+  merged.Report(&stats);
+  ASSERT_EQ(stats.count, 1001);
+  ASSERT_EQ(stats.max_micros, 5000);
+
+  merged.Clear();
+  merged.Report(&stats);
+  ASSERT_EQ(stats.count, 0);
+  ASSERT_EQ(stats.p99_micros, 0);
+}
+
+// Scope
+TEST(CommandStatsTest, ScopeTest) {
+  ResetCommandStats();
+  EnableCommandStats(false);
+  {
+    CommandStatsScope scope(kCmdHGet);
+  }
+  CommandStats command_stats;
+  ASSERT_FALSE(FindCommandStats("hget", &command_stats));
+
+  EnableCommandStats(true);
+  for (int idx = 0; idx < 10; ++idx) {
+    CommandStatsScope scope(kCmdHSet);
+    {
+      CommandPhaseTimer timer(kPhaseLockWait);
+    }
+    {
+      CommandPhaseTimer timer(kPhaseWrite);
+    }
+    // Commands called by a command are part of it
+    CommandStatsScope nested_scope(kCmdHGet);
+  }
+  {
+    CommandPhaseTimer timer(kPhaseMetaRead);
+  }
+  ASSERT_FALSE(CommandStatsActive());
+
+  ASSERT_FALSE(FindCommandStats("hget", &command_stats));
+  ASSERT_TRUE(FindCommandStats("hset", &command_stats));
+  ASSERT_EQ(command_stats.calls, 10);
+  ASSERT_EQ(command_stats.latency[kPhaseTotal].count, 10);
+  ASSERT_EQ(command_stats.latency[kPhaseLockWait].count, 10);
+  ASSERT_EQ(command_stats.latency[kPhaseWrite].count, 10);
+  ASSERT_EQ(command_stats.latency[kPhaseMetaRead].count, 0);
+  ASSERT_EQ(command_stats.latency[kPhaseDataIO].count, 0);
+
+  ResetCommandStats();
+  ASSERT_FALSE(FindCommandStats("hset", &command_stats));
+  EnableCommandStats(false);
+}
+
+// Threads
+TEST(CommandStatsTest, ThreadTest) {
+  ResetCommandStats();
+  EnableCommandStats(true);
+  std::vector<std::thread> threads;
+  for (int idx = 0; idx < 4; ++idx) {
+    threads.push_back(std::thread([] {
+      for (int idx = 0; idx < 100; ++idx) {
+        CommandStatsScope scope(kCmdZAdd);
+      }
+    }));
+  }
+  for (auto& thread : threads) {
+    thread.join();
+  }
+  {
+    CommandStatsScope scope(kCmdZAdd);
+  }
+
+  // Counters of the exited threads are kept
+  CommandStats command_stats;
+  ASSERT_TRUE(FindCommandStats("zadd", &command_stats));
+  ASSERT_EQ(command_stats.calls, 401);
+  ASSERT_GT(command_stats.qps, 0);
+
+  ResetCommandStats();
+  ASSERT_FALSE(FindCommandStats("zadd", &command_stats));
+  EnableCommandStats(false);
+}
+
+int main(int argc, char** argv) {
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
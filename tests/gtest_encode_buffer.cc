@@ -0,0 +1,86 @@
+//  Copyright (c) 2017-present, Qihoo, Inc.  All rights reserved.
+//  This source code is licensed under the BSD-style license found in the
+//  LICENSE file in the root directory of this source tree. An additional grant
+//  of patent rights can be found in the PATENTS file in the same directory.
+
+#include <gtest/gtest.h>
+#include <string>
+
+#include "blackwidow/blackwidow.h"
+#include "src/strings_value_format.h"
+#include "src/base_data_key_format.h"
+#include "src/encode_buffer.h"
+
+using namespace blackwidow;
+
+// Short encodings stay in the inline space
+TEST(EncodeBufferTest, InlineTest) {
+  uint64_t allocations = ScratchBuffers::Allocations();
+  EncodeBuffer buffer;
+  char* inline_space = buffer.Reserve(10);
+  ASSERT_EQ(buffer.Reserve(200), inline_space);
+  ASSERT_EQ(ScratchBuffers::Allocations(), allocations);
+}
+
+// A released scratch buffer is reused by the next long encoding
+TEST(EncodeBufferTest, ReuseTest) {
+  {
+    EncodeBuffer buffer;
+    buffer.Reserve(300);
+  }
+  uint64_t allocations = ScratchBuffers::Allocations();
+  for (int idx = 0; idx < 100; ++idx) {
+    EncodeBuffer buffer;
+    memset(buffer.Reserve(300), 'a', 300);
+  }
+  ASSERT_EQ(ScratchBuffers::Allocations(), allocations);
+
+  // Too large to be kept
+  {
+    EncodeBuffer buffer;
+    buffer.Reserve(ScratchBuffers::kMaxCachedSize + 1);
+  }
+  {
+    EncodeBuffer buffer;
+    buffer.Reserve(ScratchBuffers::kMaxCachedSize + 1);
+  }
+  ASSERT_EQ(ScratchBuffers::Allocations(), allocations + 2);
+}
+
+// A long data key is encoded once into a scratch buffer
+TEST(EncodeBufferTest, DataKeyTest) {
+  std::string key(256, 'k');
+  std::string field(64, 'f');
+  HashesDataKey data_key(key, 10, field);
+  Slice encoded = data_key.Encode();
+  ASSERT_EQ(encoded.size(), key.size() + field.size() + sizeof(int32_t) * 2);
+  Slice again = data_key.Encode();
+  ASSERT_EQ(again.data(), encoded.data());
+
+  ParsedHashesDataKey parsed_data_key(encoded);
+  ASSERT_EQ(parsed_data_key.key(), key);
+  ASSERT_EQ(parsed_data_key.version(), 10);
+  ASSERT_EQ(parsed_data_key.field(), field);
+}
+
+// Values are encoded again after their timestamp changes
+TEST(EncodeBufferTest, ValueTest) {
+  std::string value(1024, 'v');
+  StringsValue strings_value(value);
+  strings_value.set_timestamp(1);
+  std::string encoded = strings_value.Encode().ToString();
+  strings_value.set_timestamp(2);
+  std::string encoded_again = strings_value.Encode().ToString();
+
+  ParsedStringsValue parsed_strings_value(&encoded);
+  ASSERT_EQ(parsed_strings_value.value(), value);
+  ASSERT_EQ(parsed_strings_value.timestamp(), 1);
+  ParsedStringsValue parsed_strings_value_again(&encoded_again);
+  ASSERT_EQ(parsed_strings_value_again.value(), value);
+  ASSERT_EQ(parsed_strings_value_again.timestamp(), 2);
+}
+
+int main(int argc, char** argv) {
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
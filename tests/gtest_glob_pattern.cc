@@ -0,0 +1,89 @@
+//  Copyright (c) 2017-present, Qihoo, Inc.  All rights reserved.
+//  This source code is licensed under the BSD-style license found in the
+//  LICENSE file in the root directory of this source tree. An additional grant
+//  of patent rights can be found in the PATENTS file in the same directory.
+
+#include <gtest/gtest.h>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "src/glob_pattern.h"
+#include "blackwidow/util.h"
+
+using namespace blackwidow;
+
+static bool SameAsStringMatch(const std::string& pattern,
+                              const std::string& str) {
+  GlobPattern glob(pattern);
+  bool expect = StringMatch(pattern.data(), pattern.size(),
+                            str.data(), str.size(), 0);
+  return glob.Match(str) == expect;
+}
+
+// Prefix
+TEST(GlobPatternTest, PrefixTest) {
+  ASSERT_EQ(GlobPattern("user:*:session").prefix(), "user:");
+  ASSERT_EQ(GlobPattern("order:2024*:items").prefix(), "order:2024");
+  ASSERT_EQ(GlobPattern("key?").prefix(), "key");
+  ASSERT_EQ(GlobPattern("key[ab]*").prefix(), "key");
+  ASSERT_EQ(GlobPattern("a\\*b*").prefix(), "a*b");
+  ASSERT_EQ(GlobPattern("exact").prefix(), "exact");
+  ASSERT_EQ(GlobPattern("*").prefix(), "");
+
+  ASSERT_EQ(GlobPattern("user:*").upper_bound(), "user;");
+  ASSERT_EQ(GlobPattern("a\xff*").upper_bound(), "b");
+  ASSERT_EQ(GlobPattern("\xff*").upper_bound(), "");
+  ASSERT_EQ(GlobPattern("*").upper_bound(), "");
+
+  GlobPattern glob("user:*");
+  ASSERT_FALSE(glob.PastPrefix("a"));
+  ASSERT_FALSE(glob.PastPrefix("user:1"));
+  ASSERT_TRUE(glob.PastPrefix("user;"));
+  ASSERT_TRUE(glob.PastPrefix("v"));
+}
+
+// Match
+TEST(GlobPatternTest, MatchTest) {
+  ASSERT_TRUE(GlobPattern("user:*:session").Match("user:1:session"));
+  ASSERT_TRUE(GlobPattern("user:*:session").Match("user::session"));
+  ASSERT_FALSE(GlobPattern("user:*:session").Match("user:session"));
+  ASSERT_FALSE(GlobPattern("user:*:session").Match("user:1:sessions"));
+  ASSERT_TRUE(GlobPattern("*a*b*").Match("xxaxxbxx"));
+  ASSERT_FALSE(GlobPattern("*a*b*").Match("xxbxxaxx"));
+  ASSERT_TRUE(GlobPattern("a*a").Match("aa"));
+  ASSERT_FALSE(GlobPattern("a*a").Match("a"));
+  ASSERT_TRUE(GlobPattern("").Match(""));
+  ASSERT_FALSE(GlobPattern("").Match("a"));
+  ASSERT_TRUE(GlobPattern("a\\*").Match("a*"));
+  ASSERT_FALSE(GlobPattern("a\\*").Match("ab"));
+}
+
+// Same results as StringMatch
+TEST(GlobPatternTest, StringMatchTest) {
+  std::vector<std::string> patterns {
+    "", "*", "**", "a", "ab", "a*", "*a", "*a*", "a*b", "a**b", "*ab*ba*",
+    "a*b*a", "ab*ba", "?", "a?", "?*b", "[ab]*", "[^a]b", "[a-b]*a",
+    "a\\*", "\\", "a\\", "*\\?", "b*a*b*a"
+  };
+  std::mt19937 gen(17);
+  std::uniform_int_distribution<int> len_dist(0, 6);
+  std::uniform_int_distribution<int> char_dist(0, 2);
+  const char alphabet[] = {'a', 'b', '*'};
+  for (int round = 0; round < 2000; ++round) {
+    std::string str;
+    int len = len_dist(gen);
+    for (int idx = 0; idx < len; ++idx) {
+      str.push_back(alphabet[char_dist(gen)]);
+    }
+    for (const auto& pattern : patterns) {
+      ASSERT_TRUE(SameAsStringMatch(pattern, str))
+        << "pattern: " << pattern << " string: " << str;
+    }
+  }
+}
+
+int main(int argc, char** argv) {
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
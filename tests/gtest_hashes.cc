@@ -8,6 +8,7 @@
 #include <iostream>
 
 #include "blackwidow/blackwidow.h"
+#include "blackwidow/reply_sink.h"
 
 using namespace blackwidow;
 
@@ -1435,6 +1436,48 @@ TEST_F(HashesTest, HScanTest) {
 }
 
 // HScanx
+// HScan with stateless cursor
+TEST_F(HashesTest, HScanStatelessCursorTest) {
+  std::string cursor, next_cursor;
+  std::vector<FieldValue> field_value_out;
+
+  // {a,v} {b,v} {c,v} {d,v} {e,v} {f,v} {g,v} {h,v}
+  std::vector<FieldValue> gp1_field_value {{"a", "v"}, {"b", "v"}, {"c", "v"},
+                                           {"d", "v"}, {"e", "v"}, {"f", "v"},
+                                           {"g", "v"}, {"h", "v"}};
+  s = db.HMSet("GP1_HSCAN_CURSOR_KEY", gp1_field_value);
+  ASSERT_TRUE(s.ok());
+
+  s = db.HScan("GP1_HSCAN_CURSOR_KEY", "", "*", 3, &field_value_out, &next_cursor);
+  ASSERT_TRUE(s.ok());
+  ASSERT_FALSE(next_cursor.empty());
+  ASSERT_TRUE(field_value_match(field_value_out, {{"a", "v"}, {"b", "v"}, {"c", "v"}}));
+
+  // The same cursor can be used again
+  cursor = next_cursor;
+  s = db.HScan("GP1_HSCAN_CURSOR_KEY", cursor, "*", 3, &field_value_out, &next_cursor);
+  ASSERT_TRUE(s.ok());
+  ASSERT_TRUE(field_value_match(field_value_out, {{"d", "v"}, {"e", "v"}, {"f", "v"}}));
+  s = db.HScan("GP1_HSCAN_CURSOR_KEY", cursor, "*", 3, &field_value_out, &next_cursor);
+  ASSERT_TRUE(s.ok());
+  ASSERT_TRUE(field_value_match(field_value_out, {{"d", "v"}, {"e", "v"}, {"f", "v"}}));
+
+  cursor = next_cursor;
+  s = db.HScan("GP1_HSCAN_CURSOR_KEY", cursor, "*", 3, &field_value_out, &next_cursor);
+  ASSERT_TRUE(s.ok());
+  ASSERT_TRUE(next_cursor.empty());
+  ASSERT_TRUE(field_value_match(field_value_out, {{"g", "v"}, {"h", "v"}}));
+
+  // A cursor of another data type
+  s = db.HScan("GP1_HSCAN_CURSOR_KEY", "zd", "*", 3, &field_value_out, &next_cursor);
+  ASSERT_TRUE(s.IsInvalidArgument());
+
+  // Not exist key
+  s = db.HScan("GP2_HSCAN_CURSOR_KEY", "", "*", 3, &field_value_out, &next_cursor);
+  ASSERT_TRUE(s.IsNotFound());
+  ASSERT_TRUE(next_cursor.empty());
+}
+
 TEST_F(HashesTest, HScanxTest) {
   std::string start_field;
   std::string next_field;
@@ -2583,6 +2626,196 @@ TEST_F(HashesTest, PKHRScanRangeTest) {
   ASSERT_EQ(next_field, "i");
 }
 
+// HIncrby with write combining
+TEST_F(HashesTest, HIncrbyCombiningTest) {
+  db.EnableWriteCombining(true);
+  std::vector<std::thread> threads;
+  for (int thread_idx = 0; thread_idx < 8; ++thread_idx) {
+    threads.push_back(std::thread([this, thread_idx]() {
+      int64_t ret;
+      for (int idx = 0; idx < 1000; ++idx) {
+        ASSERT_TRUE(db.HIncrby("HINCRBY_COMBINING_KEY",
+                               thread_idx % 2 ? "ODD" : "EVEN", 1, &ret).ok());
+      }
+    }));
+  }
+  for (auto& thread : threads) {
+    thread.join();
+  }
+  db.EnableWriteCombining(false);
+
+  std::string value;
+  s = db.HGet("HINCRBY_COMBINING_KEY", "ODD", &value);
+  ASSERT_TRUE(s.ok());
+  ASSERT_EQ(value, "4000");
+  s = db.HGet("HINCRBY_COMBINING_KEY", "EVEN", &value);
+  ASSERT_TRUE(s.ok());
+  ASSERT_EQ(value, "4000");
+  int32_t len;
+  s = db.HLen("HINCRBY_COMBINING_KEY", &len);
+  ASSERT_TRUE(s.ok());
+  ASSERT_EQ(len, 2);
+}
+
+// HGetall and HScan with pooled iterators
+// HGet into a pinned value
+TEST_F(HashesTest, PinnableHGetTest) {
+  int32_t ret;
+  s = db.HSet("PINNABLE_HGET_KEY", "FIELD", "VALUE", &ret);
+  ASSERT_TRUE(s.ok());
+
+  blackwidow::PinnableSlice value;
+  s = db.HGet("PINNABLE_HGET_KEY", "FIELD", &value);
+  ASSERT_TRUE(s.ok());
+  ASSERT_EQ(value.ToString(), "VALUE");
+  s = db.HGet("PINNABLE_HGET_KEY", "NOT_EXIST_FIELD", &value);
+  ASSERT_TRUE(s.IsNotFound());
+  s = db.HGet("PINNABLE_HGET_NOT_EXIST_KEY", "FIELD", &value);
+  ASSERT_TRUE(s.IsNotFound());
+}
+
+// HGetall and HKeys visitor
+TEST_F(HashesTest, HGetallVisitorTest) {
+  std::vector<FieldValue> fvs;
+  s = db.HMSet("HGETALL_VISITOR_KEY",
+               {{"F1", "V1"}, {"F2", "V2"}, {"F3", "V3"}});
+  ASSERT_TRUE(s.ok());
+
+  s = db.HGetall("HGETALL_VISITOR_KEY",
+    [&fvs](const Slice& field, const Slice& value) {
+      fvs.push_back({field.ToString(), value.ToString()});
+      return true;
+    });
+  ASSERT_TRUE(s.ok());
+  ASSERT_TRUE(field_value_match(fvs, {{"F1", "V1"}, {"F2", "V2"},
+                                      {"F3", "V3"}}));
+
+  // The read stops once the visitor returns false
+  std::vector<std::string> fields;
+  s = db.HKeys("HGETALL_VISITOR_KEY", [&fields](const Slice& field) {
+      fields.push_back(field.ToString());
+      return fields.size() < 2;
+    });
+  ASSERT_TRUE(s.ok());
+  ASSERT_EQ(fields.size(), 2);
+  ASSERT_EQ(fields[0], "F1");
+  ASSERT_EQ(fields[1], "F2");
+
+  s = db.HGetall("HGETALL_VISITOR_NOT_EXIST_KEY",
+    [](const Slice& field, const Slice& value) { return true; });
+  ASSERT_TRUE(s.IsNotFound());
+}
+
+// HGetall and HKeys into a reply sink
+TEST_F(HashesTest, HGetallReplySinkTest) {
+  s = db.HMSet("HGETALL_SINK_KEY", {{"F1", "V1"}, {"F2", "V2"}});
+  ASSERT_TRUE(s.ok());
+
+  std::string buf;
+  blackwidow::RespReplySink sink(&buf, blackwidow::kResp2);
+  s = db.HGetall("HGETALL_SINK_KEY", &sink);
+  ASSERT_TRUE(s.ok());
+  ASSERT_EQ(buf, "*4\r\n$2\r\nF1\r\n$2\r\nV1\r\n"
+                 "$2\r\nF2\r\n$2\r\nV2\r\n");
+
+  buf.clear();
+  s = db.HKeys("HGETALL_SINK_KEY", &sink);
+  ASSERT_TRUE(s.ok());
+  ASSERT_EQ(buf, "*2\r\n$2\r\nF1\r\n$2\r\nF2\r\n");
+
+  // A missing key is an empty reply
+  buf.clear();
+  s = db.HGetall("HGETALL_SINK_NOT_EXIST_KEY", &sink);
+  ASSERT_TRUE(s.IsNotFound());
+  ASSERT_EQ(buf, "*0\r\n");
+}
+
+TEST(HashesIteratorPoolTest, HGetallTest) {
+  std::string path = "./db/hashes_iterator_pool";
+  if (access(path.c_str(), F_OK)) {
+    mkdir(path.c_str(), 0755);
+  }
+  BlackwidowOptions bw_options;
+  bw_options.options.create_if_missing = true;
+  bw_options.iterator_pool_size = 8;
+  blackwidow::BlackWidow db;
+  Status s = db.Open(bw_options, path);
+  ASSERT_TRUE(s.ok());
+
+  int32_t ret;
+  std::vector<FieldValue> fvs;
+  s = db.HMSet("POOL_KEY", {{"F1", "V1"}, {"F2", "V2"}});
+  ASSERT_TRUE(s.ok());
+  s = db.HGetall("POOL_KEY", &fvs);
+  ASSERT_TRUE(s.ok());
+  ASSERT_EQ(fvs.size(), 2);
+
+  // A reused iterator sees the writes done since its last read
+  for (int idx = 3; idx <= 10; ++idx) {
+    s = db.HSet("POOL_KEY", "F" + std::to_string(idx),
+                "V" + std::to_string(idx), &ret);
+    ASSERT_TRUE(s.ok());
+    fvs.clear();
+    s = db.HGetall("POOL_KEY", &fvs);
+    ASSERT_TRUE(s.ok());
+    ASSERT_EQ(fvs.size(), idx);
+  }
+
+  // The upper bound of a reused iterator is the one of its last checkout
+  s = db.HMSet("POOL_KEY_NEXT", {{"F1", "V1"}});
+  ASSERT_TRUE(s.ok());
+  fvs.clear();
+  s = db.HGetall("POOL_KEY", &fvs);
+  ASSERT_TRUE(s.ok());
+  ASSERT_EQ(fvs.size(), 10);
+  fvs.clear();
+  s = db.HGetall("POOL_KEY_NEXT", &fvs);
+  ASSERT_TRUE(s.ok());
+  ASSERT_EQ(fvs.size(), 1);
+
+  int64_t cursor;
+  fvs.clear();
+  s = db.HScan("POOL_KEY", 0, "F1*", 100, &fvs, &cursor);
+  ASSERT_TRUE(s.ok());
+  ASSERT_EQ(fvs.size(), 2);
+  ASSERT_EQ(cursor, 0);
+
+  std::map<DataType, Status> type_status;
+  ASSERT_EQ(db.Del({"POOL_KEY"}, &type_status), 1);
+  fvs.clear();
+  s = db.HGetall("POOL_KEY", &fvs);
+  ASSERT_TRUE(s.IsNotFound());
+}
+
+// CompactExpired drops the fields of the expired hashes with them
+TEST(HashesCompactExpiredTest, DataTest) {
+  std::string path = "./db/hashes_compact_expired";
+  if (access(path.c_str(), F_OK)) {
+    mkdir(path.c_str(), 0755);
+  }
+  BlackwidowOptions bw_options;
+  bw_options.options.create_if_missing = true;
+  bw_options.garbage_compaction_ratio = 0.5;
+  bw_options.expired_compaction_interval = 0;
+  blackwidow::BlackWidow db;
+  Status s = db.Open(bw_options, path);
+  ASSERT_TRUE(s.ok());
+
+  std::map<DataType, Status> type_status;
+  for (int idx = 0; idx < 200; ++idx) {
+    std::string key = "EXPIRED_KEY_" + std::to_string(idx);
+    ASSERT_TRUE(db.HMSet(key, {{"F1", "V1"}, {"F2", "V2"}}).ok());
+    ASSERT_EQ(db.Expire(key, 1, &type_status), 1);
+  }
+  ASSERT_TRUE(db.Compact(kHashes, true).ok());
+  std::this_thread::sleep_for(std::chrono::milliseconds(2000));
+
+  ASSERT_TRUE(db.CompactExpired(kHashes, true).ok());
+  ASSERT_EQ(db.GetProperty(HASHES_DB, "rocksdb.estimate-num-keys"), 0);
+  ASSERT_GT(db.GetProperty(HASHES_DB,
+                           PROPERTY_TYPE_BLACKWIDOW_EXPIRED_RECLAIMED), 0);
+}
+
 int main(int argc, char** argv) {
   ::testing::InitGoogleTest(&argc, argv);
   return RUN_ALL_TESTS();
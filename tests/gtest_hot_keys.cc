@@ -0,0 +1,90 @@
+//  Copyright (c) 2017-present, Qihoo, Inc.  All rights reserved.
+//  This source code is licensed under the BSD-style license found in the
+//  LICENSE file in the root directory of this source tree. An additional grant
+//  of patent rights can be found in the PATENTS file in the same directory.
+
+#include <gtest/gtest.h>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "src/hot_keys.h"
+
+using namespace blackwidow;
+
+// Disabled
+TEST(HotKeysTest, DisabledTest) {
+  HotKeys hot_keys;
+  hot_keys.RecordRead(kStrings, "KEY");
+  std::vector<HotKey> keys;
+  ASSERT_TRUE(hot_keys.GetHotKeys(kStrings, 10, &keys).ok());
+  ASSERT_TRUE(keys.empty());
+  ASSERT_TRUE(hot_keys.GetHotKeys(kAll, 10, &keys).IsInvalidArgument());
+}
+
+// Reads and writes
+TEST(HotKeysTest, ReadWriteTest) {
+  HotKeys hot_keys;
+  hot_keys.SetSampleRate(1);
+  for (int idx = 0; idx < 1000; ++idx) {
+    hot_keys.RecordRead(kHashes, "HOT_KEY");
+    hot_keys.RecordWrite(kHashes, "WARM_KEY");
+    hot_keys.RecordRead(kHashes, "COLD_KEY" + std::to_string(idx));
+  }
+  for (int idx = 0; idx < 100; ++idx) {
+    hot_keys.RecordWrite(kHashes, "HOT_KEY");
+  }
+
+  std::vector<HotKey> keys;
+  ASSERT_TRUE(hot_keys.GetHotKeys(kHashes, 2, &keys).ok());
+  ASSERT_EQ(keys.size(), 2);
+  ASSERT_EQ(keys[0].key, "HOT_KEY");
+  ASSERT_EQ(keys[0].reads, 1000);
+  ASSERT_EQ(keys[0].writes, 100);
+  ASSERT_EQ(keys[1].key, "WARM_KEY");
+  ASSERT_EQ(keys[1].reads, 0);
+  ASSERT_EQ(keys[1].writes, 1000);
+
+  // Every type is counted apart
+  ASSERT_TRUE(hot_keys.GetHotKeys(kSets, 2, &keys).ok());
+  ASSERT_TRUE(keys.empty());
+
+  hot_keys.Reset();
+  ASSERT_TRUE(hot_keys.GetHotKeys(kHashes, 2, &keys).ok());
+  ASSERT_TRUE(keys.empty());
+}
+
+// Sampled accesses of several threads
+TEST(HotKeysTest, SampleTest) {
+  HotKeys hot_keys;
+  hot_keys.SetSampleRate(10);
+  std::vector<std::thread> threads;
+  for (int thread_idx = 0; thread_idx < 4; ++thread_idx) {
+    threads.push_back(std::thread([&hot_keys, thread_idx]() {
+      for (int idx = 0; idx < 100000; ++idx) {
+        if (idx % 4 == 0) {
+          hot_keys.RecordRead(kZSets, "HOT_KEY");
+        } else {
+          hot_keys.RecordRead(kZSets, "KEY" + std::to_string(thread_idx)
+                              + "_" + std::to_string(idx));
+        }
+      }
+    }));
+  }
+  for (auto& thread : threads) {
+    thread.join();
+  }
+
+  std::vector<HotKey> keys;
+  ASSERT_TRUE(hot_keys.GetHotKeys(kZSets, 1, &keys).ok());
+  ASSERT_EQ(keys.size(), 1);
+  ASSERT_EQ(keys[0].key, "HOT_KEY");
+  // 100000 reads, the sketch never under estimates
+  ASSERT_GT(keys[0].reads, 80000);
+  ASSERT_LT(keys[0].reads, 150000);
+}
+
+int main(int argc, char** argv) {
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
@@ -0,0 +1,51 @@
+//  Copyright (c) 2017-present, Qihoo, Inc.  All rights reserved.
+//  This source code is licensed under the BSD-style license found in the
+//  LICENSE file in the root directory of this source tree. An additional grant
+//  of patent rights can be found in the PATENTS file in the same directory.
+
+#include <gtest/gtest.h>
+#include <string>
+
+#include "rocksdb/db.h"
+
+#include "src/command_stats.h"
+#include "src/instrumented_db.h"
+#include "src/iterator_pool.h"
+
+using namespace blackwidow;
+
+// The iterators built within a command are wrapped for the command
+// stats, a checkout refreshes them instead of building new ones
+TEST(IteratorPoolTest, CommandStatsTest) {
+  std::string path = "./db/iterator_pool";
+  if (access(path.c_str(), F_OK)) {
+    mkdir(path.c_str(), 0755);
+  }
+  rocksdb::Options options;
+  options.create_if_missing = true;
+  rocksdb::DB* db;
+  ASSERT_TRUE(rocksdb::DB::Open(options, path, &db).ok());
+  db = new InstrumentedDB(db, false);
+  ASSERT_TRUE(db->Put(rocksdb::WriteOptions(), "KEY", "VALUE").ok());
+
+  EnableCommandStats(true);
+  {
+    IteratorPool pool(db, db->DefaultColumnFamily(), 8);
+    for (int idx = 0; idx < 100; ++idx) {
+      CommandStatsScope scope(kCmdHGetall);
+      ScopeIterator iter(&pool, db, db->DefaultColumnFamily(),
+                         rocksdb::ReadOptions(), "KEZ");
+      iter->Seek("KEY");
+      ASSERT_TRUE(iter->Valid());
+      ASSERT_EQ(iter->value(), "VALUE");
+    }
+    ASSERT_EQ(pool.Created(), 1);
+  }
+  EnableCommandStats(false);
+  delete db;
+}
+
+int main(int argc, char** argv) {
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
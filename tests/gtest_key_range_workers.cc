@@ -0,0 +1,74 @@
+//  Copyright (c) 2017-present, Qihoo, Inc.  All rights reserved.
+//  This source code is licensed under the BSD-style license found in the
+//  LICENSE file in the root directory of this source tree. An additional grant
+//  of patent rights can be found in the PATENTS file in the same directory.
+
+#include <gtest/gtest.h>
+#include <atomic>
+#include <set>
+#include <thread>
+#include <vector>
+
+#include "src/key_range_workers.h"
+
+using namespace blackwidow;
+
+// Every task runs once, on the workers and on the calling thread
+TEST(KeyRangeWorkersTest, RunTest) {
+  KeyRangeWorkers workers;
+  workers.Start(3);
+  std::vector<std::atomic<int>> runs(100);
+  for (auto& run : runs) {
+    run = 0;
+  }
+  Status s = workers.Run(runs.size(), [&runs](size_t idx) {
+    runs[idx]++;
+    return Status::OK();
+  });
+  ASSERT_TRUE(s.ok());
+  for (auto& run : runs) {
+    ASSERT_EQ(run, 1);
+  }
+  ASSERT_TRUE(workers.Run(0, [](size_t idx) {
+    return Status::Corruption("never run");
+  }).ok());
+}
+
+// The first error is returned and the tasks not started are skipped
+TEST(KeyRangeWorkersTest, ErrorTest) {
+  KeyRangeWorkers workers;
+  std::atomic<int> runs(0);
+  Status s = workers.Run(100, [&runs](size_t idx) {
+    runs++;
+    return idx == 10 ? Status::IOError("range 10") : Status::OK();
+  });
+  ASSERT_TRUE(s.IsIOError());
+  ASSERT_EQ(runs, 11);
+}
+
+// Concurrent runs share the pool, which starts no thread per run
+TEST(KeyRangeWorkersTest, ConcurrentRunTest) {
+  KeyRangeWorkers workers;
+  workers.Start(2);
+  std::vector<std::thread> callers;
+  std::atomic<int> total(0);
+  for (int caller = 0; caller < 4; ++caller) {
+    callers.push_back(std::thread([&workers, &total]() {
+      for (int round = 0; round < 100; ++round) {
+        workers.Run(10, [&total](size_t idx) {
+          total++;
+          return Status::OK();
+        });
+      }
+    }));
+  }
+  for (auto& caller : callers) {
+    caller.join();
+  }
+  ASSERT_EQ(total, 4 * 100 * 10);
+}
+
+int main(int argc, char** argv) {
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
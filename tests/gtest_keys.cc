@@ -6,6 +6,8 @@
 #include <gtest/gtest.h>
 #include <thread>
 #include <iostream>
+#include <fstream>
+#include <sstream>
 
 #include "blackwidow/blackwidow.h"
 
@@ -4938,6 +4940,200 @@ TEST_F(KeysTest, ScanCaseSingleTest) {
   db.Compact(DataType::kAll, true);
 }
 
+// Scan with stateless cursor
+TEST_F(KeysTest, ScanStatelessCursorTest) {
+  int32_t int32_ret;
+  std::string cursor, next_cursor;
+  std::vector<std::string> keys;
+  std::vector<std::string> total_keys;
+  std::vector<std::string> delete_keys;
+  std::map<blackwidow::DataType, Status> type_status;
+
+  s = db.Set("SCAN_CURSOR_KEY1", "VALUE");
+  s = db.Set("SCAN_CURSOR_KEY2", "VALUE");
+  s = db.HSet("SCAN_CURSOR_KEY3", "FIELD", "VALUE", &int32_ret);
+  s = db.SAdd("SCAN_CURSOR_KEY4", {"MEMBER"}, &int32_ret);
+  s = db.ZAdd("SCAN_CURSOR_KEY5", {{1, "MEMBER"}}, &int32_ret);
+  s = db.Set("OTHER_SCAN_CURSOR_KEY", "VALUE");
+  delete_keys = {"SCAN_CURSOR_KEY1", "SCAN_CURSOR_KEY2", "SCAN_CURSOR_KEY3",
+                 "SCAN_CURSOR_KEY4", "SCAN_CURSOR_KEY5", "OTHER_SCAN_CURSOR_KEY"};
+
+  // The cursor moves across the databases
+  do {
+    s = db.Scan(DataType::kAll, cursor, "SCAN_CURSOR_*", 2, &keys, &next_cursor);
+    ASSERT_TRUE(s.ok());
+    total_keys.insert(total_keys.end(), keys.begin(), keys.end());
+    cursor = next_cursor;
+  } while (!cursor.empty());
+  ASSERT_TRUE(key_match(total_keys, {"SCAN_CURSOR_KEY1", "SCAN_CURSOR_KEY2",
+                                     "SCAN_CURSOR_KEY3", "SCAN_CURSOR_KEY4",
+                                     "SCAN_CURSOR_KEY5"}));
+
+  // Single data type
+  s = db.Scan(DataType::kStrings, "", "SCAN_CURSOR_KEY*", 1, &keys, &next_cursor);
+  ASSERT_TRUE(s.ok());
+  ASSERT_TRUE(key_match(keys, {"SCAN_CURSOR_KEY1"}));
+  cursor = next_cursor;
+  s = db.Scan(DataType::kStrings, cursor, "SCAN_CURSOR_KEY*", 1, &keys, &next_cursor);
+  ASSERT_TRUE(s.ok());
+  ASSERT_TRUE(key_match(keys, {"SCAN_CURSOR_KEY2"}));
+
+  // A cursor of the strings database can not scan the hashes database
+  s = db.Scan(DataType::kHashes, cursor, "*", 1, &keys, &next_cursor);
+  ASSERT_TRUE(s.IsInvalidArgument());
+
+  db.Del(delete_keys, &type_status);
+}
+
+// The key ranges of the SSTs are scanned by several threads
+TEST_F(KeysTest, ParallelKeyRangeScanTest) {
+  BlackwidowOptions parallel_options;
+  parallel_options.options.create_if_missing = true;
+  parallel_options.options.target_file_size_base = 4096;
+  parallel_options.keyspace_scan_threads = 4;
+  blackwidow::BlackWidow parallel_db;
+  std::string path = "./db/keys_parallel";
+  if (access(path.c_str(), F_OK)) {
+    mkdir(path.c_str(), 0755);
+  }
+  s = parallel_db.Open(parallel_options, path);
+  ASSERT_TRUE(s.ok());
+
+  std::vector<KeyValue> kvs;
+  std::vector<std::string> expect_keys;
+  for (int32_t idx = 0; idx < 2000; ++idx) {
+    char key[32];
+    snprintf(key, sizeof(key), "PARALLEL_KEY_%05d", idx);
+    kvs.push_back({key, std::string(100, 'v')});
+    expect_keys.push_back(key);
+  }
+  s = parallel_db.MSet(kvs);
+  ASSERT_TRUE(s.ok());
+  s = parallel_db.Compact(DataType::kStrings, true);
+  ASSERT_TRUE(s.ok());
+
+  // The keys come back in key order
+  std::vector<std::string> keys;
+  s = parallel_db.Keys(DataType::kStrings, "PARALLEL_KEY_*", &keys);
+  ASSERT_TRUE(s.ok());
+  ASSERT_EQ(keys, expect_keys);
+
+  std::vector<KeyInfo> key_infos;
+  s = parallel_db.GetKeyNum(&key_infos);
+  ASSERT_TRUE(s.ok());
+  ASSERT_EQ(key_infos.size(), 5);
+  ASSERT_EQ(key_infos[0].keys, 2000);
+  uint64_t scanned_ranges, total_ranges;
+  parallel_db.GetScanKeyNumProgress(&scanned_ranges, &total_ranges);
+  ASSERT_EQ(scanned_ranges, total_ranges);
+  ASSERT_GT(total_ranges, 5);
+
+  int32_t delete_count;
+  s = parallel_db.PKPatternMatchDel(DataType::kStrings, "PARALLEL_KEY_*",
+                                    &delete_count);
+  ASSERT_TRUE(s.ok());
+  ASSERT_EQ(delete_count, 2000);
+  s = parallel_db.Keys(DataType::kStrings, "*", &keys);
+  ASSERT_TRUE(s.ok());
+  ASSERT_TRUE(keys.empty());
+}
+
+// Key size histograms and largest keys
+TEST_F(KeysTest, AnalyzeKeyspaceTest) {
+  BlackwidowOptions analyze_options;
+  analyze_options.options.create_if_missing = true;
+  blackwidow::BlackWidow analyze_db;
+  std::string path = "./db/keys_analyze";
+  if (access(path.c_str(), F_OK)) {
+    mkdir(path.c_str(), 0755);
+  }
+  s = analyze_db.Open(analyze_options, path);
+  ASSERT_TRUE(s.ok());
+
+  int32_t int32_ret;
+  s = analyze_db.Set("ANALYZE_STRING_KEY1", "");
+  s = analyze_db.Set("ANALYZE_STRING_KEY2", std::string(1000, 'v'));
+  s = analyze_db.Set("ANALYZE_STRING_KEY3", std::string(10, 'v'));
+  std::vector<std::string> members;
+  for (int32_t idx = 0; idx < 100; ++idx) {
+    members.push_back("MEMBER" + std::to_string(idx));
+  }
+  s = analyze_db.SAdd("ANALYZE_SET_KEY1", members, &int32_ret);
+  s = analyze_db.SAdd("ANALYZE_SET_KEY2", {"MEMBER"}, &int32_ret);
+
+  KeyspaceAnalysisOptions options;
+  options.top_n = 2;
+  options.result_path = path + "/analysis";
+  s = analyze_db.AnalyzeKeyspace(options, true);
+  ASSERT_TRUE(s.ok());
+
+  KeyspaceAnalysis analysis;
+  s = analyze_db.GetKeyspaceAnalysis(&analysis);
+  ASSERT_TRUE(s.ok());
+  ASSERT_FALSE(analysis.running);
+  ASSERT_TRUE(analysis.completed);
+  ASSERT_EQ(analysis.scanned_keys, 5);
+  ASSERT_EQ(analysis.type_stats.size(), 5);
+
+  // Strings of 0, 10 and 1000 bytes
+  const KeySizeStats& strings_stats = analysis.type_stats[0];
+  ASSERT_EQ(strings_stats.keys, 3);
+  ASSERT_EQ(strings_stats.total_size, 1010);
+  ASSERT_EQ(strings_stats.histogram[0], 1);
+  ASSERT_EQ(strings_stats.histogram[4], 1);
+  ASSERT_EQ(strings_stats.histogram[10], 1);
+  ASSERT_EQ(strings_stats.largest_keys.size(), 2);
+  ASSERT_EQ(strings_stats.largest_keys[0].key, "ANALYZE_STRING_KEY2");
+  ASSERT_EQ(strings_stats.largest_keys[1].key, "ANALYZE_STRING_KEY3");
+
+  // Sets of 100 and 1 members
+  const KeySizeStats& sets_stats = analysis.type_stats[4];
+  ASSERT_EQ(sets_stats.keys, 2);
+  ASSERT_EQ(sets_stats.total_size, 101);
+  ASSERT_EQ(sets_stats.largest_keys[0].key, "ANALYZE_SET_KEY1");
+  ASSERT_EQ(sets_stats.largest_keys[0].size, 100);
+  ASSERT_EQ(analysis.type_stats[1].keys, 0);
+
+  ASSERT_EQ(access(options.result_path.c_str(), F_OK), 0);
+}
+
+// The largest keys are escaped in the report, and stopping with no
+// analysis running does not stop the next one
+TEST_F(KeysTest, AnalyzeKeyspaceBinaryKeyTest) {
+  BlackwidowOptions analyze_options;
+  analyze_options.options.create_if_missing = true;
+  blackwidow::BlackWidow analyze_db;
+  std::string path = "./db/keys_analyze_binary";
+  if (access(path.c_str(), F_OK)) {
+    mkdir(path.c_str(), 0755);
+  }
+  s = analyze_db.Open(analyze_options, path);
+  ASSERT_TRUE(s.ok());
+
+  std::string binary_key("BIN\nKEY\0\"\\", 10);
+  s = analyze_db.Set(binary_key, "VALUE");
+  ASSERT_TRUE(s.ok());
+
+  s = analyze_db.StopKeyspaceAnalysis();
+  ASSERT_TRUE(s.ok());
+  KeyspaceAnalysisOptions options;
+  options.result_path = path + "/analysis";
+  s = analyze_db.AnalyzeKeyspace(options, true);
+  ASSERT_TRUE(s.ok());
+
+  KeyspaceAnalysis analysis;
+  s = analyze_db.GetKeyspaceAnalysis(&analysis);
+  ASSERT_TRUE(s.ok());
+  ASSERT_TRUE(analysis.completed);
+  ASSERT_EQ(analysis.type_stats[0].largest_keys[0].key, binary_key);
+
+  std::ifstream report(options.result_path);
+  std::stringstream content;
+  content << report.rdbuf();
+  ASSERT_NE(content.str().find("largest 5 \"BIN\\nKEY\\x00\\\"\\\\\"\n"),
+            std::string::npos);
+}
+
 TEST_F(KeysTest, PKExpireScanCaseAllTest) {
 
   int64_t cursor;
@@ -7978,6 +8174,44 @@ TEST_F(KeysTest, TTLTest) {
   }
 }
 
+// Keys visitor
+TEST_F(KeysTest, KeysVisitorTest) {
+  int32_t ret;
+  s = db.Set("KEYS_VISITOR_KEY1", "VALUE");
+  ASSERT_TRUE(s.ok());
+  s = db.Set("KEYS_VISITOR_KEY2", "VALUE");
+  ASSERT_TRUE(s.ok());
+  s = db.SAdd("KEYS_VISITOR_KEY3", {"MEMBER"}, &ret);
+  ASSERT_TRUE(s.ok());
+
+  std::vector<std::string> keys;
+  s = db.Keys(DataType::kAll, "KEYS_VISITOR_KEY*",
+    [&keys](const Slice& key) {
+      keys.push_back(key.ToString());
+      return true;
+    });
+  ASSERT_TRUE(s.ok());
+  ASSERT_EQ(keys.size(), 3);
+  ASSERT_EQ(keys[0], "KEYS_VISITOR_KEY1");
+  ASSERT_EQ(keys[1], "KEYS_VISITOR_KEY2");
+  ASSERT_EQ(keys[2], "KEYS_VISITOR_KEY3");
+
+  // A stopped visitor stops the scan of the following dbs too
+  keys.clear();
+  s = db.Keys(DataType::kAll, "KEYS_VISITOR_KEY*",
+    [&keys](const Slice& key) {
+      keys.push_back(key.ToString());
+      return false;
+    });
+  ASSERT_TRUE(s.ok());
+  ASSERT_EQ(keys.size(), 1);
+  ASSERT_EQ(keys[0], "KEYS_VISITOR_KEY1");
+
+  std::map<DataType, Status> type_status;
+  db.Del({"KEYS_VISITOR_KEY1", "KEYS_VISITOR_KEY2", "KEYS_VISITOR_KEY3"},
+         &type_status);
+}
+
 int main(int argc, char** argv) {
   ::testing::InitGoogleTest(&argc, argv);
   return RUN_ALL_TESTS();
@@ -0,0 +1,162 @@
+//  Copyright (c) 2017-present, Qihoo, Inc.  All rights reserved.
+//  This source code is licensed under the BSD-style license found in the
+//  LICENSE file in the root directory of this source tree. An additional grant
+//  of patent rights can be found in the PATENTS file in the same directory.
+
+#include <gtest/gtest.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "src/lock_mgr.h"
+#include "src/mutex_impl.h"
+#include "src/scope_record_lock.h"
+
+using namespace blackwidow;
+
+// TryLock
+TEST(LockMgrTest, TryLockTest) {
+  LockMgr mgr(16);
+  ASSERT_TRUE(mgr.TryLock("KEY").ok());
+
+  // Waits for the holder
+  std::atomic<bool> unlocked(false);
+  std::thread holder([&mgr, &unlocked]() {
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    unlocked = true;
+    mgr.UnLock("KEY");
+  });
+  ASSERT_TRUE(mgr.TryLock("KEY").ok());
+  ASSERT_TRUE(unlocked);
+  holder.join();
+  mgr.UnLock("KEY");
+}
+
+// Lock
+TEST(LockMgrTest, LockTest) {
+  LockMgr mgr(16);
+  ASSERT_TRUE(mgr.Lock("KEY").ok());
+
+  Status s;
+  std::thread thread([&mgr, &s]() { s = mgr.Lock("KEY", 0); });
+  thread.join();
+  ASSERT_TRUE(s.IsBusy());
+  ASSERT_TRUE(LockMgr::IsLockFailure(s));
+  ASSERT_FALSE(LockMgr::IsLockFailure(Status::Busy()));
+  ASSERT_TRUE(mgr.TryLockFor("KEY", 0).IsBusy());
+
+  mgr.UnLock("KEY");
+  ASSERT_TRUE(mgr.Lock("KEY", 0).ok());
+  mgr.UnLock("KEY");
+}
+
+// TryLockFor
+TEST(LockMgrTest, TryLockForTest) {
+  LockMgr mgr(16);
+  ASSERT_TRUE(mgr.Lock("KEY").ok());
+
+  Status s;
+  uint64_t start_micros = LockMgr::NowMicros();
+  std::thread waiter([&mgr, &s]() { s = mgr.TryLockFor("KEY", 20000); });
+  waiter.join();
+  ASSERT_TRUE(s.IsTimedOut());
+  ASSERT_GE(LockMgr::NowMicros() - start_micros, 20000);
+
+  // Unlocked while waiting
+  std::thread holder([&mgr]() {
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    mgr.UnLock("KEY");
+  });
+  ASSERT_TRUE(mgr.TryLockFor("KEY", 10000000).ok());
+  holder.join();
+  mgr.UnLock("KEY");
+}
+
+// MultiLock
+TEST(LockMgrTest, MultiLockTest) {
+  // Two slots, some of the keys share one
+  LockMgr mgr(2);
+  std::vector<std::string> keys = {"a", "b", "c", "d", "a"};
+  std::vector<size_t> slots;
+  ASSERT_TRUE(mgr.MultiLock(keys, LockMgr::kNoDeadline, &slots).ok());
+  ASSERT_LE(slots.size(), 2);
+  ASSERT_TRUE(std::is_sorted(slots.begin(), slots.end()));
+
+  std::vector<size_t> other_slots;
+  std::thread thread([&mgr, &keys, &other_slots]() {
+    ASSERT_TRUE(mgr.MultiLock(keys, 0, &other_slots).IsBusy());
+  });
+  thread.join();
+  ASSERT_TRUE(other_slots.empty());
+
+  mgr.MultiUnLock(slots);
+  ASSERT_TRUE(mgr.MultiLock(keys, 0, &slots).ok());
+  mgr.MultiUnLock(slots);
+}
+
+// LockDeadline
+TEST(LockMgrTest, LockDeadlineTest) {
+  LockMgr mgr(1024);
+  ASSERT_NE(mgr.GetSlot("KEY"), mgr.GetSlot("OTHER_KEY"));
+  ASSERT_EQ(LockMgr::ThreadDeadline(), LockMgr::kNoDeadline);
+  ASSERT_TRUE(mgr.Lock("KEY").ok());
+
+  std::thread thread([&mgr]() {
+    {
+      LockDeadline deadline(0);
+      ScopeRecordLock l(&mgr, "KEY");
+      ASSERT_TRUE(l.status().IsBusy());
+      ScopeRecordLock other(&mgr, "OTHER_KEY");
+      ASSERT_TRUE(other.status().ok());
+    }
+    {
+      LockDeadline deadline(10000);
+      ScopeRecordLock l(&mgr, "KEY");
+      ASSERT_TRUE(l.status().IsTimedOut());
+      MultiScopeRecordLock ml(&mgr, {"OTHER_KEY", "KEY"});
+      ASSERT_TRUE(ml.status().IsTimedOut() || ml.status().IsBusy());
+    }
+    ASSERT_EQ(LockMgr::ThreadDeadline(), LockMgr::kNoDeadline);
+  });
+  thread.join();
+
+  // The failed locks left nothing locked
+  mgr.UnLock("KEY");
+  ASSERT_TRUE(mgr.TryLock("KEY").ok());
+  ASSERT_TRUE(mgr.TryLock("OTHER_KEY").ok());
+}
+
+// max_num_locks
+TEST(LockMgrTest, LockLimitTest) {
+  LockMgr mgr(1024, 2, std::make_shared<MutexFactoryImpl>());
+  std::vector<std::string> keys = {"KEY", "OTHER_KEY", "THIRD_KEY"};
+  std::vector<size_t> slots;
+  ASSERT_TRUE(mgr.MultiLock(keys, LockMgr::kNoDeadline, &slots).IsBusy());
+  ASSERT_TRUE(slots.empty());
+  ASSERT_TRUE(mgr.Lock("KEY").ok());
+
+  // The waiters are not counted
+  std::thread waiter([&mgr]() {
+    ASSERT_TRUE(mgr.Lock("KEY").ok());
+    mgr.UnLock("KEY");
+  });
+  std::this_thread::sleep_for(std::chrono::milliseconds(10));
+  ASSERT_TRUE(mgr.TryLockFor("OTHER_KEY", 0).ok());
+  Status s = mgr.TryLockFor("THIRD_KEY", 0);
+  ASSERT_TRUE(s.IsBusy());
+  ASSERT_EQ(s.subcode(), Status::SubCode::kLockLimit);
+
+  mgr.UnLock("KEY");
+  waiter.join();
+  mgr.UnLock("OTHER_KEY");
+  ASSERT_TRUE(mgr.TryLockFor("THIRD_KEY", 0).ok());
+  mgr.UnLock("THIRD_KEY");
+}
+
+int main(int argc, char** argv) {
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
@@ -0,0 +1,76 @@
+//  Copyright (c) 2017-present, Qihoo, Inc.  All rights reserved.
+//  This source code is licensed under the BSD-style license found in the
+//  LICENSE file in the root directory of this source tree. An additional grant
+//  of patent rights can be found in the PATENTS file in the same directory.
+
+#include <gtest/gtest.h>
+#include <thread>
+#include <vector>
+
+#include "src/lock_mgr.h"
+
+using namespace blackwidow;
+
+static void LockKey(LockMgr* mgr, const std::string& key, int times) {
+  for (int idx = 0; idx < times; ++idx) {
+    mgr->TryLock(key);
+    std::this_thread::sleep_for(std::chrono::microseconds(50));
+    mgr->UnLock(key);
+  }
+}
+
+// Disabled
+TEST(LockStatsTest, DisabledTest) {
+  LockMgr mgr(16);
+  mgr.TryLock("KEY");
+  mgr.UnLock("KEY");
+
+  LockStats stats;
+  mgr.GetStats(&stats);
+  ASSERT_EQ(stats.acquisitions, 0);
+  ASSERT_EQ(stats.waits, 0);
+  ASSERT_TRUE(stats.hot_stripes.empty());
+  ASSERT_TRUE(stats.hot_keys.empty());
+}
+
+// Contention
+TEST(LockStatsTest, ContentionTest) {
+  LockMgr mgr(16);
+  mgr.EnableStats(true);
+
+  std::vector<std::thread> threads;
+  for (int idx = 0; idx < 4; ++idx) {
+    threads.push_back(std::thread(LockKey, &mgr, "HOT_KEY", 100));
+  }
+  for (auto& thread : threads) {
+    thread.join();
+  }
+  LockKey(&mgr, "COLD_KEY", 10);
+
+  LockStats stats;
+  mgr.GetStats(&stats);
+  ASSERT_EQ(stats.acquisitions, 410);
+  ASSERT_GT(stats.waits, 0);
+  ASSERT_LE(stats.waits, 400);
+  ASSERT_GT(stats.total_wait_micros, 0);
+  ASSERT_GE(stats.total_wait_micros, stats.max_wait_micros);
+
+  // All the waits are on the slot of the hot key
+  ASSERT_EQ(stats.hot_stripes.size(), 1);
+  ASSERT_EQ(stats.hot_stripes[0].waits, stats.waits);
+  if (stats.waits >= 8) {
+    ASSERT_EQ(stats.hot_keys[0].key, "HOT_KEY");
+    ASSERT_GT(stats.hot_keys[0].waits, 0);
+  }
+
+  mgr.ResetStats();
+  mgr.GetStats(&stats);
+  ASSERT_EQ(stats.acquisitions, 0);
+  ASSERT_EQ(stats.waits, 0);
+  ASSERT_TRUE(stats.hot_keys.empty());
+}
+
+int main(int argc, char** argv) {
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
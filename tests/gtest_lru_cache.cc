@@ -4,9 +4,11 @@
 //  of patent rights can be found in the PATENTS file in the same directory.
 
 #include <gtest/gtest.h>
+#include <thread>
 
 #include "blackwidow/blackwidow.h"
 #include "src/lru_cache.h"
+#include "src/sharded_lru_cache.h"
 
 using namespace blackwidow;
 
@@ -489,6 +491,118 @@ TEST(LRUCacheTest, TestRemoveCase1) {
   ASSERT_TRUE(lru_cache.LRUAsExpected({}));
 }
 
+TEST(ShardedLRUCacheTest, TestLRUCase1) {
+  Status s;
+  std::string value;
+  // Single shard behaves as LRUCache
+  blackwidow::ShardedLRUCache<std::string, std::string> lru_cache(0);
+  lru_cache.SetCapacity(3);
+
+  // ***************** Step 1 *****************
+  // (k3, v3) -> (k2, v2) -> (k1, v1)
+  lru_cache.Insert("k1", "v1");
+  lru_cache.Insert("k2", "v2");
+  lru_cache.Insert("k3", "v3");
+  ASSERT_EQ(lru_cache.Size(), 3);
+  ASSERT_EQ(lru_cache.TotalCharge(), 3);
+  ASSERT_TRUE(lru_cache.LRUAndHandleTableConsistent());
+
+  // ***************** Step 2 *****************
+  // (k4, v4) -> (k1, v1) -> (k3, v3)
+  s = lru_cache.Lookup("k1", &value);
+  ASSERT_TRUE(s.ok());
+  ASSERT_EQ(value, "v1");
+  lru_cache.Insert("k4", "v4");
+  ASSERT_EQ(lru_cache.Size(), 3);
+  ASSERT_TRUE(lru_cache.Lookup("k2", &value).IsNotFound());
+  ASSERT_TRUE(lru_cache.LRUAndHandleTableConsistent());
+
+  // ***************** Step 3 *****************
+  // (k3, v33) -> (k4, v4) -> (k1, v1)
+  lru_cache.Insert("k3", "v33", 1);
+  ASSERT_EQ(lru_cache.Size(), 3);
+  ASSERT_TRUE(lru_cache.Lookup("k3", &value).ok());
+  ASSERT_EQ(value, "v33");
+
+  // ***************** Step 4 *****************
+  // (k5, v5)
+  lru_cache.Insert("k5", "v5", 3);
+  ASSERT_EQ(lru_cache.Size(), 1);
+  ASSERT_EQ(lru_cache.TotalCharge(), 3);
+  ASSERT_TRUE(lru_cache.Lookup("k5", &value).ok());
+  ASSERT_TRUE(lru_cache.LRUAndHandleTableConsistent());
+
+  // ***************** Step 5 *****************
+  // empty
+  ASSERT_TRUE(lru_cache.Remove("k5").ok());
+  ASSERT_TRUE(lru_cache.Remove("k5").IsNotFound());
+  ASSERT_EQ(lru_cache.Size(), 0);
+  ASSERT_EQ(lru_cache.TotalCharge(), 0);
+
+  lru_cache.SetCapacity(0);
+  s = lru_cache.Insert("k6", "v6");
+  ASSERT_TRUE(s.IsCorruption());
+}
+
+TEST(ShardedLRUCacheTest, TestClockCase1) {
+  std::string value;
+  blackwidow::ShardedLRUCache<std::string, std::string> lru_cache(
+      0, CacheEvictionPolicy::kClock);
+  lru_cache.SetCapacity(3);
+
+  lru_cache.Insert("k1", "v1");
+  lru_cache.Insert("k2", "v2");
+  lru_cache.Insert("k3", "v3");
+
+  // k1 is the oldest entry but was referenced, k2 is evicted instead
+  ASSERT_TRUE(lru_cache.Lookup("k1", &value).ok());
+  lru_cache.Insert("k4", "v4");
+  ASSERT_TRUE(lru_cache.Lookup("k1", &value).ok());
+  ASSERT_TRUE(lru_cache.Lookup("k2", &value).IsNotFound());
+  ASSERT_TRUE(lru_cache.LRUAndHandleTableConsistent());
+
+  // Reinserted handles come from the free list
+  for (int idx = 0; idx < 1000; ++idx) {
+    lru_cache.Insert("k" + std::to_string(idx), "v" + std::to_string(idx));
+  }
+  ASSERT_EQ(lru_cache.Size(), 3);
+  ASSERT_TRUE(lru_cache.Lookup("k999", &value).ok());
+  ASSERT_EQ(value, "v999");
+  ASSERT_TRUE(lru_cache.LRUAndHandleTableConsistent());
+}
+
+TEST(ShardedLRUCacheTest, TestShardsCase1) {
+  std::string value;
+  blackwidow::ShardedLRUCache<std::string, std::string> lru_cache(4);
+  lru_cache.SetCapacity(1600);
+  ASSERT_EQ(lru_cache.Capacity(), 1600);
+
+  std::vector<std::thread> threads;
+  for (int tid = 0; tid < 4; ++tid) {
+    threads.push_back(std::thread([&lru_cache, tid] {
+      std::string value;
+      for (int idx = 0; idx < 1000; ++idx) {
+        std::string key = std::to_string(tid) + "_" + std::to_string(idx);
+        lru_cache.Insert(key, key);
+        lru_cache.Lookup(key, &value);
+      }
+    }));
+  }
+  for (auto& thread : threads) {
+    thread.join();
+  }
+  ASSERT_LE(lru_cache.Size(), 1600);
+  ASSERT_EQ(lru_cache.Size(), lru_cache.TotalCharge());
+  ASSERT_TRUE(lru_cache.LRUAndHandleTableConsistent());
+  lru_cache.Insert("k1", "v1");
+  ASSERT_TRUE(lru_cache.Lookup("k1", &value).ok());
+  ASSERT_EQ(value, "v1");
+
+  lru_cache.Clear();
+  ASSERT_EQ(lru_cache.Size(), 0);
+  ASSERT_EQ(lru_cache.TotalCharge(), 0);
+}
+
 int main(int argc, char** argv) {
   ::testing::InitGoogleTest(&argc, argv);
   return RUN_ALL_TESTS();
@@ -0,0 +1,123 @@
+//  Copyright (c) 2017-present, Qihoo, Inc.  All rights reserved.
+//  This source code is licensed under the BSD-style license found in the
+//  LICENSE file in the root directory of this source tree. An additional grant
+//  of patent rights can be found in the PATENTS file in the same directory.
+
+#include <gtest/gtest.h>
+#include <map>
+#include <string>
+
+#include "blackwidow/blackwidow.h"
+#include "src/memory_budget.h"
+
+using namespace blackwidow;
+
+const size_t kBudget = 64 << 20;
+
+// The memtable part of the budget is split by the weights
+TEST(MemoryBudgetTest, SplitTest) {
+  MemoryBudget budget(kBudget, 0.25, {{kHashes, 3}});
+  ASSERT_EQ(budget.GetWriteBufferLimit(kHashes), kBudget / 4 * 3 / 7);
+  ASSERT_EQ(budget.GetWriteBufferLimit(kStrings), kBudget / 4 / 7);
+  ASSERT_EQ(budget.GetWriteBufferLimit(kSets), kBudget / 4 / 7);
+  ASSERT_EQ(budget.GetWriteBufferLimit(kAll), 0);
+
+  ASSERT_TRUE(budget.SetWeights({}).ok());
+  ASSERT_EQ(budget.GetWriteBufferLimit(kHashes), kBudget / 4 / 5);
+  ASSERT_EQ(budget.GetWriteBufferLimit(kStrings), kBudget / 4 / 5);
+
+  ASSERT_TRUE(budget.SetWeights({{kLists, 0}}).IsInvalidArgument());
+  ASSERT_TRUE(budget.SetWeights({{kAll, 1}}).IsInvalidArgument());
+  ASSERT_EQ(budget.GetWriteBufferLimit(kLists), kBudget / 4 / 5);
+
+  ASSERT_TRUE(MemoryBudget::CheckWriteBufferRatio(1).ok());
+  ASSERT_TRUE(MemoryBudget::CheckWriteBufferRatio(0).IsInvalidArgument());
+  ASSERT_TRUE(MemoryBudget::CheckWriteBufferRatio(1.5).IsInvalidArgument());
+
+  // Every type shares the block cache and has its own memtable limit
+  BlackwidowOptions strings_options, hashes_options;
+  budget.Apply(kStrings, &strings_options);
+  budget.Apply(kHashes, &hashes_options);
+  ASSERT_TRUE(strings_options.share_block_cache);
+  ASSERT_NE(strings_options.table_options.block_cache, nullptr);
+  ASSERT_EQ(strings_options.table_options.block_cache,
+            hashes_options.table_options.block_cache);
+  ASSERT_NE(strings_options.options.write_buffer_manager,
+            hashes_options.options.write_buffer_manager);
+}
+
+// The memtables of every type are reported by GetUsage
+TEST(MemoryBudgetTest, UsageTest) {
+  std::string path = "./db/memory_budget";
+  if (access(path.c_str(), F_OK)) {
+    mkdir(path.c_str(), 0755);
+  }
+  BlackwidowOptions bw_options;
+  bw_options.options.create_if_missing = true;
+  bw_options.memory_budget = kBudget;
+  bw_options.memory_budget_weights = {{kStrings, 2}, {kAll, 1}};
+  {
+    BlackWidow db;
+    ASSERT_TRUE(db.Open(bw_options, path).IsInvalidArgument());
+  }
+
+  bw_options.memory_budget_weights = {{kStrings, 2}};
+  for (double ratio : {0.0, -0.25, 1.5}) {
+    bw_options.memory_budget_write_buffer_ratio = ratio;
+    BlackWidow db;
+    ASSERT_TRUE(db.Open(bw_options, path).IsInvalidArgument());
+  }
+
+  bw_options.memory_budget_write_buffer_ratio = 0.25;
+  BlackWidow db;
+  ASSERT_TRUE(db.Open(bw_options, path).ok());
+
+  std::map<std::string, uint64_t> limits;
+  ASSERT_TRUE(db.GetUsage(PROPERTY_TYPE_BLACKWIDOW_WRITE_BUFFER_LIMIT,
+                          &limits).ok());
+  ASSERT_EQ(limits[STRINGS_DB], kBudget / 4 * 2 / 6);
+  ASSERT_EQ(limits[HASHES_DB], kBudget / 4 / 6);
+
+  for (int idx = 0; idx < 100; ++idx) {
+    ASSERT_TRUE(db.Set("KEY" + std::to_string(idx), "VALUE").ok());
+  }
+  std::map<std::string, uint64_t> usages;
+  ASSERT_TRUE(db.GetUsage(PROPERTY_TYPE_BLACKWIDOW_WRITE_BUFFER_USAGE,
+                          &usages).ok());
+  ASSERT_GT(usages[STRINGS_DB], 0);
+  ASSERT_LE(usages[STRINGS_DB], kBudget);
+
+  uint64_t total_limit = 0;
+  ASSERT_TRUE(db.GetUsage(PROPERTY_TYPE_BLACKWIDOW_WRITE_BUFFER_LIMIT,
+                          &total_limit).ok());
+  ASSERT_LE(total_limit, kBudget / 4);
+
+  ASSERT_TRUE(db.SetMemoryBudgetWeights({{kHashes, 2}}).ok());
+  ASSERT_TRUE(db.GetUsage(PROPERTY_TYPE_BLACKWIDOW_WRITE_BUFFER_LIMIT,
+                          &limits).ok());
+  ASSERT_EQ(limits[STRINGS_DB], kBudget / 4 / 6);
+  ASSERT_EQ(limits[HASHES_DB], kBudget / 4 * 2 / 6);
+}
+
+// Without a budget nothing is limited nor reported
+TEST(MemoryBudgetTest, NoBudgetTest) {
+  std::string path = "./db/no_memory_budget";
+  if (access(path.c_str(), F_OK)) {
+    mkdir(path.c_str(), 0755);
+  }
+  BlackwidowOptions bw_options;
+  bw_options.options.create_if_missing = true;
+  BlackWidow db;
+  ASSERT_TRUE(db.Open(bw_options, path).ok());
+
+  uint64_t total_limit = 0;
+  ASSERT_TRUE(db.GetUsage(PROPERTY_TYPE_BLACKWIDOW_WRITE_BUFFER_LIMIT,
+                          &total_limit).ok());
+  ASSERT_EQ(total_limit, 0);
+  ASSERT_TRUE(db.SetMemoryBudgetWeights({}).IsNotSupported());
+}
+
+int main(int argc, char** argv) {
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
@@ -0,0 +1,203 @@
+//  Copyright (c) 2017-present, Qihoo, Inc.  All rights reserved.
+//  This source code is licensed under the BSD-style license found in the
+//  LICENSE file in the root directory of this source tree. An additional grant
+//  of patent rights can be found in the PATENTS file in the same directory.
+
+#include <gtest/gtest.h>
+#include <atomic>
+#include <map>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "blackwidow/blackwidow.h"
+
+using namespace blackwidow;
+
+// The single key reads take no snapshot and no lock. These tests state
+// what they see while another thread writes the same key: every read
+// gives a state the key had, whole writes and no mix of two of them,
+// and a read after a write sees it.
+class ReadConsistencyTest : public ::testing::Test {
+ public:
+  ReadConsistencyTest() {
+    std::string path = "./db/read_consistency";
+    if (access(path.c_str(), F_OK)) {
+      mkdir(path.c_str(), 0755);
+    }
+    bw_options.options.create_if_missing = true;
+    s = db.Open(bw_options, path);
+  }
+  virtual ~ReadConsistencyTest() { }
+
+  static void SetUpTestCase() { }
+  static void TearDownTestCase() { }
+
+  // Runs write in a thread until read has been called rounds times
+  template <typename Write, typename Read>
+  void RunConcurrently(int rounds, const Write& write, const Read& read) {
+    std::atomic<bool> stop(false);
+    std::thread writer([&stop, &write]() {
+      for (int idx = 0; !stop.load(); ++idx) {
+        write(idx);
+      }
+    });
+    for (int idx = 0; idx < rounds; ++idx) {
+      read();
+    }
+    stop.store(true);
+    writer.join();
+  }
+
+  BlackwidowOptions bw_options;
+  blackwidow::BlackWidow db;
+  blackwidow::Status s;
+};
+
+// HMGet reads the fields of one HMSet
+TEST_F(ReadConsistencyTest, HMGetTest) {
+  ASSERT_TRUE(s.ok());
+  std::map<DataType, Status> type_status;
+  db.Del({"HMGET_KEY"}, &type_status);
+  ASSERT_TRUE(db.HMSet("HMGET_KEY", {{"F1", "0"}, {"F2", "0"}}).ok());
+
+  RunConcurrently(2000, [this](int idx) {
+    std::string value = std::to_string(idx);
+    db.HMSet("HMGET_KEY", {{"F1", value}, {"F2", value}});
+  }, [this]() {
+    std::vector<ValueStatus> vss;
+    ASSERT_TRUE(db.HMGet("HMGET_KEY", {"F1", "F2"}, &vss).ok());
+    ASSERT_EQ(vss.size(), 2);
+    ASSERT_TRUE(vss[0].status.ok());
+    ASSERT_EQ(vss[0].value, vss[1].value);
+  });
+}
+
+// HGetall sees all the fields of a hash deleted and set again, or none
+TEST_F(ReadConsistencyTest, HGetallRecreateTest) {
+  ASSERT_TRUE(s.ok());
+  std::map<DataType, Status> type_status;
+  db.Del({"HGETALL_KEY"}, &type_status);
+
+  RunConcurrently(2000, [this](int idx) {
+    std::map<DataType, Status> type_status;
+    std::string value = std::to_string(idx);
+    db.Del({"HGETALL_KEY"}, &type_status);
+    db.HMSet("HGETALL_KEY", {{"F1", value}, {"F2", value}, {"F3", value}});
+  }, [this]() {
+    std::vector<FieldValue> fvs;
+    Status s = db.HGetall("HGETALL_KEY", &fvs);
+    ASSERT_TRUE(s.ok() || s.IsNotFound());
+    if (s.IsNotFound()) {
+      ASSERT_TRUE(fvs.empty());
+      return;
+    }
+    ASSERT_EQ(fvs.size(), 3);
+    ASSERT_EQ(fvs[0].value, fvs[1].value);
+    ASSERT_EQ(fvs[0].value, fvs[2].value);
+  });
+}
+
+// LRange reads the nodes at the indexes of the same meta value, a list
+// pushed at the head and popped at the tail stays one run of elements
+TEST_F(ReadConsistencyTest, LRangeTest) {
+  ASSERT_TRUE(s.ok());
+  std::map<DataType, Status> type_status;
+  db.Del({"LRANGE_KEY"}, &type_status);
+  uint64_t len = 0;
+  for (int idx = -10; idx < 0; ++idx) {
+    ASSERT_TRUE(db.LPush("LRANGE_KEY", {std::to_string(idx)}, &len).ok());
+  }
+
+  RunConcurrently(2000, [this](int idx) {
+    uint64_t len = 0;
+    std::string element;
+    db.LPush("LRANGE_KEY", {std::to_string(idx)}, &len);
+    db.RPop("LRANGE_KEY", &element);
+  }, [this]() {
+    std::vector<std::string> elements;
+    ASSERT_TRUE(db.LRange("LRANGE_KEY", 0, -1, &elements).ok());
+    ASSERT_TRUE(elements.size() == 10 || elements.size() == 11);
+    for (size_t idx = 1; idx < elements.size(); ++idx) {
+      ASSERT_EQ(std::stoi(elements[idx - 1]), std::stoi(elements[idx]) + 1);
+    }
+  });
+}
+
+// ZRange and ZRevrange read the scores at the ranks of the same meta
+// value, a member added and removed below the others never shifts the
+// ranks read
+TEST_F(ReadConsistencyTest, ZRangeTest) {
+  ASSERT_TRUE(s.ok());
+  std::map<DataType, Status> type_status;
+  db.Del({"ZRANGE_KEY"}, &type_status);
+  int32_t ret = 0;
+  for (int idx = 0; idx < 10; ++idx) {
+    ASSERT_TRUE(db.ZAdd("ZRANGE_KEY",
+          {{idx * 1.0, "MEMBER" + std::to_string(idx)}}, &ret).ok());
+  }
+
+  RunConcurrently(2000, [this](int idx) {
+    int32_t ret = 0;
+    if (idx % 2 == 0) {
+      db.ZAdd("ZRANGE_KEY", {{-1.0, "LOWEST"}}, &ret);
+    } else {
+      db.ZRem("ZRANGE_KEY", {"LOWEST"}, &ret);
+    }
+  }, [this]() {
+    std::vector<ScoreMember> score_members;
+    ASSERT_TRUE(db.ZRange("ZRANGE_KEY", -1, -1, &score_members).ok());
+    ASSERT_EQ(score_members.size(), 1);
+    ASSERT_EQ(score_members[0].member, "MEMBER9");
+
+    score_members.clear();
+    ASSERT_TRUE(db.ZRevrange("ZRANGE_KEY", -1, -1, &score_members).ok());
+    ASSERT_EQ(score_members.size(), 1);
+    ASSERT_TRUE(score_members[0].member == "LOWEST"
+      || score_members[0].member == "MEMBER0");
+  });
+}
+
+// MGet reads the keys of one MSet
+TEST_F(ReadConsistencyTest, MGetTest) {
+  ASSERT_TRUE(s.ok());
+  ASSERT_TRUE(db.MSet({{"MGET_KEY1", "0"}, {"MGET_KEY2", "0"}}).ok());
+
+  RunConcurrently(2000, [this](int idx) {
+    std::string value = std::to_string(idx);
+    db.MSet({{"MGET_KEY1", value}, {"MGET_KEY2", value}});
+  }, [this]() {
+    std::vector<ValueStatus> vss;
+    ASSERT_TRUE(db.MGet({"MGET_KEY1", "MGET_KEY2"}, &vss).ok());
+    ASSERT_EQ(vss.size(), 2);
+    ASSERT_TRUE(vss[0].status.ok());
+    ASSERT_EQ(vss[0].value, vss[1].value);
+  });
+}
+
+// A read after a write sees it
+TEST_F(ReadConsistencyTest, ReadYourWritesTest) {
+  ASSERT_TRUE(s.ok());
+  int32_t ret = 0;
+  for (int idx = 0; idx < 100; ++idx) {
+    std::string value = std::to_string(idx);
+    std::string value_out;
+    ASSERT_TRUE(db.HSet("RYW_HASH_KEY", "FIELD", value, &ret).ok());
+    ASSERT_TRUE(db.HGet("RYW_HASH_KEY", "FIELD", &value_out).ok());
+    ASSERT_EQ(value_out, value);
+
+    ASSERT_TRUE(db.SAdd("RYW_SET_KEY", {value}, &ret).ok());
+    ASSERT_TRUE(db.SIsmember("RYW_SET_KEY", value, &ret).ok());
+    ASSERT_EQ(ret, 1);
+
+    double score = 0;
+    ASSERT_TRUE(db.ZAdd("RYW_ZSET_KEY", {{idx * 1.0, "MEMBER"}}, &ret).ok());
+    ASSERT_TRUE(db.ZScore("RYW_ZSET_KEY", "MEMBER", &score).ok());
+    ASSERT_EQ(score, idx * 1.0);
+  }
+}
+
+int main(int argc, char** argv) {
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
@@ -0,0 +1,96 @@
+//  Copyright (c) 2017-present The blackwidow Authors.  All rights reserved.
+//  This source code is licensed under the BSD-style license found in the
+//  LICENSE file in the root directory of this source tree. An additional grant
+//  of patent rights can be found in the PATENTS file in the same directory.
+
+#include <gtest/gtest.h>
+
+#include "blackwidow/reply_sink.h"
+
+using namespace blackwidow;
+
+// Arrays and bulk strings
+TEST(RespReplySinkTest, ArrayTest) {
+  std::string buf = "+OK\r\n";
+  RespReplySink sink(&buf, kResp2);
+  sink.StartArray(2);
+  sink.AppendBulkString("a");
+  sink.AppendBulkString("");
+  sink.EndArray(2);
+  ASSERT_EQ(buf, "+OK\r\n*2\r\n$1\r\na\r\n$0\r\n\r\n");
+
+  buf.clear();
+  sink.StartArray(0);
+  sink.EndArray(0);
+  ASSERT_EQ(buf, "*0\r\n");
+}
+
+// The header is rewritten when the hint was wrong
+TEST(RespReplySinkTest, ExpectedLenTest) {
+  std::string buf;
+  RespReplySink sink(&buf, kResp2);
+  sink.StartArray(5);
+  sink.AppendBulkString("a");
+  sink.EndArray(1);
+  ASSERT_EQ(buf, "*1\r\n$1\r\na\r\n");
+
+  buf.clear();
+  sink.StartArray(100);
+  sink.AppendBulkString("a");
+  sink.EndArray(1);
+  ASSERT_EQ(buf, "*1\r\n$1\r\na\r\n");
+
+  buf.clear();
+  sink.StartArray(-1);
+  for (int idx = 0; idx < 10; ++idx) {
+    sink.AppendBulkString("a");
+  }
+  sink.EndArray(10);
+  ASSERT_EQ(buf.substr(0, 5), "*10\r\n");
+  ASSERT_EQ(buf.size(), 5 + 10 * 7);
+}
+
+// Maps, pairs and doubles in RESP2
+TEST(RespReplySinkTest, Resp2Test) {
+  std::string buf;
+  RespReplySink sink(&buf, kResp2);
+  sink.StartMap(1);
+  sink.AppendBulkString("f");
+  sink.AppendBulkString("v");
+  sink.EndMap(1);
+  ASSERT_EQ(buf, "*2\r\n$1\r\nf\r\n$1\r\nv\r\n");
+
+  buf.clear();
+  sink.StartPairs(2);
+  sink.AppendBulkString("m1");
+  sink.AppendDouble(1.5);
+  sink.AppendBulkString("m2");
+  sink.AppendDouble(-2);
+  sink.EndPairs(2);
+  ASSERT_EQ(buf, "*4\r\n$2\r\nm1\r\n$3\r\n1.5\r\n$2\r\nm2\r\n$2\r\n-2\r\n");
+}
+
+// Maps, pairs and doubles in RESP3
+TEST(RespReplySinkTest, Resp3Test) {
+  std::string buf;
+  RespReplySink sink(&buf, kResp3);
+  sink.StartMap(1);
+  sink.AppendBulkString("f");
+  sink.AppendBulkString("v");
+  sink.EndMap(1);
+  ASSERT_EQ(buf, "%1\r\n$1\r\nf\r\n$1\r\nv\r\n");
+
+  buf.clear();
+  sink.StartPairs(2);
+  sink.AppendBulkString("m1");
+  sink.AppendDouble(1.5);
+  sink.AppendBulkString("m2");
+  sink.AppendDouble(-2);
+  sink.EndPairs(2);
+  ASSERT_EQ(buf, "*2\r\n*2\r\n$2\r\nm1\r\n,1.5\r\n*2\r\n$2\r\nm2\r\n,-2\r\n");
+}
+
+int main(int argc, char** argv) {
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
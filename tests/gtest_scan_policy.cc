@@ -0,0 +1,58 @@
+//  Copyright (c) 2017-present, Qihoo, Inc.  All rights reserved.
+//  This source code is licensed under the BSD-style license found in the
+//  LICENSE file in the root directory of this source tree. An additional grant
+//  of patent rights can be found in the PATENTS file in the same directory.
+
+#include <gtest/gtest.h>
+
+#include "src/scan_policy.h"
+
+using namespace blackwidow;
+
+// Small and large collection reads
+TEST(ScanPolicyTest, CollectionTest) {
+  ScanPolicy policy;
+  policy.SetOptions(100, 1024 * 1024);
+
+  rocksdb::ReadOptions read_options;
+  read_options.fill_cache = false;
+  ASSERT_TRUE(policy.ForCollection(100, &read_options));
+  ASSERT_TRUE(read_options.fill_cache);
+  ASSERT_EQ(read_options.readahead_size, 0);
+
+  ASSERT_FALSE(policy.ForCollection(101, &read_options));
+  ASSERT_FALSE(read_options.fill_cache);
+  ASSERT_EQ(read_options.readahead_size, 1024 * 1024);
+
+  ScanPolicyStats stats;
+  policy.GetStats(&stats);
+  ASSERT_EQ(stats.large_read_threshold, 100);
+  ASSERT_EQ(stats.readahead_size, 1024 * 1024);
+  ASSERT_EQ(stats.small_reads, 1);
+  ASSERT_EQ(stats.large_reads, 1);
+  ASSERT_EQ(stats.keyspace_scans, 0);
+}
+
+// Keyspace scans
+TEST(ScanPolicyTest, KeyspaceScanTest) {
+  ScanPolicy policy;
+  policy.SetOptions(100, 4096);
+
+  rocksdb::ReadOptions read_options;
+  policy.ForKeyspaceScan(&read_options);
+  ASSERT_FALSE(read_options.fill_cache);
+  ASSERT_EQ(read_options.readahead_size, 4096);
+
+  ScanPolicyStats stats;
+  policy.GetStats(&stats);
+  ASSERT_EQ(stats.keyspace_scans, 1);
+  policy.ResetStats();
+  policy.GetStats(&stats);
+  ASSERT_EQ(stats.keyspace_scans, 0);
+  ASSERT_EQ(stats.readahead_size, 4096);
+}
+
+int main(int argc, char** argv) {
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
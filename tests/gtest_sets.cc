@@ -4,6 +4,7 @@
 //  of patent rights can be found in the PATENTS file in the same directory.
 
 #include <gtest/gtest.h>
+#include <atomic>
 #include <thread>
 #include <iostream>
 
@@ -2300,6 +2301,69 @@ TEST_F(SetsTest, SScanTest) {
 }
 
 
+// SAdd with write combining
+TEST_F(SetsTest, SAddCombiningTest) {
+  db.EnableWriteCombining(true);
+  std::atomic<int32_t> added(0);
+  std::vector<std::thread> threads;
+  for (int thread_idx = 0; thread_idx < 8; ++thread_idx) {
+    threads.push_back(std::thread([this, &added]() {
+      int32_t ret;
+      for (int idx = 0; idx < 500; ++idx) {
+        std::vector<std::string> members {"MEMBER" + std::to_string(idx),
+                                          "MEMBER" + std::to_string(idx + 1)};
+        ASSERT_TRUE(db.SAdd("SADD_COMBINING_KEY", members, &ret).ok());
+        added += ret;
+      }
+    }));
+  }
+  for (auto& thread : threads) {
+    thread.join();
+  }
+  db.EnableWriteCombining(false);
+
+  // Every member is counted as added once
+  int32_t card;
+  s = db.SCard("SADD_COMBINING_KEY", &card);
+  ASSERT_TRUE(s.ok());
+  ASSERT_EQ(card, 501);
+  ASSERT_EQ(added, 501);
+}
+
+// SInter reads at a snapshot, with the iterator pool enabled too
+TEST(SetsIteratorPoolTest, SInterTest) {
+  std::string path = "./db/sets_iterator_pool";
+  if (access(path.c_str(), F_OK)) {
+    mkdir(path.c_str(), 0755);
+  }
+  BlackwidowOptions bw_options;
+  bw_options.options.create_if_missing = true;
+  bw_options.iterator_pool_size = 8;
+  blackwidow::BlackWidow db;
+  Status s = db.Open(bw_options, path);
+  ASSERT_TRUE(s.ok());
+
+  int32_t ret;
+  std::vector<std::string> members;
+  s = db.SAdd("POOL_SET_KEY1", {"a", "b", "c"}, &ret);
+  s = db.SAdd("POOL_SET_KEY2", {"b", "c", "d"}, &ret);
+  s = db.SInter({"POOL_SET_KEY1", "POOL_SET_KEY2"}, &members);
+  ASSERT_TRUE(s.ok());
+  ASSERT_TRUE(members_match(members, {"b", "c"}));
+
+  s = db.SAdd("POOL_SET_KEY1", {"d"}, &ret);
+  members.clear();
+  s = db.SInter({"POOL_SET_KEY1", "POOL_SET_KEY2"}, &members);
+  ASSERT_TRUE(s.ok());
+  ASSERT_TRUE(members_match(members, {"b", "c", "d"}));
+
+  // SMembers still takes a pooled iterator
+  members.clear();
+  s = db.SMembers("POOL_SET_KEY1", &members);
+  ASSERT_TRUE(s.ok());
+  ASSERT_TRUE(members_match(members, {"a", "b", "c", "d"}));
+}
+
 int main(int argc, char** argv) {
   ::testing::InitGoogleTest(&argc, argv);
   return RUN_ALL_TESTS();
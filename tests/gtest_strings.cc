@@ -1035,6 +1035,45 @@ TEST_F(StringsTest, PKSetexAtTest) {
   ASSERT_EQ(ttl_ret[DataType::kStrings], -2);
 }
 
+// Get and MGet into pinned values
+TEST_F(StringsTest, PinnableGetTest) {
+  s = db.Set("PINNABLE_GET_KEY1", "VALUE1");
+  ASSERT_TRUE(s.ok());
+  s = db.Set("PINNABLE_GET_KEY2", std::string(100 * 1024, 'a'));
+  ASSERT_TRUE(s.ok());
+
+  blackwidow::PinnableSlice value;
+  s = db.Get("PINNABLE_GET_KEY1", &value);
+  ASSERT_TRUE(s.ok());
+  ASSERT_EQ(value.ToString(), "VALUE1");
+  s = db.Get("PINNABLE_GET_KEY2", &value);
+  ASSERT_TRUE(s.ok());
+  ASSERT_EQ(value.ToString(), std::string(100 * 1024, 'a'));
+  s = db.Get("PINNABLE_GET_NOT_EXIST_KEY", &value);
+  ASSERT_TRUE(s.IsNotFound());
+
+  s = db.Set("PINNABLE_GET_KEY3", "VALUE3");
+  ASSERT_TRUE(s.ok());
+  ASSERT_TRUE(make_expired(&db, "PINNABLE_GET_KEY3"));
+  s = db.Get("PINNABLE_GET_KEY3", &value);
+  ASSERT_TRUE(s.IsNotFound());
+
+  std::vector<std::string> keys {"PINNABLE_GET_KEY1",
+                                 "PINNABLE_GET_NOT_EXIST_KEY",
+                                 "PINNABLE_GET_KEY3",
+                                 "PINNABLE_GET_KEY2"};
+  blackwidow::PinnableSlice values[4];
+  blackwidow::Status statuses[4];
+  s = db.MGet(keys, values, statuses);
+  ASSERT_TRUE(s.ok());
+  ASSERT_TRUE(statuses[0].ok());
+  ASSERT_EQ(values[0].ToString(), "VALUE1");
+  ASSERT_TRUE(statuses[1].IsNotFound());
+  ASSERT_TRUE(statuses[2].IsNotFound());
+  ASSERT_TRUE(statuses[3].ok());
+  ASSERT_EQ(values[3].size(), 100 * 1024);
+}
+
 int main(int argc, char** argv) {
   ::testing::InitGoogleTest(&argc, argv);
   return RUN_ALL_TESTS();
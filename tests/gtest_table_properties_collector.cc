@@ -0,0 +1,213 @@
+//  Copyright (c) 2017-present, Qihoo, Inc.  All rights reserved.
+//  This source code is licensed under the BSD-style license found in the
+//  LICENSE file in the root directory of this source tree. An additional grant
+//  of patent rights can be found in the PATENTS file in the same directory.
+
+#include <gtest/gtest.h>
+#include <iostream>
+
+#include "src/redis.h"
+#include "src/table_properties_collector.h"
+#include "blackwidow/blackwidow.h"
+
+using namespace blackwidow;
+
+static GarbageProperties FinishCollector(GarbagePropertiesCollector* collector) {
+  rocksdb::UserCollectedProperties props;
+  GarbageProperties garbage;
+  EXPECT_TRUE(collector->Finish(&props).ok());
+  EXPECT_TRUE(ParseGarbageProperties(props, &garbage));
+  return garbage;
+}
+
+// Meta CF
+TEST(TablePropertiesCollectorTest, MetaValueTest) {
+  GarbagePropertiesCollector collector(RecordFormat::kBaseMetaValue, 0.5);
+  int64_t unix_time;
+  rocksdb::Env::Default()->GetCurrentTime(&unix_time);
+  char str[4];
+
+  // Live hash table
+  EncodeFixed32(str, 1);
+  HashesMetaValue live_meta_value(std::string(str, sizeof(int32_t)));
+  live_meta_value.UpdateVersion();
+  collector.AddUserKey("LIVE_KEY", live_meta_value.Encode(),
+                       rocksdb::kEntryPut, 0, 0);
+
+  // Empty hash table
+  EncodeFixed32(str, 0);
+  HashesMetaValue empty_meta_value(std::string(str, sizeof(int32_t)));
+  empty_meta_value.UpdateVersion();
+  collector.AddUserKey("EMPTY_KEY", empty_meta_value.Encode(),
+                       rocksdb::kEntryPut, 0, 0);
+
+  // Expired hash table
+  EncodeFixed32(str, 1);
+  HashesMetaValue expired_meta_value(std::string(str, sizeof(int32_t)));
+  expired_meta_value.UpdateVersion();
+  expired_meta_value.set_timestamp(static_cast<int32_t>(unix_time) - 10);
+  collector.AddUserKey("EXPIRED_KEY", expired_meta_value.Encode(),
+                       rocksdb::kEntryPut, 0, 0);
+
+  collector.AddUserKey("DELETED_KEY", "", rocksdb::kEntryDelete, 0, 0);
+
+  GarbageProperties garbage = FinishCollector(&collector);
+  ASSERT_EQ(garbage.entries, 4);
+  ASSERT_EQ(garbage.deletions, 1);
+  ASSERT_EQ(garbage.stale_versions, 1);
+  ASSERT_EQ(garbage.expired, 1);
+  // Too few entries to be worth a compaction
+  ASSERT_FALSE(collector.NeedCompact());
+}
+
+// Data CF
+TEST(TablePropertiesCollectorTest, DataKeyTest) {
+  GarbagePropertiesCollector collector(RecordFormat::kBaseDataKey, 0.5);
+
+  // Old version of KEY1 then the live one, KEY2 has a single version
+  for (int32_t version = 1; version <= 2; ++version) {
+    for (size_t idx = 0; idx < 100; ++idx) {
+      HashesDataKey data_key("KEY1", version, "FIELD" + std::to_string(idx));
+      collector.AddUserKey(data_key.Encode(), "VALUE",
+                           rocksdb::kEntryPut, 0, 0);
+    }
+  }
+  for (size_t idx = 0; idx < 50; ++idx) {
+    HashesDataKey data_key("KEY2", 1, "FIELD" + std::to_string(idx));
+    collector.AddUserKey(data_key.Encode(), "VALUE",
+                         rocksdb::kEntryPut, 0, 0);
+  }
+  ASSERT_FALSE(collector.NeedCompact());
+
+  // Stale versions are only known once the key group is finished
+  GarbageProperties garbage = FinishCollector(&collector);
+  ASSERT_EQ(garbage.entries, 250);
+  ASSERT_EQ(garbage.stale_versions, 100);
+  ASSERT_EQ(garbage.deletions, 0);
+
+  GarbagePropertiesCollector tombstones(RecordFormat::kBaseDataKey, 0.5);
+  for (size_t idx = 0; idx < 200; ++idx) {
+    HashesDataKey data_key("KEY", 1, "FIELD" + std::to_string(idx));
+    tombstones.AddUserKey(data_key.Encode(), "",
+                          idx % 4 ? rocksdb::kEntryDelete : rocksdb::kEntryPut,
+                          0, 0);
+  }
+  ASSERT_TRUE(tombstones.NeedCompact());
+  garbage = FinishCollector(&tombstones);
+  ASSERT_EQ(garbage.deletions, 150);
+}
+
+// Strings
+TEST(TablePropertiesCollectorTest, StringsValueTest) {
+  GarbagePropertiesCollector collector(RecordFormat::kStringsValue, 0);
+  int64_t unix_time;
+  rocksdb::Env::Default()->GetCurrentTime(&unix_time);
+
+  for (size_t idx = 0; idx < 200; ++idx) {
+    StringsValue strings_value("VALUE");
+    if (idx % 2) {
+      strings_value.set_timestamp(static_cast<int32_t>(unix_time) - 10);
+    }
+    collector.AddUserKey("KEY" + std::to_string(idx),
+                         strings_value.Encode(), rocksdb::kEntryPut, 0, 0);
+  }
+  // Disabled when garbage ratio is 0
+  ASSERT_FALSE(collector.NeedCompact());
+
+  GarbageProperties garbage = FinishCollector(&collector);
+  ASSERT_EQ(garbage.entries, 200);
+  ASSERT_EQ(garbage.expired, 100);
+  ASSERT_DOUBLE_EQ(garbage.ratio(), 0.5);
+}
+
+// Expire range
+TEST(TablePropertiesCollectorTest, ExpireRangeTest) {
+  GarbagePropertiesCollector collector(RecordFormat::kStringsValue, 0.5);
+  int64_t unix_time;
+  rocksdb::Env::Default()->GetCurrentTime(&unix_time);
+  int32_t cur_time = static_cast<int32_t>(unix_time);
+
+  // 100 keys expire within the next 100 seconds, 100 keys never expire
+  for (int32_t idx = 0; idx < 200; ++idx) {
+    StringsValue strings_value("VALUE");
+    if (idx < 100) {
+      strings_value.set_timestamp(cur_time + 100 + idx);
+    }
+    collector.AddUserKey("KEY" + std::to_string(idx),
+                         strings_value.Encode(), rocksdb::kEntryPut, 0, 0);
+  }
+  ASSERT_FALSE(collector.NeedCompact());
+
+  rocksdb::UserCollectedProperties props;
+  ASSERT_TRUE(collector.Finish(&props).ok());
+  ExpireProperties expire;
+  ASSERT_TRUE(ParseExpireProperties(props, &expire));
+  ASSERT_EQ(expire.entries, 200);
+  ASSERT_EQ(expire.expire_count, 100);
+  ASSERT_EQ(expire.min_expire, cur_time + 100);
+  ASSERT_EQ(expire.max_expire, cur_time + 199);
+
+  ASSERT_DOUBLE_EQ(expire.ExpiredRatio(cur_time), 0);
+  ASSERT_GT(expire.ExpiredRatio(cur_time + 150), 0.2);
+  ASSERT_LT(expire.ExpiredRatio(cur_time + 150), 0.3);
+  ASSERT_DOUBLE_EQ(expire.ExpiredRatio(cur_time + 200), 0.5);
+
+  // Data CF records do not carry a timestamp
+  GarbagePropertiesCollector data_collector(RecordFormat::kBaseDataKey, 0.5);
+  props.clear();
+  ASSERT_TRUE(data_collector.Finish(&props).ok());
+  ASSERT_FALSE(ParseExpireProperties(props, &expire));
+}
+
+// Key counts
+TEST(TablePropertiesCollectorTest, KeyNumTest) {
+  GarbagePropertiesCollector collector(RecordFormat::kStringsValue, 0.5);
+  int64_t unix_time;
+  rocksdb::Env::Default()->GetCurrentTime(&unix_time);
+  int32_t cur_time = static_cast<int32_t>(unix_time);
+
+  // 100 keys never expire, 50 keys expire within the next 150 seconds,
+  // 20 keys are already expired and 10 keys are deleted
+  for (int32_t idx = 0; idx < 180; ++idx) {
+    StringsValue strings_value("VALUE");
+    if (idx >= 100 && idx < 150) {
+      strings_value.set_timestamp(cur_time + idx);
+    } else if (idx >= 150 && idx < 170) {
+      strings_value.set_timestamp(cur_time - 10);
+    }
+    collector.AddUserKey("KEY" + std::to_string(idx),
+                         strings_value.Encode(),
+                         idx < 170 ? rocksdb::kEntryPut : rocksdb::kEntryDelete,
+                         0, 0);
+  }
+
+  rocksdb::UserCollectedProperties props;
+  ASSERT_TRUE(collector.Finish(&props).ok());
+  KeyNumProperties key_num;
+  ASSERT_TRUE(ParseKeyNumProperties(props, &key_num));
+  ASSERT_EQ(key_num.live_keys, 150);
+  ASSERT_EQ(key_num.expire_count, 50);
+  ASSERT_EQ(key_num.stale_keys, 20);
+  ASSERT_EQ(key_num.deletions, 10);
+  ASSERT_EQ(key_num.min_expire, cur_time + 100);
+  ASSERT_EQ(key_num.max_expire, cur_time + 149);
+
+  // ttl of 100 to 149 seconds left
+  ASSERT_EQ(key_num.ExpiredSince(cur_time), 0);
+  ASSERT_EQ(key_num.TTLSum(cur_time), 50 * (100 + 149) / 2);
+  ASSERT_GT(key_num.ExpiredSince(cur_time + 125), 20);
+  ASSERT_LT(key_num.ExpiredSince(cur_time + 125), 30);
+  ASSERT_EQ(key_num.ExpiredSince(cur_time + 150), 50);
+  ASSERT_EQ(key_num.TTLSum(cur_time + 150), 0);
+
+  // Data CF records are not keys
+  GarbagePropertiesCollector data_collector(RecordFormat::kBaseDataKey, 0.5);
+  props.clear();
+  ASSERT_TRUE(data_collector.Finish(&props).ok());
+  ASSERT_FALSE(ParseKeyNumProperties(props, &key_num));
+}
+
+int main(int argc, char** argv) {
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
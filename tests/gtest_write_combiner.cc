@@ -0,0 +1,118 @@
+//  Copyright (c) 2017-present, Qihoo, Inc.  All rights reserved.
+//  This source code is licensed under the BSD-style license found in the
+//  LICENSE file in the root directory of this source tree. An additional grant
+//  of patent rights can be found in the PATENTS file in the same directory.
+
+#include <gtest/gtest.h>
+#include <algorithm>
+#include <chrono>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "src/write_combiner.h"
+
+using namespace blackwidow;
+
+struct AddOp {
+  int64_t value;
+  int64_t ret;
+};
+typedef WriteCombiner<AddOp> AddCombiner;
+
+// Increments a counter per key, the applied batches are counted
+struct Counters {
+  int64_t hot;
+  int64_t cold;
+  int64_t batches;
+  size_t max_batch;
+
+  void Apply(const Slice& key, const AddCombiner::Requests& requests) {
+    int64_t* counter = key == "HOT_KEY" ? &hot : &cold;
+    // Applied while holding the key lock for a while, so others queue up
+    std::this_thread::sleep_for(std::chrono::microseconds(100));
+    for (auto request : requests) {
+      EXPECT_EQ(request->key, key);
+      *counter += request->op.value;
+      request->op.ret = *counter;
+      request->status = request->op.value < 0
+        ? Status::InvalidArgument("negative") : Status::OK();
+    }
+    batches++;
+    max_batch = std::max(max_batch, requests.size());
+  }
+};
+
+// Combining
+TEST(WriteCombinerTest, CombineTest) {
+  LockMgr lock_mgr(1024);
+  AddCombiner combiner;
+  Counters counters = {0, 0, 0, 0};
+  auto apply = [&counters](const Slice& key,
+                           const AddCombiner::Requests& requests) {
+    counters.Apply(key, requests);
+  };
+
+  std::vector<std::thread> threads;
+  std::vector<std::vector<int64_t>> rets(8);
+  for (int thread_idx = 0; thread_idx < 8; ++thread_idx) {
+    threads.push_back(std::thread([&, thread_idx]() {
+      for (int idx = 0; idx < 200; ++idx) {
+        std::string key = idx % 10 ? "HOT_KEY" : "COLD_KEY";
+        AddCombiner::Request request(key, {1, 0});
+        ASSERT_TRUE(combiner.Run(&lock_mgr, &request, apply).ok());
+        if (key == "HOT_KEY") {
+          rets[thread_idx].push_back(request.op.ret);
+        }
+      }
+    }));
+  }
+  for (auto& thread : threads) {
+    thread.join();
+  }
+
+  ASSERT_EQ(counters.hot, 1440);
+  ASSERT_EQ(counters.cold, 160);
+  ASSERT_LT(counters.batches, 1600);
+  ASSERT_GT(counters.max_batch, 1);
+
+  // Every request got its own result
+  std::vector<int64_t> all;
+  for (const auto& thread_rets : rets) {
+    ASSERT_TRUE(std::is_sorted(thread_rets.begin(), thread_rets.end()));
+    all.insert(all.end(), thread_rets.begin(), thread_rets.end());
+  }
+  std::sort(all.begin(), all.end());
+  for (size_t idx = 0; idx < all.size(); ++idx) {
+    ASSERT_EQ(all[idx], idx + 1);
+  }
+}
+
+// A failed request
+TEST(WriteCombinerTest, StatusTest) {
+  LockMgr lock_mgr(1024);
+  AddCombiner combiner;
+  Counters counters = {0, 0, 0, 0};
+  auto apply = [&counters](const Slice& key,
+                           const AddCombiner::Requests& requests) {
+    counters.Apply(key, requests);
+  };
+  AddCombiner::Request request("HOT_KEY", {-1, 0});
+  ASSERT_TRUE(combiner.Run(&lock_mgr, &request, apply).IsInvalidArgument());
+
+  // Given up on by its deadline
+  ASSERT_TRUE(lock_mgr.Lock("HOT_KEY").ok());
+  std::thread thread([&]() {
+    LockDeadline deadline(1000);
+    AddCombiner::Request request("HOT_KEY", {1, 0});
+    ASSERT_TRUE(combiner.Run(&lock_mgr, &request, apply).IsTimedOut());
+  });
+  thread.join();
+  lock_mgr.UnLock("HOT_KEY");
+  ASSERT_EQ(counters.batches, 1);
+}
+
+int main(int argc, char** argv) {
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
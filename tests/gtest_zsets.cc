@@ -4862,6 +4862,116 @@ TEST_F(ZSetsTest, ZScanTest) {
   ASSERT_TRUE(score_members_match(score_member_out, {}));
 }
 
+// ZScan with stateless cursor
+TEST_F(ZSetsTest, ZScanStatelessCursorTest) {
+  int32_t ret = 0;
+  std::string cursor, next_cursor;
+  std::vector<ScoreMember> score_member_out;
+
+  // {0,a} {0,b_1} {0,b_2} {0,b_3} {0,c}
+  std::vector<ScoreMember> gp1_score_member {{0, "a"}, {0, "b_1"}, {0, "b_2"},
+                                             {0, "b_3"}, {0, "c"}};
+  s = db.ZAdd("GP1_ZSCAN_CURSOR_KEY", gp1_score_member, &ret);
+  ASSERT_TRUE(s.ok());
+
+  // The scan starts from the prefix of the pattern
+  s = db.ZScan("GP1_ZSCAN_CURSOR_KEY", "", "b_*", 2, &score_member_out, &next_cursor);
+  ASSERT_TRUE(s.ok());
+  ASSERT_TRUE(score_members_match(score_member_out, {{0, "b_1"}, {0, "b_2"}}));
+  ASSERT_FALSE(next_cursor.empty());
+
+  cursor = next_cursor;
+  s = db.ZScan("GP1_ZSCAN_CURSOR_KEY", cursor, "b_*", 2, &score_member_out, &next_cursor);
+  ASSERT_TRUE(s.ok());
+  ASSERT_TRUE(score_members_match(score_member_out, {{0, "b_3"}}));
+  ASSERT_TRUE(next_cursor.empty());
+
+  s = db.ZScan("GP1_ZSCAN_CURSOR_KEY", "hb_1", "*", 2, &score_member_out, &next_cursor);
+  ASSERT_TRUE(s.IsInvalidArgument());
+}
+
+
+// ZIncrby with write combining
+TEST_F(ZSetsTest, ZIncrbyCombiningTest) {
+  db.EnableWriteCombining(true);
+  std::vector<std::thread> threads;
+  for (int thread_idx = 0; thread_idx < 8; ++thread_idx) {
+    threads.push_back(std::thread([this]() {
+      double ret;
+      for (int idx = 0; idx < 1000; ++idx) {
+        ASSERT_TRUE(db.ZIncrby("ZINCRBY_COMBINING_KEY",
+                               idx % 2 ? "ODD" : "EVEN", 1, &ret).ok());
+      }
+    }));
+  }
+  for (auto& thread : threads) {
+    thread.join();
+  }
+  db.EnableWriteCombining(false);
+
+  // The score keys of the intermediate scores are gone
+  std::vector<ScoreMember> score_members;
+  s = db.ZRange("ZINCRBY_COMBINING_KEY", 0, -1, &score_members);
+  ASSERT_TRUE(s.ok());
+  ASSERT_EQ(score_members.size(), 2);
+  ASSERT_EQ(score_members[0].score, 4000);
+  ASSERT_EQ(score_members[1].score, 4000);
+  int32_t card;
+  s = db.ZCard("ZINCRBY_COMBINING_KEY", &card);
+  ASSERT_TRUE(s.ok());
+  ASSERT_EQ(card, 2);
+}
+
+// ZAdd and ZRem of many members, probed by a sweep or a MultiGet
+TEST_F(ZSetsTest, ZAddManyMembersTest) {
+  int32_t ret;
+  std::vector<ScoreMember> score_members;
+  for (int idx = 0; idx < 200; idx += 2) {
+    score_members.push_back({static_cast<double>(idx),
+                             "MEMBER" + std::to_string(idx)});
+  }
+  s = db.ZAdd("ZADD_MANY_KEY", score_members, &ret);
+  ASSERT_TRUE(s.ok());
+  ASSERT_EQ(ret, 100);
+
+  // Dense, half of the members exist and half of those get a new score
+  score_members.clear();
+  for (int idx = 0; idx < 200; ++idx) {
+    score_members.push_back({static_cast<double>(idx % 4 ? idx : idx + 1000),
+                             "MEMBER" + std::to_string(idx)});
+  }
+  s = db.ZAdd("ZADD_MANY_KEY", score_members, &ret);
+  ASSERT_TRUE(s.ok());
+  ASSERT_EQ(ret, 100);
+  int32_t card;
+  s = db.ZCard("ZADD_MANY_KEY", &card);
+  ASSERT_TRUE(s.ok());
+  ASSERT_EQ(card, 200);
+  double score;
+  s = db.ZScore("ZADD_MANY_KEY", "MEMBER4", &score);
+  ASSERT_TRUE(s.ok());
+  ASSERT_EQ(score, 1004);
+  s = db.ZScore("ZADD_MANY_KEY", "MEMBER6", &score);
+  ASSERT_TRUE(s.ok());
+  ASSERT_EQ(score, 6);
+
+  // Sparse
+  std::vector<std::string> members;
+  for (int idx = 0; idx < 10; ++idx) {
+    members.push_back("MEMBER" + std::to_string(idx * 50));
+  }
+  members.push_back("NOT_A_MEMBER");
+  s = db.ZRem("ZADD_MANY_KEY", members, &ret);
+  ASSERT_TRUE(s.ok());
+  ASSERT_EQ(ret, 4);
+  s = db.ZCard("ZADD_MANY_KEY", &card);
+  ASSERT_TRUE(s.ok());
+  ASSERT_EQ(card, 196);
+  std::vector<ScoreMember> range;
+  s = db.ZRangebyscore("ZADD_MANY_KEY", 1000, 2000, true, true, &range);
+  ASSERT_TRUE(s.ok());
+  ASSERT_EQ(range.size(), 48);
+}
 
 int main(int argc, char** argv) {
   ::testing::InitGoogleTest(&argc, argv);
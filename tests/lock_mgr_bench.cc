@@ -0,0 +1,57 @@
+//  Copyright (c) 2017-present, Qihoo, Inc.  All rights reserved.
+//  This source code is licensed under the BSD-style license found in the
+//  LICENSE file in the root directory of this source tree. An additional grant
+//  of patent rights can be found in the PATENTS file in the same directory.
+
+#include <stdio.h>
+#include <chrono>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "src/lock_mgr.h"
+
+using namespace blackwidow;
+
+static const int kLocksPerThread = 1000000;
+
+// Lock and unlock keys, every thread on its own keys or all on the same one
+static void LockLoop(LockMgr* mgr, int id, bool contended) {
+  std::vector<std::string> keys;
+  for (int idx = 0; idx < 64; ++idx) {
+    keys.push_back(contended ? "HOT_KEY"
+                   : "key_" + std::to_string(id) + "_" + std::to_string(idx));
+  }
+  for (int idx = 0; idx < kLocksPerThread; ++idx) {
+    const std::string& key = keys[idx % keys.size()];
+    mgr->TryLock(key);
+    mgr->UnLock(key);
+  }
+}
+
+static void Bench(int num_threads, bool contended) {
+  LockMgr mgr(1024);
+  std::vector<std::thread> threads;
+  auto start = std::chrono::steady_clock::now();
+  for (int idx = 0; idx < num_threads; ++idx) {
+    threads.push_back(std::thread(LockLoop, &mgr, idx, contended));
+  }
+  for (auto& thread : threads) {
+    thread.join();
+  }
+  double seconds = std::chrono::duration<double>(
+      std::chrono::steady_clock::now() - start).count();
+  printf("%-12s threads %2d: %10.0f locks/s\n",
+         contended ? "contended" : "uncontended", num_threads,
+         num_threads * kLocksPerThread / seconds);
+}
+
+int main() {
+  for (int num_threads = 1; num_threads <= 16; num_threads *= 2) {
+    Bench(num_threads, false);
+  }
+  for (int num_threads = 1; num_threads <= 16; num_threads *= 2) {
+    Bench(num_threads, true);
+  }
+  return 0;
+}